@@ -0,0 +1,130 @@
+#include "console_input.h"
+#include "ci_internal.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WINDOW 256 /* lines a deferring handler holds on to at once */
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    ci_queue queue;
+    size_t count;
+    bool arena;
+} handoff;
+
+/* Consumer: drop each line handed over, as a worker finishing deferred work would. */
+static void *release_thread(void *arg) {
+    handoff *h = arg;
+    for (size_t done = 0; done < h->count;) {
+        void *item;
+        if (!ci_queue_pop(&h->queue, &item)) {
+            sched_yield();
+            continue;
+        }
+        if (h->arena) {
+            ci_line_release(item);
+        } else {
+            free(item);
+        }
+        done++;
+    }
+    return NULL;
+}
+
+static char *copy_line(ci_arena *arena, const char *line, size_t len) {
+    if (arena) return ci_arena_copy(arena, line, len);
+    char *copy = malloc(len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, line, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+/* The handler keeps the last WINDOW lines and drops the oldest on this thread. */
+static double run_local(ci_arena *arena, const char *line, size_t len, size_t count) {
+    char *held[WINDOW] = {0};
+    double start = now_sec();
+    for (size_t i = 0; i < count; i++) {
+        char *copy = copy_line(arena, line, len);
+        if (!copy) exit(1);
+        if (arena) {
+            ci_line_release(held[i % WINDOW]);
+        } else {
+            free(held[i % WINDOW]);
+        }
+        held[i % WINDOW] = copy;
+    }
+    double t = now_sec() - start;
+    for (size_t i = 0; i < WINDOW; i++) {
+        if (arena) {
+            ci_line_release(held[i]);
+        } else {
+            free(held[i]);
+        }
+    }
+    return t;
+}
+
+/* The handler passes every line to another thread, which drops it. */
+static double run_handoff(ci_arena *arena, const char *line, size_t len, size_t count) {
+    handoff h;
+    if (!ci_queue_init(&h.queue, WINDOW)) exit(1);
+    h.count = count;
+    h.arena = arena != NULL;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, release_thread, &h) != 0) exit(1);
+
+    double start = now_sec();
+    for (size_t i = 0; i < count; i++) {
+        char *copy = copy_line(arena, line, len);
+        if (!copy) exit(1);
+        while (!ci_queue_push(&h.queue, copy)) sched_yield();
+    }
+    pthread_join(thread, NULL);
+    double t = now_sec() - start;
+    ci_queue_destroy(&h.queue);
+    return t;
+}
+
+/*
+ * A handler that defers work retains each line for a while. Compare copying
+ * each line with malloc and freeing it later against copying it into the
+ * arena and releasing it, with the release on the same thread or on another.
+ */
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 5000000;
+    static const size_t lens[] = {16, 80, 400};
+    char line[512];
+    memset(line, 'x', sizeof(line));
+
+    printf("bench_arena: %zu lines per case\n", count);
+    for (int mode = 0; mode < 2; mode++) {
+        for (size_t c = 0; c < sizeof(lens) / sizeof(lens[0]); c++) {
+            size_t len = lens[c];
+            double (*run)(ci_arena *, const char *, size_t, size_t) = mode ? run_handoff : run_local;
+
+            double t_malloc = run(NULL, line, len, count);
+            ci_arena *arena = ci_arena_create(0);
+            if (!arena) return 1;
+            double t_arena = run(arena, line, len, count);
+            ci_arena_stats stats;
+            ci_arena_get_stats(arena, &stats);
+            ci_arena_destroy(arena);
+
+            printf("%-8s %3zu B  malloc/free %6.1f Mlines/s   arena %6.1f Mlines/s   %.2fx  (%zu chunk mallocs)\n",
+                   mode ? "handoff" : "local", len, (double)count / t_malloc / 1e6, (double)count / t_arena / 1e6,
+                   t_malloc / t_arena, stats.chunk_allocs);
+        }
+    }
+    return 0;
+}
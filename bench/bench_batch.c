@@ -0,0 +1,105 @@
+#include "console_input.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static unsigned long lines_seen = 0;
+static unsigned long bytes_seen = 0;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void line_cb(const char *line, void *user_data) {
+    (void)user_data;
+    lines_seen++;
+    bytes_seen += strlen(line);
+}
+
+static void batch_cb(const ci_line_view *lines, size_t count, void *user_data) {
+    (void)user_data;
+    for (size_t i = 0; i < count; i++) {
+        bytes_seen += lines[i].len;
+    }
+    lines_seen += count;
+}
+
+static char *payload = NULL;
+static size_t payload_size = 0;
+
+static void make_payload(size_t lines) {
+    payload = malloc(lines * 32);
+    if (!payload) exit(1);
+    for (size_t i = 0; i < lines; i++) {
+        payload_size += (size_t)sprintf(payload + payload_size, "metric.%zu %zu\n", i % 977, i);
+    }
+}
+
+/* Feed the payload into stdin through a pipe from a child process; returns the child pid. */
+static pid_t feed_stdin(void) {
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        size_t off = 0;
+        while (off < payload_size) {
+            ssize_t n = write(fds[1], payload + off, payload_size - off);
+            if (n <= 0) _exit(1);
+            off += (size_t)n;
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    dup2(fds[0], STDIN_FILENO);
+    close(fds[0]);
+    return pid;
+}
+
+static void run(const char *name, const ci_async_options *opts, size_t lines) {
+    lines_seen = 0;
+    bytes_seen = 0;
+    pid_t pid = feed_stdin();
+
+    double start = now_sec();
+    if (ci_start_async_input_ex(NULL, line_cb, NULL, opts) != CI_OK) {
+        fprintf(stderr, "start failed\n");
+        exit(1);
+    }
+    /* a registered command keeps the per-line lookup in the measured path */
+    ci_register_command("q", line_cb, NULL);
+    while (ci_async_is_running()) {
+        struct timespec ts = {0, 1000000};
+        nanosleep(&ts, NULL);
+    }
+    double elapsed = now_sec() - start;
+    ci_stop_async_input();
+    waitpid(pid, NULL, 0);
+
+    if (lines_seen != lines) {
+        fprintf(stderr, "%s: expected %zu lines, got %lu\n", name, lines, lines_seen);
+        exit(1);
+    }
+    printf("%-10s %8.2f Mlines/s\n", name, (double)lines / elapsed / 1e6);
+}
+
+int main(int argc, char **argv) {
+    size_t lines = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 2000000;
+    make_payload(lines);
+    printf("bench_batch: %zu lines, %zu bytes over a pipe\n", lines, payload_size);
+
+    run("per-line", NULL, lines);
+
+    ci_async_options opts = {0};
+    opts.batch_callback = batch_cb;
+    opts.max_batch = 256;
+    run("batch", &opts, lines);
+    free(payload);
+    return 0;
+}
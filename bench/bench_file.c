@@ -0,0 +1,91 @@
+#include "console_input.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* A light handler: parse the numbers on the line and fold them into a per-call sum. */
+static void parse_cb(const char *line, void *user_data) {
+    (void)user_data;
+    static __thread unsigned long long sink;
+    for (const char *p = line; *p;) {
+        char *end;
+        sink += strtoull(p, &end, 10);
+        if (end == p) break;
+        p = end;
+    }
+}
+
+static void set_cb(const char *line, void *user_data) {
+    parse_cb(line, user_data);
+}
+
+/* Replay a generated record file: an fgets loop vs ci_process_file on 1..N threads. */
+int main(int argc, char **argv) {
+    size_t lines = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 4000000;
+    char path[] = "/tmp/ci_bench_file_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return 1;
+    FILE *f = fdopen(fd, "w");
+    if (!f) return 1;
+    for (size_t i = 0; i < lines; i++) {
+        if (i % 16 == 0) {
+            fputs("set\n", f);
+        } else {
+            fprintf(f, "%zu %zu %zu\n", i, i * 7, i * 13);
+        }
+    }
+    fclose(f);
+    FILE *in = fopen(path, "r");
+    if (!in) return 1;
+    fseek(in, 0, SEEK_END);
+    double mb = (double)ftell(in) / 1e6;
+    fclose(in);
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned max_threads = online > 0 ? (unsigned)online : 1;
+    ci_register_command("set", set_cb, NULL);
+    printf("bench_file: %zu lines, %.1f MB, %u online CPUs\n", lines, mb, max_threads);
+
+    /* baseline: the same callbacks fed by an fgets loop on one thread */
+    ci_file_options one = {1, true, 0, NULL};
+    ci_process_file(path, parse_cb, NULL, &one); /* warm the page cache */
+    in = fopen(path, "r");
+    double start = now_sec();
+    char buf[256];
+    while (fgets(buf, sizeof(buf), in)) {
+        buf[strcspn(buf, "\n")] = '\0';
+        if (strcmp(buf, "set") == 0) {
+            set_cb(buf, NULL);
+        } else {
+            parse_cb(buf, NULL);
+        }
+    }
+    double t_base = now_sec() - start;
+    fclose(in);
+    printf("fgets loop            %8.1f MB/s\n", mb / t_base);
+
+    for (int ordered = 0; ordered <= 1; ordered++) {
+        for (unsigned threads = 1; threads <= max_threads;) {
+            ci_file_options opts = {threads, ordered != 0, 0, NULL};
+            start = now_sec();
+            ci_process_file(path, parse_cb, NULL, &opts);
+            double t = now_sec() - start;
+            printf("%-9s %3u threads %8.1f MB/s   %.2fx fgets\n", ordered ? "ordered" : "unordered", threads,
+                   mb / t, t_base / t);
+            if (threads == max_threads) break;
+            threads = threads * 2 < max_threads ? threads * 2 : max_threads;
+        }
+    }
+
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "console_input.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FIELD 32 /* bytes per number slot, NUL-terminated for strtod */
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t rng_next(uint64_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 1000000;
+    static const struct {
+        const char *name;
+        const char *format;
+        int kind; /* 0: uniform [0,1), 1: random bit patterns, 2: prices */
+    } cases[] = {{"uniform %.17g", "%.17g", 0}, {"any bits %.17g", "%.17g", 1}, {"short %.6g", "%.6g", 0},
+                 {"prices %.2f", "%.2f", 2}};
+    char *slots = malloc(count * FIELD);
+    size_t *lens = malloc(count * sizeof(*lens));
+    if (!slots || !lens) return 1;
+
+    printf("bench_float: %zu numbers per case\n", count);
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t r = rng_next(&x);
+            double v;
+            if (cases[c].kind == 1) {
+                r &= 0x7FEFFFFFFFFFFFFFull; /* finite */
+                memcpy(&v, &r, sizeof(v));
+            } else {
+                v = (double)(r >> 11) / 9007199254740992.0;
+                if (cases[c].kind == 2) v *= 10000.0;
+            }
+            int n = snprintf(slots + i * FIELD, FIELD, cases[c].format, v);
+            lens[i] = (size_t)n;
+        }
+
+        double sum_ref = 0.0;
+        double start = now_sec();
+        for (size_t i = 0; i < count; i++) sum_ref += strtod(slots + i * FIELD, NULL);
+        double t_ref = now_sec() - start;
+
+        double sum = 0.0;
+        start = now_sec();
+        for (size_t i = 0; i < count; i++) {
+            double v = 0.0;
+            ci_parse_double(slots + i * FIELD, lens[i], 0, &v);
+            sum += v;
+        }
+        double t_ci = now_sec() - start;
+
+        printf("%-15s strtod %7.1f Mnum/s   ci_parse_double %7.1f Mnum/s   %.2fx%s\n", cases[c].name,
+               (double)count / t_ref / 1e6, (double)count / t_ci / 1e6, t_ref / t_ci,
+               sum == sum_ref ? "" : "  (MISMATCH)");
+    }
+
+    free(lens);
+    free(slots);
+    return 0;
+}
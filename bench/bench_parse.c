@@ -0,0 +1,114 @@
+#include "console_input.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FIELD 24 /* bytes per number slot, NUL-terminated for strtoll */
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Fill slots with numbers of roughly max_digits decimal digits (or hex digits). */
+static void fill(char *slots, size_t *lens, size_t count, unsigned max_digits, unsigned base) {
+    uint64_t x = 0x2545F4914F6CDD1Dull;
+    for (size_t i = 0; i < count; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        unsigned digits = 1 + (unsigned)(x % max_digits);
+        char *p = slots + i * FIELD;
+        size_t n = 0;
+        if (base == 10 && (x >> 40) & 1) p[n++] = '-';
+        p[n++] = "123456789abcdef"[(x >> 20) % (base - 1)];
+        for (unsigned d = 1; d < digits; d++) p[n++] = "0123456789abcdef"[(x >> (d * 3)) % base];
+        p[n] = '\0';
+        lens[i] = n;
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 1000000;
+    static const struct {
+        const char *name;
+        unsigned digits;
+        unsigned base;
+    } cases[] = {{"dec 1-4", 4, 10}, {"dec 1-10", 10, 10}, {"dec 1-18", 18, 10}, {"hex 1-15", 15, 16}};
+    char *slots = malloc(count * FIELD);
+    size_t *lens = malloc(count * sizeof(*lens));
+    if (!slots || !lens) return 1;
+
+    printf("bench_parse: %zu numbers per case\n", count);
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        unsigned base = cases[c].base;
+        fill(slots, lens, count, cases[c].digits, base);
+
+        int64_t sum_ref = 0;
+        double start = now_sec();
+        for (size_t i = 0; i < count; i++) {
+            char *end;
+            errno = 0;
+            sum_ref += strtoll(slots + i * FIELD, &end, (int)base);
+        }
+        double t_ref = now_sec() - start;
+
+        int64_t sum = 0;
+        start = now_sec();
+        for (size_t i = 0; i < count; i++) {
+            int64_t v = 0;
+            ci_parse_int64(slots + i * FIELD, lens[i], base, &v);
+            sum += v;
+        }
+        double t_ci = now_sec() - start;
+
+        printf("%-9s strtoll %7.1f Mnum/s   ci_parse_int64 %7.1f Mnum/s   %.2fx%s\n", cases[c].name,
+               (double)count / t_ref / 1e6, (double)count / t_ci / 1e6, t_ref / t_ci,
+               sum == sum_ref ? "" : "  (MISMATCH)");
+    }
+
+    /* one long line of space-separated values: list parser vs a strtoll loop */
+    fill(slots, lens, count, 10, 10);
+    char *line = malloc(count * FIELD);
+    if (!line) return 1;
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(line + len, slots + i * FIELD, lens[i]);
+        len += lens[i];
+        line[len++] = ' ';
+    }
+    line[len - 1] = '\0';
+
+    double start = now_sec();
+    int64_t sum_ref = 0;
+    size_t n_ref = 0;
+    for (char *p = line, *end; *p; p = end) {
+        sum_ref += strtoll(p, &end, 10);
+        n_ref++;
+        if (end == p) break;
+    }
+    double t_ref = now_sec() - start;
+
+    ci_int_list list = {0};
+    list.growable = true;
+    ci_parse_int_list(line, len - 1, &list); /* warm the growable arrays */
+    start = now_sec();
+    ci_parse_int_list(line, len - 1, &list);
+    double t_ci = now_sec() - start;
+    int64_t sum = 0;
+    for (size_t i = 0; i < list.count; i++) sum += list.values[i];
+
+    printf("line list strtoll %7.1f MB/s      ci_parse_int_list %7.1f MB/s   %.2fx%s\n", (double)len / t_ref / 1e6,
+           (double)len / t_ci / 1e6, t_ref / t_ci, sum == sum_ref && list.count == n_ref ? "" : "  (MISMATCH)");
+
+    ci_int_list_free(&list);
+    free(line);
+    free(lens);
+    free(slots);
+    return 0;
+}
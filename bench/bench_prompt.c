@@ -0,0 +1,95 @@
+#include "console_input.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Write syscalls made by this process so far, from /proc/self/io. */
+static unsigned long long write_syscalls(void) {
+    FILE *f = fopen("/proc/self/io", "r");
+    if (!f) return 0;
+    char line[128];
+    unsigned long long count = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "syscw: %llu", &count) == 1) break;
+    }
+    fclose(f);
+    return count;
+}
+
+/* Producer end of the pipe, in a child so its writes are not counted: every 50th number is malformed. */
+static void feed(int fd, size_t lines) {
+    FILE *out = fdopen(fd, "w");
+    if (!out) _exit(1);
+    for (size_t i = 0; i < lines; i++) {
+        if (i % 50 == 49) {
+            fputs("oops\n", out);
+        } else {
+            fprintf(out, "%zu\n", i);
+        }
+    }
+    fclose(out);
+    _exit(0);
+}
+
+/*
+ * Read a piped stream of numbers with ci_read_int, with stdout on /dev/null,
+ * and count the write syscalls made for prompts and diagnostics. "flush per
+ * prompt" reproduces the old behaviour, an fflush after every message.
+ */
+int main(int argc, char **argv) {
+    size_t lines = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 200000;
+    static const char *names[] = {"flush per prompt", "CI_PROMPT_ALWAYS", "CI_PROMPT_TTY"};
+
+    int devnull = open("/dev/null", O_WRONLY);
+    int saved_stdout = dup(STDOUT_FILENO);
+    if (devnull < 0 || saved_stdout < 0) return 1;
+    FILE *report = fdopen(saved_stdout, "w");
+    if (!report) return 1;
+    fprintf(report, "bench_prompt: %zu piped lines, stdout on /dev/null\n", lines);
+
+    for (int mode = 0; mode < 3; mode++) {
+        int fds[2];
+        fflush(report);
+        if (pipe(fds) != 0) return 1;
+        dup2(fds[0], STDIN_FILENO);
+        close(fds[0]);
+        pid_t child = fork();
+        if (child < 0) return 1;
+        if (child == 0) feed(fds[1], lines);
+        close(fds[1]);
+        dup2(devnull, STDOUT_FILENO);
+
+        ci_set_prompt_policy(mode == 0 ? CI_PROMPT_NEVER : mode == 1 ? CI_PROMPT_ALWAYS : CI_PROMPT_TTY);
+        unsigned long long writes = write_syscalls();
+        double start = now_sec();
+        size_t values = 0;
+        int value;
+        for (;;) {
+            if (mode == 0) {
+                fputs("n: ", stdout);
+                fflush(stdout);
+            }
+            if (ci_read_int("n: ", &value) != CI_OK) break;
+            values++;
+        }
+        fflush(stdout);
+        double t = now_sec() - start;
+        writes = write_syscalls() - writes;
+        waitpid(child, NULL, 0);
+
+        fprintf(report, "%-17s %8llu write syscalls  %6.3f per line  %7.1f Klines/s  (%zu values)\n", names[mode],
+                writes, (double)writes / (double)lines, (double)lines / t / 1e3, values);
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include "ci_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static size_t count_lines(ci_scan_fn fn, const char *data, size_t size) {
+    size_t lines = 0;
+    const char *p = data;
+    const char *end = data + size;
+    const char *nl;
+    while ((nl = fn(p, (size_t)(end - p), '\n')) != NULL) {
+        lines++;
+        p = nl + 1;
+    }
+    return lines;
+}
+
+int main(int argc, char **argv) {
+    size_t mb = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 64;
+    size_t size = mb * 1024 * 1024;
+    static const size_t line_lens[] = {16, 80, 1024};
+    char *data = malloc(size);
+    if (!data) return 1;
+
+    size_t count = 0;
+    const ci_scan_variant *variants = ci_scan_variants(&count);
+    printf("bench_scan: %zu MB, dispatch selects %s\n", mb, ci_scan_selected());
+
+    for (size_t l = 0; l < sizeof(line_lens) / sizeof(line_lens[0]); l++) {
+        for (size_t i = 0; i < size; i++) {
+            data[i] = (i % line_lens[l] == line_lens[l] - 1) ? '\n' : (char)('a' + i % 26);
+        }
+        for (size_t v = 0; v < count; v++) {
+            double start = now_sec();
+            size_t lines = count_lines(variants[v].fn, data, size);
+            double elapsed = now_sec() - start;
+            printf("line %-5zu %-7s %8.2f GB/s (%zu lines)\n", line_lens[l], variants[v].name,
+                   (double)size / elapsed / 1e9, lines);
+        }
+    }
+
+    free(data);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "console_input.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void line_cb(const char *line, void *user_data) {
+    (void)line;
+    (*(size_t *)user_data)++;
+}
+
+/* Run a file through a context's line loop; returns seconds from start to end of input. */
+static double run(const char *path, bool stats, size_t *lines, ci_stats *out) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) exit(1);
+    ci_context *ctx = ci_context_create(fd, NULL);
+    if (!ctx) exit(1);
+    ci_context_enable_stats(ctx, stats);
+
+    double start = now_sec();
+    if (ci_context_start(ctx, NULL, line_cb, lines, NULL) != CI_OK) exit(1);
+    ci_context_register_command(ctx, "set", line_cb, lines, 0);
+    while (ci_context_is_running(ctx)) {
+        struct timespec ts = {0, 100000};
+        nanosleep(&ts, NULL);
+    }
+    double t = now_sec() - start;
+    ci_context_get_stats(ctx, out);
+    ci_context_destroy(ctx);
+    close(fd);
+    return t;
+}
+
+/* Cost of the instrumentation on the line loop: stats off (the default) against on. */
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 4000000;
+    char path[] = "/tmp/ci_bench_stats_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return 1;
+    FILE *f = fdopen(fd, "w");
+    if (!f) return 1;
+    for (size_t i = 0; i < count; i++) {
+        if (i % 8 == 0) {
+            fputs("set\n", f);
+        } else {
+            fprintf(f, "%zu %zu\n", i, i * 7);
+        }
+    }
+    fclose(f);
+
+    printf("bench_stats: %zu lines per run, best of 3\n", count);
+    double best[2] = {1e9, 1e9};
+    ci_stats stats;
+    for (int rep = 0; rep < 3; rep++) {
+        for (int on = 0; on < 2; on++) {
+            size_t lines = 0;
+            double t = run(path, on != 0, &lines, &stats);
+            if (t < best[on]) best[on] = t;
+        }
+    }
+    printf("stats off  %7.1f Mlines/s  %5.1f ns/line\n", (double)count / best[0] / 1e6, best[0] / (double)count * 1e9);
+    printf("stats on   %7.1f Mlines/s  %5.1f ns/line  (+%.1f ns/line)\n", (double)count / best[1] / 1e6,
+           best[1] / (double)count * 1e9, (best[1] - best[0]) / (double)count * 1e9);
+    printf("last run: %llu lines, %llu hits, read-to-dispatch p50 %llu ns p99 %llu ns, callback p50 %llu ns p99 %llu ns\n",
+           (unsigned long long)stats.lines, (unsigned long long)stats.command_hits,
+           (unsigned long long)stats.read_to_dispatch.p50_ns, (unsigned long long)stats.read_to_dispatch.p99_ns,
+           (unsigned long long)stats.callback.p50_ns, (unsigned long long)stats.callback.p99_ns);
+    unlink(path);
+    return 0;
+}
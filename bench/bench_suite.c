@@ -0,0 +1,557 @@
+#include "console_input.h"
+#include "ci_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LINE_MAX_BYTES 256
+#define LOOKUPS 4000000
+#define PARSES 4000000
+#define FIELD 24
+#define INJECTS 2097152 /* a multiple of every producers * burst */
+
+/* Set by `make bench`, so results from differently built versions can be told apart. */
+#ifndef CI_BENCH_CFLAGS
+#define CI_BENCH_CFLAGS "unknown"
+#endif
+
+/*
+ * Machine-readable results for tracking regressions between versions:
+ * one row per (bench, source, param, metric). Run through `make bench`, or
+ * directly: bench_suite [--format csv|json] [--size-mb N] [--source pipe|file|all]
+ * [--label TEXT] [--out FILE].
+ */
+typedef struct {
+    FILE *out;
+    bool json;
+    bool first;
+    const char *label;
+} report;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report_begin(report *r) {
+    if (r->json) {
+        fprintf(r->out, "{\"label\": \"%s\", \"compiler\": \"%s\", \"cflags\": \"%s\", \"results\": [", r->label,
+                __VERSION__, CI_BENCH_CFLAGS);
+    } else {
+        fprintf(r->out, "label,bench,source,param,metric,value,unit,compiler,cflags\n");
+    }
+    r->first = true;
+}
+
+static void report_end(report *r) {
+    if (r->json) fprintf(r->out, "\n]}\n");
+    fflush(r->out);
+}
+
+static void emit(report *r, const char *bench, const char *source, const char *param, const char *metric, double value,
+                 const char *unit) {
+    if (r->json) {
+        fprintf(r->out,
+                "%s\n  {\"bench\": \"%s\", \"source\": \"%s\", \"param\": \"%s\", \"metric\": \"%s\", "
+                "\"value\": %.6g, \"unit\": \"%s\"}",
+                r->first ? "" : ",", bench, source, param, metric, value, unit);
+    } else {
+        fprintf(r->out, "%s,%s,%s,%s,%s,%.6g,%s,\"%s\",\"%s\"\n", r->label, bench, source, param, metric, value, unit,
+                __VERSION__, CI_BENCH_CFLAGS);
+    }
+    r->first = false;
+}
+
+/* Lines of 8..71 letters, as bench_read uses. */
+static char *make_payload(size_t size, size_t *lines_out) {
+    char *data = malloc(size);
+    if (!data) return NULL;
+    size_t pos = 0, lines = 0;
+    unsigned seed = 12345;
+    while (pos < size) {
+        seed = seed * 1103515245u + 12345u;
+        size_t len = 8 + (seed >> 16) % 64;
+        if (pos + len + 1 > size) len = size - pos - 1;
+        for (size_t i = 0; i < len; i++) data[pos + i] = (char)('a' + (i + lines) % 26);
+        pos += len;
+        data[pos++] = '\n';
+        lines++;
+    }
+    *lines_out = lines;
+    return data;
+}
+
+typedef struct {
+    const char *data;
+    size_t size;
+    const char *path; /* payload written to a file, for the "file" source */
+    pid_t writer;
+} source;
+
+/* Open the payload as a descriptor: a pipe fed by a child process, or the file. */
+static int source_open(source *src, bool pipe_source) {
+    src->writer = -1;
+    if (!pipe_source) return open(src->path, O_RDONLY);
+
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        close(fds[0]);
+        for (size_t off = 0; off < src->size;) {
+            ssize_t n = write(fds[1], src->data + off, src->size - off);
+            if (n <= 0) _exit(1);
+            off += (size_t)n;
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    src->writer = pid;
+    return fds[0];
+}
+
+static void source_close(source *src, int fd) {
+    close(fd);
+    if (src->writer > 0) waitpid(src->writer, NULL, 0);
+}
+
+static void bench_sync_read(report *r, source *src, bool pipe_source, size_t expect) {
+    int fd = source_open(src, pipe_source);
+    if (fd < 0) exit(1);
+    ci_reader *reader = ci_reader_create(fd, 0);
+    if (!reader) exit(1);
+    char buf[LINE_MAX_BYTES];
+    size_t lines = 0;
+    double start = now_sec();
+    for (ci_status st; (st = ci_reader_read_line(reader, buf, sizeof(buf))) != CI_EOF && st != CI_INVALID;) lines++;
+    double t = now_sec() - start;
+    ci_reader_destroy(reader);
+    source_close(src, fd);
+    if (lines != expect) {
+        fprintf(stderr, "sync_read_line: expected %zu lines, got %zu\n", expect, lines);
+        exit(1);
+    }
+    const char *name = pipe_source ? "pipe" : "file";
+    emit(r, "sync_read_line", name, "", "throughput", (double)src->size / t / 1e6, "MB/s");
+    emit(r, "sync_read_line", name, "", "rate", (double)lines / t / 1e6, "Mlines/s");
+}
+
+static void count_cb(const char *line, void *user_data) {
+    (void)line;
+    (*(size_t *)user_data)++;
+}
+
+/* End to end through the async line loop; latencies come from the library's own histograms. */
+static void bench_async(report *r, source *src, bool pipe_source, size_t expect) {
+    const char *name = pipe_source ? "pipe" : "file";
+    for (int timed = 0; timed < 2; timed++) {
+        int fd = source_open(src, pipe_source);
+        if (fd < 0) exit(1);
+        ci_context *ctx = ci_context_create(fd, NULL);
+        if (!ctx) exit(1);
+        ci_context_enable_stats(ctx, timed != 0);
+        size_t lines = 0;
+        double start = now_sec();
+        if (ci_context_start(ctx, NULL, count_cb, &lines, NULL) != CI_OK) exit(1);
+        while (ci_context_is_running(ctx)) {
+            struct timespec ts = {0, 100000};
+            nanosleep(&ts, NULL);
+        }
+        double t = now_sec() - start;
+        ci_stats stats;
+        ci_context_get_stats(ctx, &stats);
+        ci_context_destroy(ctx);
+        source_close(src, fd);
+        if (lines != expect) {
+            fprintf(stderr, "async: expected %zu lines, got %zu\n", expect, lines);
+            exit(1);
+        }
+
+        if (!timed) {
+            /* throughput without the instrumentation's clock reads */
+            emit(r, "async", name, "", "rate", (double)lines / t / 1e6, "Mlines/s");
+            continue;
+        }
+        const ci_latency_stats *l = &stats.read_to_dispatch;
+        emit(r, "async", name, "", "read_to_dispatch_p50", (double)l->p50_ns, "ns");
+        emit(r, "async", name, "", "read_to_dispatch_p99", (double)l->p99_ns, "ns");
+        emit(r, "async", name, "", "read_to_dispatch_p999", (double)l->p999_ns, "ns");
+        emit(r, "async", name, "", "read_to_dispatch_max", (double)l->max_ns, "ns");
+    }
+}
+
+static void nop_cb(const char *line, void *user_data) {
+    (void)line;
+    (void)user_data;
+}
+
+/* Command lookup against command count, for lines that match a command and lines that don't,
+   with the commands registered at run time and as a static perfect-hash table. */
+static void bench_lookup(report *r) {
+    static const size_t sizes[] = {1, 16, 256, 4096};
+    char (*names)[16] = malloc(4096 * sizeof(*names));
+    char (*misses)[16] = malloc(4096 * sizeof(*misses));
+    size_t *lens = malloc(4096 * sizeof(*lens));
+    size_t *miss_lens = malloc(4096 * sizeof(*miss_lens));
+    const char **name_ptrs = malloc(4096 * sizeof(*name_ptrs));
+    ci_command_def *defs = malloc(4096 * sizeof(*defs));
+    if (!names || !misses || !lens || !miss_lens || !name_ptrs || !defs) exit(1);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        for (size_t i = 0; i < n; i++) {
+            lens[i] = (size_t)snprintf(names[i], sizeof(names[i]), "cmd%zu", i);
+            miss_lens[i] = (size_t)snprintf(misses[i], sizeof(misses[i]), "line%zu", i);
+            name_ptrs[i] = names[i];
+            defs[i] = (ci_command_def){names[i], lens[i], nop_cb, NULL, 0};
+        }
+        char param[32];
+        snprintf(param, sizeof(param), "commands=%zu", n);
+
+        for (int fixed = 0; fixed <= 1; fixed++) {
+            ci_registry reg;
+            ci_registry_init(&reg);
+            ci_phash ph = {0};
+            ci_command_table table; /* installed by pointer: must outlive the registry */
+            if (fixed) {
+                if (!ci_phash_build(name_ptrs, lens, n, &ph)) exit(1);
+                table = (ci_command_table){defs, n, ph.seed, ph.displace, ph.bucket_mask, ph.slots, ph.slot_mask};
+                if (ci_registry_set_table(&reg, &table) != CI_OK) exit(1);
+            } else {
+                for (size_t i = 0; i < n; i++) ci_registry_put(&reg, names[i], nop_cb, NULL, 0);
+            }
+
+            for (int hit = 1; hit >= 0; hit--) {
+                char (*keys)[16] = hit ? names : misses;
+                size_t *key_lens = hit ? lens : miss_lens;
+                size_t found = 0;
+                ci_command_entry entry;
+                double start = now_sec();
+                for (size_t i = 0; i < LOOKUPS; i++) {
+                    size_t k = i & (n - 1);
+                    found += ci_registry_lookup(&reg, keys[k], key_lens[k], &entry);
+                }
+                double t = now_sec() - start;
+                if (found != (hit ? LOOKUPS : 0)) exit(1);
+                const char *metric = fixed ? (hit ? "static_hit" : "static_miss") : (hit ? "hit" : "miss");
+                emit(r, "command_lookup", "memory", param, metric, t / LOOKUPS * 1e9, "ns/op");
+            }
+            ci_registry_destroy(&reg);
+            ci_phash_free(&ph);
+        }
+    }
+    free(names);
+    free(misses);
+    free(lens);
+    free(miss_lens);
+    free(name_ptrs);
+    free(defs);
+}
+
+static void nop_args_cb(const char *line, const ci_arg *argv, size_t argc, void *user_data) {
+    (void)line;
+    (void)argv;
+    *(size_t *)user_data += argc;
+}
+
+/* Verb dispatch (trie match plus splitting the arguments) against verb count, case-sensitive and not. */
+static void bench_verbs(report *r) {
+    static const size_t sizes[] = {1, 16, 256, 4096};
+    char (*lines)[80] = malloc(4096 * sizeof(*lines));
+    size_t *lens = malloc(4096 * sizeof(*lens));
+    if (!lines || !lens) exit(1);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        char param[32];
+        snprintf(param, sizeof(param), "verbs=%zu", n);
+        for (int nocase = 0; nocase <= 1; nocase++) {
+            ci_registry reg;
+            ci_registry_init(&reg);
+            size_t args = 0;
+            for (size_t i = 0; i < n; i++) {
+                char verb[32];
+                snprintf(verb, sizeof(verb), "verb%zu", i);
+                ci_registry_put_verb(&reg, verb, nop_args_cb, &args, nocase ? CI_CMD_NOCASE : 0);
+                lens[i] = (size_t)snprintf(lines[i], sizeof(lines[i]), "%s%zu key%zu %zu", nocase ? "VERB" : "verb", i,
+                                           i, i * 7);
+            }
+            double start = now_sec();
+            for (size_t i = 0; i < LOOKUPS; i++) {
+                size_t k = i & (n - 1);
+                ci_registry_dispatch(&reg, lines[k], lens[k], NULL);
+            }
+            double t = now_sec() - start;
+            if (args != (size_t)LOOKUPS * 3) exit(1);
+            emit(r, "verb_dispatch", "memory", param, nocase ? "nocase" : "exact", t / LOOKUPS * 1e9, "ns/op");
+            ci_registry_destroy(&reg);
+        }
+    }
+    free(lines);
+    free(lens);
+}
+
+static void nop_line_cb(const char *line, void *user_data) {
+    (void)line;
+    (*(size_t *)user_data)++;
+}
+
+/* Pattern dispatch through the combined DFA against trying each pattern with fnmatch in turn. */
+static void bench_patterns(report *r) {
+    static const size_t sizes[] = {10, 100, 1000};
+    char (*patterns)[32] = malloc(1000 * sizeof(*patterns));
+    char (*lines)[32] = malloc(1000 * sizeof(*lines));
+    if (!patterns || !lines) exit(1);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        char param[32];
+        snprintf(param, sizeof(param), "patterns=%zu", n);
+        ci_registry reg;
+        ci_registry_init(&reg);
+        size_t calls = 0;
+        for (size_t i = 0; i < n; i++) {
+            static const char *shapes[][2] = {
+                {"get k%zu *", "get k%zu some value"},
+                {"metric.*.r%zu", "metric.cpu.r%zu"},
+                {"job%zu [0-9]*", "job%zu 42"},
+            };
+            snprintf(patterns[i], sizeof(patterns[i]), shapes[i % 3][0], i);
+            snprintf(lines[i], sizeof(lines[i]), shapes[i % 3][1], i);
+            ci_pattern *pattern;
+            if (ci_pattern_compile(patterns[i], nop_line_cb, &calls, 0, &pattern) != CI_OK ||
+                ci_registry_put_pattern(&reg, pattern) != CI_OK) {
+                exit(1);
+            }
+        }
+
+        double start = now_sec();
+        for (size_t i = 0; i < LOOKUPS; i++) {
+            const char *line = lines[i % n];
+            ci_registry_dispatch(&reg, line, strlen(line), NULL);
+        }
+        double t = now_sec() - start;
+        if (calls != LOOKUPS) exit(1);
+        emit(r, "pattern_dispatch", "memory", param, "dfa", t / LOOKUPS * 1e9, "ns/op");
+        ci_registry_destroy(&reg);
+
+        /* the loop costs O(patterns) a line, so it runs fewer lines */
+        size_t loops = LOOKUPS / n, found = 0;
+        start = now_sec();
+        for (size_t i = 0; i < loops; i++) {
+            const char *line = lines[i % n];
+            for (size_t k = 0; k < n; k++) {
+                if (fnmatch(patterns[k], line, 0) == 0) {
+                    found++;
+                    break;
+                }
+            }
+        }
+        t = now_sec() - start;
+        if (found != loops) exit(1);
+        emit(r, "pattern_dispatch", "memory", param, "fnmatch_loop", t / loops * 1e9, "ns/op");
+    }
+    free(patterns);
+    free(lines);
+}
+
+typedef struct {
+    ci_context *ctx;
+    size_t lines;
+    size_t burst;
+    double seconds;
+} inject_producer;
+
+static void *inject_producer_main(void *arg) {
+    inject_producer *p = arg;
+    ci_line_view views[64];
+    for (size_t i = 0; i < p->burst; i++) {
+        views[i].data = "metric.cpu.idle 42";
+        views[i].len = 18;
+    }
+    double start = now_sec();
+    for (size_t i = 0; i < p->lines; i += p->burst) {
+        ci_status status = p->burst == 1 ? ci_context_inject_line(p->ctx, views[0].data, views[0].len)
+                                         : ci_context_inject_lines(p->ctx, views, p->burst);
+        if (status != CI_OK) exit(1);
+    }
+    p->seconds = now_sec() - start;
+    return NULL;
+}
+
+/*
+ * Lines injected from other threads into a context whose input stays idle: the
+ * cost of a push on the producer side, and the rate at which the input thread
+ * dispatches them (until the last one has run).
+ */
+static void bench_inject(report *r) {
+    static const size_t producer_counts[] = {1, 4};
+    static const size_t bursts[] = {1, 64};
+    for (size_t c = 0; c < sizeof(producer_counts) / sizeof(producer_counts[0]); c++) {
+        for (size_t b = 0; b < sizeof(bursts) / sizeof(bursts[0]); b++) {
+            size_t producers = producer_counts[c];
+            char param[32];
+            snprintf(param, sizeof(param), "producers=%zu,burst=%zu", producers, bursts[b]);
+            int fds[2];
+            if (pipe(fds) != 0) exit(1);
+            ci_context *ctx = ci_context_create(fds[0], NULL);
+            size_t lines = 0;
+            if (!ctx || ci_context_start(ctx, NULL, count_cb, &lines, NULL) != CI_OK) exit(1);
+
+            pthread_t threads[4];
+            inject_producer p[4];
+            double start = now_sec();
+            for (size_t i = 0; i < producers; i++) {
+                p[i] = (inject_producer){ctx, INJECTS / producers, bursts[b], 0};
+                if (pthread_create(&threads[i], NULL, inject_producer_main, &p[i]) != 0) exit(1);
+            }
+            double push = 0;
+            for (size_t i = 0; i < producers; i++) {
+                pthread_join(threads[i], NULL);
+                push += p[i].seconds;
+            }
+            ci_context_stop(ctx); /* returns once every queued line has run */
+            double t = now_sec() - start;
+            ci_context_destroy(ctx);
+            close(fds[0]);
+            close(fds[1]);
+            if (lines != INJECTS) {
+                fprintf(stderr, "inject: expected %d lines, got %zu\n", INJECTS, lines);
+                exit(1);
+            }
+            emit(r, "inject", "memory", param, "push", push / INJECTS * 1e9, "ns/line");
+            emit(r, "inject", "memory", param, "rate", (double)INJECTS / t / 1e6, "Mlines/s");
+        }
+    }
+}
+
+/* ci_parse_int64 (same core as ci_read_long's parser) against strtoll on 1..18 digit numbers. */
+static void bench_parse(report *r) {
+    char *slots = malloc((size_t)PARSES * FIELD);
+    size_t *lens = malloc((size_t)PARSES * sizeof(*lens));
+    if (!slots || !lens) exit(1);
+    uint64_t x = 0x2545F4914F6CDD1Dull;
+    for (size_t i = 0; i < PARSES; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        unsigned digits = 1 + (unsigned)(x % 18);
+        char *p = slots + i * FIELD;
+        size_t n = 0;
+        if ((x >> 40) & 1) p[n++] = '-';
+        p[n++] = "123456789"[(x >> 20) % 9];
+        for (unsigned d = 1; d < digits; d++) p[n++] = (char)('0' + (x >> (d * 3)) % 10);
+        p[n] = '\0';
+        lens[i] = n;
+    }
+
+    int64_t sum = 0, sum_ref = 0;
+    double start = now_sec();
+    for (size_t i = 0; i < PARSES; i++) {
+        int64_t v;
+        if (ci_parse_int64(slots + i * FIELD, lens[i], 10, &v) == CI_OK) sum += v;
+    }
+    double t = now_sec() - start;
+    start = now_sec();
+    for (size_t i = 0; i < PARSES; i++) {
+        errno = 0;
+        sum_ref += strtoll(slots + i * FIELD, NULL, 10);
+    }
+    double t_ref = now_sec() - start;
+    if (sum != sum_ref) exit(1);
+    emit(r, "parse_long", "memory", "digits=1-18", "ci_parse_int64", (double)PARSES / t / 1e6, "Mparses/s");
+    emit(r, "parse_long", "memory", "digits=1-18", "strtoll", (double)PARSES / t_ref / 1e6, "Mparses/s");
+    free(slots);
+    free(lens);
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: bench_suite [--format csv|json] [--size-mb N] [--source pipe|file|all] [--label TEXT] "
+            "[--out FILE]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    report r = {stdout, false, true, "dev"};
+    size_t mb = 16;
+    bool use_pipe = true, use_file = true;
+    const char *out_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (i + 1 >= argc) usage();
+        const char *val = argv[++i];
+        if (strcmp(arg, "--format") == 0) {
+            if (strcmp(val, "json") != 0 && strcmp(val, "csv") != 0) usage();
+            r.json = strcmp(val, "json") == 0;
+        } else if (strcmp(arg, "--size-mb") == 0) {
+            mb = (size_t)strtoul(val, NULL, 10);
+            if (mb == 0) usage();
+        } else if (strcmp(arg, "--source") == 0) {
+            use_pipe = strcmp(val, "file") != 0;
+            use_file = strcmp(val, "pipe") != 0;
+        } else if (strcmp(arg, "--label") == 0) {
+            r.label = val;
+        } else if (strcmp(arg, "--out") == 0) {
+            out_path = val;
+        } else {
+            usage();
+        }
+    }
+    if (out_path) {
+        r.out = fopen(out_path, "w");
+        if (!r.out) {
+            perror(out_path);
+            return 1;
+        }
+    }
+
+    size_t expect = 0;
+    source src = {NULL, mb * 1024 * 1024, NULL, -1};
+    char *data = make_payload(src.size, &expect);
+    if (!data) return 1;
+    src.data = data;
+    char path[] = "/tmp/ci_bench_suite_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return 1;
+    for (size_t off = 0; off < src.size;) {
+        ssize_t n = write(fd, data + off, src.size - off);
+        if (n <= 0) return 1;
+        off += (size_t)n;
+    }
+    close(fd);
+    src.path = path;
+
+    report_begin(&r);
+    for (int p = 1; p >= 0; p--) {
+        if (p ? !use_pipe : !use_file) continue;
+        bench_sync_read(&r, &src, p != 0, expect);
+        bench_async(&r, &src, p != 0, expect);
+    }
+    bench_lookup(&r);
+    bench_verbs(&r);
+    bench_patterns(&r);
+    bench_inject(&r);
+    bench_parse(&r);
+    report_end(&r);
+
+    unlink(path);
+    free(data);
+    if (out_path) {
+        fclose(r.out);
+        fprintf(stderr, "bench_suite: results in %s\n", out_path);
+    }
+    return 0;
+}
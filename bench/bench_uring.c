@@ -0,0 +1,120 @@
+#include "console_input.h"
+#include "ci_internal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_LINE_MAX 256
+
+static char *make_payload(size_t size, size_t *lines_out) {
+    char *data = malloc(size);
+    if (!data) return NULL;
+
+    size_t pos = 0, lines = 0;
+    unsigned seed = 12345;
+    while (pos < size) {
+        seed = seed * 1103515245u + 12345u;
+        size_t len = 8 + (seed >> 16) % 64;
+        if (pos + len + 1 > size) len = size - pos - 1;
+        for (size_t i = 0; i < len; i++) {
+            data[pos + i] = (char)('a' + (i + lines) % 26);
+        }
+        pos += len;
+        data[pos++] = '\n';
+        lines++;
+    }
+    *lines_out = lines;
+    return data;
+}
+
+/* Fork a writer that streams the payload into a pipe in 4 KiB writes; returns the read end. */
+static int spawn_writer(const char *data, size_t size, pid_t *pid_out) {
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        close(fds[0]);
+        size_t off = 0;
+        while (off < size) {
+            size_t chunk = size - off < 4096 ? size - off : 4096;
+            ssize_t n = write(fds[1], data + off, chunk);
+            if (n <= 0) _exit(1);
+            off += (size_t)n;
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    *pid_out = pid;
+    return fds[0];
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void run(const char *name, ci_read_backend backend, size_t block, const char *data, size_t size,
+                size_t expect) {
+    pid_t pid;
+    int fd = spawn_writer(data, size, &pid);
+    if (fd < 0) {
+        perror("spawn_writer");
+        exit(1);
+    }
+
+    ci_reader *reader = ci_reader_create(fd, block);
+    if (ci_reader_set_backend(reader, backend) != CI_OK) {
+        printf("%-10s %6zu KiB  unavailable, skipped\n", name, block / 1024);
+        ci_reader_destroy(reader);
+        close(fd);
+        waitpid(pid, NULL, 0);
+        return;
+    }
+
+    char buf[BENCH_LINE_MAX];
+    size_t lines = 0;
+    ci_status st;
+    double start = now_sec();
+    while ((st = ci_reader_read_line(reader, buf, sizeof(buf))) != CI_EOF) {
+        if (st == CI_INVALID) break;
+        lines++;
+    }
+    double elapsed = now_sec() - start;
+    unsigned long syscalls = reader->syscalls;
+    ci_reader_destroy(reader);
+    close(fd);
+    waitpid(pid, NULL, 0);
+
+    if (lines != expect) {
+        fprintf(stderr, "%s: expected %zu lines, got %zu\n", name, expect, lines);
+        exit(1);
+    }
+    double mb = (double)size / (1024.0 * 1024.0);
+    printf("%-10s %6zu KiB %8.1f MB/s %8.2f Mlines/s %9.1f syscalls/MB\n", name, block / 1024,
+           (double)size / elapsed / 1e6, (double)lines / elapsed / 1e6, (double)syscalls / mb);
+}
+
+int main(int argc, char **argv) {
+    size_t mb = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 64;
+    size_t size = mb * 1024 * 1024;
+    size_t lines = 0;
+    char *data = make_payload(size, &lines);
+    if (!data) return 1;
+
+    printf("bench_uring: %zu MB over a pipe, %zu lines\n", mb, lines);
+    static const size_t blocks[] = {4096, 16384, 65536};
+    for (size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++) {
+        run("read", CI_BACKEND_READ, blocks[i], data, size, lines);
+        run("io_uring", CI_BACKEND_IO_URING, blocks[i], data, size, lines);
+    }
+
+    free(data);
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "console_input.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static unsigned long processed = 0;
+static long callback_us = 50;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* A slow handler: blocks as if waiting on I/O. */
+static void slow_cb(const char *line, void *user_data) {
+    (void)line;
+    (void)user_data;
+    struct timespec ts = {0, callback_us * 1000};
+    nanosleep(&ts, NULL);
+    __atomic_add_fetch(&processed, 1, __ATOMIC_RELAXED);
+}
+
+/* Feed lines into stdin through a pipe from a child process; returns the child pid. */
+static pid_t feed_stdin(size_t lines) {
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        char line[32];
+        for (size_t i = 0; i < lines; i++) {
+            int n = snprintf(line, sizeof(line), "item %zu\n", i);
+            if (write(fds[1], line, (size_t)n) != n) _exit(1);
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    dup2(fds[0], STDIN_FILENO);
+    close(fds[0]);
+    return pid;
+}
+
+static void run(unsigned workers, size_t lines) {
+    processed = 0;
+    pid_t pid = feed_stdin(lines);
+
+    ci_async_options opts = {0};
+    opts.workers = workers;
+    double start = now_sec();
+    if (ci_start_async_input_ex(NULL, slow_cb, NULL, &opts) != CI_OK) {
+        fprintf(stderr, "start failed\n");
+        exit(1);
+    }
+    while (ci_async_is_running()) {
+        struct timespec ts = {0, 1000000};
+        nanosleep(&ts, NULL);
+    }
+    double elapsed = now_sec() - start;
+    ci_stop_async_input();
+    waitpid(pid, NULL, 0);
+
+    if (processed != lines) {
+        fprintf(stderr, "workers=%u: expected %zu lines, got %lu\n", workers, lines, processed);
+        exit(1);
+    }
+    printf("workers %-2u %10.0f lines/s\n", workers, (double)lines / elapsed);
+}
+
+int main(int argc, char **argv) {
+    size_t lines = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 5000;
+    if (argc > 2) callback_us = strtol(argv[2], NULL, 10);
+
+    printf("bench_workers: %zu lines, %ld us per callback\n", lines, callback_us);
+    static const unsigned counts[] = {0, 1, 2, 4, 8};
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        run(counts[i], lines);
+    }
+    return 0;
+}
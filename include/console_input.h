@@ -3,26 +3,211 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 typedef enum {
     CI_OK = 0,
     CI_EOF = -1,
     CI_OVERFLOW = -2,
-    CI_INVALID = -3
+    CI_INVALID = -3,
+    CI_UNDERFLOW = -4 /* a nonzero floating-point value too small to represent */
 } ci_status;
 typedef void (*ci_line_callback)(const char *line, void *user_data);
+/* Line plus its length; bytes after an embedded NUL are kept (line[len] is NUL). */
+typedef void (*ci_view_callback)(const char *line, size_t len, void *user_data);
+typedef struct ci_reader ci_reader;
+typedef struct ci_context ci_context;
+typedef struct ci_reactor ci_reactor;
 
+/*
+ * Legacy limits, kept so existing code still compiles. The command registry
+ * grows as needed, so neither is a limit any more: commands of any length and
+ * count are accepted.
+ */
 #define CI_COMMAND_MAX_LEN 64
 #define CI_MAX_COMMANDS 32
 
+typedef struct {
+    const char *data; /* NUL-terminated at data[len] */
+    size_t len;
+} ci_line_view;
+typedef void (*ci_batch_callback)(const ci_line_view *lines, size_t count, void *user_data);
+
+/*
+ * Numbers parsed from one line. For a fixed list, point values (and optionally
+ * status) at arrays of capacity elements. For a growable list, zero-initialise it
+ * and set growable: the arrays are allocated as needed, reused across lines and
+ * released with ci_int_list_free / ci_double_list_free.
+ */
+typedef struct {
+    int64_t *values;   /* element i of the line; 0 where parsing failed */
+    ci_status *status; /* per-element result, or NULL (always set for growable lists) */
+    size_t count;      /* elements stored from the last line */
+    size_t capacity;   /* slots in values and status */
+    size_t errors;     /* elements whose status is not CI_OK, plus elements dropped for lack of room */
+    bool growable;     /* realloc the arrays when the line has more elements */
+} ci_int_list;
+
+typedef struct {
+    double *values;
+    ci_status *status;
+    size_t count;
+    size_t capacity;
+    size_t errors;
+    bool growable;
+    unsigned flags; /* CI_FLOAT_ALLOW_INF / CI_FLOAT_ALLOW_NAN */
+} ci_double_list;
+
+/* How a reader pulls bytes from its descriptor. */
+typedef enum {
+    CI_BACKEND_READ = 0, /* read(2), one syscall per block */
+    CI_BACKEND_IO_URING  /* io_uring (Linux): multishot reads into a buffer ring where supported */
+} ci_read_backend;
+
+/* When prompts are written; diagnostics such as "Input too long" are always written. */
+typedef enum {
+    CI_PROMPT_TTY = 0, /* only when input and output are both terminals (default) */
+    CI_PROMPT_ALWAYS,  /* always, even into pipes and files */
+    CI_PROMPT_NEVER
+} ci_prompt_policy;
+
+/* Command flags for ci_register_command_ex, ci_register_verb and ci_register_pattern. */
+#define CI_CMD_SERIAL 0x1u   /* with workers: run in arrival order, one at a time */
+#define CI_CMD_NOCASE 0x2u   /* verbs and patterns only: match in any ASCII case */
+#define CI_CMD_PRIORITY 0x4u /* with workers: queued on a lane workers take first, never dropped; not with SERIAL */
+
+/* What the reader does with a line whose worker queue lane is full (ci_async_options.overload). */
+typedef enum {
+    CI_OVERLOAD_BLOCK = 0,   /* wait for room: backpressure to the input (default) */
+    CI_OVERLOAD_DROP_OLDEST, /* discard the oldest line waiting in the lane */
+    CI_OVERLOAD_DROP_NEWEST, /* discard the line being queued */
+    CI_OVERLOAD_COALESCE     /* discard the line if the same line is still waiting, else wait for room */
+} ci_overload_policy;
+
+/* One argument of a line: a view into the line buffer, not NUL-terminated. */
+typedef struct {
+    const char *ptr;
+    size_t len;
+} ci_arg;
+
+/* Most arguments passed to a verb callback, the verb included; the last one then holds the rest of the line. */
+#define CI_MAX_ARGS 32
+
+/* Verb callback: argv[0] is the verb as written in the line, argv[1..argc-1] its arguments. */
+typedef void (*ci_args_callback)(const char *line, const ci_arg *argv, size_t argc, void *user_data);
+
+/* One command of a static table. */
+typedef struct {
+    const char *name;
+    size_t len; /* strlen(name) */
+    ci_line_callback callback;
+    void *user_data;
+    unsigned flags; /* CI_CMD_* */
+} ci_command_def;
+
+/*
+ * A fixed command table with a collision-free hash, normally generated at build
+ * time by tools/ci_cmdgen (see README). A line is looked up with one hash and
+ * one slot: bucket = hash >> 32 & bucket_mask, and the slot is
+ * ((uint32_t)hash ^ displace[bucket] * 0x9e3779b9) & slot_mask.
+ */
+typedef struct {
+    const ci_command_def *commands;
+    size_t count;
+    uint64_t seed;            /* hash seed the displacements were found for */
+    const uint32_t *displace; /* bucket_mask + 1 displacements */
+    size_t bucket_mask;
+    const uint32_t *slots; /* slot_mask + 1 entries: command index + 1, or 0 when empty */
+    size_t slot_mask;
+} ci_command_table;
+
+/* Flags for the floating-point parsers; by default only finite numbers are accepted. */
+#define CI_FLOAT_ALLOW_INF 0x1u /* accept "inf" and "infinity" (any case, optional sign) */
+#define CI_FLOAT_ALLOW_NAN 0x2u /* accept "nan" (any case) */
+
+typedef struct {
+    unsigned workers;                 /* callback threads; 0 runs callbacks on the reader thread */
+    size_t queue_capacity;            /* lines buffered per lane before the reader blocks; 0 = 1024 */
+    ci_batch_callback batch_callback; /* receive non-command lines in batches (no workers) */
+    size_t max_batch;                 /* lines per batch; 0 = 64 */
+    unsigned max_wait_ms;             /* how long a partial batch may wait for more input */
+    bool pollable;                    /* no thread: caller polls ci_get_fd() and calls ci_process_ready() */
+    ci_read_backend backend;          /* reader thread backend; falls back to read(2) if unavailable */
+    size_t max_line;                  /* longest accepted line in bytes; 0 = 1 MiB */
+    ci_view_callback view_callback;   /* used instead of callback for lines matching no command */
+    bool arena_lines;                 /* lines live in refcounted arena chunks; see ci_line_retain */
+    size_t arena_chunk_size;          /* bytes per arena chunk; 0 = 64 KiB */
+    ci_overload_policy overload;      /* full worker queue handling; anything but BLOCK needs workers */
+} ci_async_options;
+
+/* Options for ci_process_file. */
+typedef struct {
+    unsigned threads;               /* threads dispatching lines, including the caller; 0 = online CPUs */
+    bool ordered;                   /* run callbacks one at a time in file order */
+    size_t chunk_size;              /* bytes of the file handed to a thread at a time; 0 = 1 MiB */
+    ci_view_callback view_callback; /* used instead of callback for lines matching no command */
+} ci_file_options;
+
+/* Allocator statistics of a context started with arena_lines. */
+typedef struct {
+    size_t chunk_size;     /* bytes per chunk */
+    size_t chunks;         /* chunks currently allocated, in use or free */
+    size_t chunks_free;    /* chunks waiting on the free list */
+    size_t chunk_allocs;   /* chunks obtained from malloc, ever */
+    size_t chunk_reuses;   /* chunks taken back off the free list, ever */
+    size_t lines;          /* lines copied into the arena */
+    size_t bytes;          /* line bytes copied into the arena */
+    size_t oversize_lines; /* lines longer than a chunk, given a chunk of their own */
+    size_t dropped_lines;  /* lines lost because no chunk could be allocated for them */
+} ci_arena_stats;
+
+/* Worker queue counters of a context, since it was last started with workers. */
+typedef struct {
+    size_t capacity;         /* lines per lane */
+    uint64_t queued;         /* lines handed to the workers */
+    uint64_t priority;       /* of those, lines queued on the priority lane */
+    uint64_t blocked;        /* lines the reader had to wait to queue */
+    uint64_t dropped_oldest; /* waiting lines discarded to make room (CI_OVERLOAD_DROP_OLDEST) */
+    uint64_t dropped_newest; /* lines discarded on a full lane (CI_OVERLOAD_DROP_NEWEST) */
+    uint64_t coalesced;      /* lines discarded as repeats of a waiting line (CI_OVERLOAD_COALESCE) */
+    uint64_t dropped_nomem;  /* lines lost because copying them for the workers failed to allocate */
+} ci_ingest_stats;
+
+/* Summary of a latency histogram; percentiles are bucket upper bounds, within 1/16 of the true value. */
+typedef struct {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+} ci_latency_stats;
+
+/* Pipeline counters of a context since it was created or last reset (see ci_context_enable_stats). */
+typedef struct {
+    uint64_t lines;                    /* lines handed to dispatch */
+    uint64_t bytes;                    /* bytes in those lines, without line ends */
+    uint64_t overflows;                /* over-long lines rejected */
+    uint64_t parse_failures;           /* numeric prompts answered with something that is not a number */
+    uint64_t command_hits;             /* lines that ran a registered command */
+    uint64_t command_misses;           /* lines given to the default, view or batch callback */
+    ci_latency_stats read_to_dispatch; /* from the read that brought a line in to its callback starting */
+    ci_latency_stats callback;         /* callback run time with the command lookup (one sample per batch) */
+} ci_stats;
+
 /**
  * @brief Read a single line from the given stream.
  * @param stream Input stream (e.g., stdin).
  * @param buffer Destination buffer for the line.
  * @param size Size of the destination buffer.
  * @return CI_OK on success, CI_EOF on end-of-file, CI_OVERFLOW if truncated, CI_INVALID on error.
- * @note Blocking convenience helper for synchronous use.
+ * @note Blocking convenience helper for synchronous use. Any stream is read through
+ *       stdio (fmemopen streams too), so it mixes with fgets on the same FILE. A line of
+ *       exactly size - 1 characters fits, "\r\n" is folded, and on CI_OVERFLOW the rest of
+ *       the line is discarded. stdin is the exception: it is read through the library's
+ *       stdin reader, shared with ci_prompt_line and async input.
  */
 ci_status ci_read_line(FILE *stream, char *buffer, size_t size);
 
@@ -54,6 +239,182 @@ ci_status ci_read_int(const char *prompt, int *out_value);
  */
 ci_status ci_read_long(const char *prompt, long *out_value);
 
+/**
+ * @brief Prompt for and read a double value.
+ * @param prompt Prompt text to display.
+ * @param flags CI_FLOAT_ALLOW_INF / CI_FLOAT_ALLOW_NAN, or 0 for finite values only.
+ * @param out_value Output pointer for the parsed double.
+ * @return CI_OK on success, CI_EOF on end-of-file, CI_OVERFLOW on range/length issues,
+ *         CI_UNDERFLOW if a nonzero value rounds to zero, CI_INVALID on parse error.
+ * @note Blocking convenience helper for synchronous use; re-prompts on invalid input like ci_read_long.
+ */
+ci_status ci_read_double(const char *prompt, unsigned flags, double *out_value);
+
+/**
+ * @brief Prompt for and read a float value; as ci_read_double.
+ */
+ci_status ci_read_float(const char *prompt, unsigned flags, float *out_value);
+
+/**
+ * @brief Parse an integer of a fixed width from a byte range.
+ * @param text Input bytes (need not be NUL-terminated).
+ * @param len Number of bytes in text.
+ * @param base 2, 8, 10 or 16, or 0 to select by prefix (0x, 0o, 0b; otherwise decimal).
+ * @param out Output pointer; written only on CI_OK.
+ * @return CI_OK on success, CI_OVERFLOW if the value does not fit the type, CI_INVALID on bad syntax or args.
+ * @note Same rules as ci_read_long: optional leading whitespace and sign, then digits
+ *       through the end of the range. A prefix matching the base is accepted ("0x1f" in
+ *       base 16). Unsigned variants reject negative values other than -0 as CI_OVERFLOW.
+ *       Decimal digits are converted eight at a time; no locale or errno is involved.
+ */
+ci_status ci_parse_int8(const char *text, size_t len, unsigned base, int8_t *out);
+ci_status ci_parse_int16(const char *text, size_t len, unsigned base, int16_t *out);
+ci_status ci_parse_int32(const char *text, size_t len, unsigned base, int32_t *out);
+ci_status ci_parse_int64(const char *text, size_t len, unsigned base, int64_t *out);
+ci_status ci_parse_uint8(const char *text, size_t len, unsigned base, uint8_t *out);
+ci_status ci_parse_uint16(const char *text, size_t len, unsigned base, uint16_t *out);
+ci_status ci_parse_uint32(const char *text, size_t len, unsigned base, uint32_t *out);
+ci_status ci_parse_uint64(const char *text, size_t len, unsigned base, uint64_t *out);
+ci_status ci_parse_size(const char *text, size_t len, unsigned base, size_t *out);
+
+/**
+ * @brief Parse a decimal floating-point number from a byte range.
+ * @param text Input bytes (need not be NUL-terminated).
+ * @param len Number of bytes in text.
+ * @param flags CI_FLOAT_ALLOW_INF / CI_FLOAT_ALLOW_NAN, or 0 for finite values only.
+ * @param out Output pointer; written only on CI_OK.
+ * @return CI_OK on success, CI_OVERFLOW if the value rounds to infinity, CI_UNDERFLOW if a
+ *         nonzero value rounds to zero, CI_INVALID on bad syntax or args.
+ * @note Accepts optional leading whitespace and sign, digits with an optional '.', and an
+ *       optional e/E exponent, through the end of the range; hex floats are not accepted.
+ *       The result is correctly rounded (round-to-nearest-even). It is computed without
+ *       locale or errno, except that inputs with more than 19 significant digits that land
+ *       on a rounding boundary are finished by strtod, which assumes the "C" locale.
+ */
+ci_status ci_parse_double(const char *text, size_t len, unsigned flags, double *out);
+ci_status ci_parse_float(const char *text, size_t len, unsigned flags, float *out);
+
+/**
+ * @brief Parse every integer on a line into a list.
+ * @param text Line bytes (need not be NUL-terminated; '\n' counts as whitespace).
+ * @param len Number of bytes in text.
+ * @param list Destination; count, errors and per-element status are rewritten.
+ * @return CI_OK if every element parsed, CI_INVALID if some did not (see list->status)
+ *         or on bad args, CI_OVERFLOW if elements were dropped: a fixed-capacity list could
+ *         not hold the line, or growing a growable list failed. Dropped elements count in errors.
+ * @note Elements are decimal int64 values separated by whitespace or commas. Each comma
+ *       separates two elements, so "1,,2" and "1,2," hold an empty (CI_INVALID) element.
+ *       A failed element keeps its slot with value 0 and status CI_INVALID or CI_OVERFLOW.
+ */
+ci_status ci_parse_int_list(const char *text, size_t len, ci_int_list *list);
+
+/**
+ * @brief Parse every floating-point number on a line into a list.
+ * @param text Line bytes (need not be NUL-terminated; '\n' counts as whitespace).
+ * @param len Number of bytes in text.
+ * @param list Destination; count, errors and per-element status are rewritten.
+ * @return As ci_parse_int_list. Elements follow ci_parse_double with list->flags, so an
+ *         element may also fail with CI_UNDERFLOW.
+ */
+ci_status ci_parse_double_list(const char *text, size_t len, ci_double_list *list);
+
+/**
+ * @brief Split a line into whitespace-separated arguments without copying.
+ * @param text Line bytes (need not be NUL-terminated).
+ * @param len Number of bytes in text.
+ * @param argv Output views into text.
+ * @param max_args Capacity of argv.
+ * @return Number of arguments stored.
+ * @note Spaces and tabs separate arguments. An argument starting with '"' runs to the next '"'
+ *       (or the end of the line), and its view excludes the quotes; there are no escapes.
+ *       When the line has more than max_args arguments, the last one stored holds the rest
+ *       of the line from where it starts.
+ */
+size_t ci_split_args(const char *text, size_t len, ci_arg *argv, size_t max_args);
+
+/**
+ * @brief Read one line from a reader and parse its integers into a list.
+ * @param reader Reader to consume the line from.
+ * @param list Destination, as for ci_parse_int_list.
+ * @return As ci_parse_int_list, or CI_EOF if the input has ended.
+ * @note The line is parsed straight out of the reader's buffer as it streams in, so
+ *       there is no line length limit. A single token longer than the reader's block
+ *       size is stored as a CI_OVERFLOW element.
+ */
+ci_status ci_reader_read_int_list(ci_reader *reader, ci_int_list *list);
+
+/**
+ * @brief Read one line from a reader and parse its floating-point numbers into a list.
+ * @return As ci_reader_read_int_list.
+ */
+ci_status ci_reader_read_double_list(ci_reader *reader, ci_double_list *list);
+
+/**
+ * @brief Prompt and read a line of integers from stdin.
+ * @param prompt Prompt text to display (can be NULL).
+ * @param list Destination, as for ci_parse_int_list.
+ * @return As ci_reader_read_int_list.
+ * @note Blocking convenience helper for synchronous use.
+ */
+ci_status ci_read_int_list(const char *prompt, ci_int_list *list);
+
+/**
+ * @brief Prompt and read a line of floating-point numbers from stdin.
+ * @return As ci_reader_read_double_list.
+ * @note Blocking convenience helper for synchronous use.
+ */
+ci_status ci_read_double_list(const char *prompt, ci_double_list *list);
+
+/**
+ * @brief Release the arrays of a growable list and reset it to empty.
+ * @param list List to clear; fixed-capacity (caller-owned) lists are left alone.
+ */
+void ci_int_list_free(ci_int_list *list);
+void ci_double_list_free(ci_double_list *list);
+
+/**
+ * @brief Create a buffered line scanner over a file descriptor.
+ * @param fd File descriptor to read from (not owned; never closed by the reader).
+ * @param block_size Size of each read(2) block; 0 selects the default (64 KiB).
+ * @return New reader, or NULL on bad args/allocation failure.
+ */
+ci_reader *ci_reader_create(int fd, size_t block_size);
+
+/**
+ * @brief Destroy a reader created with ci_reader_create; buffered input is discarded.
+ * @param reader Reader to destroy (can be NULL).
+ */
+void ci_reader_destroy(ci_reader *reader);
+
+/**
+ * @brief Read the next line from a reader into a buffer.
+ * @param reader Reader to pull the line from.
+ * @param buffer Destination buffer for the line (newline stripped).
+ * @param size Size of the destination buffer.
+ * @return CI_OK on success, CI_EOF on end-of-file, CI_OVERFLOW if truncated, CI_INVALID on error.
+ * @note On CI_OVERFLOW the rest of the line is discarded, like ci_read_line.
+ */
+ci_status ci_reader_read_line(ci_reader *reader, char *buffer, size_t size);
+
+/**
+ * @brief Switch how a reader pulls bytes from its descriptor.
+ * @param reader Reader to configure.
+ * @param backend CI_BACKEND_IO_URING to read through io_uring, CI_BACKEND_READ for read(2).
+ * @return CI_OK if the reader now uses the backend, CI_INVALID if io_uring is unavailable
+ *         (the reader keeps using read(2)) or when switching back from io_uring.
+ * @note Multishot reads keep the kernel reading ahead into a ring of buffers (8 x block
+ *       size), so at high rates most fills need no syscall. A reader stays on io_uring
+ *       once switched, since read-ahead data lives in its buffers.
+ */
+ci_status ci_reader_set_backend(ci_reader *reader, ci_read_backend backend);
+
+/**
+ * @brief Report the backend a reader uses.
+ * @param reader Reader to query.
+ * @return Current backend.
+ */
+ci_read_backend ci_reader_get_backend(const ci_reader *reader);
+
 /**
  * @brief Start an async input thread that forwards lines to a callback.
  * @param prompt Prompt text to display before each read (can be NULL).
@@ -65,8 +426,162 @@ ci_status ci_start_async_input(const char *prompt,
                                 ci_line_callback callback,
                                 void *user_data);
 
+/**
+ * @brief Start async input with options (e.g. a worker pool for callbacks).
+ * @param prompt Prompt text to display before each read (can be NULL).
+ * @param callback Callback invoked for lines matching no command (can be NULL with batch_callback
+ *        or view_callback).
+ * @param user_data User pointer passed to the callback or batch callback.
+ * @param options Options, or NULL for the ci_start_async_input defaults.
+ * @return CI_OK on start, CI_INVALID on bad args, if already running, or if threads can't start.
+ * @note With workers > 0 the reader only frames lines and pushes them into a bounded
+ *       lock-free queue; workers run command and default callbacks concurrently.
+ *       Commands registered with CI_CMD_SERIAL go to a separate lane drained in order
+ *       by a single worker, and CI_CMD_PRIORITY ones to a lane every worker takes first;
+ *       registering a command with both flags fails with CI_INVALID.
+ * @note Each lane holds queue_capacity lines. When a lane is full, overload selects what
+ *       happens: the reader waits (backpressure to the input, the default), or discards
+ *       the oldest waiting line, the new line, or the new line if the same line is still
+ *       waiting (compared by length and 64-bit hash). The priority lane always waits.
+ *       Rather than wait at once, the reader holds up to 64 lines (at most a lane's worth)
+ *       and keeps reading, so priority lines behind a full lane still overtake; past that
+ *       it waits until the held lines are queued. ci_context_get_ingest_stats counts drops.
+ * @note With batch_callback, lines matching no command are delivered as views into the
+ *       read buffer, up to max_batch at a time, covering everything already buffered;
+ *       a partial batch waits at most max_wait_ms for more input. Views are valid only
+ *       during the call. Commands still run per line, after the batch preceding them.
+ * @note Lines of any length up to max_line are framed in place in a read buffer that
+ *       grows to fit the longest line seen and is then reused, so steady state does not
+ *       allocate. Longer lines are skipped with "Input too long, try again.".
+ * @note With arena_lines, each line is copied into a refcounted arena chunk before its
+ *       callback runs (instead of a malloc per line when workers are used). A callback
+ *       can keep the line with ci_line_retain and drop it later with ci_line_release.
+ *       A line that can't get arena memory is dropped and counted in ci_arena_stats.dropped_lines.
+ *       Arena mode can't be combined with a batch callback.
+ */
+ci_status ci_start_async_input_ex(const char *prompt,
+                                  ci_line_callback callback,
+                                  void *user_data,
+                                  const ci_async_options *options);
+
+/**
+ * @brief Readiness descriptor for pollable mode (add it to your epoll/poll set).
+ * @return The input descriptor, or -1 when pollable mode is not active.
+ * @note Regular files are always readable and can't be added to epoll; call
+ *       ci_process_ready until it returns CI_EOF instead.
+ */
+int ci_get_fd(void);
+
+/**
+ * @brief Read whatever input is available without blocking and dispatch it on this thread.
+ * @return CI_OK when more input may follow, CI_EOF when input ended or a stop was requested,
+ *         CI_INVALID on read error or when pollable mode is not active.
+ * @note Uses the same command registry as the threaded mode. Call ci_stop_async_input
+ *       to leave pollable mode.
+ */
+ci_status ci_process_ready(void);
+
+/**
+ * @brief Choose when the sync helpers and default async input write prompts.
+ * @param policy CI_PROMPT_TTY (default), CI_PROMPT_ALWAYS or CI_PROMPT_NEVER.
+ * @note Prompts and "try again" messages are queued on stdout's stdio buffer and flushed
+ *       only when the reader is about to wait for input, so piped input costs no write
+ *       per line. With CI_PROMPT_TTY, prompts are skipped unless stdin and stdout are
+ *       both terminals.
+ */
+void ci_set_prompt_policy(ci_prompt_policy policy);
+
+/**
+ * @brief Replay a file through the default context's commands; see ci_context_process_file.
+ * @param path File to read.
+ * @param callback Callback for lines matching no command (can be NULL).
+ * @param user_data User pointer passed to the callback.
+ * @param options Options, or NULL for unordered delivery on every online CPU.
+ * @return CI_OK when the whole file was dispatched, CI_EOF after a stop request,
+ *         CI_INVALID on bad args, if async input is running, or on I/O/allocation failure.
+ */
+ci_status ci_process_file(const char *path, ci_line_callback callback, void *user_data,
+                          const ci_file_options *options);
+
+/**
+ * @brief Keep a line delivered in arena mode alive after its callback returns.
+ * @param line Line pointer passed to a callback of a context started with arena_lines.
+ * @note Cheap (one atomic increment); each retain must be paired with ci_line_release,
+ *       which may be called from any thread. Retained lines stay valid after the
+ *       context stops. Passing any other pointer is undefined.
+ */
+void ci_line_retain(const char *line);
+
+/**
+ * @brief Drop a reference taken with ci_line_retain.
+ * @param line Retained line (NULL is ignored).
+ * @note A chunk is recycled once every line in it has been released.
+ */
+void ci_line_release(const char *line);
+
+/**
+ * @brief Allocator statistics of the default context; see ci_context_get_arena_stats.
+ * @param out Output statistics.
+ * @return CI_OK, or CI_INVALID when the context is not started in arena mode.
+ */
+ci_status ci_get_arena_stats(ci_arena_stats *out);
+
+/**
+ * @brief Feed a line to the default context from another thread; see ci_context_inject_line.
+ * @param line Line text without the newline (need not be NUL-terminated).
+ * @param len Line length.
+ * @return CI_OK, CI_INVALID when async input isn't running on a thread, CI_OVERFLOW
+ *         when the line exceeds max_line or memory runs out.
+ */
+ci_status ci_inject_line(const char *line, size_t len);
+
+/**
+ * @brief Feed several lines to the default context at once; see ci_context_inject_lines.
+ * @param lines Lines to copy, in order.
+ * @param count Number of lines.
+ * @return CI_OK, CI_INVALID, or CI_OVERFLOW (then none of the lines was queued).
+ */
+ci_status ci_inject_lines(const ci_line_view *lines, size_t count);
+
+/**
+ * @brief Worker queue counters of the default context; see ci_context_get_ingest_stats.
+ * @param out Output counters.
+ * @return CI_OK, or CI_INVALID when the context was not started with workers.
+ */
+ci_status ci_get_ingest_stats(ci_ingest_stats *out);
+
+/**
+ * @brief Turn pipeline statistics of the default context on or off; see ci_context_enable_stats.
+ * @param enable true to start counting.
+ * @return CI_OK, or CI_INVALID when the library was built with CI_NO_STATS.
+ */
+ci_status ci_enable_stats(bool enable);
+
+/**
+ * @brief Statistics of the default context, including the sync helpers; see ci_context_get_stats.
+ * @param out Output snapshot.
+ * @return CI_OK, or CI_INVALID on bad args.
+ */
+ci_status ci_get_stats(ci_stats *out);
+
+/**
+ * @brief Start the default context's statistics (and its per-command statistics) from zero.
+ */
+void ci_reset_stats(void);
+
+/**
+ * @brief Callback run time of one command of the default context; see ci_context_get_command_stats.
+ * @param command Registered command string.
+ * @param out Output summary.
+ * @return CI_OK, or CI_INVALID when the command is not registered.
+ */
+ci_status ci_get_command_stats(const char *command, ci_latency_stats *out);
+
 /**
  * @brief Stop the async input thread and join it.
+ * @note Returns once the current callback (if any) finishes; a blocked read is woken, not
+ *       cancelled. Input read but not yet dispatched stays buffered for ci_read_line or a
+ *       restart. With workers, lines already queued are dispatched before this returns.
  */
 void ci_stop_async_input(void);
 
@@ -77,28 +592,413 @@ void ci_stop_async_input(void);
 bool ci_async_is_running(void);
 
 /**
- * @brief Request the async input thread to stop; safe to call from callbacks.
+ * @brief Request the async input thread to stop; safe to call from callbacks and signal handlers.
+ * @note Takes effect at once, even while the thread waits for input.
  */
 void ci_request_stop_async_input(void);
 
-/* Command callbacks. Thread-safe for registration while async input runs. */
+/*
+ * Input contexts. Each context serves one descriptor with its own reader, prompt,
+ * command table and thread (or readiness fd), so a process can run many at once.
+ * The ci_*_async_input, ci_*register_command, ci_get_fd and ci_process_ready
+ * functions operate on the default context (stdin, prompts to stdout).
+ */
+
+/**
+ * @brief Create a context reading lines from a descriptor.
+ * @param fd Input descriptor (not owned; never closed by the context).
+ * @param out Stream for prompts and "Input too long" messages (can be NULL for none).
+ * @return New stopped context, or NULL on bad args/allocation failure.
+ */
+ci_context *ci_context_create(int fd, FILE *out);
+
+/**
+ * @brief Stop a context if running and free it.
+ * @param ctx Context to destroy (can be NULL; the default context is never freed).
+ */
+void ci_context_destroy(ci_context *ctx);
+
+/**
+ * @brief Return the context behind the stdin-based convenience API.
+ * @return Default context (stdin in, stdout out).
+ */
+ci_context *ci_default_context(void);
+
+/**
+ * @brief Start input on a context; see ci_start_async_input_ex for the options.
+ * @param ctx Context to start.
+ * @param prompt Prompt text to display before each read (can be NULL).
+ * @param callback Callback invoked for lines matching no command (can be NULL with batch_callback
+ *        or view_callback).
+ * @param user_data User pointer passed to the callback or batch callback.
+ * @param options Options, or NULL for defaults.
+ * @return CI_OK on start, CI_INVALID on bad args, if already running, or if threads can't start.
+ */
+ci_status ci_context_start(ci_context *ctx,
+                           const char *prompt,
+                           ci_line_callback callback,
+                           void *user_data,
+                           const ci_async_options *options);
+
+/**
+ * @brief Stop a context's input thread (or pollable mode) and clear its commands.
+ * @param ctx Context to stop.
+ * @note See ci_stop_async_input; unread input stays in the context's reader.
+ */
+void ci_context_stop(ci_context *ctx);
+
+/**
+ * @brief Ask a context to stop after the current line; safe to call from callbacks and signal handlers.
+ * @param ctx Context to stop.
+ * @note A thread waiting for input is woken immediately.
+ */
+void ci_context_request_stop(ci_context *ctx);
+
+/**
+ * @brief Check whether a context is reading input.
+ * @param ctx Context to check.
+ * @return true if running, false otherwise.
+ */
+bool ci_context_is_running(const ci_context *ctx);
+
+/**
+ * @brief Readiness descriptor of a pollable context.
+ * @param ctx Context started with options.pollable.
+ * @return The input descriptor, or -1 when the context is not in pollable mode.
+ */
+int ci_context_get_fd(const ci_context *ctx);
+
+/**
+ * @brief Read available input on a pollable context without blocking; see ci_process_ready.
+ * @param ctx Context started with options.pollable.
+ * @return CI_OK, CI_EOF or CI_INVALID as for ci_process_ready.
+ */
+ci_status ci_context_process_ready(ci_context *ctx);
+
+/**
+ * @brief Choose when a context writes its prompt; see ci_set_prompt_policy.
+ * @param ctx Context to configure (the setting survives stop and restart).
+ * @param policy Prompt policy.
+ * @return CI_OK, or CI_INVALID on bad args.
+ */
+ci_status ci_context_set_prompt_policy(ci_context *ctx, ci_prompt_policy policy);
+
+/**
+ * @brief Replay a file through a context's command table on a pool of threads.
+ * @param ctx Context whose commands handle the lines; must not be running.
+ * @param path Regular file to read.
+ * @param callback Callback for lines matching no command (can be NULL).
+ * @param user_data User pointer passed to the callback.
+ * @param options Options, or NULL for unordered delivery on every online CPU.
+ * @return CI_OK when the whole file was dispatched, CI_EOF after a stop request,
+ *         CI_INVALID on bad args, if the context is running, or on I/O/allocation failure.
+ * @note The file is memory-mapped and split at line boundaries into chunks that the
+ *       threads claim in turn; the caller's thread is one of them and the call returns
+ *       once every line has been dispatched. Unordered, callbacks run concurrently and
+ *       must be thread-safe. Ordered, threads still find the lines of their chunks in
+ *       parallel, but callbacks run one at a time in file order. '\r\n' is folded and
+ *       a final line without a newline is delivered; lines have no length limit.
+ *       ci_context_request_stop from a callback ends the replay early.
+ */
+ci_status ci_context_process_file(ci_context *ctx,
+                                  const char *path,
+                                  ci_line_callback callback,
+                                  void *user_data,
+                                  const ci_file_options *options);
+
+/**
+ * @brief Allocator statistics of a context started with arena_lines.
+ * @param ctx Context to query.
+ * @param out Output statistics.
+ * @return CI_OK, or CI_INVALID on bad args or when the context has no arena.
+ * @note The arena lives from ci_context_start until the context is stopped.
+ */
+ci_status ci_context_get_arena_stats(const ci_context *ctx, ci_arena_stats *out);
+
+/**
+ * @brief Feed a line into a running context as if it had been read from its input.
+ * @param ctx Context started with ci_context_start (not in pollable mode).
+ * @param line Line text without the newline (need not be NUL-terminated).
+ * @param len Line length.
+ * @return CI_OK once the line is queued, CI_INVALID on bad args or when the context
+ *         isn't running on its input thread, CI_OVERFLOW when the line exceeds
+ *         max_line or memory runs out.
+ * @note Any thread may call this (timers, RPC handlers, test drivers). The line is
+ *       copied and pushed onto a lock-free queue with one compare-and-swap; the input
+ *       thread picks it up between reads and runs it through the same path as input
+ *       lines: commands, verbs, patterns, workers or the batch callback. Lines from one
+ *       producer keep their order; how they interleave with input lines or other
+ *       producers is unspecified. Lines queued before a stop are still dispatched.
+ */
+ci_status ci_context_inject_line(ci_context *ctx, const char *line, size_t len);
+
+/**
+ * @brief Feed several lines at once; cheaper than one ci_context_inject_line each.
+ * @param ctx Context started with ci_context_start.
+ * @param lines Lines to copy, in order.
+ * @param count Number of lines.
+ * @return As ci_context_inject_line; on failure none of the lines was queued.
+ * @note The lines are copied into one allocation and queued with one compare-and-swap,
+ *       so they reach the input thread together and in order.
+ */
+ci_status ci_context_inject_lines(ci_context *ctx, const ci_line_view *lines, size_t count);
+
+/**
+ * @brief Worker queue counters of a context started with workers.
+ * @param ctx Context to query.
+ * @param out Output counters.
+ * @return CI_OK, or CI_INVALID on bad args or when the context was not started with workers.
+ * @note Counters start at zero with each start and can still be read after the context stops.
+ */
+ci_status ci_context_get_ingest_stats(const ci_context *ctx, ci_ingest_stats *out);
+
+/**
+ * @brief Turn pipeline statistics on or off.
+ * @param ctx Context to instrument; may be running.
+ * @param enable true to start counting.
+ * @return CI_OK, or CI_INVALID on bad args or when the library was built with CI_NO_STATS.
+ * @note Off by default. Each thread counts into its own shard, so counting takes no
+ *       locks; while off, the only cost is one load per line. Counts survive stop and
+ *       restart; per-command statistics live as long as the command's registration.
+ */
+ci_status ci_context_enable_stats(ci_context *ctx, bool enable);
+
+/**
+ * @brief Snapshot the statistics gathered since the context was created or last reset.
+ * @param ctx Context to query.
+ * @param out Output snapshot.
+ * @return CI_OK, or CI_INVALID on bad args.
+ * @note Safe while the context is running; counts of threads still dispatching may be a few lines behind.
+ */
+ci_status ci_context_get_stats(ci_context *ctx, ci_stats *out);
+
+/**
+ * @brief Start a context's statistics (and its per-command statistics) from zero.
+ * @param ctx Context to reset.
+ * @return CI_OK, CI_INVALID on bad args, or CI_OVERFLOW on allocation failure.
+ */
+ci_status ci_context_reset_stats(ci_context *ctx);
+
+/**
+ * @brief Callback run time of one registered command.
+ * @param ctx Context the command is registered on.
+ * @param command Registered command string.
+ * @param out Output summary; count is the number of timed runs.
+ * @return CI_OK, or CI_INVALID on bad args or when the command is not registered.
+ */
+ci_status ci_context_get_command_stats(ci_context *ctx, const char *command, ci_latency_stats *out);
+
+/**
+ * @brief Register (or replace) a command on a context.
+ * @param ctx Context whose table to update.
+ * @param command Exact command string to match.
+ * @param callback Callback to invoke when the command matches.
+ * @param user_data User pointer passed to the callback.
+ * @param flags Bitwise OR of CI_CMD_* flags (0 for none).
+ * @return CI_OK on success, CI_OVERFLOW on allocation failure, CI_INVALID on bad args.
+ */
+ci_status ci_context_register_command(ci_context *ctx,
+                                      const char *command,
+                                      ci_line_callback callback,
+                                      void *user_data,
+                                      unsigned flags);
+
+/**
+ * @brief Remove a command from a context.
+ * @param ctx Context whose table to update.
+ * @param command Command string to remove.
+ * @return CI_OK if removed, CI_INVALID if not found or bad args.
+ */
+ci_status ci_context_unregister_command(ci_context *ctx, const char *command);
+
+/**
+ * @brief Register (or replace) a verb: a command matched on the leading words of a line.
+ * @param ctx Context whose commands to update.
+ * @param verb One or more words separated by single spaces, e.g. "set" or "show stats".
+ * @param callback Callback given the line split by ci_split_args, the verb as argv[0].
+ * @param user_data User pointer passed to the callback.
+ * @param flags Bitwise OR of CI_CMD_* flags; CI_CMD_NOCASE matches the verb in any case.
+ * @return CI_OK on success, CI_OVERFLOW on allocation failure, CI_INVALID on bad args or
+ *         a verb that is empty, has leading, trailing or repeated spaces, or contains a tab.
+ * @note A verb matches a line whose words start with the verb's words; any run of spaces
+ *       and tabs in the line matches a space of the verb. When several verbs match, the
+ *       longest wins, and a case-sensitive verb beats a CI_CMD_NOCASE one of the same
+ *       length. Exact commands (registered or static) are tried before verbs.
+ *       Matching walks a trie once over the line, whatever the number of verbs.
+ *       Like commands, verbs are cleared by ci_context_stop.
+ */
+ci_status ci_context_register_verb(ci_context *ctx,
+                                   const char *verb,
+                                   ci_args_callback callback,
+                                   void *user_data,
+                                   unsigned flags);
+
+/**
+ * @brief Remove a verb from a context.
+ * @param ctx Context whose commands to update.
+ * @param verb Verb as registered.
+ * @return CI_OK if removed, CI_INVALID if not found or bad args.
+ */
+ci_status ci_context_unregister_verb(ci_context *ctx, const char *verb);
+
+/**
+ * @brief Register (or replace) a pattern: a command matched on the shape of the whole line.
+ * @param ctx Context whose commands to update.
+ * @param pattern Glob over the whole line: '*' any run of bytes, '?' any byte, "[a-z]" a
+ *                class ("[!...]" or "[^...]" negated), '+' one or more of the previous
+ *                character, '?' or class, and '\' takes the next character literally.
+ * @param callback Callback given the line.
+ * @param user_data User pointer passed to the callback.
+ * @param flags Bitwise OR of CI_CMD_* flags; CI_CMD_NOCASE matches letters in any case.
+ * @return CI_OK on success, CI_OVERFLOW on allocation failure, CI_INVALID on bad args or
+ *         a malformed pattern (empty, unclosed '[', trailing '\', '+' with nothing to repeat).
+ * @note Patterns are tried after exact commands and verbs. When several patterns match,
+ *       the one registered first wins; registering the same pattern again replaces its
+ *       callback and keeps its place. All patterns are combined into one DFA that is built
+ *       lazily as lines need it, so a line is matched in one pass whatever the number of
+ *       patterns. Like commands, patterns are cleared by ci_context_stop.
+ */
+ci_status ci_context_register_pattern(ci_context *ctx,
+                                      const char *pattern,
+                                      ci_line_callback callback,
+                                      void *user_data,
+                                      unsigned flags);
+
+/**
+ * @brief Remove a pattern from a context.
+ * @param ctx Context whose commands to update.
+ * @param pattern Pattern as registered.
+ * @return CI_OK if removed, CI_INVALID if not found or bad args.
+ */
+ci_status ci_context_unregister_pattern(ci_context *ctx, const char *pattern);
+
+/**
+ * @brief Install a static command table on a context, under its registered commands.
+ * @param ctx Context to update.
+ * @param table Table to install (must stay valid while installed), or NULL to remove it.
+ * @return CI_OK, CI_INVALID on bad args or a table whose hash doesn't place every command
+ *         in its own slot, CI_OVERFLOW on allocation failure.
+ * @note Registered commands overlay the table: a registered command of the same name wins.
+ *       Unlike registered commands the table survives ci_context_stop and restarts.
+ *       Callbacks of a table being replaced may still be running when this returns.
+ */
+ci_status ci_context_set_command_table(ci_context *ctx, const ci_command_table *table);
+
+/*
+ * Reactor: a few threads serving many pollable contexts. Each thread waits on its
+ * own epoll set (poll(2) where epoll is unavailable) and gives every ready context
+ * one read per round, dispatching through that context's own command table.
+ */
+
+/**
+ * @brief Start a reactor.
+ * @param threads Number of reactor threads; contexts are spread round-robin (0 means 1).
+ * @return New reactor, or NULL on allocation/thread failure.
+ */
+ci_reactor *ci_reactor_create(unsigned threads);
+
+/**
+ * @brief Stop every context still attached, join the threads and free the reactor.
+ * @param reactor Reactor to destroy (can be NULL).
+ */
+void ci_reactor_destroy(ci_reactor *reactor);
+
+/**
+ * @brief Hand a context to the reactor.
+ * @param reactor Reactor to serve the context.
+ * @param ctx Context started with options.pollable (register its commands first or later).
+ * @return CI_OK on success, CI_INVALID if the context isn't a running pollable context or
+ *         is already attached, CI_OVERFLOW on allocation failure.
+ * @note The context is detached when its input ends or a stop is requested; then
+ *       ci_context_is_running returns false. Regular files are read every round.
+ */
+ci_status ci_reactor_add(ci_reactor *reactor, ci_context *ctx);
+
+/**
+ * @brief Stop a context and detach it from its reactor.
+ * @param reactor Reactor serving the context.
+ * @param ctx Context to remove.
+ * @return CI_OK on success, CI_INVALID if the context is not attached.
+ * @note Waits for the detach, except from that reactor's own callbacks, where the
+ *       context is detached right after the callback returns. Don't destroy a context
+ *       from its own callbacks.
+ */
+ci_status ci_reactor_remove(ci_reactor *reactor, ci_context *ctx);
+
+/* Command callbacks. Thread-safe for registration while async input runs; dispatch never blocks on it. */
 
 /**
  * @brief Register (or replace) a command string callback.
- * @param command Exact command string to match (max CI_COMMAND_MAX_LEN-1 chars).
+ * @param command Exact command string to match (any length; the table grows as needed).
  * @param callback Callback to invoke when the command matches.
  * @param user_data User pointer passed to the callback.
- * @return CI_OK on success, CI_OVERFLOW if table is full/command too long, CI_INVALID on bad args.
+ * @return CI_OK on success, CI_OVERFLOW on allocation failure, CI_INVALID on bad args.
  */
 ci_status ci_register_command(const char *command,
                                ci_line_callback callback,
                                void *user_data);
 
+/**
+ * @brief Register (or replace) a command string callback with CI_CMD_* flags.
+ * @param command Exact command string to match.
+ * @param callback Callback to invoke when the command matches.
+ * @param user_data User pointer passed to the callback.
+ * @param flags Bitwise OR of CI_CMD_* flags (0 for none).
+ * @return CI_OK on success, CI_OVERFLOW on allocation failure, CI_INVALID on bad args.
+ */
+ci_status ci_register_command_ex(const char *command,
+                                  ci_line_callback callback,
+                                  void *user_data,
+                                  unsigned flags);
+
 /**
  * @brief Remove a previously registered command callback.
  * @param command Command string to remove.
  * @return CI_OK if removed, CI_INVALID if not found or bad args.
+ * @note Waits for an in-flight callback of the command; once this returns the callback will not run.
+ *       Called from a callback, it doesn't wait (callbacks on other workers may be finishing).
  */
 ci_status ci_unregister_command(const char *command);
 
+/**
+ * @brief Install a static command table on the default context; see ci_context_set_command_table.
+ * @param table Table to install, or NULL to remove it.
+ * @return CI_OK, CI_INVALID for an inconsistent table, CI_OVERFLOW on allocation failure.
+ */
+ci_status ci_set_command_table(const ci_command_table *table);
+
+/**
+ * @brief Register (or replace) a verb on the default context; see ci_context_register_verb.
+ * @param verb One or more words separated by single spaces.
+ * @param callback Callback given the verb and its arguments.
+ * @param user_data User pointer passed to the callback.
+ * @param flags Bitwise OR of CI_CMD_* flags.
+ * @return CI_OK on success, CI_OVERFLOW on allocation failure, CI_INVALID on bad args.
+ */
+ci_status ci_register_verb(const char *verb, ci_args_callback callback, void *user_data, unsigned flags);
+
+/**
+ * @brief Remove a verb from the default context.
+ * @param verb Verb as registered.
+ * @return CI_OK if removed, CI_INVALID if not found or bad args.
+ */
+ci_status ci_unregister_verb(const char *verb);
+
+/**
+ * @brief Register (or replace) a pattern on the default context; see ci_context_register_pattern.
+ * @param pattern Glob over the whole line.
+ * @param callback Callback given the line.
+ * @param user_data User pointer passed to the callback.
+ * @param flags Bitwise OR of CI_CMD_* flags.
+ * @return CI_OK on success, CI_OVERFLOW on allocation failure, CI_INVALID on bad args.
+ */
+ci_status ci_register_pattern(const char *pattern, ci_line_callback callback, void *user_data, unsigned flags);
+
+/**
+ * @brief Remove a pattern from the default context.
+ * @param pattern Pattern as registered.
+ * @return CI_OK if removed, CI_INVALID if not found or bad args.
+ */
+ci_status ci_unregister_pattern(const char *pattern);
+
 #endif
@@ -0,0 +1,250 @@
+#include "ci_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CI_ARENA_DEFAULT_CHUNK 65536
+#define CI_ARENA_ALIGN 8
+/* references pre-charged to the chunk being filled, so handing out a line needs no atomic */
+#define CI_ARENA_BIAS ((size_t)1 << (sizeof(size_t) * 8 - 2))
+
+/* Counters with a single writer (the owner thread) that other threads may read. */
+#define ci_arena_count(p, v) __atomic_store_n((p), *(p) + (v), __ATOMIC_RELAXED)
+
+/*
+ * Lines are copied back to back into chunks. Every line holds one reference
+ * on its chunk, and the arena holds one on the chunk it is filling, so a chunk
+ * goes back on the free list once it is full and every line in it has been
+ * released. Only the owning reader thread allocates; any thread may release.
+ *
+ * The chunk being filled starts with CI_ARENA_BIAS extra references; the
+ * lines handed out draw from them, and the unused part is returned in one
+ * subtraction when the chunk is retired.
+ */
+typedef struct ci_arena_chunk {
+    ci_arena *arena;
+    struct ci_arena_chunk *next; /* free list link */
+    size_t refs;
+    size_t size; /* usable bytes in data */
+    size_t used;
+    bool oversize;   /* holds a single line longer than a chunk; freed, not recycled */
+    uint64_t data[]; /* line headers need 8-byte alignment */
+} ci_arena_chunk;
+
+/* Header in front of every line handed out. */
+typedef struct {
+    ci_arena_chunk *chunk;
+    size_t len;
+} ci_arena_line;
+
+struct ci_arena {
+    pthread_mutex_t mutex;
+    size_t chunk_size;
+    ci_arena_chunk *current; /* owner thread only */
+    size_t handed;           /* lines handed out of current, drawn from its bias */
+    ci_arena_chunk *free_list;
+    size_t chunks;      /* allocated and not yet freed, including free ones */
+    size_t chunks_free; /* on the free list */
+    bool closed;
+    /* owner-thread counters, read by ci_arena_get_stats */
+    size_t chunk_allocs;
+    size_t chunk_reuses;
+    size_t lines;
+    size_t bytes;
+    size_t oversize_lines;
+    size_t dropped_lines;
+};
+
+static size_t ci_arena_round(size_t n) {
+    return (n + CI_ARENA_ALIGN - 1) & ~(size_t)(CI_ARENA_ALIGN - 1);
+}
+
+/**
+ * @brief Free an arena once it is closed and its last chunk is gone.
+ */
+static void ci_arena_free(ci_arena *arena) {
+    pthread_mutex_destroy(&arena->mutex);
+    free(arena);
+}
+
+/**
+ * @brief Return a chunk whose last reference was dropped: recycle it, or free it if oversized or the arena is closed.
+ * @param chunk Chunk with refs == 0.
+ */
+static void ci_arena_chunk_done(ci_arena_chunk *chunk) {
+    ci_arena *arena = chunk->arena;
+    bool free_arena = false;
+
+    pthread_mutex_lock(&arena->mutex);
+    if (chunk->oversize || arena->closed) {
+        free(chunk);
+        arena->chunks--;
+        free_arena = arena->closed && arena->chunks == 0;
+    } else {
+        chunk->next = arena->free_list;
+        arena->free_list = chunk;
+        arena->chunks_free++;
+    }
+    pthread_mutex_unlock(&arena->mutex);
+
+    if (free_arena) ci_arena_free(arena);
+}
+
+static void ci_arena_chunk_release(ci_arena_chunk *chunk, size_t refs) {
+    if (ci_atomic_sub(&chunk->refs, refs) == 0) ci_arena_chunk_done(chunk);
+}
+
+/**
+ * @brief Stop filling the current chunk: drop the arena's reference and the unused bias.
+ */
+static void ci_arena_retire(ci_arena *arena, ci_arena_chunk *chunk) {
+    ci_arena_chunk_release(chunk, 1 + CI_ARENA_BIAS - arena->handed);
+}
+
+/**
+ * @brief Take a recycled chunk or allocate a new one.
+ * @param arena Arena to draw from.
+ * @param size Usable bytes needed; a size above the chunk size yields an oversized chunk.
+ * @return Chunk with one reference, or NULL on allocation failure.
+ */
+static ci_arena_chunk *ci_arena_chunk_get(ci_arena *arena, size_t size) {
+    ci_arena_chunk *chunk = NULL;
+    bool oversize = size > arena->chunk_size;
+
+    if (!oversize) {
+        pthread_mutex_lock(&arena->mutex);
+        chunk = arena->free_list;
+        if (chunk) {
+            arena->free_list = chunk->next;
+            arena->chunks_free--;
+        }
+        pthread_mutex_unlock(&arena->mutex);
+        if (chunk) ci_arena_count(&arena->chunk_reuses, 1);
+        size = arena->chunk_size;
+    }
+    if (!chunk) {
+        chunk = malloc(sizeof(*chunk) + size);
+        if (!chunk) return NULL;
+        chunk->arena = arena;
+        chunk->size = size;
+        chunk->oversize = oversize;
+        pthread_mutex_lock(&arena->mutex);
+        arena->chunks++;
+        pthread_mutex_unlock(&arena->mutex);
+        ci_arena_count(&arena->chunk_allocs, 1);
+    }
+    chunk->next = NULL;
+    chunk->used = 0;
+    ci_atomic_store(&chunk->refs, 1);
+    return chunk;
+}
+
+ci_arena *ci_arena_create(size_t chunk_size) {
+    if (chunk_size == 0) chunk_size = CI_ARENA_DEFAULT_CHUNK;
+    chunk_size = ci_arena_round(chunk_size);
+
+    ci_arena *arena = calloc(1, sizeof(*arena));
+    if (!arena) return NULL;
+    pthread_mutex_init(&arena->mutex, NULL);
+    arena->chunk_size = chunk_size;
+    return arena;
+}
+
+void ci_arena_destroy(ci_arena *arena) {
+    if (!arena) return;
+
+    pthread_mutex_lock(&arena->mutex);
+    arena->closed = true;
+    ci_arena_chunk *chunk = arena->free_list;
+    arena->free_list = NULL;
+    while (chunk) {
+        ci_arena_chunk *next = chunk->next;
+        free(chunk);
+        arena->chunks--;
+        arena->chunks_free--;
+        chunk = next;
+    }
+    ci_arena_chunk *current = arena->current;
+    bool free_now = arena->chunks == 0;
+    pthread_mutex_unlock(&arena->mutex);
+
+    /* lines still retained keep their chunks (and the arena) alive until released */
+    if (current) {
+        ci_arena_retire(arena, current);
+    } else if (free_now) {
+        ci_arena_free(arena);
+    }
+}
+
+char *ci_arena_copy(ci_arena *arena, const char *line, size_t len) {
+    size_t need = ci_arena_round(sizeof(ci_arena_line) + len + 1);
+    ci_arena_chunk *chunk;
+
+    if (need > arena->chunk_size) {
+        /* the single reference is the line's */
+        chunk = ci_arena_chunk_get(arena, need);
+        if (!chunk) {
+            ci_arena_count(&arena->dropped_lines, 1);
+            return NULL;
+        }
+        ci_arena_count(&arena->oversize_lines, 1);
+    } else {
+        chunk = arena->current;
+        if (!chunk || chunk->size - chunk->used < need) {
+            /* the old chunk is recycled once its lines are released */
+            if (chunk) ci_arena_retire(arena, chunk);
+            chunk = arena->current = ci_arena_chunk_get(arena, need);
+            if (!chunk) {
+                ci_arena_count(&arena->dropped_lines, 1);
+                return NULL;
+            }
+            ci_atomic_add(&chunk->refs, CI_ARENA_BIAS);
+            arena->handed = 0;
+        }
+        arena->handed++;
+    }
+
+    ci_arena_line *hdr = (ci_arena_line *)(void *)((char *)chunk->data + chunk->used);
+    chunk->used += need;
+    hdr->chunk = chunk;
+    hdr->len = len;
+    char *text = (char *)(hdr + 1);
+    memcpy(text, line, len);
+    text[len] = '\0';
+    ci_arena_count(&arena->lines, 1);
+    ci_arena_count(&arena->bytes, len);
+    return text;
+}
+
+/**
+ * @brief Header of a line handed out by ci_arena_copy.
+ */
+static ci_arena_line *ci_arena_header(const char *line) {
+    return (ci_arena_line *)(void *)(line - sizeof(ci_arena_line));
+}
+
+size_t ci_arena_line_len(const char *line) {
+    return ci_arena_header(line)->len;
+}
+
+void ci_line_retain(const char *line) {
+    if (line) ci_atomic_add(&ci_arena_header(line)->chunk->refs, 1);
+}
+
+void ci_line_release(const char *line) {
+    if (line) ci_arena_chunk_release(ci_arena_header(line)->chunk, 1);
+}
+
+void ci_arena_get_stats(ci_arena *arena, ci_arena_stats *out) {
+    pthread_mutex_lock(&arena->mutex);
+    out->chunks = arena->chunks;
+    out->chunks_free = arena->chunks_free;
+    pthread_mutex_unlock(&arena->mutex);
+    out->chunk_size = arena->chunk_size;
+    out->chunk_allocs = __atomic_load_n(&arena->chunk_allocs, __ATOMIC_RELAXED);
+    out->chunk_reuses = __atomic_load_n(&arena->chunk_reuses, __ATOMIC_RELAXED);
+    out->lines = __atomic_load_n(&arena->lines, __ATOMIC_RELAXED);
+    out->bytes = __atomic_load_n(&arena->bytes, __ATOMIC_RELAXED);
+    out->oversize_lines = __atomic_load_n(&arena->oversize_lines, __ATOMIC_RELAXED);
+    out->dropped_lines = __atomic_load_n(&arena->dropped_lines, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,780 @@
+#include "ci_internal.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CI_LINE_DEFAULT_MAX (1024 * 1024)
+#define CI_BATCH_DEFAULT_MAX 64
+#define CI_POLL_MAX_READS 8
+
+static ci_context ci_default;
+static pthread_once_t ci_default_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Reset a context to the stopped state for a descriptor and output stream.
+ * @param ctx Context to initialize.
+ * @param fd Input descriptor.
+ * @param out Stream for prompts and messages (can be NULL).
+ */
+static void ci_context_init(ci_context *ctx, int fd, FILE *out) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->fd = fd;
+    ci_output_init(&ctx->out, out);
+    ci_wake_init(&ctx->wake);
+    ci_inject_init(&ctx->inject);
+    ci_registry_init(&ctx->commands);
+    ci_stats_init(&ctx->stats);
+}
+
+/**
+ * @brief One-time setup of the stdin/stdout context behind the ci_* wrappers.
+ */
+static void ci_default_init(void) {
+    ci_context_init(&ci_default, STDIN_FILENO, stdout);
+}
+
+ci_context *ci_default_context(void) {
+    pthread_once(&ci_default_once, ci_default_init);
+    return &ci_default;
+}
+
+ci_context *ci_context_create(int fd, FILE *out) {
+    if (fd < 0) return NULL;
+
+    ci_context *ctx = malloc(sizeof(*ctx));
+    if (!ctx) return NULL;
+    ci_context_init(ctx, fd, out);
+
+    ctx->reader = ci_reader_create(fd, 0);
+    if (!ctx->reader) {
+        ci_stats_destroy(&ctx->stats);
+        ci_registry_destroy(&ctx->commands);
+        free(ctx);
+        return NULL;
+    }
+    ctx->owns_reader = true;
+    return ctx;
+}
+
+void ci_context_destroy(ci_context *ctx) {
+    if (!ctx || ctx == &ci_default) return;
+    ci_context_stop(ctx);
+    ci_registry_destroy(&ctx->commands);
+    ci_stats_destroy(&ctx->stats);
+    if (ctx->owns_reader) ci_reader_destroy(ctx->reader);
+    ci_wake_close(&ctx->wake);
+    free(ctx);
+}
+
+/**
+ * @brief Queue a message on the context's output; it is flushed before the next blocking read.
+ * @param ctx Context to write to.
+ * @param text Text to write (can be NULL).
+ */
+static void ci_context_write(ci_context *ctx, const char *text) {
+    ci_output_write(&ctx->out, text);
+}
+
+/**
+ * @brief Report (and count) an over-long line that was skipped.
+ * @param ctx Context the line belongs to.
+ */
+static void ci_context_overflow(ci_context *ctx) {
+    ci_stats_shard *shard = ci_stats_shard_for(&ctx->stats);
+    if (shard) ci_stats_count(&shard->overflows, 1);
+    ci_context_write(ctx, "Input too long, try again.\n");
+}
+
+/**
+ * @brief Queue the prompt if the context's prompt policy calls for one.
+ * @param ctx Context to prompt on.
+ */
+static void ci_context_prompt(ci_context *ctx) {
+    if (ctx->prompt && ci_prompt_wanted(ctx->prompt_policy, ctx->reader, &ctx->out)) {
+        ci_output_write(&ctx->out, ctx->prompt);
+    }
+}
+
+ci_status ci_context_set_prompt_policy(ci_context *ctx, ci_prompt_policy policy) {
+    if (!ctx || policy < CI_PROMPT_TTY || policy > CI_PROMPT_NEVER) return CI_INVALID;
+    ctx->prompt_policy = policy;
+    return CI_OK;
+}
+
+/**
+ * @brief Queue a line for the workers, or run its command/default callback here.
+ * @param ctx Context the line belongs to.
+ * @param line NUL-terminated line (may contain embedded NULs).
+ * @param len Line length.
+ * @param read_ns When the line was read, for the read-to-dispatch latency (0 if unknown).
+ */
+static void ci_dispatch_line(ci_context *ctx, const char *line, size_t len, uint64_t read_ns) {
+    ci_stats_shard *shard = ci_stats_shard_for(&ctx->stats);
+    if (ctx->use_workers) {
+        /* workers count the line when they dispatch it; the pool counts lines it drops */
+        ci_command_entry entry;
+        unsigned flags = ci_registry_lookup(&ctx->commands, line, len, &entry) ? entry.flags : 0;
+        ci_pool_submit(&ctx->workers, line, len, flags, shard ? read_ns : 0);
+        return;
+    }
+
+    char *copy = NULL;
+    if (ctx->arena) {
+        /* callbacks may retain the copy; the reference taken here is dropped after them */
+        /* without one the line is dropped, as a callback could retain it; the arena counts it */
+        copy = ci_arena_copy(ctx->arena, line, len);
+        if (!copy) return;
+        line = copy;
+    }
+    if (shard) ci_stats_line(shard, len, read_ns);
+    if (!ci_registry_dispatch(&ctx->commands, line, len, shard)) {
+        if (ctx->view_cb) {
+            ctx->view_cb(line, len, ctx->cb_data);
+        } else if (ctx->cb) {
+            ctx->cb(line, ctx->cb_data);
+        }
+        if (shard) ci_stats_callback(shard, false);
+    }
+    ci_line_release(copy);
+}
+
+/**
+ * @brief Hand the pending views to the batch callback.
+ * @param ctx Context owning the batch.
+ * @param count In/out number of pending views; reset to 0.
+ */
+static void ci_batch_flush(ci_context *ctx, size_t *count) {
+    if (*count == 0) return;
+    ci_stats_shard *shard = ci_stats_shard_for(&ctx->stats);
+    uint64_t start = shard ? ci_stats_now() : 0;
+    ctx->batch_cb(ctx->batch_views, *count, ctx->cb_data);
+    if (shard) ci_hist_add(&shard->callback, ci_stats_now() - start);
+    *count = 0;
+}
+
+/**
+ * @brief Flush the pending batch from outside a registry section.
+ * @param ctx Context owning the batch.
+ * @param count In/out number of pending views; reset to 0.
+ */
+static void ci_async_batch_flush_now(ci_context *ctx, size_t *count) {
+    if (*count == 0) return;
+    ci_registry_section section;
+    ci_registry_begin(&ctx->commands, &section);
+    ci_batch_flush(ctx, count);
+    ci_registry_end(&ctx->commands, &section);
+}
+
+/**
+ * @brief Route one framed line: commands run immediately (after flushing), others join the batch.
+ * @note Called inside a registry section.
+ * @param ctx Context owning the batch.
+ * @param line NUL-terminated view into the reader buffer.
+ * @param len Line length.
+ * @param read_ns When the line was read (0 if unknown).
+ * @param count In/out number of pending views.
+ * @param deadline In/out time by which a non-empty batch must be flushed.
+ */
+static void ci_batch_add(ci_context *ctx,
+                         const char *line,
+                         size_t len,
+                         uint64_t read_ns,
+                         size_t *count,
+                         struct timespec *deadline) {
+    if (len > ctx->max_line) {
+        ci_batch_flush(ctx, count);
+        ci_context_overflow(ctx);
+        return;
+    }
+
+    ci_stats_shard *shard = ci_stats_shard_for(&ctx->stats);
+    if (shard) ci_stats_line(shard, len, read_ns);
+    ci_command_entry entry;
+    if (ci_registry_find_entry(&ctx->commands, line, len, &entry)) {
+        /* keep command callbacks ordered after the lines that preceded them */
+        ci_batch_flush(ctx, count);
+        if (shard) {
+            shard->mark = ci_stats_now();
+            ci_registry_dispatch(&ctx->commands, line, len, shard);
+        } else {
+            ci_registry_run_entry(&entry, line, len);
+        }
+        return;
+    }
+    if (shard) ci_stats_count(&shard->command_misses, 1);
+
+    if (*count == 0) {
+        clock_gettime(CLOCK_MONOTONIC, deadline);
+        deadline->tv_sec += ctx->batch_wait_ms / 1000;
+        deadline->tv_nsec += (long)(ctx->batch_wait_ms % 1000) * 1000000L;
+        if (deadline->tv_nsec >= 1000000000L) {
+            deadline->tv_sec++;
+            deadline->tv_nsec -= 1000000000L;
+        }
+    }
+    ctx->batch_views[*count].data = line;
+    ctx->batch_views[*count].len = len;
+    if (++*count == ctx->batch_max) ci_batch_flush(ctx, count);
+}
+
+/**
+ * @brief Dispatch lines injected by other threads, in the order they were pushed.
+ * @param ctx Context whose input thread is calling.
+ * @param close Stop accepting injected lines (the thread is about to exit).
+ * @note In batch mode the caller has flushed any pending batch.
+ */
+static void ci_context_run_injected(ci_context *ctx, bool close) {
+    ci_inject_node *first = ci_inject_take(&ctx->inject, close);
+    if (!first) return;
+    if (ctx->batch_cb) {
+        size_t count = 0;
+        struct timespec deadline;
+        ci_registry_section section;
+        ci_registry_begin(&ctx->commands, &section);
+        for (ci_inject_node *node = first; node; node = node->next) {
+            ci_batch_add(ctx, node->line, node->len, 0, &count, &deadline);
+        }
+        ci_batch_flush(ctx, &count);
+        ci_registry_end(&ctx->commands, &section);
+    } else {
+        for (ci_inject_node *node = first; node; node = node->next) ci_dispatch_line(ctx, node->line, node->len, 0);
+    }
+    while (first) {
+        ci_inject_node *next = first->next;
+        ci_inject_release(first);
+        first = next;
+    }
+}
+
+/**
+ * @brief Per-line loop: frame each line in the reader buffer and dispatch (or queue) it.
+ * @param ctx Context to serve.
+ */
+static void ci_async_line_loop(ci_context *ctx) {
+    const char *line;
+    size_t len;
+    bool prompted = false;
+
+    while (ci_atomic_load(&ctx->running) && !ci_atomic_load(&ctx->stop_requested)) {
+        /* lines held for a full lane; a worker wakes the read below once one fits */
+        if (ctx->use_workers) ci_pool_flush(&ctx->workers);
+        if (ci_inject_pending(&ctx->inject)) ci_context_run_injected(ctx, false);
+        if (!prompted) ci_context_prompt(ctx);
+        prompted = true;
+        ci_status status = ci_reader_next_line(ctx->reader, ctx->max_line, &line, &len);
+        if (status == CI_WOKEN) {
+            /* a stop request, injected lines or room for held ones; the loop checks for each */
+            ci_wake_drain(&ctx->wake);
+            continue;
+        }
+        prompted = false;
+        if (status == CI_EOF || status == CI_INVALID) break;
+        if (status == CI_OVERFLOW) {
+            ci_context_overflow(ctx);
+            continue;
+        }
+
+        ci_dispatch_line(ctx, line, len, ctx->reader->filled_ns);
+
+        if (ci_atomic_load(&ctx->stop_requested)) break;
+    }
+}
+
+/**
+ * @brief Milliseconds left until a deadline (rounded up), or 0 if it has passed.
+ * @param deadline CLOCK_MONOTONIC deadline.
+ * @return Remaining milliseconds.
+ */
+static int ci_millis_until(const struct timespec *deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long ns = (long long)(deadline->tv_sec - now.tv_sec) * 1000000000LL + (deadline->tv_nsec - now.tv_nsec);
+    if (ns <= 0) return 0;
+    return (int)((ns + 999999) / 1000000);
+}
+
+/**
+ * @brief Batch loop: frame every buffered line in place and deliver them as views.
+ * @param ctx Context to serve.
+ *
+ * Views point into the reader buffer, so the buffer is only compacted once the
+ * pending batch has been flushed. A batch is flushed when it reaches max_batch,
+ * when max_wait_ms has passed since its first line, or when the buffer is full.
+ * A line that fills the whole buffer makes it grow, which also needs an empty batch.
+ */
+static void ci_async_batch_loop(ci_context *ctx) {
+    ci_reader *reader = ctx->reader;
+    size_t count = 0;
+    struct timespec deadline = {0, 0};
+    bool eof = false;
+    const char *line;
+    size_t len;
+
+    while (ci_atomic_load(&ctx->running) && !ci_atomic_load(&ctx->stop_requested)) {
+        /* one registry section per drained block */
+        ci_registry_section section;
+        ci_registry_begin(&ctx->commands, &section);
+        while (!ci_atomic_load(&ctx->stop_requested) && ci_reader_next_buffered(reader, &line, &len)) {
+            ci_batch_add(ctx, line, len, reader->filled_ns, &count, &deadline);
+        }
+        if (eof && !ci_atomic_load(&ctx->stop_requested) && ci_reader_take_rest(reader, &line, &len)) {
+            ci_batch_add(ctx, line, len, reader->filled_ns, &count, &deadline);
+        }
+        size_t pending = reader->tail - reader->head;
+        bool too_long = pending > ctx->max_line + 1;
+        bool must_grow = !too_long && pending == reader->cap;
+        if (eof || ci_atomic_load(&ctx->stop_requested) || too_long || must_grow) ci_batch_flush(ctx, &count);
+        ci_registry_end(&ctx->commands, &section);
+        if (eof || ci_atomic_load(&ctx->stop_requested)) break;
+
+        if (too_long || (must_grow && !ci_reader_grow(reader, ctx->max_line))) {
+            /* no newline within the line limit; skipping compacts, so the batch was flushed */
+            reader->head = reader->tail;
+            ci_reader_skip_line(reader);
+            ci_context_overflow(ctx);
+            continue;
+        }
+
+        if (count > 0) {
+            int wait = reader->tail < reader->cap ? ci_millis_until(&deadline) : 0;
+            if (wait == 0 || !ci_reader_wait(reader, wait)) {
+                ci_async_batch_flush_now(ctx, &count);
+                continue;
+            }
+        } else {
+            ci_context_prompt(ctx);
+        }
+
+        ssize_t n = ci_reader_fill(reader, count == 0);
+        if (n == CI_READ_WOKEN) {
+            ci_wake_drain(&ctx->wake);
+            /* injected lines can't share a batch with views of the read buffer */
+            ci_async_batch_flush_now(ctx, &count);
+            ci_context_run_injected(ctx, false);
+            continue;
+        }
+        if (n == 0) eof = true;
+        if (n < 0) break;
+    }
+    ci_async_batch_flush_now(ctx, &count);
+}
+
+/**
+ * @brief Thread routine that reads lines and dispatches to commands/default callback.
+ * @param arg Context to serve.
+ * @return NULL when thread exits.
+ */
+static void *ci_async_thread(void *arg) {
+    ci_context *ctx = arg;
+
+    if (ctx->batch_cb) {
+        ci_async_batch_loop(ctx);
+    } else {
+        ci_async_line_loop(ctx);
+    }
+
+    /* lines injected before the queue closes still run */
+    ci_context_run_injected(ctx, true);
+
+    /* let workers finish what was queued before reporting the thread as stopped */
+    ci_output_flush(&ctx->out);
+    ci_pool_shutdown(&ctx->workers);
+    ci_stats_detach(&ctx->stats);
+    ctx->reader->wake_fd = -1;
+    ci_atomic_store(&ctx->running, false);
+    ci_atomic_store(&ctx->stop_requested, false);
+    return NULL;
+}
+
+/**
+ * @brief Drop the arena of a stopped context; retained lines keep their chunks until released.
+ * @param ctx Context to reset.
+ */
+static void ci_context_release_arena(ci_context *ctx) {
+    ci_arena_destroy(ctx->arena);
+    ctx->arena = NULL;
+}
+
+/**
+ * @brief Drop batch-mode state set up by ci_context_start.
+ * @param ctx Context to reset.
+ */
+static void ci_batch_release(ci_context *ctx) {
+    free(ctx->batch_views);
+    ctx->batch_views = NULL;
+    ctx->batch_cb = NULL;
+    ctx->batch_max = 0;
+    ctx->batch_wait_ms = 0;
+}
+
+ci_status ci_context_start(ci_context *ctx,
+                           const char *prompt,
+                           ci_line_callback callback,
+                           void *user_data,
+                           const ci_async_options *options) {
+    if (!ctx) return CI_INVALID;
+    bool batch = options && options->batch_callback;
+    bool pollable = options && options->pollable;
+    ci_view_callback view_callback = options ? options->view_callback : NULL;
+    if (!callback && !batch && !view_callback) return CI_INVALID;
+    if (batch && (options->workers > 0 || view_callback || options->arena_lines)) return CI_INVALID;
+    if (pollable && (batch || options->workers > 0)) return CI_INVALID;
+    if (options && (options->overload < CI_OVERLOAD_BLOCK || options->overload > CI_OVERLOAD_COALESCE ||
+                    (options->overload != CI_OVERLOAD_BLOCK && options->workers == 0))) {
+        return CI_INVALID;
+    }
+    if (ci_atomic_load(&ctx->running) || ctx->polling) return CI_INVALID;
+    if (ctx->thread_joinable) {
+        /* previous thread ended on its own (EOF or stop request) */
+        pthread_join(ctx->thread, NULL);
+        ctx->thread_joinable = false;
+        ctx->use_workers = false;
+        ci_batch_release(ctx);
+    }
+    ci_context_release_arena(ctx);
+
+    /* the default context shares its stdin reader with ci_prompt_line */
+    if (!ctx->reader) ctx->reader = ci_reader_for_fd(ctx->fd);
+    if (!ctx->reader) return CI_INVALID;
+    ctx->reader->out = &ctx->out;
+
+    ctx->cb = callback;
+    ctx->view_cb = view_callback;
+    ctx->cb_data = user_data;
+    ctx->prompt = prompt;
+    ctx->max_line = options && options->max_line ? options->max_line : CI_LINE_DEFAULT_MAX;
+    ci_registry_clear(&ctx->commands);
+    ci_atomic_store(&ctx->stop_requested, false);
+
+    if (options && options->arena_lines) {
+        ctx->arena = ci_arena_create(options->arena_chunk_size);
+        if (!ctx->arena) return CI_INVALID;
+    }
+
+    if (pollable) {
+        /* readiness is reported on the descriptor, which io_uring read-ahead drains */
+        if (ctx->reader->uring) {
+            ci_context_release_arena(ctx);
+            return CI_INVALID;
+        }
+        ctx->poll_skipping = false;
+        ctx->polling = true;
+        ci_atomic_store(&ctx->running, true);
+        ci_context_prompt(ctx);
+        ci_output_flush(&ctx->out);
+        return CI_OK;
+    }
+
+    if (batch) {
+        ctx->batch_max = options->max_batch ? options->max_batch : CI_BATCH_DEFAULT_MAX;
+        ctx->batch_wait_ms = options->max_wait_ms;
+        ctx->batch_views = malloc(ctx->batch_max * sizeof(*ctx->batch_views));
+        if (!ctx->batch_views) {
+            ci_context_release_arena(ctx);
+            return CI_INVALID;
+        }
+        ctx->batch_cb = options->batch_callback;
+    }
+
+    /* io_uring is best effort; without it the reader keeps using read(2) */
+    if (options && options->backend == CI_BACKEND_IO_URING) {
+        ci_reader_set_backend(ctx->reader, CI_BACKEND_IO_URING);
+    }
+
+    /* stop requests wake the thread through this pipe instead of cancelling it */
+    if (!ci_wake_open(&ctx->wake)) {
+        ci_batch_release(ctx);
+        ci_context_release_arena(ctx);
+        return CI_INVALID;
+    }
+    ci_wake_drain(&ctx->wake);
+
+    ctx->use_workers = options && options->workers > 0;
+    memset(&ctx->ingest, 0, sizeof(ctx->ingest));
+    if (ctx->use_workers && !ci_pool_start(&ctx->workers, options->workers, options->queue_capacity,
+                                           &ctx->commands, callback, view_callback, user_data, ctx->arena,
+                                           &ctx->stats, options->overload, &ctx->ingest, &ctx->wake)) {
+        memset(&ctx->ingest, 0, sizeof(ctx->ingest));
+        ctx->use_workers = false;
+        ci_batch_release(ctx);
+        ci_context_release_arena(ctx);
+        return CI_INVALID;
+    }
+
+    ci_atomic_store(&ctx->running, true);
+    ctx->reader->wake_fd = ctx->wake.fds[0];
+    ci_inject_open(&ctx->inject);
+    int rc = pthread_create(&ctx->thread, NULL, ci_async_thread, ctx);
+    if (rc != 0) {
+        for (ci_inject_node *node = ci_inject_take(&ctx->inject, true); node;) {
+            ci_inject_node *next = node->next;
+            ci_inject_release(node);
+            node = next;
+        }
+        ctx->reader->wake_fd = -1;
+        ci_atomic_store(&ctx->running, false);
+        ci_pool_shutdown(&ctx->workers);
+        ctx->use_workers = false;
+        ci_batch_release(ctx);
+        ci_context_release_arena(ctx);
+        return CI_INVALID;
+    }
+    ctx->thread_joinable = true;
+
+    return CI_OK;
+}
+
+ci_status ci_context_register_command(ci_context *ctx,
+                                      const char *command,
+                                      ci_line_callback callback,
+                                      void *user_data,
+                                      unsigned flags) {
+    if (!ctx || !command || !callback || (flags & CI_CMD_NOCASE) || !ci_cmd_flags_valid(flags)) return CI_INVALID;
+    return ci_registry_put(&ctx->commands, command, callback, user_data, flags);
+}
+
+ci_status ci_context_unregister_command(ci_context *ctx, const char *command) {
+    if (!ctx || !command) return CI_INVALID;
+    return ci_registry_remove(&ctx->commands, command);
+}
+
+ci_status ci_context_register_verb(ci_context *ctx,
+                                   const char *verb,
+                                   ci_args_callback callback,
+                                   void *user_data,
+                                   unsigned flags) {
+    if (!ctx || !ci_verb_valid(verb) || !callback || !ci_cmd_flags_valid(flags)) return CI_INVALID;
+    return ci_registry_put_verb(&ctx->commands, verb, callback, user_data, flags);
+}
+
+ci_status ci_context_unregister_verb(ci_context *ctx, const char *verb) {
+    if (!ctx || !verb) return CI_INVALID;
+    return ci_registry_remove_verb(&ctx->commands, verb);
+}
+
+ci_status ci_context_register_pattern(ci_context *ctx,
+                                      const char *pattern,
+                                      ci_line_callback callback,
+                                      void *user_data,
+                                      unsigned flags) {
+    if (!ctx || !pattern || !callback || !ci_cmd_flags_valid(flags)) return CI_INVALID;
+    ci_pattern *compiled;
+    ci_status status = ci_pattern_compile(pattern, callback, user_data, flags, &compiled);
+    if (status != CI_OK) return status;
+    return ci_registry_put_pattern(&ctx->commands, compiled);
+}
+
+ci_status ci_context_unregister_pattern(ci_context *ctx, const char *pattern) {
+    if (!ctx || !pattern) return CI_INVALID;
+    return ci_registry_remove_pattern(&ctx->commands, pattern);
+}
+
+ci_status ci_context_set_command_table(ci_context *ctx, const ci_command_table *table) {
+    if (!ctx) return CI_INVALID;
+    return ci_registry_set_table(&ctx->commands, table);
+}
+
+/**
+ * @brief Forget the callbacks and commands of a stopped context.
+ * @param ctx Context to reset.
+ */
+static void ci_context_reset(ci_context *ctx) {
+    ci_atomic_store(&ctx->running, false);
+    ctx->cb = NULL;
+    ctx->view_cb = NULL;
+    ctx->cb_data = NULL;
+    ctx->prompt = NULL;
+    ci_registry_clear(&ctx->commands);
+    ci_context_release_arena(ctx);
+    ci_atomic_store(&ctx->stop_requested, false);
+}
+
+void ci_context_stop(ci_context *ctx) {
+    if (!ctx) return;
+    if (ci_atomic_load(&ctx->shard)) ci_reactor_release(ctx);
+    if (ctx->polling) {
+        ctx->polling = false;
+        ci_context_reset(ctx);
+        return;
+    }
+    if (!ctx->thread_joinable) return;
+
+    ci_atomic_store(&ctx->stop_requested, true);
+    ci_wake_signal(&ctx->wake);
+    pthread_join(ctx->thread, NULL);
+    ctx->thread_joinable = false;
+    ci_pool_shutdown(&ctx->workers);
+    ctx->use_workers = false;
+    ci_batch_release(ctx);
+    ci_context_reset(ctx);
+}
+
+void ci_context_request_stop(ci_context *ctx) {
+    if (!ctx) return;
+    ci_atomic_store(&ctx->stop_requested, true);
+    ci_wake_signal(&ctx->wake);
+}
+
+bool ci_context_is_running(const ci_context *ctx) {
+    return ctx && ci_atomic_load(&ctx->running);
+}
+
+/**
+ * @brief Dispatch every complete line buffered by a pollable context.
+ * @param ctx Pollable context.
+ * @return Number of lines consumed.
+ */
+static size_t ci_poll_drain(ci_context *ctx) {
+    ci_reader *reader = ctx->reader;
+    size_t lines = 0;
+    const char *line;
+    size_t len;
+
+    while (!ci_atomic_load(&ctx->stop_requested)) {
+        if (ctx->poll_skipping) {
+            /* dropping the rest of an over-long line */
+            const char *nl = ci_scan(reader->buf + reader->head, reader->tail - reader->head, '\n');
+            if (!nl) {
+                reader->head = reader->tail;
+                break;
+            }
+            reader->head = (size_t)(nl - reader->buf) + 1;
+            ctx->poll_skipping = false;
+            continue;
+        }
+        if (!ci_reader_next_buffered(reader, &line, &len)) {
+            size_t pending = reader->tail - reader->head;
+            if (pending > ctx->max_line + 1 || (pending == reader->cap && !ci_reader_grow(reader, ctx->max_line))) {
+                ci_context_overflow(ctx);
+                ctx->poll_skipping = true;
+                continue;
+            }
+            break;
+        }
+        lines++;
+        if (len > ctx->max_line) {
+            ci_context_overflow(ctx);
+            continue;
+        }
+        ci_dispatch_line(ctx, line, len, ctx->reader->filled_ns);
+    }
+    return lines;
+}
+
+ci_status ci_context_get_arena_stats(const ci_context *ctx, ci_arena_stats *out) {
+    if (!ctx || !out || !ctx->arena) return CI_INVALID;
+    ci_arena_get_stats(ctx->arena, out);
+    return CI_OK;
+}
+
+ci_status ci_context_inject_lines(ci_context *ctx, const ci_line_view *lines, size_t count) {
+    if (!ctx || (!lines && count)) return CI_INVALID;
+    bool was_empty = false;
+    ci_status status = ci_inject_push(&ctx->inject, lines, count, ctx->max_line, &was_empty);
+    if (status == CI_OK && was_empty) ci_wake_signal(&ctx->wake);
+    return status;
+}
+
+ci_status ci_context_inject_line(ci_context *ctx, const char *line, size_t len) {
+    ci_line_view view = {line, len};
+    return ci_context_inject_lines(ctx, &view, 1);
+}
+
+ci_status ci_context_get_ingest_stats(const ci_context *ctx, ci_ingest_stats *out) {
+    if (!ctx || !out || ctx->ingest.capacity == 0) return CI_INVALID;
+    out->capacity = ctx->ingest.capacity;
+    out->queued = __atomic_load_n(&ctx->ingest.queued, __ATOMIC_RELAXED);
+    out->priority = __atomic_load_n(&ctx->ingest.priority, __ATOMIC_RELAXED);
+    out->blocked = __atomic_load_n(&ctx->ingest.blocked, __ATOMIC_RELAXED);
+    out->dropped_oldest = __atomic_load_n(&ctx->ingest.dropped_oldest, __ATOMIC_RELAXED);
+    out->dropped_newest = __atomic_load_n(&ctx->ingest.dropped_newest, __ATOMIC_RELAXED);
+    out->coalesced = __atomic_load_n(&ctx->ingest.coalesced, __ATOMIC_RELAXED);
+    out->dropped_nomem = __atomic_load_n(&ctx->ingest.dropped_nomem, __ATOMIC_RELAXED);
+    return CI_OK;
+}
+
+ci_status ci_context_enable_stats(ci_context *ctx, bool enable) {
+#ifdef CI_NO_STATS
+    (void)ctx;
+    (void)enable;
+    return CI_INVALID;
+#else
+    if (!ctx) return CI_INVALID;
+    __atomic_store_n(&ctx->stats.enabled, enable, __ATOMIC_RELAXED);
+    return CI_OK;
+#endif
+}
+
+ci_status ci_context_get_stats(ci_context *ctx, ci_stats *out) {
+    if (!ctx || !out) return CI_INVALID;
+    ci_stats_snapshot(&ctx->stats, out);
+    return CI_OK;
+}
+
+ci_status ci_context_reset_stats(ci_context *ctx) {
+    if (!ctx) return CI_INVALID;
+    ci_registry_reset_stats(&ctx->commands);
+    return ci_stats_reset(&ctx->stats) ? CI_OK : CI_OVERFLOW;
+}
+
+ci_status ci_context_get_command_stats(ci_context *ctx, const char *command, ci_latency_stats *out) {
+    if (!ctx || !command || !out) return CI_INVALID;
+    return ci_registry_command_stats(&ctx->commands, command, out) ? CI_OK : CI_INVALID;
+}
+
+int ci_context_get_fd(const ci_context *ctx) {
+    return ctx && ctx->polling ? ctx->reader->fd : -1;
+}
+
+ci_status ci_context_pump(ci_context *ctx, unsigned max_reads, bool known_ready) {
+    if (!ctx->polling) return CI_INVALID;
+    if (!ci_atomic_load(&ctx->running)) return CI_EOF;
+
+    ci_reader *reader = ctx->reader;
+    size_t lines = 0;
+    ci_status status = CI_OK;
+
+    for (unsigned reads = 0; reads < max_reads && !ci_atomic_load(&ctx->stop_requested); reads++) {
+        if ((reads > 0 || !known_ready) && !ci_reader_wait(reader, 0)) break;
+
+        ssize_t n = ci_reader_fill(reader, true);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            status = CI_INVALID;
+            break;
+        }
+        if (n == 0) {
+            lines += ci_poll_drain(ctx);
+            const char *line;
+            size_t len;
+            bool stopping = ci_atomic_load(&ctx->stop_requested);
+            if (!stopping && !ctx->poll_skipping && ci_reader_take_rest(reader, &line, &len)) {
+                lines++;
+                if (len <= ctx->max_line) ci_dispatch_line(ctx, line, len, reader->filled_ns);
+            }
+            status = CI_EOF;
+            break;
+        }
+        lines += ci_poll_drain(ctx);
+    }
+
+    ci_output_flush(&ctx->out);
+    if (ci_atomic_load(&ctx->stop_requested) || status != CI_OK) {
+        ci_atomic_store(&ctx->running, false);
+        return status == CI_OK ? CI_EOF : status;
+    }
+    if (lines > 0) ci_context_prompt(ctx);
+    ci_output_flush(&ctx->out);
+    return CI_OK;
+}
+
+ci_status ci_context_process_ready(ci_context *ctx) {
+    if (!ctx) return CI_INVALID;
+    /* bounded number of reads per call so one busy stream can't starve the caller's loop */
+    return ci_context_pump(ctx, CI_POLL_MAX_READS, false);
+}
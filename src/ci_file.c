@@ -0,0 +1,294 @@
+#include "ci_internal.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CI_FILE_DEFAULT_CHUNK (1024 * 1024)
+#define CI_FILE_MAX_THREADS 256
+
+/*
+ * The mapping is split into fixed-size chunks. Chunk k owns the lines that
+ * start inside it: it begins after the first newline at or past its start
+ * (chunk 0 at offset 0) and its last line may run into the next chunk, so no
+ * pre-pass over the file is needed to find the boundaries. Threads claim
+ * chunks from a shared counter. In ordered mode a thread frames its chunk
+ * into a line table in parallel with the others, then waits for the chunk's
+ * turn to run the callbacks.
+ */
+typedef struct {
+    size_t offset;
+    size_t len;
+} ci_file_line;
+
+typedef struct ci_file_job ci_file_job;
+
+typedef struct {
+    ci_file_job *job;
+    char *scratch; /* NUL-terminated copy of the line being dispatched */
+    size_t scratch_cap;
+    ci_file_line *lines; /* ordered mode: framed lines of the current chunk */
+    size_t line_count;
+    size_t lines_cap;
+    ci_stats_shard *shard; /* this thread's statistics, or NULL when off */
+    bool failed;
+} ci_file_worker;
+
+struct ci_file_job {
+    ci_context *ctx;
+    ci_line_callback cb;
+    ci_view_callback view_cb;
+    void *cb_data;
+    const char *data;
+    size_t size;
+    size_t chunk_size;
+    size_t chunks;
+    size_t next_chunk; /* atomic: next chunk to claim */
+    bool ordered;
+    pthread_mutex_t mutex; /* ordered mode: guards turn */
+    pthread_cond_t cond;
+    size_t turn; /* ordered mode: chunk whose lines run next */
+};
+
+/**
+ * @brief Run the command or default callback for one line of the mapping.
+ * @param worker Worker dispatching the line.
+ * @param line Line bytes inside the mapping (not NUL-terminated).
+ * @param len Line length, '\r' already folded.
+ * @return false on allocation failure.
+ */
+static bool ci_file_dispatch(ci_file_worker *worker, const char *line, size_t len) {
+    if (len + 1 > worker->scratch_cap) {
+        size_t cap = worker->scratch_cap ? worker->scratch_cap : 256;
+        while (cap < len + 1) cap *= 2;
+        char *scratch = realloc(worker->scratch, cap);
+        if (!scratch) return false;
+        worker->scratch = scratch;
+        worker->scratch_cap = cap;
+    }
+    /* the mapping is read-only; callbacks get a NUL-terminated copy that stays in cache */
+    memcpy(worker->scratch, line, len);
+    worker->scratch[len] = '\0';
+
+    ci_file_job *job = worker->job;
+    ci_stats_shard *shard = worker->shard;
+    if (shard) ci_stats_line(shard, len, 0);
+    if (!ci_registry_dispatch(&job->ctx->commands, worker->scratch, len, shard)) {
+        if (job->view_cb) {
+            job->view_cb(worker->scratch, len, job->cb_data);
+        } else if (job->cb) {
+            job->cb(worker->scratch, job->cb_data);
+        }
+        if (shard) ci_stats_callback(shard, false);
+    }
+    return true;
+}
+
+/**
+ * @brief Find the byte range of the lines owned by a chunk.
+ * @param job Job describing the mapping.
+ * @param chunk Chunk index.
+ * @param begin Output: offset of the first line starting in the chunk.
+ * @param end Output: offset where the chunk's lines stop being owned.
+ * @return false if no line starts inside the chunk.
+ */
+static bool ci_file_chunk_range(const ci_file_job *job, size_t chunk, size_t *begin, size_t *end) {
+    size_t start = chunk * job->chunk_size;
+    size_t stop = start + job->chunk_size < job->size ? start + job->chunk_size : job->size;
+    if (chunk > 0) {
+        /* a line starting at start belongs here only if the previous byte ends a line */
+        const char *nl = ci_scan(job->data + start - 1, stop - start + 1, '\n');
+        if (!nl) return false;
+        start = (size_t)(nl - job->data) + 1;
+    }
+    *begin = start;
+    *end = stop;
+    return start < stop;
+}
+
+/**
+ * @brief Frame the lines owned by a chunk, calling emit for each one.
+ * @return false if emit failed.
+ */
+static bool ci_file_frame(ci_file_worker *worker, size_t begin, size_t end,
+                          bool (*emit)(ci_file_worker *, size_t, size_t)) {
+    ci_file_job *job = worker->job;
+    size_t pos = begin;
+    while (pos < end) {
+        const char *start = job->data + pos;
+        const char *nl = ci_scan(start, job->size - pos, '\n');
+        size_t take = nl ? (size_t)(nl - start) : job->size - pos;
+        size_t len = (nl && take > 0 && start[take - 1] == '\r') ? take - 1 : take;
+        if (!emit(worker, pos, len)) return false;
+        pos += take + 1;
+    }
+    return true;
+}
+
+static bool ci_file_emit_now(ci_file_worker *worker, size_t offset, size_t len) {
+    return ci_file_dispatch(worker, worker->job->data + offset, len);
+}
+
+/**
+ * @brief Ordered mode: record a framed line for delivery when the chunk's turn comes.
+ */
+static bool ci_file_emit_later(ci_file_worker *worker, size_t offset, size_t len) {
+    if (worker->line_count == worker->lines_cap) {
+        size_t cap = worker->lines_cap ? worker->lines_cap * 2 : 1024;
+        ci_file_line *lines = realloc(worker->lines, cap * sizeof(*lines));
+        if (!lines) return false;
+        worker->lines = lines;
+        worker->lines_cap = cap;
+    }
+    worker->lines[worker->line_count].offset = offset;
+    worker->lines[worker->line_count].len = len;
+    worker->line_count++;
+    return true;
+}
+
+/**
+ * @brief Ordered mode: wait for a chunk's turn, deliver its framed lines, pass the turn on.
+ */
+static bool ci_file_deliver(ci_file_worker *worker, size_t chunk) {
+    ci_file_job *job = worker->job;
+    pthread_mutex_lock(&job->mutex);
+    while (job->turn != chunk) pthread_cond_wait(&job->cond, &job->mutex);
+    pthread_mutex_unlock(&job->mutex);
+
+    bool ok = true;
+    for (size_t i = 0; i < worker->line_count && ok; i++) {
+        if (ci_atomic_load(&job->ctx->stop_requested)) break;
+        ok = ci_file_dispatch(worker, job->data + worker->lines[i].offset, worker->lines[i].len);
+    }
+
+    pthread_mutex_lock(&job->mutex);
+    job->turn++;
+    pthread_cond_broadcast(&job->cond);
+    pthread_mutex_unlock(&job->mutex);
+    return ok;
+}
+
+/**
+ * @brief Worker routine: claim chunks until none are left (or a stop is requested).
+ * @param arg ci_file_worker of this thread.
+ * @return NULL when done.
+ */
+static void *ci_file_thread(void *arg) {
+    ci_file_worker *worker = arg;
+    ci_file_job *job = worker->job;
+    worker->shard = ci_stats_shard_for(&job->ctx->stats);
+
+    for (;;) {
+        size_t chunk = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_SEQ_CST);
+        if (chunk >= job->chunks) break;
+
+        size_t begin, end;
+        bool owns = ci_file_chunk_range(job, chunk, &begin, &end);
+        bool stopping = ci_atomic_load(&job->ctx->stop_requested) || worker->failed;
+        if (job->ordered) {
+            /* every chunk takes its turn, even an empty one, or later chunks would wait forever */
+            worker->line_count = 0;
+            if (owns && !stopping && !ci_file_frame(worker, begin, end, ci_file_emit_later)) worker->failed = true;
+            if (!ci_file_deliver(worker, chunk)) worker->failed = true;
+        } else if (owns && !stopping) {
+            if (!ci_file_frame(worker, begin, end, ci_file_emit_now)) worker->failed = true;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Routine of the threads started for a replay; gives up their statistics shard on exit.
+ * @param arg ci_file_worker of this thread.
+ * @return NULL when done.
+ */
+static void *ci_file_spawned(void *arg) {
+    ci_file_worker *worker = arg;
+    ci_file_thread(worker);
+    ci_stats_detach(&worker->job->ctx->stats);
+    return NULL;
+}
+
+ci_status ci_context_process_file(ci_context *ctx,
+                                  const char *path,
+                                  ci_line_callback callback,
+                                  void *user_data,
+                                  const ci_file_options *options) {
+    if (!ctx || !path || ci_atomic_load(&ctx->running) || ctx->polling) return CI_INVALID;
+    ci_view_callback view_callback = options ? options->view_callback : NULL;
+    ci_scan_init();
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return CI_INVALID;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return CI_INVALID;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return CI_OK;
+    }
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return CI_INVALID;
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    unsigned threads = options && options->threads ? options->threads : 0;
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned)online : 1;
+    }
+    if (threads > CI_FILE_MAX_THREADS) threads = CI_FILE_MAX_THREADS;
+
+    ci_file_job job;
+    memset(&job, 0, sizeof(job));
+    job.ctx = ctx;
+    job.cb = callback;
+    job.view_cb = view_callback;
+    job.cb_data = user_data;
+    job.data = map;
+    job.size = size;
+    job.chunk_size = options && options->chunk_size ? options->chunk_size : CI_FILE_DEFAULT_CHUNK;
+    job.chunks = (size - 1) / job.chunk_size + 1;
+    job.ordered = options && options->ordered;
+    if (threads > job.chunks) threads = (unsigned)job.chunks;
+    pthread_mutex_init(&job.mutex, NULL);
+    pthread_cond_init(&job.cond, NULL);
+    ci_atomic_store(&ctx->stop_requested, false);
+
+    ci_file_worker *workers = calloc(threads, sizeof(*workers));
+    pthread_t *tids = calloc(threads, sizeof(*tids));
+    unsigned started = 0;
+    if (workers && tids) {
+        for (unsigned i = 0; i < threads; i++) workers[i].job = &job;
+        /* the calling thread is worker 0 */
+        for (unsigned i = 1; i < threads; i++) {
+            if (pthread_create(&tids[i], NULL, ci_file_spawned, &workers[i]) != 0) break;
+            started++;
+        }
+        ci_file_thread(&workers[0]);
+        for (unsigned i = 1; i <= started; i++) pthread_join(tids[i], NULL);
+    }
+
+    ci_status status = workers && tids ? CI_OK : CI_INVALID;
+    for (unsigned i = 0; workers && i < threads; i++) {
+        if (workers[i].failed) status = CI_INVALID;
+        free(workers[i].scratch);
+        free(workers[i].lines);
+    }
+    if (status == CI_OK && ci_atomic_load(&ctx->stop_requested)) status = CI_EOF;
+    ci_atomic_store(&ctx->stop_requested, false);
+
+    free(workers);
+    free(tids);
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.mutex);
+    munmap(map, size);
+    return status;
+}
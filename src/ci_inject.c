@@ -0,0 +1,100 @@
+#include "ci_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Injected lines are pushed onto a lock-free stack (one compare-and-swap per
+ * call, however many lines it carries) and the input thread takes the whole
+ * stack with one exchange, reversing it into arrival order. A push that finds
+ * the stack empty tells the caller to wake the thread; later pushes ride on
+ * that wakeup, so a burst costs one pipe write. While no thread consumes the
+ * stack its head is the closed sentinel and pushes fail.
+ */
+
+#define CI_INJECT_ALIGN 16
+
+static ci_inject_node ci_inject_closed;
+#define CI_INJECT_CLOSED (&ci_inject_closed)
+
+/**
+ * @brief Bytes taken by a node holding a line of len bytes, rounded so the next node stays aligned.
+ */
+static size_t ci_inject_node_size(size_t len) {
+    size_t size = sizeof(ci_inject_node) + len + 1;
+    return (size + CI_INJECT_ALIGN - 1) & ~(size_t)(CI_INJECT_ALIGN - 1);
+}
+
+void ci_inject_init(ci_inject_queue *queue) {
+    queue->head = CI_INJECT_CLOSED;
+}
+
+void ci_inject_open(ci_inject_queue *queue) {
+    ci_inject_node *expected = CI_INJECT_CLOSED;
+    ci_atomic_cas(&queue->head, &expected, (ci_inject_node *)NULL);
+}
+
+ci_status ci_inject_push(ci_inject_queue *queue, const ci_line_view *lines, size_t count, size_t max_line,
+                         bool *was_empty) {
+    if (__atomic_load_n(&queue->head, __ATOMIC_RELAXED) == CI_INJECT_CLOSED) return CI_INVALID;
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!lines[i].data && lines[i].len) return CI_INVALID;
+        if (lines[i].len > max_line) return CI_OVERFLOW;
+        total += ci_inject_node_size(lines[i].len);
+    }
+    if (count == 0) return CI_OK;
+
+    /* one block per call; the node of its last line frees it */
+    char *block = malloc(total);
+    if (!block) return CI_OVERFLOW;
+    ci_inject_node *newest = NULL, *oldest = NULL;
+    size_t at = 0;
+    for (size_t i = 0; i < count; i++) {
+        ci_inject_node *node = (ci_inject_node *)(block + at);
+        at += ci_inject_node_size(lines[i].len);
+        node->len = lines[i].len;
+        node->block = i + 1 == count ? block : NULL;
+        if (lines[i].len) memcpy(node->line, lines[i].data, lines[i].len);
+        node->line[lines[i].len] = '\0';
+        /* the stack holds the newest line first */
+        node->next = newest;
+        newest = node;
+        if (!oldest) oldest = node;
+    }
+
+    ci_inject_node *head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    do {
+        if (head == CI_INJECT_CLOSED) {
+            free(block);
+            return CI_INVALID;
+        }
+        oldest->next = head;
+    } while (!__atomic_compare_exchange_n(&queue->head, &head, newest, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    *was_empty = head == NULL;
+    return CI_OK;
+}
+
+bool ci_inject_pending(ci_inject_queue *queue) {
+    ci_inject_node *head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    return head && head != CI_INJECT_CLOSED;
+}
+
+ci_inject_node *ci_inject_take(ci_inject_queue *queue, bool close) {
+    ci_inject_node *node = __atomic_exchange_n(&queue->head, close ? CI_INJECT_CLOSED : NULL, __ATOMIC_ACQUIRE);
+    if (node == CI_INJECT_CLOSED) return NULL;
+
+    /* newest first -> arrival order */
+    ci_inject_node *ordered = NULL;
+    while (node) {
+        ci_inject_node *next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+    }
+    return ordered;
+}
+
+void ci_inject_release(ci_inject_node *node) {
+    free(node->block);
+}
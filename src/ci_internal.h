@@ -0,0 +1,1128 @@
+#ifndef CI_INTERNAL_H
+#define CI_INTERNAL_H
+
+#include "console_input.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#define CI_READER_BLOCK 65536
+/* ci_reader_fill/ci_uring_read result when the reader's wake descriptor fired first */
+#define CI_READ_WOKEN (-2)
+/* ci_reader_next_line result when the wake descriptor fired before a full line arrived */
+#define CI_WOKEN ((ci_status)-100)
+
+#if defined(__GNUC__)
+#define CI_THREAD_LOCAL __thread
+#else
+#define CI_THREAD_LOCAL _Thread_local
+#endif
+
+/* Sequentially consistent atomics on plain objects (GCC/Clang builtins). */
+#define ci_atomic_load(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define ci_atomic_store(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define ci_atomic_add(p, v) __atomic_add_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define ci_atomic_sub(p, v) __atomic_sub_fetch((p), (v), __ATOMIC_SEQ_CST)
+#define ci_atomic_cas(p, expected, desired) \
+    __atomic_compare_exchange_n((p), (expected), (desired), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+/* Self-pipe that interrupts a thread blocked on input; both ends nonblocking. */
+typedef struct {
+    int fds[2]; /* -1 until opened */
+} ci_wake;
+
+/**
+ * @brief Mark a wake pipe as not yet opened.
+ */
+void ci_wake_init(ci_wake *wake);
+
+/**
+ * @brief Create the pipe unless it is already open.
+ * @return false if the pipe can't be created.
+ */
+bool ci_wake_open(ci_wake *wake);
+
+/**
+ * @brief Close the pipe (no-op if never opened).
+ */
+void ci_wake_close(ci_wake *wake);
+
+/**
+ * @brief Make the read end readable until drained; async-signal-safe, no-op if not open.
+ */
+void ci_wake_signal(ci_wake *wake);
+
+/**
+ * @brief Consume pending wakeups.
+ */
+void ci_wake_drain(ci_wake *wake);
+
+typedef struct ci_uring ci_uring;
+typedef struct ci_arena ci_arena;
+
+/* Prompts and diagnostics for one stream, flushed only before the reader blocks. */
+typedef struct {
+    FILE *stream;          /* NULL discards output */
+    int tty;               /* -1 until isatty has been asked */
+    bool pending;          /* written since the last flush */
+    unsigned long flushes; /* fflush calls made, i.e. coalesced writes */
+} ci_output;
+
+struct ci_reader {
+    int fd;
+    char *buf;
+    size_t cap;
+    size_t head;
+    size_t tail;
+    ci_uring *uring;        /* io_uring backend, or NULL for read(2) */
+    unsigned long syscalls; /* kernel entries made to fill the buffer */
+    uint64_t filled_ns;     /* ci_stats_now() after the last fill that returned data */
+    int tty;                /* -1 until isatty has been asked */
+    ci_output *out;         /* flushed before each fill, so prompts show before blocking */
+    int wake_fd;            /* readable when a blocked fill should give up, or -1 */
+};
+
+/**
+ * @brief Bind an output to a stream.
+ * @param out Output to initialize.
+ * @param stream Stream to write to (can be NULL).
+ */
+void ci_output_init(ci_output *out, FILE *stream);
+
+/**
+ * @brief Queue text on the stream without flushing.
+ * @param out Output to write to.
+ * @param text Text to write (can be NULL).
+ */
+void ci_output_write(ci_output *out, const char *text);
+
+/**
+ * @brief Flush the stream if anything was written since the last flush.
+ * @param out Output to flush.
+ */
+void ci_output_flush(ci_output *out);
+
+/**
+ * @brief Whether the stream is a terminal (asked once, then cached).
+ */
+bool ci_output_is_tty(ci_output *out);
+
+/**
+ * @brief Decide whether to show a prompt for input from reader echoed to out.
+ * @param policy Prompt policy.
+ * @param reader Reader the input comes from.
+ * @param out Output the prompt would go to.
+ * @return true if the prompt should be written.
+ */
+bool ci_prompt_wanted(ci_prompt_policy policy, ci_reader *reader, ci_output *out);
+
+/**
+ * @brief The shared stdin reader, flushing the default context's output before it blocks.
+ * @return Reader, or NULL on allocation failure.
+ */
+ci_reader *ci_stdin_reader(void);
+
+/**
+ * @brief Queue a prompt on the default context's output, subject to its prompt policy.
+ * @param reader Reader the answer will be read from.
+ * @param prompt Prompt text (can be NULL).
+ */
+void ci_prompt(ci_reader *reader, const char *prompt);
+
+/**
+ * @brief Set up io_uring reads from a descriptor.
+ * @param fd Descriptor to read from.
+ * @param buf_size Size of each kernel-filled buffer.
+ * @return New ring, or NULL when io_uring is unavailable (caller falls back to read(2)).
+ */
+ci_uring *ci_uring_create(int fd, size_t buf_size);
+
+/**
+ * @brief Cancel outstanding reads and release the ring; unread data is discarded.
+ * @param u Ring to destroy (can be NULL).
+ */
+void ci_uring_destroy(ci_uring *u);
+
+/**
+ * @brief Copy the next available bytes, blocking until some arrive or wake_fd becomes readable.
+ * @param u Ring to read from.
+ * @param dst Destination.
+ * @param cap Destination capacity (at least 1).
+ * @param wake_fd Descriptor polled alongside the read, or -1.
+ * @param syscalls Counter incremented per io_uring_enter.
+ * @return Bytes copied, 0 on end-of-file, -1 on error (errno set), CI_READ_WOKEN if wake_fd fired.
+ */
+ssize_t ci_uring_read(ci_uring *u, char *dst, size_t cap, int wake_fd, unsigned long *syscalls);
+
+/**
+ * @brief Wait until ci_uring_read would not block.
+ * @param u Ring to wait on.
+ * @param timeout_ms Milliseconds to wait (0 checks without blocking).
+ * @param wake_fd Descriptor polled alongside the read, or -1.
+ * @param syscalls Counter incremented per io_uring_enter.
+ * @return true if data, end-of-file, an error or a wakeup is available.
+ */
+bool ci_uring_wait(ci_uring *u, int timeout_ms, int wake_fd, unsigned long *syscalls);
+
+typedef const char *(*ci_scan_fn)(const char *p, size_t n, char delim);
+
+typedef struct {
+    const char *name;
+    ci_scan_fn fn;
+} ci_scan_variant;
+
+/**
+ * @brief Select the delimiter search kernel for this CPU; idempotent and thread-safe.
+ */
+void ci_scan_init(void);
+
+/**
+ * @brief Find the first occurrence of delim using the kernel chosen by ci_scan_init.
+ * @param p Start of the bytes to search.
+ * @param n Number of bytes to search.
+ * @param delim Byte to look for.
+ * @return Pointer to the first match, or NULL if none.
+ */
+const char *ci_scan(const char *p, size_t n, char delim);
+
+/**
+ * @brief List the kernels usable on this CPU (scalar first, as the reference).
+ * @param count Output for the number of entries.
+ * @return Static table of kernels.
+ */
+const ci_scan_variant *ci_scan_variants(size_t *count);
+
+/**
+ * @brief Name of the kernel ci_scan dispatches to.
+ * @return Static string such as "avx2" or "swar".
+ */
+const char *ci_scan_selected(void);
+
+const char *ci_scan_scalar(const char *p, size_t n, char delim);
+const char *ci_scan_swar(const char *p, size_t n, char delim);
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+const char *ci_scan_sse2(const char *p, size_t n, char delim);
+const char *ci_scan_avx2(const char *p, size_t n, char delim);
+#endif
+
+#define CI_HIST_SUB_BITS 4
+#define CI_HIST_SUB (1u << CI_HIST_SUB_BITS)
+#define CI_HIST_MAX_MSB 35 /* values from 2^36 ns (about a minute) on share the last bucket */
+#define CI_HIST_BUCKETS ((CI_HIST_MAX_MSB - CI_HIST_SUB_BITS + 2) * CI_HIST_SUB)
+
+/* Log-linear histogram of nanoseconds: exact below 16, then 16 buckets per power of two. */
+typedef struct {
+    uint64_t buckets[CI_HIST_BUCKETS];
+    uint64_t total_ns;
+} ci_hist;
+
+typedef struct ci_stats_shard ci_stats_shard;
+
+/* Counters of one thread for one context; only the owner writes, snapshots read them relaxed. */
+struct ci_stats_shard {
+    ci_stats_shard *next;
+    pthread_t owner;
+    bool owned; /* false once the owner thread has exited; the next new thread takes it over */
+    uint64_t lines;
+    uint64_t bytes;
+    uint64_t overflows;
+    uint64_t parse_failures;
+    uint64_t command_hits;
+    uint64_t command_misses;
+    uint64_t mark; /* ci_stats_now() when the line being dispatched was counted */
+    ci_hist read_to_dispatch;
+    ci_hist callback;
+};
+
+typedef struct {
+    bool enabled;
+    uint64_t id; /* unique per set, so thread caches never match a destroyed set */
+    pthread_mutex_t mutex;
+    ci_stats_shard *shards;
+    ci_stats_shard *baseline; /* totals at the last reset, or NULL */
+} ci_stats_set;
+
+/* Single-writer counter bump that snapshots on other threads may read. */
+#define ci_stats_count(p, v) __atomic_store_n((p), *(p) + (v), __ATOMIC_RELAXED)
+
+#ifdef CI_NO_STATS
+#define ci_stats_shard_for(set) ((ci_stats_shard *)NULL)
+#else
+/* The calling thread's shard, or NULL while stats are off: disabled, this load is the whole cost. */
+#define ci_stats_shard_for(set) (__atomic_load_n(&(set)->enabled, __ATOMIC_RELAXED) ? ci_stats_local(set) : NULL)
+#endif
+
+/**
+ * @brief Initialize an empty, disabled statistics set.
+ */
+void ci_stats_init(ci_stats_set *set);
+
+/**
+ * @brief Free every shard; no thread may still count into the set.
+ */
+void ci_stats_destroy(ci_stats_set *set);
+
+/**
+ * @brief Find or create the calling thread's shard (use ci_stats_shard_for on hot paths).
+ * @return Shard, or NULL on allocation failure.
+ */
+ci_stats_shard *ci_stats_local(ci_stats_set *set);
+
+/**
+ * @brief Give up the calling thread's shard before the thread exits, so a later thread can reuse it.
+ */
+void ci_stats_detach(ci_stats_set *set);
+
+/**
+ * @brief CLOCK_MONOTONIC in nanoseconds.
+ */
+uint64_t ci_stats_now(void);
+
+/**
+ * @brief Count a line about to be dispatched and mark the start of its dispatch.
+ * @param shard Calling thread's shard.
+ * @param len Line length.
+ * @param read_ns ci_stats_now() when the line was read, or 0 when unknown.
+ */
+void ci_stats_line(ci_stats_shard *shard, size_t len, uint64_t read_ns);
+
+/**
+ * @brief Count a finished callback, timed from the mark set by ci_stats_line.
+ * @param shard Calling thread's shard.
+ * @param hit A registered command ran (rather than the default callback).
+ * @return The callback's run time, command lookup included.
+ */
+uint64_t ci_stats_callback(ci_stats_shard *shard, bool hit);
+
+/**
+ * @brief Add a sample to a histogram only the calling thread writes.
+ */
+void ci_hist_add(ci_hist *hist, uint64_t ns);
+
+/**
+ * @brief Add a sample to a histogram that several threads update.
+ */
+void ci_hist_add_shared(ci_hist *hist, uint64_t ns);
+
+/**
+ * @brief Summarize a histogram that may be updated concurrently.
+ */
+void ci_hist_summarize(const ci_hist *hist, ci_latency_stats *out);
+
+/**
+ * @brief Sum every shard and subtract the last reset.
+ */
+void ci_stats_snapshot(ci_stats_set *set, ci_stats *out);
+
+/**
+ * @brief Make the current totals the new zero.
+ * @return false on allocation failure.
+ */
+bool ci_stats_reset(ci_stats_set *set);
+
+typedef struct {
+    ci_line_callback cb;
+    ci_args_callback args_cb; /* set instead of cb for a verb */
+    void *user_data;
+    unsigned flags;
+    size_t verb_end; /* for a verb: length of the line's span the verb matched */
+} ci_command_entry;
+
+typedef struct ci_command_rec ci_command_rec;
+
+typedef struct {
+    uint64_t hash;
+    ci_command_rec *rec;
+} ci_registry_slot;
+
+typedef struct ci_registry_table ci_registry_table;
+typedef struct ci_fixed_table ci_fixed_table;
+typedef struct ci_retired ci_retired;
+
+/* A registered verb. */
+typedef struct {
+    size_t len;
+    ci_args_callback cb;
+    void *user_data;
+    unsigned flags;
+    ci_hist *stats; /* callback run times, allocated on the first timed run */
+    char name[];
+} ci_verb;
+
+/* One trie node: its edges are edge_bytes[first_edge .. first_edge + edge_count). */
+typedef struct {
+    uint32_t first_edge;
+    uint32_t edge_count;
+    uint32_t verb; /* index + 1 of the verb ending here, or 0 */
+} ci_trie_node;
+
+/* Nodes 0 and 1 are the roots of the case-sensitive and the CI_CMD_NOCASE verbs. */
+#define CI_TRIE_ROOTS 2
+
+/*
+ * Immutable byte trie over the verbs, in breadth-first order so that every
+ * node's children are consecutive: edge e leads to node e + CI_TRIE_ROOTS.
+ * CI_CMD_NOCASE verbs are stored lowercased under their own root.
+ */
+typedef struct {
+    size_t count;
+    ci_verb **verbs;
+    ci_trie_node *nodes;
+    unsigned char *edge_bytes;
+} ci_trie;
+
+/**
+ * @brief Build a trie over verbs.
+ * @param verbs Verbs with distinct names (the trie keeps the pointers, not copies).
+ * @param count Number of verbs.
+ * @return New trie, or NULL on allocation failure.
+ */
+ci_trie *ci_trie_build(ci_verb *const *verbs, size_t count);
+
+/**
+ * @brief Free a trie; its verbs are not freed.
+ */
+void ci_trie_free(ci_trie *trie);
+
+/**
+ * @brief Find the verb matching the leading words of a line, in one pass over the line.
+ * @param trie Trie to search (can be NULL).
+ * @param line Line bytes.
+ * @param len Line length.
+ * @param verb_end Output length of the line's span matched by the verb.
+ * @return Longest matching verb, or NULL.
+ */
+ci_verb *ci_trie_match(const ci_trie *trie, const char *line, size_t len, size_t *verb_end);
+
+/**
+ * @brief Whether a string may be registered as a verb (see ci_context_register_verb).
+ */
+bool ci_verb_valid(const char *verb);
+
+/* One step of a compiled pattern: a byte class taken once, or any number of times when star is set. */
+typedef struct {
+    uint32_t bits[8]; /* bytes accepted, one bit each; all clear marks the end of a pattern */
+    uint32_t star;
+} ci_pattern_item;
+
+/* A registered pattern command. */
+typedef struct {
+    ci_line_callback cb;
+    void *user_data;
+    unsigned flags;
+    ci_hist *stats;         /* callback run times, allocated on the first timed run */
+    size_t item_count;      /* items, the end marker included */
+    ci_pattern_item *items; /* in the same allocation */
+    char text[];
+} ci_pattern;
+
+typedef struct ci_pattern_set ci_pattern_set;
+
+/**
+ * @brief Compile a pattern (see ci_context_register_pattern for the syntax).
+ * @param text NUL-terminated pattern.
+ * @param callback Callback stored in the result.
+ * @param user_data User pointer stored in the result.
+ * @param flags CI_CMD_* flags; CI_CMD_NOCASE folds ASCII letters.
+ * @param out Compiled pattern (free with free()).
+ * @return CI_OK, CI_INVALID for a malformed pattern, CI_OVERFLOW on allocation failure.
+ */
+ci_status ci_pattern_compile(const char *text, ci_line_callback callback, void *user_data, unsigned flags,
+                             ci_pattern **out);
+
+/**
+ * @brief Combine patterns into one automaton; earlier patterns win when several match.
+ * @param patterns Patterns in priority order (the set keeps the pointers, not copies).
+ * @param count Number of patterns (at least 1).
+ * @return New set, or NULL on allocation failure.
+ * @note The DFA is built lazily: each state transition is computed the first time
+ *       a line needs it, under the set's mutex, and read lock-free afterwards.
+ */
+ci_pattern_set *ci_pattern_set_build(ci_pattern *const *patterns, size_t count);
+
+/**
+ * @brief Free a set and its DFA; its patterns are not freed.
+ */
+void ci_pattern_set_free(ci_pattern_set *set);
+
+/**
+ * @brief Patterns of a set, in priority order.
+ */
+ci_pattern *const *ci_pattern_set_list(const ci_pattern_set *set, size_t *count);
+
+/**
+ * @brief Find the first pattern matching a whole line, in one pass over the line.
+ * @param set Set to search (can be NULL).
+ * @param line Line bytes.
+ * @param len Line length.
+ * @return Matching pattern, or NULL.
+ */
+ci_pattern *ci_pattern_set_match(ci_pattern_set *set, const char *line, size_t len);
+
+/*
+ * Open-addressing command table (linear probing, power-of-two capacity).
+ * Readers see an immutable snapshot without locking; writers serialize on the
+ * mutex, publish a modified copy and retire the old one, which is freed after a
+ * grace period. Nobody waits for readers while holding the mutex, and a writer
+ * running inside a read section (a callback) never waits at all: what it
+ * retires is freed by a later writer or when the last section ends.
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_mutex_t gp_mutex; /* serializes grace periods; taken without the writer mutex */
+    ci_retired *retired;      /* unpublished snapshots waiting for a grace period */
+    ci_registry_table *table;
+    unsigned long epoch;
+    unsigned long readers[2];
+    ci_fixed_table *fixed;      /* static table under the registered commands, or NULL */
+    ci_fixed_table *fixed_list; /* every table ever installed, freed with the registry */
+    ci_trie *verbs;             /* registered verbs, tried after every exact command; snapshot like table */
+    ci_pattern_set *patterns;   /* registered patterns, tried after verbs; snapshot like table */
+} ci_registry;
+
+#define CI_REGISTRY_INIT \
+    {PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, NULL, NULL, 0, {0, 0}, NULL, NULL, NULL, NULL}
+
+/**
+ * @brief Initialize an empty registry at runtime (same state as CI_REGISTRY_INIT).
+ * @param reg Registry to initialize.
+ */
+void ci_registry_init(ci_registry *reg);
+
+/**
+ * @brief Clear a registry and release its mutex.
+ * @param reg Registry to destroy; no other thread may use it.
+ */
+void ci_registry_destroy(ci_registry *reg);
+
+/**
+ * @brief Hash a byte string for registry lookups.
+ * @param p Bytes to hash.
+ * @param len Number of bytes.
+ * @return 64-bit hash.
+ */
+uint64_t ci_hash_bytes(const char *p, size_t len);
+
+/**
+ * @brief ci_hash_bytes with a seed mixed in (seed 0 gives ci_hash_bytes).
+ */
+uint64_t ci_hash_seeded(const char *p, size_t len, uint64_t seed);
+
+/* A hash-and-displace perfect hash over a set of keys, as stored in ci_command_table. */
+typedef struct {
+    uint64_t seed;
+    uint32_t *displace;
+    size_t bucket_mask;
+    uint32_t *slots; /* key index + 1, or 0 */
+    size_t slot_mask;
+} ci_phash;
+
+/**
+ * @brief Slot of a hashed key in a perfect hash table.
+ * @param hash ci_hash_seeded(key, len, seed).
+ * @param displace Per-bucket displacements.
+ * @param bucket_mask Bucket count - 1.
+ * @param slot_mask Slot count - 1.
+ * @return Slot index.
+ */
+static inline size_t ci_phash_slot(uint64_t hash, const uint32_t *displace, size_t bucket_mask, size_t slot_mask) {
+    uint32_t d = displace[(size_t)(hash >> 32) & bucket_mask];
+    return (size_t)((uint32_t)hash ^ d * 0x9e3779b9u) & slot_mask;
+}
+
+/**
+ * @brief Find a seed and displacements that give every key its own slot.
+ * @param names Keys (need not be NUL-terminated).
+ * @param lens Key lengths.
+ * @param count Number of keys; they must be distinct.
+ * @param out Output table (free with ci_phash_free).
+ * @return false on duplicate keys, allocation failure or when no seed works.
+ */
+bool ci_phash_build(const char *const *names, const size_t *lens, size_t count, ci_phash *out);
+
+/**
+ * @brief Release arrays allocated by ci_phash_build.
+ */
+void ci_phash_free(ci_phash *ph);
+
+/* A read-side section; the snapshot current at ci_registry_begin stays valid until ci_registry_end. */
+typedef struct {
+    unsigned idx;
+    ci_registry *prev_reg;
+    unsigned long prev_counts[2];
+} ci_registry_section;
+
+/**
+ * @brief Enter a read-side section that callbacks may run inside.
+ * @param reg Registry to read.
+ * @param section Section state to pass to ci_registry_end.
+ * @note Writers outside any section wait for it to end before freeing what they replaced;
+ *       writers inside one (callbacks) leave the freeing to a later grace period.
+ */
+void ci_registry_begin(ci_registry *reg, ci_registry_section *section);
+
+/**
+ * @brief Leave a section entered with ci_registry_begin.
+ * @param reg Registry being read.
+ * @param section Section state from ci_registry_begin.
+ */
+void ci_registry_end(ci_registry *reg, const ci_registry_section *section);
+
+/**
+ * @brief Lookup a command from inside a ci_registry_begin/end section (no atomics).
+ * @param reg Registry to search.
+ * @param line Input line to match.
+ * @param len Length of line in bytes.
+ * @param out_entry Output copy of the matched entry when found.
+ * @return true if a command matched, false otherwise.
+ */
+bool ci_registry_find_entry(ci_registry *reg, const char *line, size_t len, ci_command_entry *out_entry);
+
+/**
+ * @brief Run the callback of an entry from ci_registry_find_entry, inside the same section.
+ * @param entry Matched entry.
+ * @param line NUL-terminated line passed to the callback.
+ * @param len Length of line in bytes.
+ */
+void ci_registry_run_entry(const ci_command_entry *entry, const char *line, size_t len);
+
+/**
+ * @brief Run the callback registered for a line, if any, without taking a lock.
+ * @param reg Registry to search.
+ * @param line NUL-terminated line passed to the callback.
+ * @param len Length of line in bytes.
+ * @param shard Calling thread's stats shard; when set, the callback is timed (can be NULL).
+ * @return true if a command matched (and its callback ran), false otherwise.
+ * @note The callback runs inside a read-side section, so ci_registry_put/remove
+ *       for that command only return once it has finished.
+ */
+bool ci_registry_dispatch(ci_registry *reg, const char *line, size_t len, ci_stats_shard *shard);
+
+/**
+ * @brief Summarize the run time of a command's callback.
+ * @param reg Registry to search.
+ * @param command NUL-terminated command string.
+ * @param out Output summary.
+ * @return true if the command is registered.
+ */
+bool ci_registry_command_stats(ci_registry *reg, const char *command, ci_latency_stats *out);
+
+/**
+ * @brief Zero the run-time statistics of every registered command.
+ * @param reg Registry to reset.
+ */
+void ci_registry_reset_stats(ci_registry *reg);
+
+/**
+ * @brief Remove every registered command and release the table; a static table stays.
+ * @param reg Registry to clear.
+ */
+void ci_registry_clear(ci_registry *reg);
+
+/**
+ * @brief Install (or with NULL remove) the static table consulted when no registered command matches.
+ * @param reg Registry to update.
+ * @param table Table to install; it is checked to place every command in its own slot.
+ * @return CI_OK, CI_INVALID for an inconsistent table, CI_OVERFLOW on allocation failure.
+ */
+ci_status ci_registry_set_table(ci_registry *reg, const ci_command_table *table);
+
+/**
+ * @brief Lookup a registered command matching the given line (wait-free).
+ * @param reg Registry to search.
+ * @param line Input line to match.
+ * @param len Length of line in bytes.
+ * @param out_entry Output copy of the matched entry when found.
+ * @return true if a command matched, false otherwise.
+ */
+bool ci_registry_lookup(ci_registry *reg, const char *line, size_t len, ci_command_entry *out_entry);
+
+/**
+ * @brief Whether CI_CMD_* flags can be registered together.
+ *
+ * CI_CMD_SERIAL and CI_CMD_PRIORITY select different worker lanes, so a
+ * command can't have both.
+ */
+static inline bool ci_cmd_flags_valid(unsigned flags) {
+    return (flags & (CI_CMD_SERIAL | CI_CMD_PRIORITY)) != (CI_CMD_SERIAL | CI_CMD_PRIORITY);
+}
+
+/**
+ * @brief Insert or replace a command callback.
+ * @param reg Registry to update.
+ * @param command NUL-terminated command string (any length).
+ * @param callback Callback to invoke when the command matches.
+ * @param user_data User pointer passed to the callback.
+ * @param flags CI_CMD_* flags.
+ * @return CI_OK on success, CI_OVERFLOW on allocation failure.
+ */
+ci_status ci_registry_put(ci_registry *reg, const char *command, ci_line_callback callback, void *user_data,
+                          unsigned flags);
+
+/**
+ * @brief Remove a command callback.
+ * @param reg Registry to update.
+ * @param command NUL-terminated command string.
+ * @return CI_OK if removed, CI_INVALID if not found.
+ */
+ci_status ci_registry_remove(ci_registry *reg, const char *command);
+
+/**
+ * @brief Insert or replace a verb.
+ * @param reg Registry to update.
+ * @param verb NUL-terminated verb, already checked with ci_verb_valid.
+ * @param callback Callback to invoke when the verb matches.
+ * @param user_data User pointer passed to the callback.
+ * @param flags CI_CMD_* flags.
+ * @return CI_OK on success, CI_OVERFLOW on allocation failure.
+ */
+ci_status ci_registry_put_verb(ci_registry *reg, const char *verb, ci_args_callback callback, void *user_data,
+                               unsigned flags);
+
+/**
+ * @brief Remove a verb.
+ * @param reg Registry to update.
+ * @param verb NUL-terminated verb as registered.
+ * @return CI_OK if removed, CI_INVALID if not found, CI_OVERFLOW on allocation failure.
+ */
+ci_status ci_registry_remove_verb(ci_registry *reg, const char *verb);
+
+/**
+ * @brief Insert a pattern, or replace the pattern with the same text in its place.
+ * @param reg Registry to update.
+ * @param pattern Compiled pattern; the registry owns it from now on, also on failure.
+ * @return CI_OK on success, CI_OVERFLOW on allocation failure.
+ */
+ci_status ci_registry_put_pattern(ci_registry *reg, ci_pattern *pattern);
+
+/**
+ * @brief Remove a pattern.
+ * @param reg Registry to update.
+ * @param text Pattern text as registered.
+ * @return CI_OK if removed, CI_INVALID if not found, CI_OVERFLOW on allocation failure.
+ */
+ci_status ci_registry_remove_pattern(ci_registry *reg, const char *text);
+
+typedef struct {
+    size_t seq;
+    void *item;
+} ci_queue_cell;
+
+/* Bounded lock-free MPMC ring; head and tail sit on separate cache lines. */
+typedef struct {
+    ci_queue_cell *cells;
+    size_t mask;
+    char pad0[64];
+    size_t head;
+    char pad1[64];
+    size_t tail;
+    char pad2[64];
+} ci_queue;
+
+/**
+ * @brief Allocate a queue holding at least capacity items (rounded up to a power of two).
+ * @param queue Queue to initialize.
+ * @param capacity Minimum number of slots.
+ * @return true on success, false on allocation failure.
+ */
+bool ci_queue_init(ci_queue *queue, size_t capacity);
+
+/**
+ * @brief Release the queue's slots; items still queued are not freed.
+ * @param queue Queue to destroy.
+ */
+void ci_queue_destroy(ci_queue *queue);
+
+/**
+ * @brief Append an item without blocking.
+ * @param queue Queue to push to.
+ * @param item Item pointer.
+ * @return true if queued, false if the queue is full.
+ */
+bool ci_queue_push(ci_queue *queue, void *item);
+
+/**
+ * @brief Remove the oldest item without blocking.
+ * @param queue Queue to pop from.
+ * @param item Output for the item pointer.
+ * @return true if an item was popped, false if the queue is empty.
+ */
+bool ci_queue_pop(ci_queue *queue, void **item);
+
+/**
+ * @brief Check whether no item is queued or being queued.
+ * @param queue Queue to check.
+ * @return true if empty.
+ */
+bool ci_queue_empty(ci_queue *queue);
+
+/**
+ * @brief Number of pops claimed so far: the item pushed at position pos is still queued while this is <= pos.
+ * @param queue Queue to check.
+ * @return Consumer position.
+ */
+size_t ci_queue_popped(ci_queue *queue);
+
+/**
+ * @brief Number of pushes claimed so far; with a single producer, the position its next push takes.
+ * @param queue Queue to check.
+ * @return Producer position.
+ */
+size_t ci_queue_pushed(ci_queue *queue);
+
+/* A line given to ci_context_inject_line(s), waiting for the input thread. */
+typedef struct ci_inject_node {
+    struct ci_inject_node *next;
+    void *block; /* allocation to free after this line; set on the last line of each call */
+    size_t len;
+    char line[]; /* NUL-terminated at line[len] */
+} ci_inject_node;
+
+/* Lines injected by other threads: a lock-free stack, newest first, taken whole by the input thread. */
+typedef struct {
+    ci_inject_node *head; /* NULL when empty; a closed sentinel while no thread consumes it */
+} ci_inject_queue;
+
+/**
+ * @brief Initialize a queue as closed.
+ */
+void ci_inject_init(ci_inject_queue *queue);
+
+/**
+ * @brief Start accepting lines (no-op if already open).
+ */
+void ci_inject_open(ci_inject_queue *queue);
+
+/**
+ * @brief Copy lines into one allocation and push them with a single compare-and-swap.
+ * @param queue Queue to push to; safe from any number of threads.
+ * @param lines Lines to copy; data need not be NUL-terminated.
+ * @param count Number of lines (0 pushes nothing).
+ * @param max_line Longest accepted line.
+ * @param was_empty Output: the queue was empty, so the consumer must be woken.
+ * @return CI_OK, CI_INVALID when the queue is closed or a line has no data,
+ *         CI_OVERFLOW for a line over max_line or on allocation failure.
+ */
+ci_status ci_inject_push(ci_inject_queue *queue, const ci_line_view *lines, size_t count, size_t max_line,
+                         bool *was_empty);
+
+/**
+ * @brief Whether lines are waiting (a hint; the consumer's own check before blocking).
+ */
+bool ci_inject_pending(ci_inject_queue *queue);
+
+/**
+ * @brief Take every waiting line, optionally closing the queue in the same step.
+ * @param queue Queue to take from; only its single consumer may call this.
+ * @param close Leave the queue closed, so later pushes fail instead of being stranded.
+ * @return The lines in arrival order (linked through next), or NULL; release each with ci_inject_release.
+ */
+ci_inject_node *ci_inject_take(ci_inject_queue *queue, bool close);
+
+/**
+ * @brief Release a taken line once dispatched; lines of one call must be released in order.
+ */
+void ci_inject_release(ci_inject_node *node);
+
+/* Where a line was last queued on a lane, for CI_OVERLOAD_COALESCE. */
+typedef struct {
+    uint64_t hash;
+    size_t len;
+    size_t pos; /* queue position + 1, or 0 when unused */
+} ci_pool_recent;
+
+/* A line the submitting thread holds back until its full lane has room. */
+typedef struct {
+    void *item;
+    bool serial;
+} ci_pool_held;
+
+/* Worker threads running command/default callbacks for lines queued by the reader. */
+typedef struct {
+    ci_registry *reg;
+    ci_line_callback cb;
+    ci_view_callback view_cb;
+    void *cb_data;
+    ci_arena *arena; /* queued lines are arena copies instead of malloc'd items */
+    ci_stats_set *stats;
+    ci_queue shared;
+    ci_queue serial;
+    ci_queue priority;
+    ci_overload_policy policy;
+    ci_ingest_stats *counters; /* written by the submitting thread only */
+    ci_pool_recent *recent;    /* COALESCE: one table per droppable lane, shared.mask + 1 entries each */
+    ci_pool_held *held;        /* lines waiting for a full lane, oldest first; held_mask + 1 entries */
+    size_t held_mask;          /* held is owned by the submitting thread */
+    size_t held_head;
+    size_t held_count;
+    size_t held_lane[2];       /* held lines bound for the shared and the serial lane */
+    ci_wake *wake;             /* signalled by a worker that frees a slot while lines are held */
+    int wanted;                /* the submitter waits for that signal */
+    pthread_t *threads;
+    void *workers;
+    unsigned count;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    unsigned long sleepers;
+    bool closing;
+    bool sync_ready;
+} ci_pool;
+
+/**
+ * @brief Start worker threads dispatching through a registry.
+ * @param pool Pool to start.
+ * @param workers Number of worker threads (at least 1).
+ * @param capacity Queue capacity per lane; 0 selects the default (1024).
+ * @param reg Command registry to dispatch through.
+ * @param callback Default callback for lines matching no command.
+ * @param view_callback Length-aware default callback; used instead of callback when set.
+ * @param user_data User pointer passed to the default callback.
+ * @param arena Arena to copy queued lines into, or NULL to malloc each one.
+ * @param stats Statistics the workers count into.
+ * @param policy What ci_pool_submit does when a lane is full.
+ * @param counters Queue counters, zeroed here and updated by ci_pool_submit.
+ * @param wake Wakes the submitting thread once held lines may fit (see ci_pool_flush), or NULL
+ *        to make ci_pool_submit wait for room in a full lane instead of holding the line.
+ * @return true on success, false on bad args/allocation/thread failure.
+ */
+bool ci_pool_start(ci_pool *pool, unsigned workers, size_t capacity, ci_registry *reg,
+                   ci_line_callback callback, ci_view_callback view_callback, void *user_data, ci_arena *arena,
+                   ci_stats_set *stats, ci_overload_policy policy, ci_ingest_stats *counters, ci_wake *wake);
+
+/**
+ * @brief Copy a line into the pool (or its arena) and queue it, applying the overload policy.
+ * @param pool Pool to submit to; only one thread may submit.
+ * @param line Line bytes.
+ * @param len Line length.
+ * @param flags CI_CMD_* flags of the line's command: CI_CMD_PRIORITY selects the priority
+ *              lane, otherwise CI_CMD_SERIAL the serial lane (handled in order by worker 0).
+ * @param read_ns When the line was read, for the read-to-dispatch latency (0 if unknown).
+ * @return true if queued (or held), false if dropped by the policy or on allocation failure
+ *         (counted in dropped_nomem).
+ * @note With a wake, a line that would wait for a full shared or serial lane is held
+ *       instead, and later ones queue behind it, so the caller can go on reading and
+ *       priority lines still overtake. Only once 64 lines (at most a lane's worth) are
+ *       held does the call wait, until every held line has been queued.
+ */
+bool ci_pool_submit(ci_pool *pool, const char *line, size_t len, unsigned flags, uint64_t read_ns);
+
+/**
+ * @brief Queue held lines as far as their lanes have room, without waiting.
+ * @param pool Pool to flush; only the submitting thread may call this.
+ * @return true if lines are still held; a worker then signals the pool's wake once it frees a slot.
+ */
+bool ci_pool_flush(ci_pool *pool);
+
+/**
+ * @brief Let workers drain queued lines, join them and release the pool.
+ * @param pool Pool to shut down; safe to call on a zeroed or partially started pool.
+ */
+void ci_pool_shutdown(ci_pool *pool);
+
+/**
+ * @brief Read the next block from the descriptor into the free tail of the buffer.
+ * @param reader Reader to fill.
+ * @param compact Move unconsumed bytes to the front first. Pass false while views
+ *        returned by ci_reader_next_buffered are still in use (requires tail < cap).
+ * @return Bytes read, 0 on end-of-file, -1 on error, CI_READ_WOKEN if the wake descriptor
+ *         fired (nothing is consumed, so buffered input stays for the next reader).
+ */
+ssize_t ci_reader_fill(ci_reader *reader, bool compact);
+
+/**
+ * @brief Wait until ci_reader_fill would not block.
+ * @param reader Reader to wait on.
+ * @param timeout_ms Milliseconds to wait (0 checks without blocking).
+ * @return true if the next fill returns immediately (possibly with CI_READ_WOKEN).
+ */
+bool ci_reader_wait(ci_reader *reader, int timeout_ms);
+
+/**
+ * @brief Discard input up to and including the next newline (or end-of-file).
+ * @param reader Reader whose current line should be dropped.
+ */
+void ci_reader_skip_line(ci_reader *reader);
+
+/**
+ * @brief Frame the next complete line already in the buffer, without reading.
+ * @param reader Reader to frame from.
+ * @param line Output view into the reader buffer, NUL-terminated in place ('\r\n' folded).
+ * @param len Output line length.
+ * @return true if a line was framed, false if no complete line is buffered.
+ * @note The view stays valid until the next compacting ci_reader_fill.
+ */
+bool ci_reader_next_buffered(ci_reader *reader, const char **line, size_t *len);
+
+/**
+ * @brief Hand out the unterminated bytes left at end-of-file as a final line.
+ * @param reader Reader to drain.
+ * @param line Output view into the reader buffer, NUL-terminated in place.
+ * @param len Output line length.
+ * @return true if bytes were left, false if the buffer was empty.
+ */
+bool ci_reader_take_rest(ci_reader *reader, const char **line, size_t *len);
+
+/**
+ * @brief Double the reader buffer, up to what a line of max_line bytes needs.
+ * @param reader Reader to grow; views into the old buffer become invalid.
+ * @param max_line Longest line the caller accepts.
+ * @return true if the buffer grew, false at the limit or on allocation failure.
+ * @note The buffer is never shrunk, so once it fits the longest line seen,
+ *       framing further lines allocates nothing.
+ */
+bool ci_reader_grow(ci_reader *reader, size_t max_line);
+
+/**
+ * @brief Frame the next line in place, reading and growing the buffer as needed.
+ * @param reader Reader to read from.
+ * @param max_line Longest accepted line; longer lines are skipped through their newline.
+ * @param line Output view into the reader buffer, NUL-terminated in place ('\r\n' folded).
+ * @param len Output line length.
+ * @return CI_OK, CI_OVERFLOW for a skipped over-long line, CI_EOF, CI_WOKEN when the reader's
+ *         wake descriptor fired first (a partial line stays buffered), or CI_INVALID on read error.
+ * @note The view stays valid until the next call on the reader.
+ */
+ci_status ci_reader_next_line(ci_reader *reader, size_t max_line, const char **line, size_t *len);
+
+/**
+ * @brief Return the shared reader for a file descriptor, creating it on first use.
+ * @param fd File descriptor to read from.
+ * @return Reader bound to fd, or NULL on allocation failure/too many descriptors.
+ */
+ci_reader *ci_reader_for_fd(int fd);
+
+/**
+ * @brief Create an arena of refcounted line chunks.
+ * @param chunk_size Bytes per chunk; 0 selects the default (64 KiB).
+ * @return New arena, or NULL on allocation failure.
+ */
+ci_arena *ci_arena_create(size_t chunk_size);
+
+/**
+ * @brief Drop the owner's hold on an arena; it is freed once every retained line is released.
+ * @param arena Arena to destroy (can be NULL).
+ */
+void ci_arena_destroy(ci_arena *arena);
+
+/**
+ * @brief Copy a line into the arena, holding one reference for the caller.
+ * @param arena Arena to copy into; called only from the owning thread.
+ * @param line Line bytes.
+ * @param len Line length.
+ * @return NUL-terminated copy (release with ci_line_release), or NULL on allocation failure.
+ */
+char *ci_arena_copy(ci_arena *arena, const char *line, size_t len);
+
+/**
+ * @brief Length of a line returned by ci_arena_copy.
+ */
+size_t ci_arena_line_len(const char *line);
+
+/**
+ * @brief Snapshot the allocator statistics.
+ */
+void ci_arena_get_stats(ci_arena *arena, ci_arena_stats *out);
+
+typedef struct ci_reactor_shard ci_reactor_shard;
+
+/* One input stream with its own reader, prompt, command table and thread or readiness fd. */
+struct ci_context {
+    int fd;
+    ci_output out;
+    ci_prompt_policy prompt_policy;
+    ci_reader *reader;
+    bool owns_reader;
+    pthread_t thread;
+    bool thread_joinable;
+    ci_wake wake; /* stop requests interrupt the input thread's blocking reads */
+    ci_line_callback cb;
+    ci_view_callback view_cb;
+    void *cb_data;
+    const char *prompt;
+    size_t max_line;
+    ci_arena *arena; /* arena_lines mode: lines are copied here before dispatch */
+    /* read and written across threads: only through ci_atomic_load/store */
+    bool running;
+    bool stop_requested;
+    ci_registry commands;
+    ci_stats_set stats;
+    ci_pool workers;
+    bool use_workers;
+    ci_ingest_stats ingest; /* capacity is 0 unless last started with workers */
+    ci_inject_queue inject; /* open while the input thread runs */
+    ci_batch_callback batch_cb;
+    ci_line_view *batch_views;
+    size_t batch_max;
+    unsigned batch_wait_ms;
+    bool polling;
+    bool poll_skipping;
+    ci_reactor_shard *shard; /* reactor thread serving this pollable context, if any */
+    bool always_ready;       /* not watchable (regular file); serviced every reactor round */
+};
+
+/**
+ * @brief Read and dispatch input of a pollable context without blocking.
+ * @param ctx Context in pollable mode.
+ * @param max_reads Upper bound on read(2) calls, so one stream can't starve others.
+ * @param known_ready The descriptor was just reported readable; skip the readiness check before the first read.
+ * @return CI_OK when more input may follow, CI_EOF at end of input or on a stop request, CI_INVALID on error.
+ */
+ci_status ci_context_pump(ci_context *ctx, unsigned max_reads, bool known_ready);
+
+/**
+ * @brief Detach a context from its reactor, waiting unless called from that reactor's thread.
+ * @param ctx Context with ctx->shard set.
+ */
+void ci_reactor_release(ci_context *ctx);
+
+/**
+ * @brief Parse a signed integer at the start of a range and check it against [min, max].
+ * @param stop Output: first character after the digits (text when there are none).
+ * @return CI_OK, CI_OVERFLOW when out of range, CI_INVALID when no digits start the range.
+ * @note Characters after the number are not examined; *out is written only on CI_OK.
+ */
+ci_status ci_parse_signed_prefix(const char *text, size_t len, unsigned base, int64_t min, int64_t max,
+                                 int64_t *out, const char **stop);
+
+/**
+ * @brief Parse a signed integer and check it against [min, max].
+ * @return CI_OK, CI_OVERFLOW when out of range, CI_INVALID on bad syntax.
+ */
+ci_status ci_parse_signed(const char *text, size_t len, unsigned base, int64_t min, int64_t max, int64_t *out);
+
+/**
+ * @brief Parse an unsigned integer and check it against max.
+ * @return CI_OK, CI_OVERFLOW when out of range (including negative values), CI_INVALID on bad syntax.
+ */
+ci_status ci_parse_unsigned(const char *text, size_t len, unsigned base, uint64_t max, uint64_t *out);
+
+/**
+ * @brief ASCII whitespace as accepted by strtol in the C locale.
+ */
+bool ci_is_space(char c);
+
+/**
+ * @brief Parse a double at the start of a range.
+ * @param flags CI_FLOAT_ALLOW_INF / CI_FLOAT_ALLOW_NAN.
+ * @param stop Output: first character after the number (text when there is none).
+ * @return CI_OK, CI_OVERFLOW, CI_UNDERFLOW, or CI_INVALID when no number starts the range.
+ * @note Characters after the number are not examined; *out is written only on CI_OK.
+ */
+ci_status ci_parse_double_prefix(const char *text, size_t len, unsigned flags, double *out, const char **stop);
+
+/**
+ * @brief Parse a float at the start of a range; as ci_parse_double_prefix.
+ */
+ci_status ci_parse_float_prefix(const char *text, size_t len, unsigned flags, float *out, const char **stop);
+
+#define CI_POW5_MIN_Q (-342)
+#define CI_POW5_MAX_Q 308
+
+/* 128-bit normalised powers of five for the Eisel-Lemire conversion (ci_pow5.c). */
+extern const uint64_t ci_pow5_128[][2];
+
+#endif
@@ -0,0 +1,295 @@
+#include "ci_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CI_LIST_INITIAL 16
+
+/*
+ * Number-list parsing shared by the int and double lists. The feed walks the
+ * bytes once: separators are skipped in place and each token is converted
+ * where it lies, so a line streamed out of a reader is never copied or
+ * scanned for its newline first.
+ */
+typedef struct {
+    bool is_double;
+    bool growable;
+    void *values; /* int64_t or double elements */
+    ci_status *status;
+    size_t count;
+    size_t capacity;
+    size_t errors;
+    bool full;           /* no room for more elements: a fixed list is full, or growing failed */
+    bool elem_since_sep; /* an element was stored since line start or the last comma */
+    bool after_comma;    /* the last separator was a comma */
+    bool skipping;       /* discarding a token longer than the reader block */
+    unsigned flags;      /* double lists: CI_FLOAT_ALLOW_* */
+} ci_list_sink;
+
+static bool ci_list_is_sep(char c) {
+    return c == ',' || ci_is_space(c);
+}
+
+/**
+ * @brief Make room for one more element, growing the arrays when allowed.
+ * @return true if slot *count is writable, false if a fixed list is full or an allocation failed.
+ * @note If only the values array grew, it is kept and capacity stays at the old size.
+ */
+static bool ci_list_reserve(ci_list_sink *sink) {
+    if (sink->count < sink->capacity) return true;
+    if (!sink->growable) return false;
+
+    size_t elem = sink->is_double ? sizeof(double) : sizeof(int64_t);
+    size_t cap = sink->capacity ? sink->capacity * 2 : CI_LIST_INITIAL;
+    void *values = realloc(sink->values, cap * elem);
+    if (!values) return false;
+    sink->values = values;
+    ci_status *status = realloc(sink->status, cap * sizeof(ci_status));
+    if (!status) return false;
+    sink->status = status;
+    sink->capacity = cap;
+    return true;
+}
+
+/**
+ * @brief Append one element; once there is no room, the rest of the line is dropped and counted in errors.
+ */
+static void ci_list_push(ci_list_sink *sink, int64_t ival, double dval, ci_status status) {
+    sink->elem_since_sep = true;
+    if (sink->full || !ci_list_reserve(sink)) {
+        sink->full = true;
+        sink->errors++;
+        return;
+    }
+    size_t i = sink->count++;
+    if (sink->is_double) {
+        ((double *)sink->values)[i] = status == CI_OK ? dval : 0.0;
+    } else {
+        ((int64_t *)sink->values)[i] = status == CI_OK ? ival : 0;
+    }
+    if (sink->status) sink->status[i] = status;
+    if (status != CI_OK) sink->errors++;
+}
+
+/**
+ * @brief Parse list elements out of a byte range.
+ * @param sink Destination list.
+ * @param start Bytes to parse.
+ * @param end End of the bytes.
+ * @param last No more bytes follow end on this line; a token touching end is complete.
+ * @param stop_at_newline Treat '\n' as the end of the line rather than as whitespace.
+ * @param eol Set when a newline ended the line.
+ * @return Bytes consumed. Short of end only when a token runs into end and !last,
+ *         in which case the caller must supply more bytes after the unconsumed ones.
+ */
+static size_t ci_list_feed(ci_list_sink *sink, const char *start, const char *end, bool last, bool stop_at_newline,
+                           bool *eol) {
+    const char *p = start;
+    *eol = false;
+
+    if (sink->skipping) {
+        while (p < end && !ci_list_is_sep(*p)) p++;
+        if (p == end && !last) return (size_t)(end - start);
+        ci_list_push(sink, 0, 0.0, CI_OVERFLOW);
+        sink->skipping = false;
+    }
+
+    while (p < end) {
+        char c = *p;
+        if (c == '\n' && stop_at_newline) {
+            *eol = true;
+            return (size_t)(p + 1 - start);
+        }
+        if (c == ',') {
+            if (!sink->elem_since_sep) ci_list_push(sink, 0, 0.0, CI_INVALID);
+            sink->elem_since_sep = false;
+            sink->after_comma = true;
+            p++;
+            continue;
+        }
+        if (ci_is_space(c)) {
+            p++;
+            continue;
+        }
+
+        const char *stop = p;
+        int64_t ival = 0;
+        double dval = 0.0;
+        ci_status status;
+        if (sink->is_double) {
+            status = ci_parse_double_prefix(p, (size_t)(end - p), sink->flags, &dval, &stop);
+        } else {
+            status = ci_parse_signed_prefix(p, (size_t)(end - p), 10, INT64_MIN, INT64_MAX, &ival, &stop);
+        }
+        if (stop == end && !last) break;
+        if (stop < end && !ci_list_is_sep(*stop)) {
+            /* "12ab": the whole token is bad, not just its tail */
+            if (status == CI_OK) status = CI_INVALID;
+            while (stop < end && !ci_list_is_sep(*stop)) stop++;
+            if (stop == end && !last) break;
+        }
+        ci_list_push(sink, ival, dval, status);
+        sink->after_comma = false;
+        p = stop;
+    }
+    return (size_t)(p - start);
+}
+
+static void ci_list_begin(ci_list_sink *sink) {
+    sink->count = 0;
+    sink->errors = 0;
+    sink->full = false;
+    sink->elem_since_sep = false;
+    sink->after_comma = false;
+    sink->skipping = false;
+    if (sink->growable && !sink->status && sink->capacity > 0) {
+        /* a growable list always tracks per-element status */
+        sink->status = malloc(sink->capacity * sizeof(ci_status));
+        if (!sink->status) sink->capacity = 0;
+    }
+}
+
+static ci_status ci_list_finish(ci_list_sink *sink) {
+    /* "1,2," ends with an empty element */
+    if (sink->after_comma && !sink->elem_since_sep) ci_list_push(sink, 0, 0.0, CI_INVALID);
+    if (sink->full) return CI_OVERFLOW;
+    return sink->errors ? CI_INVALID : CI_OK;
+}
+
+static ci_status ci_list_parse_text(ci_list_sink *sink, const char *text, size_t len) {
+    bool eol;
+    ci_list_begin(sink);
+    ci_list_feed(sink, text, text + len, true, false, &eol);
+    return ci_list_finish(sink);
+}
+
+/**
+ * @brief Stream one line out of a reader into a list, refilling as tokens straddle blocks.
+ */
+static ci_status ci_list_parse_reader(ci_list_sink *sink, ci_reader *reader) {
+    bool seen = false;
+    bool eol = false;
+    ci_list_begin(sink);
+
+    for (;;) {
+        char *start = reader->buf + reader->head;
+        size_t avail = reader->tail - reader->head;
+        size_t used = ci_list_feed(sink, start, start + avail, false, true, &eol);
+        reader->head += used;
+        if (used > 0) seen = true;
+        if (eol) break;
+
+        if (reader->tail - reader->head == reader->cap) {
+            /* one token fills the whole block; it cannot be a sane number */
+            sink->skipping = true;
+            reader->head = reader->tail;
+        }
+        ssize_t n = ci_reader_fill(reader, true);
+        if (n < 0) return CI_INVALID;
+        if (n == 0) {
+            start = reader->buf + reader->head;
+            avail = reader->tail - reader->head;
+            if (!seen && avail == 0 && !sink->skipping) return CI_EOF;
+            ci_list_feed(sink, start, start + avail, true, true, &eol);
+            reader->head = reader->tail;
+            break;
+        }
+    }
+    return ci_list_finish(sink);
+}
+
+/* The list structs are mirrored into a sink for parsing and written back after. */
+#define CI_LIST_LOAD(sink, list, dbl)          \
+    do {                                       \
+        (sink)->is_double = (dbl);             \
+        (sink)->growable = (list)->growable;   \
+        (sink)->values = (list)->values;       \
+        (sink)->status = (list)->status;       \
+        (sink)->count = (list)->count;         \
+        (sink)->capacity = (list)->capacity;   \
+        (sink)->errors = (list)->errors;       \
+        (sink)->flags = 0;                     \
+    } while (0)
+
+#define CI_LIST_STORE(sink, list)              \
+    do {                                       \
+        (list)->values = (sink)->values;       \
+        (list)->status = (sink)->status;       \
+        (list)->count = (sink)->count;         \
+        (list)->capacity = (sink)->capacity;   \
+        (list)->errors = (sink)->errors;       \
+    } while (0)
+
+ci_status ci_parse_int_list(const char *text, size_t len, ci_int_list *list) {
+    if (!text || !list || (!list->values && list->capacity > 0)) return CI_INVALID;
+    ci_list_sink sink;
+    CI_LIST_LOAD(&sink, list, false);
+    ci_status status = ci_list_parse_text(&sink, text, len);
+    CI_LIST_STORE(&sink, list);
+    return status;
+}
+
+ci_status ci_parse_double_list(const char *text, size_t len, ci_double_list *list) {
+    if (!text || !list || (!list->values && list->capacity > 0)) return CI_INVALID;
+    ci_list_sink sink;
+    CI_LIST_LOAD(&sink, list, true);
+    sink.flags = list->flags;
+    ci_status status = ci_list_parse_text(&sink, text, len);
+    CI_LIST_STORE(&sink, list);
+    return status;
+}
+
+ci_status ci_reader_read_int_list(ci_reader *reader, ci_int_list *list) {
+    if (!reader || !list || (!list->values && list->capacity > 0)) return CI_INVALID;
+    ci_list_sink sink;
+    CI_LIST_LOAD(&sink, list, false);
+    ci_status status = ci_list_parse_reader(&sink, reader);
+    CI_LIST_STORE(&sink, list);
+    return status;
+}
+
+ci_status ci_reader_read_double_list(ci_reader *reader, ci_double_list *list) {
+    if (!reader || !list || (!list->values && list->capacity > 0)) return CI_INVALID;
+    ci_list_sink sink;
+    CI_LIST_LOAD(&sink, list, true);
+    sink.flags = list->flags;
+    ci_status status = ci_list_parse_reader(&sink, reader);
+    CI_LIST_STORE(&sink, list);
+    return status;
+}
+
+/**
+ * @brief Queue the prompt and return the shared stdin reader.
+ */
+static ci_reader *ci_list_prompt(const char *prompt) {
+    ci_reader *reader = ci_stdin_reader();
+    ci_prompt(reader, prompt);
+    return reader;
+}
+
+ci_status ci_read_int_list(const char *prompt, ci_int_list *list) {
+    return ci_reader_read_int_list(ci_list_prompt(prompt), list);
+}
+
+ci_status ci_read_double_list(const char *prompt, ci_double_list *list) {
+    return ci_reader_read_double_list(ci_list_prompt(prompt), list);
+}
+
+void ci_int_list_free(ci_int_list *list) {
+    if (!list || !list->growable) return;
+    free(list->values);
+    free(list->status);
+    list->values = NULL;
+    list->status = NULL;
+    list->count = list->capacity = list->errors = 0;
+}
+
+void ci_double_list_free(ci_double_list *list) {
+    if (!list || !list->growable) return;
+    free(list->values);
+    free(list->status);
+    list->values = NULL;
+    list->status = NULL;
+    list->count = list->capacity = list->errors = 0;
+}
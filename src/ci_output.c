@@ -0,0 +1,50 @@
+#include "ci_internal.h"
+
+#include <unistd.h>
+
+/*
+ * Prompts and diagnostics go through the stream's stdio buffer, which keeps
+ * them ordered with whatever the callbacks print, and are flushed only when
+ * the reader is about to wait for input. With piped input a whole block of
+ * lines is handled between two reads, so their prompts and "try again"
+ * messages leave in one write instead of one per line.
+ */
+
+void ci_output_init(ci_output *out, FILE *stream) {
+    out->stream = stream;
+    out->tty = -1;
+    out->pending = false;
+    out->flushes = 0;
+}
+
+void ci_output_write(ci_output *out, const char *text) {
+    if (!text || !out->stream) return;
+    fputs(text, out->stream);
+    out->pending = true;
+}
+
+void ci_output_flush(ci_output *out) {
+    if (!out->pending) return;
+    out->pending = false;
+    out->flushes++;
+    fflush(out->stream);
+}
+
+bool ci_output_is_tty(ci_output *out) {
+    if (out->tty < 0) out->tty = out->stream && isatty(fileno(out->stream)) ? 1 : 0;
+    return out->tty == 1;
+}
+
+bool ci_prompt_wanted(ci_prompt_policy policy, ci_reader *reader, ci_output *out) {
+    switch (policy) {
+    case CI_PROMPT_ALWAYS:
+        return true;
+    case CI_PROMPT_NEVER:
+        return false;
+    case CI_PROMPT_TTY:
+    default:
+        /* someone is typing and watching: both ends are terminals */
+        if (reader->tty < 0) reader->tty = isatty(reader->fd) ? 1 : 0;
+        return reader->tty == 1 && ci_output_is_tty(out);
+    }
+}
@@ -0,0 +1,723 @@
+#include "ci_internal.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CI_DIGIT_BAD 0xFF
+
+/* Digit values for bases up to 16; CI_DIGIT_BAD for anything else. */
+static const unsigned char ci_digit_value[256] = {
+    ['0'] = 0,  ['1'] = 1,  ['2'] = 2,  ['3'] = 3,  ['4'] = 4,  ['5'] = 5,  ['6'] = 6,  ['7'] = 7,
+    ['8'] = 8,  ['9'] = 9,  ['a'] = 10, ['b'] = 11, ['c'] = 12, ['d'] = 13, ['e'] = 14, ['f'] = 15,
+    ['A'] = 10, ['B'] = 11, ['C'] = 12, ['D'] = 13, ['E'] = 14, ['F'] = 15,
+};
+
+/**
+ * @brief Value of a digit character in a base.
+ * @param c Character.
+ * @param base Base (2, 8, 10 or 16).
+ * @return Digit value, or CI_DIGIT_BAD if c is not a digit of the base.
+ */
+static unsigned ci_digit(unsigned char c, unsigned base) {
+    /* the table is zero-filled, so only '0' itself may map to 0 */
+    unsigned v = ci_digit_value[c];
+    if (v == 0 && c != '0') return CI_DIGIT_BAD;
+    return v < base ? v : CI_DIGIT_BAD;
+}
+
+bool ci_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CI_PARSE_SWAR 1
+
+static const uint64_t ci_pow10[9] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+/**
+ * @brief Combine 8 digit values (first digit in the lowest byte) into a number.
+ * @param word Little-endian load of the digits with '0' already subtracted from each byte.
+ * @return Value in 0..99999999.
+ */
+static uint32_t ci_swar_parse8(uint64_t word) {
+    const uint64_t mask = 0x000000FF000000FFull;
+    const uint64_t mul1 = 100 + (1000000ull << 32);
+    const uint64_t mul2 = 1 + (10000ull << 32);
+    word = (word * 10) + (word >> 8); /* pairs of digits */
+    word = (((word & mask) * mul1) + (((word >> 16) & mask) * mul2)) >> 32;
+    return (uint32_t)word;
+}
+#endif
+
+/**
+ * @brief Accumulate decimal digits into a 64-bit magnitude with exact overflow detection.
+ * @param p Digits start (already past sign and leading zeros).
+ * @param end End of input.
+ * @param value In/out accumulated magnitude.
+ * @param overflow Set when the magnitude exceeds UINT64_MAX.
+ * @return Pointer to the first non-digit.
+ */
+static const char *ci_parse_decimal(const char *p, const char *end, uint64_t *value, bool *overflow) {
+    uint64_t v = *value;
+    size_t digits = 0;
+
+#ifdef CI_PARSE_SWAR
+    /* 19 digits always fit in 64 bits, so only the last step needs checked arithmetic */
+    while (end - p >= 8 && digits + 8 <= 19) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        /* a lane holds a digit iff byte - '0' is below 10; a borrow only spoils lanes after a non-digit */
+        uint64_t d = word - 0x3030303030303030ull;
+        uint64_t bad = ((d + 0x7676767676767676ull) | d) & 0x8080808080808080ull;
+        if (!bad) {
+            v = v * 100000000ull + ci_swar_parse8(d);
+            p += 8;
+            digits += 8;
+            continue;
+        }
+        /* shift the n leading digits to the top; the vacated lanes read as leading zeros */
+        unsigned n = (unsigned)__builtin_ctzll(bad) / 8;
+        if (n > 0) v = v * ci_pow10[n] + ci_swar_parse8(d << (64 - 8 * n));
+        *value = v;
+        return p + n;
+    }
+#endif
+    for (; p < end; p++) {
+        unsigned d = (unsigned char)*p - '0';
+        if (d > 9) break;
+        if (digits < 19) {
+            v = v * 10 + d;
+        } else if (!*overflow && (__builtin_mul_overflow(v, 10, &v) || __builtin_add_overflow(v, d, &v))) {
+            *overflow = true;
+        }
+        digits++;
+    }
+    *value = v;
+    return p;
+}
+
+/**
+ * @brief Accumulate digits of a power-of-two base with exact overflow detection.
+ * @param p Digits start.
+ * @param end End of input.
+ * @param base 2, 8 or 16.
+ * @param value In/out accumulated magnitude.
+ * @param overflow Set when the magnitude exceeds UINT64_MAX.
+ * @return Pointer to the first non-digit.
+ */
+static const char *ci_parse_pow2(const char *p, const char *end, unsigned base, uint64_t *value, bool *overflow) {
+    unsigned shift = base == 16 ? 4 : base == 8 ? 3 : 1;
+    uint64_t v = *value;
+
+    for (; p < end; p++) {
+        unsigned d = ci_digit((unsigned char)*p, base);
+        if (d == CI_DIGIT_BAD) break;
+        if (v >> (64 - shift)) *overflow = true;
+        v = (v << shift) | d;
+    }
+    *value = v;
+    return p;
+}
+
+/**
+ * @brief Split an integer into sign and 64-bit magnitude.
+ * @param text Input bytes (need not be NUL-terminated).
+ * @param len Number of bytes.
+ * @param base 0 (prefix decides: 0x, 0o, 0b, else 10), 2, 8, 10 or 16.
+ * @param negative Output sign.
+ * @param magnitude Output absolute value.
+ * @param stop Output: first character after the digits.
+ * @return CI_OK, CI_OVERFLOW if the magnitude exceeds 64 bits, CI_INVALID if there are no digits.
+ *
+ * Accepts optional leading whitespace, one sign, an optional prefix matching the
+ * base, then digits. Trailing characters are left to the caller so that, like
+ * strtol, a range error is reported ahead of them.
+ */
+static ci_status ci_parse_magnitude(const char *text, size_t len, unsigned base, bool *negative,
+                                    uint64_t *magnitude, const char **stop) {
+    const char *p = text;
+    const char *end = text + len;
+    *stop = text;
+    if (!text) return CI_INVALID;
+    if (base != 0 && base != 2 && base != 8 && base != 10 && base != 16) return CI_INVALID;
+
+    while (p < end && ci_is_space(*p)) p++;
+
+    *negative = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+        *negative = *p == '-';
+        p++;
+    }
+
+    /* a prefix needs a digit after it; "0x" alone is an invalid number */
+    if (end - p >= 3 && p[0] == '0') {
+        char tag = (char)(p[1] | 0x20);
+        unsigned prefixed = tag == 'x' ? 16 : tag == 'o' ? 8 : tag == 'b' ? 2 : 0;
+        if (prefixed && (base == 0 || base == prefixed) && ci_digit((unsigned char)p[2], prefixed) != CI_DIGIT_BAD) {
+            base = prefixed;
+            p += 2;
+        }
+    }
+    if (base == 0) base = 10;
+
+    const char *digits = p;
+    while (p < end && *p == '0') p++;
+
+    uint64_t value = 0;
+    bool overflow = false;
+    p = base == 10 ? ci_parse_decimal(p, end, &value, &overflow) : ci_parse_pow2(p, end, base, &value, &overflow);
+
+    if (p == digits) return CI_INVALID;
+    *stop = p;
+    if (overflow) return CI_OVERFLOW;
+    *magnitude = value;
+    return CI_OK;
+}
+
+ci_status ci_parse_signed_prefix(const char *text, size_t len, unsigned base, int64_t min, int64_t max,
+                                 int64_t *out, const char **stop) {
+    bool negative;
+    uint64_t magnitude;
+    ci_status status = ci_parse_magnitude(text, len, base, &negative, &magnitude, stop);
+    if (status != CI_OK) return status;
+
+    /* -(min + 1) + 1 is |min| without overflowing int64_t */
+    uint64_t limit = negative ? (uint64_t)(-(min + 1)) + 1 : (uint64_t)max;
+    if (magnitude > limit) return CI_OVERFLOW;
+    *out = negative ? (magnitude == 0 ? 0 : -(int64_t)(magnitude - 1) - 1) : (int64_t)magnitude;
+    return CI_OK;
+}
+
+ci_status ci_parse_signed(const char *text, size_t len, unsigned base, int64_t min, int64_t max, int64_t *out) {
+    const char *stop;
+    int64_t v;
+    ci_status status = ci_parse_signed_prefix(text, len, base, min, max, &v, &stop);
+    if (status != CI_OK) return status;
+    if (stop != text + len) return CI_INVALID;
+    *out = v;
+    return CI_OK;
+}
+
+ci_status ci_parse_unsigned(const char *text, size_t len, unsigned base, uint64_t max, uint64_t *out) {
+    bool negative;
+    uint64_t magnitude;
+    const char *stop;
+    ci_status status = ci_parse_magnitude(text, len, base, &negative, &magnitude, &stop);
+    if (status != CI_OK) return status;
+
+    /* "-0" is zero; any other negative value is out of range */
+    if (magnitude > max || (negative && magnitude != 0)) return CI_OVERFLOW;
+    if (stop != text + len) return CI_INVALID;
+    *out = magnitude;
+    return CI_OK;
+}
+
+ci_status ci_parse_int8(const char *text, size_t len, unsigned base, int8_t *out) {
+    int64_t v;
+    if (!out) return CI_INVALID;
+    ci_status status = ci_parse_signed(text, len, base, INT8_MIN, INT8_MAX, &v);
+    if (status == CI_OK) *out = (int8_t)v;
+    return status;
+}
+
+ci_status ci_parse_int16(const char *text, size_t len, unsigned base, int16_t *out) {
+    int64_t v;
+    if (!out) return CI_INVALID;
+    ci_status status = ci_parse_signed(text, len, base, INT16_MIN, INT16_MAX, &v);
+    if (status == CI_OK) *out = (int16_t)v;
+    return status;
+}
+
+ci_status ci_parse_int32(const char *text, size_t len, unsigned base, int32_t *out) {
+    int64_t v;
+    if (!out) return CI_INVALID;
+    ci_status status = ci_parse_signed(text, len, base, INT32_MIN, INT32_MAX, &v);
+    if (status == CI_OK) *out = (int32_t)v;
+    return status;
+}
+
+ci_status ci_parse_int64(const char *text, size_t len, unsigned base, int64_t *out) {
+    if (!out) return CI_INVALID;
+    return ci_parse_signed(text, len, base, INT64_MIN, INT64_MAX, out);
+}
+
+ci_status ci_parse_uint8(const char *text, size_t len, unsigned base, uint8_t *out) {
+    uint64_t v;
+    if (!out) return CI_INVALID;
+    ci_status status = ci_parse_unsigned(text, len, base, UINT8_MAX, &v);
+    if (status == CI_OK) *out = (uint8_t)v;
+    return status;
+}
+
+ci_status ci_parse_uint16(const char *text, size_t len, unsigned base, uint16_t *out) {
+    uint64_t v;
+    if (!out) return CI_INVALID;
+    ci_status status = ci_parse_unsigned(text, len, base, UINT16_MAX, &v);
+    if (status == CI_OK) *out = (uint16_t)v;
+    return status;
+}
+
+ci_status ci_parse_uint32(const char *text, size_t len, unsigned base, uint32_t *out) {
+    uint64_t v;
+    if (!out) return CI_INVALID;
+    ci_status status = ci_parse_unsigned(text, len, base, UINT32_MAX, &v);
+    if (status == CI_OK) *out = (uint32_t)v;
+    return status;
+}
+
+ci_status ci_parse_uint64(const char *text, size_t len, unsigned base, uint64_t *out) {
+    if (!out) return CI_INVALID;
+    return ci_parse_unsigned(text, len, base, UINT64_MAX, out);
+}
+
+ci_status ci_parse_size(const char *text, size_t len, unsigned base, size_t *out) {
+    uint64_t v;
+    if (!out) return CI_INVALID;
+    ci_status status = ci_parse_unsigned(text, len, base, SIZE_MAX, &v);
+    if (status == CI_OK) *out = (size_t)v;
+    return status;
+}
+
+/* ---- floating point: Clinger fast path, Eisel-Lemire, strtod fallback ---- */
+
+#define CI_FLOAT_MAX_DIGITS 19
+#define CI_FLOAT_NINETEEN_DIGITS 1000000000000000000ull
+#define CI_FLOAT_EXP_CAP 0x10000000
+#define CI_FLOAT_TOKEN_STACK 128
+
+/* Binary interchange format parameters for the Eisel-Lemire conversion. */
+typedef struct {
+    int mantissa_bits;  /* explicit mantissa bits */
+    int min_exponent;   /* exponent bias, negated */
+    int infinite_power; /* biased exponent of infinity */
+    int min_round_even; /* decimal exponents where 5^q fits 64 bits and ties can occur */
+    int max_round_even;
+    int smallest_pow10; /* w * 10^q is zero for any q below this */
+    int largest_pow10;  /* and infinite for any q above this */
+} ci_float_format;
+
+static const ci_float_format ci_binary64 = {52, -1023, 0x7FF, -4, 23, -342, 308};
+static const ci_float_format ci_binary32 = {23, -127, 0xFF, -17, 10, -64, 38};
+
+typedef struct {
+    uint64_t mantissa;
+    int power2; /* biased exponent; -1 when the result cannot be decided */
+} ci_float_bits;
+
+typedef struct {
+    uint64_t high;
+    uint64_t low;
+} ci_u128;
+
+static ci_u128 ci_mul_64x64(uint64_t a, uint64_t b) {
+    ci_u128 r;
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 ci_uint128;
+    ci_uint128 p = (ci_uint128)a * b;
+    r.high = (uint64_t)(p >> 64);
+    r.low = (uint64_t)p;
+#else
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32, b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    r.high = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    r.low = (cross << 32) | (uint32_t)lo_lo;
+#endif
+    return r;
+}
+
+static int ci_clz64(uint64_t x) {
+    return __builtin_clzll(x);
+}
+
+/**
+ * @brief Round w * 10^q to the nearest binary float (Eisel-Lemire).
+ * @param fmt Target format.
+ * @param q Decimal exponent.
+ * @param w Decimal significand; exact, or the first 19 digits of a longer one.
+ * @return Biased exponent and mantissa of the correctly rounded result.
+ *
+ * Truncated 128-bit powers of five are always sufficient to round an exact
+ * significand correctly (Mushtak and Lemire, "Fast number parsing without
+ * fallback"); a truncated one is settled by the caller comparing w and w + 1.
+ */
+static ci_float_bits ci_eisel_lemire(const ci_float_format *fmt, int q, uint64_t w) {
+    ci_float_bits r = {0, 0};
+    if (w == 0 || q < fmt->smallest_pow10) return r;
+    if (q > fmt->largest_pow10) {
+        r.power2 = fmt->infinite_power;
+        return r;
+    }
+
+    int lz = ci_clz64(w);
+    w <<= lz;
+
+    /* the high 64 bits of w * 5^q, refined with the low table word only when they are ambiguous */
+    const uint64_t *pow5 = ci_pow5_128[q - CI_POW5_MIN_Q];
+    ci_u128 product = ci_mul_64x64(w, pow5[0]);
+    uint64_t precision_mask = UINT64_MAX >> (fmt->mantissa_bits + 3);
+    if ((product.high & precision_mask) == precision_mask) {
+        ci_u128 second = ci_mul_64x64(w, pow5[1]);
+        product.low += second.high;
+        if (second.high > product.low) product.high++;
+    }
+
+    int upperbit = (int)(product.high >> 63);
+    int shift = upperbit + 64 - fmt->mantissa_bits - 3;
+    r.mantissa = product.high >> shift;
+    /* floor(log2(10^q)) + 63, exact for |q| <= 1650 */
+    int power = (((152170 + 65536) * q) >> 16) + 63;
+    r.power2 = power + upperbit - lz - fmt->min_exponent;
+
+    if (r.power2 <= 0) {
+        /* subnormal; ties cannot occur this far from 10^0 */
+        if (-r.power2 + 1 >= 64) {
+            r.mantissa = 0;
+            r.power2 = 0;
+            return r;
+        }
+        r.mantissa >>= -r.power2 + 1;
+        r.mantissa += r.mantissa & 1;
+        r.mantissa >>= 1;
+        /* rounding up may have carried into the smallest normal */
+        r.power2 = r.mantissa < (1ull << fmt->mantissa_bits) ? 0 : 1;
+        return r;
+    }
+
+    /* exactly halfway: only zeros were shifted out, so round to even instead of up */
+    if (product.low <= 1 && q >= fmt->min_round_even && q <= fmt->max_round_even && (r.mantissa & 3) == 1 &&
+        (r.mantissa << shift) == product.high) {
+        r.mantissa &= ~1ull;
+    }
+    r.mantissa += r.mantissa & 1;
+    r.mantissa >>= 1;
+    if (r.mantissa >= (2ull << fmt->mantissa_bits)) {
+        r.mantissa = 1ull << fmt->mantissa_bits;
+        r.power2++;
+    }
+    r.mantissa &= ~(1ull << fmt->mantissa_bits);
+    if (r.power2 >= fmt->infinite_power) {
+        r.power2 = fmt->infinite_power;
+        r.mantissa = 0;
+    }
+    return r;
+}
+
+/* A decimal number split into its significand and exponent. */
+typedef struct {
+    uint64_t mantissa;  /* first 19 significant digits when truncated */
+    int exponent;       /* value = mantissa * 10^exponent (before truncation adjustments) */
+    bool negative;
+    bool truncated;     /* more than 19 significant digits; mantissa is a lower bound */
+    const char *start;  /* first character after leading whitespace */
+    const char *stop;   /* first character after the number */
+} ci_decimal;
+
+static bool ci_is_digit(char c) {
+    return (unsigned char)(c - '0') < 10;
+}
+
+static bool ci_match_word(const char *p, const char *end, const char *word) {
+    for (; *word; word++, p++) {
+        if (p == end || (*p | 0x20) != *word) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Tokenize a decimal floating-point number.
+ * @param text Input bytes.
+ * @param len Number of bytes.
+ * @param d Output decomposition; d->stop marks the end of the number.
+ * @return true if there was at least one significand digit.
+ */
+static bool ci_decimal_scan(const char *text, size_t len, ci_decimal *d) {
+    const char *p = text;
+    const char *end = text + len;
+    while (p < end && ci_is_space(*p)) p++;
+    d->start = p;
+    d->negative = false;
+    d->truncated = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+        d->negative = *p == '-';
+        p++;
+    }
+
+    const char *int_start = p;
+    uint64_t w = 0;
+    while (p < end && ci_is_digit(*p)) {
+        w = w * 10 + (uint64_t)(*p - '0'); /* may wrap; redone below when too long */
+        p++;
+    }
+    const char *int_end = p;
+    size_t digits = (size_t)(int_end - int_start);
+
+    const char *frac_start = p;
+    const char *frac_end = p;
+    if (p < end && *p == '.') {
+        frac_start = ++p;
+#ifdef CI_PARSE_SWAR
+        while (end - p >= 8) {
+            uint64_t word;
+            memcpy(&word, p, sizeof(word));
+            uint64_t dw = word - 0x3030303030303030ull;
+            if (((dw + 0x7676767676767676ull) | dw) & 0x8080808080808080ull) break;
+            w = w * 100000000ull + ci_swar_parse8(dw);
+            p += 8;
+        }
+#endif
+        while (p < end && ci_is_digit(*p)) {
+            w = w * 10 + (uint64_t)(*p - '0');
+            p++;
+        }
+        frac_end = p;
+        digits += (size_t)(frac_end - frac_start);
+    }
+    if (digits == 0) {
+        d->stop = text;
+        return false;
+    }
+
+    int64_t exp10 = 0;
+    if (p < end && (*p | 0x20) == 'e') {
+        const char *e = p + 1;
+        bool exp_negative = false;
+        if (e < end && (*e == '+' || *e == '-')) {
+            exp_negative = *e == '-';
+            e++;
+        }
+        if (e < end && ci_is_digit(*e)) {
+            while (e < end && ci_is_digit(*e)) {
+                if (exp10 < CI_FLOAT_EXP_CAP) exp10 = exp10 * 10 + (*e - '0');
+                e++;
+            }
+            if (exp_negative) exp10 = -exp10;
+            p = e;
+        }
+        /* otherwise "1e" / "1e+" end at the 'e', which the caller rejects as trailing */
+    }
+    d->stop = p;
+
+    if (digits > CI_FLOAT_MAX_DIGITS) {
+        /* leading zeros are not significant */
+        for (const char *z = int_start; z < frac_end && (*z == '0' || *z == '.'); z++) {
+            if (*z == '0') digits--;
+        }
+    }
+    if (digits > CI_FLOAT_MAX_DIGITS) {
+        /* keep the first 19 significant digits and move the rest into the exponent */
+        d->truncated = true;
+        w = 0;
+        const char *q = int_start;
+        while (w < CI_FLOAT_NINETEEN_DIGITS && q != int_end) w = w * 10 + (uint64_t)(*q++ - '0');
+        if (w >= CI_FLOAT_NINETEEN_DIGITS) {
+            exp10 += int_end - q;
+        } else {
+            q = frac_start;
+            while (w < CI_FLOAT_NINETEEN_DIGITS && q != frac_end) w = w * 10 + (uint64_t)(*q++ - '0');
+            exp10 -= q - frac_start;
+        }
+    } else {
+        exp10 -= frac_end - frac_start;
+    }
+    d->mantissa = w;
+    d->exponent = exp10 > CI_FLOAT_EXP_CAP ? CI_FLOAT_EXP_CAP : exp10 < -CI_FLOAT_EXP_CAP ? -CI_FLOAT_EXP_CAP : (int)exp10;
+    return true;
+}
+
+/**
+ * @brief Recognise "inf", "infinity" and "nan" (any case) after an optional sign.
+ * @return 1 for infinity, 2 for NaN, 0 otherwise; *stop is set past the word.
+ */
+static int ci_decimal_special(const char *text, size_t len, bool *negative, const char **stop) {
+    const char *p = text;
+    const char *end = text + len;
+    while (p < end && ci_is_space(*p)) p++;
+    *negative = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+        *negative = *p == '-';
+        p++;
+    }
+    if (ci_match_word(p, end, "infinity")) {
+        *stop = p + 8;
+        return 1;
+    }
+    if (ci_match_word(p, end, "inf")) {
+        *stop = p + 3;
+        return 1;
+    }
+    if (ci_match_word(p, end, "nan")) {
+        *stop = p + 3;
+        return 2;
+    }
+    return 0;
+}
+
+static bool ci_float_bits_equal(ci_float_bits a, ci_float_bits b) {
+    return a.mantissa == b.mantissa && a.power2 == b.power2;
+}
+
+/**
+ * @brief Convert a scanned decimal, or report that the slow path is needed.
+ * @return Rounded bits, with power2 == -1 when w and w + 1 round differently.
+ */
+static ci_float_bits ci_decimal_round(const ci_float_format *fmt, const ci_decimal *d) {
+    ci_float_bits r = ci_eisel_lemire(fmt, d->exponent, d->mantissa);
+    if (d->truncated && r.power2 >= 0 && !ci_float_bits_equal(r, ci_eisel_lemire(fmt, d->exponent, d->mantissa + 1))) {
+        r.power2 = -1;
+    }
+    return r;
+}
+
+/**
+ * @brief Classify a finished conversion of a number with digits.
+ * @param is_zero The result is (signed) zero.
+ * @param is_inf The result is infinite.
+ * @param mantissa Scanned significand; nonzero means the input itself was nonzero.
+ */
+static ci_status ci_float_range(bool is_zero, bool is_inf, uint64_t mantissa) {
+    if (is_inf) return CI_OVERFLOW;
+    if (is_zero && mantissa != 0) return CI_UNDERFLOW;
+    return CI_OK;
+}
+
+/**
+ * @brief Correct slow path: strtod/strtof on a NUL-terminated copy of the unsigned token.
+ * @return false if the copy could not be allocated.
+ * @note Only reached for more than 19 significant digits that sit on a rounding boundary.
+ */
+static bool ci_float_fallback(const ci_decimal *d, bool single, double *dout, float *fout) {
+    const char *p = d->start;
+    if (*p == '+' || *p == '-') p++;
+    size_t len = (size_t)(d->stop - p);
+    char stack[CI_FLOAT_TOKEN_STACK];
+    char *copy = len < sizeof(stack) ? stack : malloc(len + 1);
+    if (!copy) return false;
+    memcpy(copy, p, len);
+    copy[len] = '\0';
+    if (single) {
+        *fout = strtof(copy, NULL);
+    } else {
+        *dout = strtod(copy, NULL);
+    }
+    if (copy != stack) free(copy);
+    return true;
+}
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#define CI_FLOAT_CLINGER 1
+static const double ci_exact_pow10_d[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                          1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+static const float ci_exact_pow10_f[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+#endif
+
+ci_status ci_parse_double_prefix(const char *text, size_t len, unsigned flags, double *out, const char **stop) {
+    ci_decimal d;
+    *stop = text;
+    if (!text) return CI_INVALID;
+    if (!ci_decimal_scan(text, len, &d)) {
+        bool negative;
+        int special = ci_decimal_special(text, len, &negative, stop);
+        if (special == 1 && (flags & CI_FLOAT_ALLOW_INF)) {
+            *out = negative ? -HUGE_VAL : HUGE_VAL;
+            return CI_OK;
+        }
+        if (special == 2 && (flags & CI_FLOAT_ALLOW_NAN)) {
+            *out = negative ? -NAN : NAN;
+            return CI_OK;
+        }
+        *stop = text;
+        return CI_INVALID;
+    }
+    *stop = d.stop;
+
+    double v;
+#ifdef CI_FLOAT_CLINGER
+    /* w and 10^|q| are both exact doubles, so one correctly rounded operation is exact */
+    if (!d.truncated && d.exponent >= -22 && d.exponent <= 22 && d.mantissa <= (1ull << 53)) {
+        v = (double)d.mantissa;
+        v = d.exponent < 0 ? v / ci_exact_pow10_d[-d.exponent] : v * ci_exact_pow10_d[d.exponent];
+        *out = d.negative ? -v : v;
+        return CI_OK;
+    }
+#endif
+    ci_float_bits r = ci_decimal_round(&ci_binary64, &d);
+    if (r.power2 < 0 && !ci_float_fallback(&d, false, &v, NULL)) {
+        /* no memory for the slow path: the 19-digit prefix is within one unit of the answer */
+        r = ci_eisel_lemire(&ci_binary64, d.exponent, d.mantissa);
+    }
+    if (r.power2 >= 0) {
+        uint64_t bits = r.mantissa | ((uint64_t)r.power2 << 52);
+        memcpy(&v, &bits, sizeof(v));
+    }
+    ci_status status = ci_float_range(v == 0.0, isinf(v), d.mantissa);
+    if (status == CI_OK) *out = d.negative ? -v : v;
+    return status;
+}
+
+ci_status ci_parse_float_prefix(const char *text, size_t len, unsigned flags, float *out, const char **stop) {
+    ci_decimal d;
+    *stop = text;
+    if (!text) return CI_INVALID;
+    if (!ci_decimal_scan(text, len, &d)) {
+        bool negative;
+        int special = ci_decimal_special(text, len, &negative, stop);
+        if (special == 1 && (flags & CI_FLOAT_ALLOW_INF)) {
+            *out = negative ? -HUGE_VALF : HUGE_VALF;
+            return CI_OK;
+        }
+        if (special == 2 && (flags & CI_FLOAT_ALLOW_NAN)) {
+            *out = negative ? -NAN : NAN;
+            return CI_OK;
+        }
+        *stop = text;
+        return CI_INVALID;
+    }
+    *stop = d.stop;
+
+    float v;
+#ifdef CI_FLOAT_CLINGER
+    if (!d.truncated && d.exponent >= -10 && d.exponent <= 10 && d.mantissa <= (1ull << 24)) {
+        v = (float)d.mantissa;
+        v = d.exponent < 0 ? v / ci_exact_pow10_f[-d.exponent] : v * ci_exact_pow10_f[d.exponent];
+        *out = d.negative ? -v : v;
+        return CI_OK;
+    }
+#endif
+    ci_float_bits r = ci_decimal_round(&ci_binary32, &d);
+    if (r.power2 < 0 && !ci_float_fallback(&d, true, NULL, &v)) {
+        r = ci_eisel_lemire(&ci_binary32, d.exponent, d.mantissa);
+    }
+    if (r.power2 >= 0) {
+        uint32_t bits = (uint32_t)r.mantissa | ((uint32_t)r.power2 << 23);
+        memcpy(&v, &bits, sizeof(v));
+    }
+    ci_status status = ci_float_range(v == 0.0f, isinf(v), d.mantissa);
+    if (status == CI_OK) *out = d.negative ? -v : v;
+    return status;
+}
+
+ci_status ci_parse_double(const char *text, size_t len, unsigned flags, double *out) {
+    const char *stop;
+    double v;
+    if (!out) return CI_INVALID;
+    ci_status status = ci_parse_double_prefix(text, len, flags, &v, &stop);
+    if (status != CI_OK) return status;
+    if (stop != text + len) return CI_INVALID;
+    *out = v;
+    return CI_OK;
+}
+
+ci_status ci_parse_float(const char *text, size_t len, unsigned flags, float *out) {
+    const char *stop;
+    float v;
+    if (!out) return CI_INVALID;
+    ci_status status = ci_parse_float_prefix(text, len, flags, &v, &stop);
+    if (status != CI_OK) return status;
+    if (stop != text + len) return CI_INVALID;
+    *out = v;
+    return CI_OK;
+}
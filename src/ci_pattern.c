@@ -0,0 +1,370 @@
+#include "ci_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CI_DFA_CHUNK 64
+#define CI_DFA_MAX_STATES 4096
+#define CI_DFA_UNKNOWN (-1) /* transition not computed yet */
+#define CI_DFA_DEAD (-2)    /* no pattern can match any more */
+#define CI_DFA_FULL (-3)    /* state limit reached; match without caching */
+
+/*
+ * Every registered pattern compiles to a list of items, each a byte class that
+ * is taken once or (star) any number of times. The items of all patterns are
+ * laid end to end, so a position in that array is an NFA state and a sorted
+ * set of positions is a DFA state. DFA states are created lazily, the first
+ * time a line needs a transition, and cached in the set: once warm, a line
+ * costs one table load per byte however many patterns there are. Positions of
+ * earlier patterns are smaller, so the first end position in a state's set
+ * names the pattern that wins.
+ */
+
+typedef struct {
+    int32_t next[256]; /* state id, or CI_DFA_UNKNOWN / CI_DFA_DEAD */
+    uint32_t accept;   /* index + 1 of the winning pattern, or 0 */
+    uint32_t count;
+    uint32_t *positions;
+    uint64_t hash;
+} ci_dfa_state;
+
+struct ci_pattern_set {
+    size_t count;
+    ci_pattern **patterns;
+    size_t positions;
+    ci_pattern_item *items; /* every pattern's items, end markers included */
+    uint32_t *ends;         /* per position: pattern index + 1 at end markers, else 0 */
+
+    pthread_mutex_t mutex; /* guards everything below and filling next[] */
+    size_t states;
+    ci_dfa_state *chunks[CI_DFA_MAX_STATES / CI_DFA_CHUNK];
+    uint32_t index[CI_DFA_MAX_STATES * 2]; /* open addressing on state hash: id + 1, or 0 */
+    uint32_t *stamps;                      /* per position: generation it was last added in */
+    uint32_t generation;
+    uint32_t *scratch[2];
+};
+
+static inline bool ci_class_has(const uint32_t *bits, unsigned char c) {
+    return (bits[c >> 5] >> (c & 31)) & 1u;
+}
+
+static inline void ci_class_add(uint32_t *bits, unsigned char c) {
+    bits[c >> 5] |= 1u << (c & 31);
+}
+
+/** @brief Add the other case of every ASCII letter in the class. */
+static void ci_class_fold(uint32_t *bits) {
+    for (unsigned char l = 'a'; l <= 'z'; l++) {
+        unsigned char u = (unsigned char)(l - 'a' + 'A');
+        if (ci_class_has(bits, l) || ci_class_has(bits, u)) {
+            ci_class_add(bits, l);
+            ci_class_add(bits, u);
+        }
+    }
+}
+
+/**
+ * @brief Parse a bracket expression; *p points just past '['.
+ *
+ * With @p nocase the listed set is folded before a '!' negates it, so
+ * "[!a]" excludes both 'a' and 'A'.
+ * @return false if the class is not closed.
+ */
+static bool ci_pattern_class(const char **p, uint32_t *bits, bool nocase) {
+    const char *s = *p;
+    bool negate = *s == '!' || *s == '^';
+    if (negate) s++;
+    for (bool first = true; *s && (first || *s != ']'); first = false) {
+        unsigned char lo = (unsigned char)*s++;
+        if (lo == '\\' && *s) lo = (unsigned char)*s++;
+        unsigned char hi = lo;
+        if (s[0] == '-' && s[1] && s[1] != ']') {
+            s++;
+            hi = (unsigned char)*s++;
+            if (hi == '\\' && *s) hi = (unsigned char)*s++;
+        }
+        for (unsigned c = lo; c <= hi; c++) ci_class_add(bits, (unsigned char)c);
+    }
+    if (*s != ']') return false;
+    if (nocase) ci_class_fold(bits);
+    if (negate) {
+        for (int i = 0; i < 8; i++) bits[i] = ~bits[i];
+    }
+    *p = s + 1;
+    return true;
+}
+
+ci_status ci_pattern_compile(const char *text, ci_line_callback callback, void *user_data, unsigned flags,
+                             ci_pattern **out) {
+    *out = NULL;
+    size_t len = strlen(text);
+    if (len == 0) return CI_INVALID;
+
+    /* "x+" takes two items, everything else at most one, plus the end marker */
+    size_t max_items = len * 2 + 1;
+    size_t items_at = (sizeof(ci_pattern) + len + 1 + sizeof(ci_pattern_item) - 1) / sizeof(ci_pattern_item);
+    ci_pattern *pat = calloc(items_at + max_items, sizeof(ci_pattern_item));
+    if (!pat) return CI_OVERFLOW;
+    pat->cb = callback;
+    pat->user_data = user_data;
+    pat->flags = flags;
+    pat->items = (ci_pattern_item *)pat + items_at;
+    memcpy(pat->text, text, len + 1);
+
+    size_t n = 0;
+    bool atom = false; /* the previous item can take a '+' */
+    bool any = false;  /* the previous item is a '*' */
+    for (const char *p = text; *p;) {
+        char c = *p++;
+        ci_pattern_item *item = &pat->items[n];
+        if (c == '*') {
+            /* "**" is the same as "*" */
+            if (!any) {
+                memset(item->bits, 0xff, sizeof(item->bits));
+                item->star = 1;
+                n++;
+            }
+            atom = false;
+            any = true;
+            continue;
+        }
+        any = false;
+        if (c == '+') {
+            if (!atom) {
+                free(pat);
+                return CI_INVALID;
+            }
+            *item = pat->items[n - 1];
+            item->star = 1;
+            atom = false;
+            n++;
+            continue;
+        }
+
+        if (c == '?') {
+            memset(item->bits, 0xff, sizeof(item->bits));
+        } else if (c == '[') {
+            if (!ci_pattern_class(&p, item->bits, flags & CI_CMD_NOCASE)) {
+                free(pat);
+                return CI_INVALID;
+            }
+        } else {
+            if (c == '\\') {
+                if (*p == '\0') {
+                    free(pat);
+                    return CI_INVALID;
+                }
+                c = *p++;
+            }
+            ci_class_add(item->bits, (unsigned char)c);
+            if (flags & CI_CMD_NOCASE) ci_class_fold(item->bits);
+        }
+        atom = true;
+        n++;
+    }
+    pat->item_count = n + 1; /* the end marker is already zeroed */
+    *out = pat;
+    return CI_OK;
+}
+
+/**
+ * @brief Add a position and every position reachable from it by skipping star items.
+ */
+static void ci_pattern_close(ci_pattern_set *set, uint32_t pos, uint32_t *dst, size_t *n) {
+    for (;;) {
+        if (set->stamps[pos] != set->generation) {
+            set->stamps[pos] = set->generation;
+            dst[(*n)++] = pos;
+        }
+        if (!set->items[pos].star) return;
+        pos++;
+    }
+}
+
+static int ci_pattern_cmp(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Start a new generation of the position stamps (caller holds the mutex).
+ */
+static void ci_pattern_new_generation(ci_pattern_set *set) {
+    if (++set->generation == 0) {
+        memset(set->stamps, 0, set->positions * sizeof(*set->stamps));
+        set->generation = 1;
+    }
+}
+
+/**
+ * @brief Positions reachable from a set of positions by one byte (caller holds the mutex).
+ * @return Number of positions written to dst, sorted.
+ */
+static size_t ci_pattern_step(ci_pattern_set *set, const uint32_t *src, size_t count, unsigned char c,
+                              uint32_t *dst) {
+    ci_pattern_new_generation(set);
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        const ci_pattern_item *item = &set->items[src[i]];
+        if (!ci_class_has(item->bits, c)) continue;
+        ci_pattern_close(set, item->star ? src[i] : src[i] + 1, dst, &n);
+    }
+    qsort(dst, n, sizeof(*dst), ci_pattern_cmp);
+    return n;
+}
+
+/**
+ * @brief Pattern index + 1 of the winning end position in a sorted set, or 0.
+ */
+static uint32_t ci_pattern_accept(const ci_pattern_set *set, const uint32_t *positions, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (set->ends[positions[i]]) return set->ends[positions[i]];
+    }
+    return 0;
+}
+
+static inline ci_dfa_state *ci_dfa_at(const ci_pattern_set *set, uint32_t id) {
+    return &set->chunks[id / CI_DFA_CHUNK][id % CI_DFA_CHUNK];
+}
+
+/**
+ * @brief Find or create the DFA state for a sorted set of positions (caller holds the mutex).
+ * @return State id, or CI_DFA_FULL when no more states can be created.
+ */
+static int32_t ci_dfa_state_for(ci_pattern_set *set, const uint32_t *positions, size_t count) {
+    uint64_t hash = ci_hash_bytes((const char *)positions, count * sizeof(*positions));
+    size_t mask = sizeof(set->index) / sizeof(set->index[0]) - 1;
+    size_t i = (size_t)hash & mask;
+    for (; set->index[i]; i = (i + 1) & mask) {
+        const ci_dfa_state *st = ci_dfa_at(set, set->index[i] - 1);
+        if (st->hash == hash && st->count == count &&
+            memcmp(st->positions, positions, count * sizeof(*positions)) == 0) {
+            return (int32_t)(set->index[i] - 1);
+        }
+    }
+    if (set->states == CI_DFA_MAX_STATES) return CI_DFA_FULL;
+
+    size_t id = set->states;
+    if (id % CI_DFA_CHUNK == 0 && !set->chunks[id / CI_DFA_CHUNK]) {
+        set->chunks[id / CI_DFA_CHUNK] = malloc(CI_DFA_CHUNK * sizeof(ci_dfa_state));
+        if (!set->chunks[id / CI_DFA_CHUNK]) return CI_DFA_FULL;
+    }
+    ci_dfa_state *st = ci_dfa_at(set, (uint32_t)id);
+    st->positions = malloc((count ? count : 1) * sizeof(*positions));
+    if (!st->positions) return CI_DFA_FULL;
+    memcpy(st->positions, positions, count * sizeof(*positions));
+    st->count = (uint32_t)count;
+    st->hash = hash;
+    st->accept = ci_pattern_accept(set, positions, count);
+    for (int c = 0; c < 256; c++) st->next[c] = CI_DFA_UNKNOWN;
+    set->states++;
+    set->index[i] = (uint32_t)id + 1;
+    return (int32_t)id;
+}
+
+ci_pattern_set *ci_pattern_set_build(ci_pattern *const *patterns, size_t count) {
+    ci_pattern_set *set = calloc(1, sizeof(*set));
+    if (!set) return NULL;
+    for (size_t i = 0; i < count; i++) set->positions += patterns[i]->item_count;
+    set->count = count;
+    set->patterns = malloc(count * sizeof(*set->patterns));
+    set->items = malloc(set->positions * sizeof(*set->items));
+    set->ends = calloc(set->positions, sizeof(*set->ends));
+    set->stamps = calloc(set->positions, sizeof(*set->stamps));
+    set->scratch[0] = malloc(set->positions * sizeof(uint32_t));
+    set->scratch[1] = malloc(set->positions * sizeof(uint32_t));
+    pthread_mutex_init(&set->mutex, NULL);
+    if (!set->patterns || !set->items || !set->ends || !set->stamps || !set->scratch[0] || !set->scratch[1] ||
+        set->positions >= UINT32_MAX) {
+        ci_pattern_set_free(set);
+        return NULL;
+    }
+    memcpy(set->patterns, patterns, count * sizeof(*patterns));
+
+    /* the start state holds the first positions of every pattern */
+    size_t pos = 0, n = 0;
+    ci_pattern_new_generation(set);
+    for (size_t i = 0; i < count; i++) {
+        memcpy(set->items + pos, patterns[i]->items, patterns[i]->item_count * sizeof(*set->items));
+        set->ends[pos + patterns[i]->item_count - 1] = (uint32_t)i + 1;
+        ci_pattern_close(set, (uint32_t)pos, set->scratch[0], &n);
+        pos += patterns[i]->item_count;
+    }
+    if (ci_dfa_state_for(set, set->scratch[0], n) != 0) {
+        ci_pattern_set_free(set);
+        return NULL;
+    }
+    return set;
+}
+
+void ci_pattern_set_free(ci_pattern_set *set) {
+    if (!set) return;
+    for (size_t id = 0; id < set->states; id++) free(ci_dfa_at(set, (uint32_t)id)->positions);
+    for (size_t c = 0; c < CI_DFA_MAX_STATES / CI_DFA_CHUNK; c++) free(set->chunks[c]);
+    pthread_mutex_destroy(&set->mutex);
+    free(set->patterns);
+    free(set->items);
+    free(set->ends);
+    free(set->stamps);
+    free(set->scratch[0]);
+    free(set->scratch[1]);
+    free(set);
+}
+
+ci_pattern *const *ci_pattern_set_list(const ci_pattern_set *set, size_t *count) {
+    *count = set ? set->count : 0;
+    return set ? set->patterns : NULL;
+}
+
+/**
+ * @brief Compute and cache one transition.
+ * @return Next state id, CI_DFA_DEAD, or CI_DFA_FULL.
+ */
+static int32_t ci_dfa_fill(ci_pattern_set *set, uint32_t id, unsigned char c) {
+    pthread_mutex_lock(&set->mutex);
+    ci_dfa_state *st = ci_dfa_at(set, id);
+    int32_t next = st->next[c]; /* another thread may have filled it meanwhile */
+    if (next == CI_DFA_UNKNOWN) {
+        size_t n = ci_pattern_step(set, st->positions, st->count, c, set->scratch[0]);
+        next = n == 0 ? CI_DFA_DEAD : ci_dfa_state_for(set, set->scratch[0], n);
+        /* readers find the new state's chunk through this store */
+        if (next != CI_DFA_FULL) __atomic_store_n(&st->next[c], next, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&set->mutex);
+    return next;
+}
+
+/**
+ * @brief Finish a match from a state without caching, once the DFA is full.
+ */
+static ci_pattern *ci_pattern_slow(ci_pattern_set *set, uint32_t id, const char *line, size_t len) {
+    pthread_mutex_lock(&set->mutex);
+    const ci_dfa_state *st = ci_dfa_at(set, id);
+    uint32_t *cur = set->scratch[1], *next = set->scratch[0];
+    size_t n = st->count;
+    memcpy(cur, st->positions, n * sizeof(*cur));
+    for (size_t i = 0; i < len && n > 0; i++) {
+        n = ci_pattern_step(set, cur, n, (unsigned char)line[i], next);
+        uint32_t *t = cur;
+        cur = next;
+        next = t;
+    }
+    uint32_t accept = ci_pattern_accept(set, cur, n);
+    pthread_mutex_unlock(&set->mutex);
+    return accept ? set->patterns[accept - 1] : NULL;
+}
+
+ci_pattern *ci_pattern_set_match(ci_pattern_set *set, const char *line, size_t len) {
+    if (!set) return NULL;
+    uint32_t id = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)line[i];
+        int32_t next = __atomic_load_n(&ci_dfa_at(set, id)->next[c], __ATOMIC_ACQUIRE);
+        if (next == CI_DFA_UNKNOWN) next = ci_dfa_fill(set, id, c);
+        if (next == CI_DFA_DEAD) return NULL;
+        if (next == CI_DFA_FULL) return ci_pattern_slow(set, id, line + i, len - i);
+        id = (uint32_t)next;
+    }
+    uint32_t accept = ci_dfa_at(set, id)->accept;
+    return accept ? set->patterns[accept - 1] : NULL;
+}
@@ -0,0 +1,131 @@
+#include "ci_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CI_PHASH_KEYS_PER_BUCKET 4
+#define CI_PHASH_SEEDS 4096
+
+/*
+ * Hash and displace: keys are split into small buckets by the high half of
+ * their hash, and each bucket gets a displacement that XORs the low half of its
+ * keys' hashes into free slots. Buckets are placed largest first, while most
+ * slots are still free. With twice as many slots as keys a seed rarely fails;
+ * when one does (two keys of a bucket share their low bits), the next is tried.
+ */
+
+/**
+ * @brief Smallest power of two that is at least n (and at least 1).
+ */
+static size_t ci_phash_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+/**
+ * @brief Place every bucket for one seed.
+ * @param hashes Hash of each key under the seed.
+ * @param members Key indexes grouped by bucket.
+ * @param first For each bucket, its first position in members; first[buckets] is the key count.
+ * @param order Bucket ids, largest bucket first.
+ * @param ph Table with seed and masks set; displace and slots are filled in.
+ * @return false if some bucket can't be placed.
+ */
+static bool ci_phash_place(const uint64_t *hashes, const size_t *members, const size_t *first, const size_t *order,
+                           ci_phash *ph) {
+    size_t buckets = ph->bucket_mask + 1;
+    memset(ph->slots, 0, (ph->slot_mask + 1) * sizeof(*ph->slots));
+    memset(ph->displace, 0, buckets * sizeof(*ph->displace));
+
+    for (size_t o = 0; o < buckets; o++) {
+        size_t bucket = order[o];
+        const size_t *keys = members + first[bucket];
+        size_t n = first[bucket + 1] - first[bucket];
+        if (n == 0) break;
+
+        /* d * odd takes every value of the slot mask once as d runs over the slot count */
+        size_t k = 0;
+        for (uint32_t d = 0; d <= ph->slot_mask; d++) {
+            ph->displace[bucket] = d;
+            for (k = 0; k < n; k++) {
+                size_t s = ci_phash_slot(hashes[keys[k]], ph->displace, ph->bucket_mask, ph->slot_mask);
+                if (ph->slots[s]) break;
+                ph->slots[s] = (uint32_t)keys[k] + 1;
+            }
+            if (k == n) break;
+            while (k-- > 0) {
+                ph->slots[ci_phash_slot(hashes[keys[k]], ph->displace, ph->bucket_mask, ph->slot_mask)] = 0;
+            }
+        }
+        if (k != n) return false;
+    }
+    return true;
+}
+
+bool ci_phash_build(const char *const *names, const size_t *lens, size_t count, ci_phash *out) {
+    memset(out, 0, sizeof(*out));
+    if (count >= UINT32_MAX) return false;
+    out->slot_mask = ci_phash_pow2(count * 2) - 1;
+    out->bucket_mask = ci_phash_pow2((count + CI_PHASH_KEYS_PER_BUCKET - 1) / CI_PHASH_KEYS_PER_BUCKET) - 1;
+    size_t buckets = out->bucket_mask + 1;
+
+    out->slots = malloc((out->slot_mask + 1) * sizeof(*out->slots));
+    out->displace = malloc(buckets * sizeof(*out->displace));
+    uint64_t *hashes = malloc((count + 1) * sizeof(*hashes));
+    size_t *members = malloc((count + 1) * sizeof(*members));
+    size_t *first = malloc((buckets + 1) * sizeof(*first));
+    size_t *order = malloc(buckets * sizeof(*order));
+    size_t *by_size = malloc((count + 2) * sizeof(*by_size));
+    bool ok = out->slots && out->displace && hashes && members && first && order && by_size;
+
+    /* duplicates would collide under every seed */
+    for (size_t i = 0; ok && i < count; i++) hashes[i] = ci_hash_bytes(names[i], lens[i]);
+    for (size_t i = 0; ok && i < count; i++) {
+        for (size_t j = i + 1; j < count; j++) {
+            if (hashes[i] == hashes[j] && lens[i] == lens[j] && memcmp(names[i], names[j], lens[i]) == 0) ok = false;
+        }
+    }
+
+    bool found = false;
+    for (uint64_t seed = 1; ok && !found && seed <= CI_PHASH_SEEDS; seed++) {
+        /* group keys by bucket (counting sort on the bucket id) */
+        memset(first, 0, (buckets + 1) * sizeof(*first));
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = ci_hash_seeded(names[i], lens[i], seed);
+            first[((size_t)(hashes[i] >> 32) & out->bucket_mask) + 1]++;
+        }
+        for (size_t b = 0; b < buckets; b++) first[b + 1] += first[b];
+        for (size_t i = 0; i < count; i++) {
+            size_t b = (size_t)(hashes[i] >> 32) & out->bucket_mask;
+            /* first[b] advances while filling; restored below */
+            members[first[b]++] = i;
+        }
+        for (size_t b = buckets; b > 0; b--) first[b] = first[b - 1];
+        first[0] = 0;
+
+        /* then order buckets largest first (counting sort on the size) */
+        memset(by_size, 0, (count + 2) * sizeof(*by_size));
+        for (size_t b = 0; b < buckets; b++) by_size[count - (first[b + 1] - first[b]) + 1]++;
+        for (size_t n = 0; n <= count; n++) by_size[n + 1] += by_size[n];
+        for (size_t b = 0; b < buckets; b++) order[by_size[count - (first[b + 1] - first[b])]++] = b;
+
+        out->seed = seed;
+        found = ci_phash_place(hashes, members, first, order, out);
+    }
+
+    free(hashes);
+    free(members);
+    free(first);
+    free(order);
+    free(by_size);
+    if (!found) ci_phash_free(out);
+    return found;
+}
+
+void ci_phash_free(ci_phash *ph) {
+    free(ph->displace);
+    free(ph->slots);
+    ph->displace = NULL;
+    ph->slots = NULL;
+}
@@ -0,0 +1,449 @@
+#include "ci_internal.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CI_POOL_DEFAULT_CAPACITY 1024
+#define CI_POOL_SPIN 64
+#define CI_POOL_IDLE_NS 10000000L
+#define CI_POOL_HOLD 64 /* lines held for full lanes before the submitter waits */
+
+typedef struct {
+    size_t len;
+    uint64_t read_ns; /* for the read-to-dispatch latency; 0 if not measured */
+    char line[];
+} ci_line_item;
+
+typedef struct {
+    ci_pool *pool;
+    unsigned index;
+} ci_pool_worker;
+
+/**
+ * @brief Run the command or default callback for one queued line.
+ * @param pool Pool the line was queued on.
+ * @param line NUL-terminated line.
+ * @param len Line length.
+ * @param read_ns When the line was read (0 if unknown).
+ */
+static void ci_pool_run(ci_pool *pool, const char *line, size_t len, uint64_t read_ns) {
+    ci_stats_shard *shard = ci_stats_shard_for(pool->stats);
+    if (shard) ci_stats_line(shard, len, read_ns);
+    if (!ci_registry_dispatch(pool->reg, line, len, shard)) {
+        if (pool->view_cb) {
+            pool->view_cb(line, len, pool->cb_data);
+        } else if (pool->cb) {
+            pool->cb(line, pool->cb_data);
+        }
+        if (shard) ci_stats_callback(shard, false);
+    }
+}
+
+/**
+ * @brief Dispatch one queued entry, then free it (or release it back to the arena).
+ * @param pool Pool the line was queued on.
+ * @param item ci_line_item, or an arena line when pool->arena is set.
+ */
+static void ci_pool_dispatch(ci_pool *pool, void *item) {
+    if (pool->arena) {
+        char *line = item;
+        ci_pool_run(pool, line, ci_arena_line_len(line), 0);
+        ci_line_release(line);
+    } else {
+        ci_line_item *copy = item;
+        ci_pool_run(pool, copy->line, copy->len, copy->read_ns);
+        free(copy);
+    }
+}
+
+/**
+ * @brief Drop an entry that was never dispatched.
+ */
+static void ci_pool_discard(ci_pool *pool, void *item) {
+    if (pool->arena) {
+        ci_line_release(item);
+    } else {
+        free(item);
+    }
+}
+
+/**
+ * @brief Signal the submitting thread after freeing a slot, if it holds lines for a full lane.
+ * @param pool Pool a line was popped from.
+ */
+static void ci_pool_notify(ci_pool *pool) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int wanted = 1;
+    if (ci_atomic_load(&pool->wanted) && ci_atomic_cas(&pool->wanted, &wanted, 0)) ci_wake_signal(pool->wake);
+}
+
+/**
+ * @brief Pop the next line for a worker: priority lines first; worker 0 owns the serial queue.
+ * @param pool Pool to pop from.
+ * @param index Worker index.
+ * @param out Output for the popped entry.
+ * @return true if a line was popped.
+ */
+static bool ci_pool_next(ci_pool *pool, unsigned index, void **out) {
+    void *item;
+    if (ci_queue_pop(&pool->priority, &item)) {
+        *out = item;
+        return true;
+    }
+    if (index == 0 && ci_queue_pop(&pool->serial, &item)) {
+        ci_pool_notify(pool);
+        *out = item;
+        return true;
+    }
+    if (ci_queue_pop(&pool->shared, &item)) {
+        ci_pool_notify(pool);
+        *out = item;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Check whether a worker has anything to pop.
+ * @param pool Pool to check.
+ * @param index Worker index.
+ * @return true if a queue the worker consumes is non-empty.
+ */
+static bool ci_pool_has_work(ci_pool *pool, unsigned index) {
+    return !ci_queue_empty(&pool->priority) || !ci_queue_empty(&pool->shared) ||
+           (index == 0 && !ci_queue_empty(&pool->serial));
+}
+
+/**
+ * @brief Worker routine: dispatch queued lines, sleep when idle, exit once closed and drained.
+ * @param arg ci_pool_worker describing this worker.
+ * @return NULL when the worker exits.
+ */
+static void *ci_pool_thread(void *arg) {
+    ci_pool_worker *worker = arg;
+    ci_pool *pool = worker->pool;
+    unsigned index = worker->index;
+
+    for (;;) {
+        void *item;
+        if (ci_pool_next(pool, index, &item)) {
+            ci_pool_dispatch(pool, item);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        ci_atomic_add(&pool->sleepers, 1);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        bool closing = ci_atomic_load(&pool->closing);
+        if (!ci_pool_has_work(pool, index)) {
+            if (closing) {
+                ci_atomic_sub(&pool->sleepers, 1);
+                pthread_mutex_unlock(&pool->mutex);
+                break;
+            }
+            /* timed so a missed signal costs at most one idle period */
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += CI_POOL_IDLE_NS;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&pool->cond, &pool->mutex, &deadline);
+        }
+        ci_atomic_sub(&pool->sleepers, 1);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    ci_stats_detach(pool->stats);
+    return NULL;
+}
+
+/**
+ * @brief Wake sleeping workers after a push.
+ * @param pool Pool to wake.
+ * @param all Wake every worker (needed when only worker 0 may take the line).
+ */
+static void ci_pool_wake(ci_pool *pool, bool all) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (ci_atomic_load(&pool->sleepers) == 0) return;
+    pthread_mutex_lock(&pool->mutex);
+    if (all) {
+        pthread_cond_broadcast(&pool->cond);
+    } else {
+        pthread_cond_signal(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+bool ci_pool_start(ci_pool *pool, unsigned workers, size_t capacity, ci_registry *reg,
+                   ci_line_callback callback, ci_view_callback view_callback, void *user_data, ci_arena *arena,
+                   ci_stats_set *stats, ci_overload_policy policy, ci_ingest_stats *counters, ci_wake *wake) {
+    if (workers == 0) return false;
+    if (capacity == 0) capacity = CI_POOL_DEFAULT_CAPACITY;
+
+    memset(pool, 0, sizeof(*pool));
+    pool->reg = reg;
+    pool->cb = callback;
+    pool->view_cb = view_callback;
+    pool->arena = arena;
+    pool->stats = stats;
+    pool->cb_data = user_data;
+    pool->policy = policy;
+    pool->counters = counters;
+    pool->wake = wake;
+
+    if (!ci_queue_init(&pool->shared, capacity) || !ci_queue_init(&pool->serial, capacity) ||
+        !ci_queue_init(&pool->priority, capacity)) {
+        ci_pool_shutdown(pool);
+        return false;
+    }
+    memset(counters, 0, sizeof(*counters));
+    counters->capacity = pool->shared.mask + 1;
+    if (policy == CI_OVERLOAD_COALESCE) {
+        pool->recent = calloc(2 * (pool->shared.mask + 1), sizeof(*pool->recent));
+        if (!pool->recent) {
+            ci_pool_shutdown(pool);
+            return false;
+        }
+    }
+    /* the policies that wait for room hold lines instead, when the submitter can be woken */
+    if (wake && (policy == CI_OVERLOAD_BLOCK || policy == CI_OVERLOAD_COALESCE)) {
+        pool->held_mask = (pool->shared.mask < CI_POOL_HOLD ? pool->shared.mask + 1 : CI_POOL_HOLD) - 1;
+        pool->held = calloc(pool->held_mask + 1, sizeof(*pool->held));
+        if (!pool->held) {
+            ci_pool_shutdown(pool);
+            return false;
+        }
+    }
+    pool->threads = calloc(workers, sizeof(*pool->threads));
+    pool->workers = calloc(workers, sizeof(ci_pool_worker));
+    if (!pool->threads || !pool->workers) {
+        ci_pool_shutdown(pool);
+        return false;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    pool->sync_ready = true;
+
+    ci_pool_worker *args = pool->workers;
+    for (unsigned i = 0; i < workers; i++) {
+        args[i].pool = pool;
+        args[i].index = i;
+        if (pthread_create(&pool->threads[i], NULL, ci_pool_thread, &args[i]) != 0) {
+            ci_pool_shutdown(pool);
+            return false;
+        }
+        pool->count++;
+    }
+    return true;
+}
+
+/**
+ * @brief Wait for a worker to free a slot, then push.
+ * @param pool Pool owning the queue.
+ * @param queue Full lane.
+ * @param item Entry to push.
+ * @param all Wake every worker (only worker 0 may take the line).
+ */
+static void ci_pool_push_wait(ci_pool *pool, ci_queue *queue, void *item, bool all) {
+    for (unsigned spins = 0; !ci_queue_push(queue, item); spins++) {
+        ci_pool_wake(pool, all);
+        if (spins < CI_POOL_SPIN) {
+            sched_yield();
+        } else {
+            struct timespec ts = {0, 50000};
+            nanosleep(&ts, NULL);
+        }
+    }
+}
+
+/**
+ * @brief Queue held lines, oldest first.
+ * @param pool Pool holding the lines.
+ * @param wait Wait for room until every held line is queued, instead of stopping at a full lane.
+ * @return true if lines are still held.
+ */
+static bool ci_pool_release(ci_pool *pool, bool wait) {
+    while (pool->held_count > 0) {
+        ci_pool_held *held = &pool->held[pool->held_head];
+        ci_queue *queue = held->serial ? &pool->serial : &pool->shared;
+        if (!ci_queue_push(queue, held->item)) {
+            if (!wait) return true;
+            ci_pool_push_wait(pool, queue, held->item, held->serial);
+        }
+        ci_pool_wake(pool, held->serial);
+        pool->held_lane[held->serial]--;
+        pool->held_head = (pool->held_head + 1) & pool->held_mask;
+        pool->held_count--;
+    }
+    return false;
+}
+
+bool ci_pool_flush(ci_pool *pool) {
+    if (!ci_pool_release(pool, false)) return false;
+    ci_atomic_store(&pool->wanted, 1);
+    /* a slot freed before the request was made is not signalled */
+    if (ci_pool_release(pool, false)) return true;
+    ci_atomic_store(&pool->wanted, 0);
+    return false;
+}
+
+/**
+ * @brief Hold a line for its full lane, so the submitter can go on reading.
+ * @param pool Pool to hold the line in.
+ * @param item Entry to queue later.
+ * @param serial The line goes to the serial lane.
+ * @note Once the hold is full, waits until every held line is queued.
+ */
+static void ci_pool_hold(ci_pool *pool, void *item, bool serial) {
+    if (pool->held_count == pool->held_mask + 1) ci_pool_release(pool, true);
+    ci_pool_held *slot = &pool->held[(pool->held_head + pool->held_count) & pool->held_mask];
+    slot->item = item;
+    slot->serial = serial;
+    pool->held_lane[serial]++;
+    pool->held_count++;
+}
+
+/**
+ * @brief Handle a full lane according to the pool's overload policy.
+ * @param pool Pool owning the queue.
+ * @param queue Full lane (shared or serial).
+ * @param item Entry to push.
+ * @param recent The lane's coalescing slot for this line (COALESCE only).
+ * @param hash Hash of the line (COALESCE only).
+ * @param len Line length.
+ * @return true if the entry was queued or held, false if it was discarded.
+ */
+static bool ci_pool_overload(ci_pool *pool, ci_queue *queue, void *item, const ci_pool_recent *recent,
+                             uint64_t hash, size_t len) {
+    void *oldest;
+    switch (pool->policy) {
+    case CI_OVERLOAD_DROP_OLDEST:
+        do {
+            /* a worker may empty the lane meanwhile; then the push simply succeeds */
+            if (ci_queue_pop(queue, &oldest)) {
+                ci_pool_discard(pool, oldest);
+                ci_stats_count(&pool->counters->dropped_oldest, 1);
+            }
+        } while (!ci_queue_push(queue, item));
+        return true;
+    case CI_OVERLOAD_DROP_NEWEST:
+        ci_pool_discard(pool, item);
+        ci_stats_count(&pool->counters->dropped_newest, 1);
+        return false;
+    case CI_OVERLOAD_COALESCE:
+        if (recent->pos && recent->hash == hash && recent->len == len && recent->pos > ci_queue_popped(queue)) {
+            ci_pool_discard(pool, item);
+            ci_stats_count(&pool->counters->coalesced, 1);
+            return false;
+        }
+        break;
+    case CI_OVERLOAD_BLOCK:
+        break;
+    }
+    ci_stats_count(&pool->counters->blocked, 1);
+    if (pool->held) {
+        ci_pool_hold(pool, item, queue == &pool->serial);
+    } else {
+        ci_pool_push_wait(pool, queue, item, queue == &pool->serial);
+    }
+    return true;
+}
+
+bool ci_pool_submit(ci_pool *pool, const char *line, size_t len, unsigned flags, uint64_t read_ns) {
+    void *item;
+    if (pool->arena) {
+        item = ci_arena_copy(pool->arena, line, len);
+    } else {
+        ci_line_item *copy = malloc(sizeof(*copy) + len + 1);
+        if (copy) {
+            copy->len = len;
+            copy->read_ns = read_ns;
+            memcpy(copy->line, line, len);
+            copy->line[len] = '\0';
+        }
+        item = copy;
+    }
+    if (!item) {
+        ci_stats_count(&pool->counters->dropped_nomem, 1);
+        return false;
+    }
+    bool serial = false;
+    ci_queue *queue = &pool->shared;
+    if (flags & CI_CMD_PRIORITY) {
+        queue = &pool->priority;
+        ci_stats_count(&pool->counters->priority, 1);
+    } else if (flags & CI_CMD_SERIAL) {
+        queue = &pool->serial;
+        serial = true;
+    }
+
+    ci_pool_recent *recent = NULL;
+    uint64_t hash = 0;
+    size_t pos = 0;
+    if (pool->recent && queue != &pool->priority) {
+        hash = ci_hash_bytes(line, len);
+        recent = &pool->recent[(serial ? pool->shared.mask + 1 : 0) + (hash & pool->shared.mask)];
+        /* the only producer, so the line takes that position once the held ones are queued */
+        pos = ci_queue_pushed(queue) + (pool->held ? pool->held_lane[serial] : 0);
+    }
+
+    /* other lines queue behind held ones; priority lines overtake them */
+    bool behind = queue != &pool->priority && ci_pool_release(pool, false);
+    if (behind || !ci_queue_push(queue, item)) {
+        /* the priority lane is never dropped: it waits like CI_OVERLOAD_BLOCK */
+        if (queue == &pool->priority) {
+            ci_stats_count(&pool->counters->blocked, 1);
+            ci_pool_push_wait(pool, queue, item, false);
+        } else if (!ci_pool_overload(pool, queue, item, recent, hash, len)) {
+            return false;
+        }
+    }
+    if (recent) {
+        recent->hash = hash;
+        recent->len = len;
+        recent->pos = pos + 1;
+    }
+    ci_stats_count(&pool->counters->queued, 1);
+    ci_pool_wake(pool, serial);
+    return true;
+}
+
+void ci_pool_shutdown(ci_pool *pool) {
+    /* held lines are queued before the workers are told to finish */
+    if (pool->count > 0) ci_pool_release(pool, true);
+    if (pool->sync_ready) {
+        pthread_mutex_lock(&pool->mutex);
+        ci_atomic_store(&pool->closing, true);
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    for (unsigned i = 0; i < pool->count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    /* workers drain before exiting; anything left means none were started */
+    void *item;
+    while (pool->shared.cells && ci_queue_pop(&pool->shared, &item)) ci_pool_discard(pool, item);
+    while (pool->serial.cells && ci_queue_pop(&pool->serial, &item)) ci_pool_discard(pool, item);
+    while (pool->priority.cells && ci_queue_pop(&pool->priority, &item)) ci_pool_discard(pool, item);
+    for (; pool->held_count > 0; pool->held_count--) {
+        ci_pool_discard(pool, pool->held[pool->held_head].item);
+        pool->held_head = (pool->held_head + 1) & pool->held_mask;
+    }
+
+    if (pool->sync_ready) {
+        pthread_cond_destroy(&pool->cond);
+        pthread_mutex_destroy(&pool->mutex);
+    }
+    ci_queue_destroy(&pool->shared);
+    ci_queue_destroy(&pool->serial);
+    ci_queue_destroy(&pool->priority);
+    free(pool->recent);
+    free(pool->held);
+    free(pool->threads);
+    free(pool->workers);
+    memset(pool, 0, sizeof(*pool));
+}
@@ -0,0 +1,84 @@
+#include "ci_internal.h"
+
+#include <stdlib.h>
+
+/*
+ * Bounded multi-producer/multi-consumer ring (Vyukov). Each cell carries a
+ * sequence number: seq == pos means free for the producer claiming pos,
+ * seq == pos + 1 means filled and ready for the consumer claiming pos.
+ */
+
+bool ci_queue_init(ci_queue *queue, size_t capacity) {
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+
+    queue->cells = malloc(cap * sizeof(*queue->cells));
+    if (!queue->cells) return false;
+    for (size_t i = 0; i < cap; i++) {
+        queue->cells[i].seq = i;
+        queue->cells[i].item = NULL;
+    }
+    queue->mask = cap - 1;
+    queue->head = 0;
+    queue->tail = 0;
+    return true;
+}
+
+void ci_queue_destroy(ci_queue *queue) {
+    free(queue->cells);
+    queue->cells = NULL;
+}
+
+bool ci_queue_push(ci_queue *queue, void *item) {
+    size_t pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    for (;;) {
+        ci_queue_cell *cell = &queue->cells[pos & queue->mask];
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->head, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                cell->item = item;
+                __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; /* full */
+        } else {
+            pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+bool ci_queue_pop(ci_queue *queue, void **item) {
+    size_t pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    for (;;) {
+        ci_queue_cell *cell = &queue->cells[pos & queue->mask];
+        size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->tail, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                *item = cell->item;
+                __atomic_store_n(&cell->seq, pos + queue->mask + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false; /* empty */
+        } else {
+            pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+bool ci_queue_empty(ci_queue *queue) {
+    return __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST) == __atomic_load_n(&queue->head, __ATOMIC_SEQ_CST);
+}
+
+size_t ci_queue_popped(ci_queue *queue) {
+    return __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+}
+
+size_t ci_queue_pushed(ci_queue *queue) {
+    return __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+}
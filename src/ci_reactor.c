@@ -0,0 +1,371 @@
+#include "ci_internal.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
+
+#define CI_REACTOR_EVENTS 64
+#define CI_REACTOR_MIN_MEMBERS 8
+
+/*
+ * Each shard is one thread waiting on its own epoll set (poll(2) elsewhere) plus a
+ * self-pipe for wakeups. Every round services each ready context with a single
+ * read, so a busy stream can't starve the others and per-stream memory stays at
+ * one reader buffer. Only the shard thread removes members; other threads ask it
+ * to through the wake pipe.
+ */
+struct ci_reactor_shard {
+    pthread_t thread;
+    bool started;
+    ci_wake wake;
+#if defined(__linux__)
+    int epfd;
+#else
+    struct pollfd *pfds;
+    ci_context **polled;
+    size_t pfd_cap;
+#endif
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    ci_context **members;
+    size_t count;
+    size_t cap;
+    size_t always;
+    bool closing; /* ci_atomic_load/store */
+};
+
+struct ci_reactor {
+    ci_reactor_shard *shards;
+    unsigned count;
+    unsigned next;
+};
+
+/**
+ * @brief Drop a member from a shard; only the shard thread calls this.
+ * @param shard Shard owning the context.
+ * @param ctx Context to detach.
+ */
+static void ci_reactor_detach(ci_reactor_shard *shard, ci_context *ctx) {
+    pthread_mutex_lock(&shard->mutex);
+    for (size_t i = 0; i < shard->count; i++) {
+        if (shard->members[i] != ctx) continue;
+        shard->members[i] = shard->members[--shard->count];
+        if (ctx->always_ready) {
+            shard->always--;
+        } else {
+#if defined(__linux__)
+            epoll_ctl(shard->epfd, EPOLL_CTL_DEL, ctx->reader->fd, NULL);
+#endif
+        }
+        ctx->always_ready = false;
+        ci_atomic_store(&ctx->shard, (ci_reactor_shard *)NULL);
+        pthread_cond_broadcast(&shard->cond);
+        break;
+    }
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+/**
+ * @brief Give one context its turn: one read, then dispatch every complete line.
+ * @param shard Shard serving the context.
+ * @param ctx Context reported ready (or always ready).
+ * @return true if the context was detached (end of input, stop or error).
+ */
+static bool ci_reactor_service(ci_reactor_shard *shard, ci_context *ctx) {
+    if (ci_context_pump(ctx, 1, true) == CI_OK) return false;
+    ci_reactor_detach(shard, ctx);
+    return true;
+}
+
+/**
+ * @brief Service members matching a filter, tolerating removals done by the services themselves.
+ * @param shard Shard to walk.
+ * @param stopping Visit members with a pending stop request instead of always-ready ones.
+ */
+static void ci_reactor_sweep(ci_reactor_shard *shard, bool stopping) {
+    pthread_mutex_lock(&shard->mutex);
+    size_t i = 0;
+    while (i < shard->count) {
+        ci_context *ctx = shard->members[i];
+        bool visit = stopping ? ci_atomic_load(&ctx->stop_requested) || ci_atomic_load(&shard->closing)
+                              : ctx->always_ready;
+        if (!visit) {
+            i++;
+            continue;
+        }
+        pthread_mutex_unlock(&shard->mutex);
+        if (stopping) ci_context_request_stop(ctx);
+        bool detached = ci_reactor_service(shard, ctx);
+        pthread_mutex_lock(&shard->mutex);
+        /* a detach swapped the last member into slot i */
+        if (!detached) i++;
+    }
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+#if defined(__linux__)
+
+/**
+ * @brief Wait for readiness and service every ready context once.
+ * @param shard Shard to run.
+ * @param timeout_ms poll-style timeout (-1 blocks, 0 returns immediately).
+ * @return true if the wake pipe fired.
+ */
+static bool ci_reactor_wait(ci_reactor_shard *shard, int timeout_ms) {
+    struct epoll_event events[CI_REACTOR_EVENTS];
+    int n = epoll_wait(shard->epfd, events, CI_REACTOR_EVENTS, timeout_ms);
+    bool woken = false;
+
+    for (int i = 0; i < n; i++) {
+        ci_context *ctx = events[i].data.ptr;
+        if (!ctx) {
+            ci_wake_drain(&shard->wake);
+            woken = true;
+            continue;
+        }
+        ci_reactor_service(shard, ctx);
+    }
+    return woken;
+}
+
+/**
+ * @brief Start watching a member's descriptor.
+ * @param shard Shard to watch on.
+ * @param ctx Context to watch.
+ * @return 0 on success, 1 if it can't be watched but is always readable, -1 on error.
+ */
+static int ci_reactor_watch(ci_reactor_shard *shard, ci_context *ctx) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = ctx;
+    if (epoll_ctl(shard->epfd, EPOLL_CTL_ADD, ctx->reader->fd, &ev) == 0) return 0;
+    /* epoll rejects regular files; they never block, so poll them every round instead */
+    return errno == EPERM ? 1 : -1;
+}
+
+/**
+ * @brief Create the shard's readiness set and register the wake pipe in it.
+ * @param shard Shard to set up.
+ * @return true on success.
+ */
+static bool ci_reactor_backend_init(ci_reactor_shard *shard) {
+    shard->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (shard->epfd < 0) return false;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    return epoll_ctl(shard->epfd, EPOLL_CTL_ADD, shard->wake.fds[0], &ev) == 0;
+}
+
+/**
+ * @brief Release the shard's readiness set.
+ * @param shard Shard to tear down.
+ */
+static void ci_reactor_backend_destroy(ci_reactor_shard *shard) {
+    if (shard->epfd >= 0) close(shard->epfd);
+}
+
+#else
+
+static bool ci_reactor_wait(ci_reactor_shard *shard, int timeout_ms) {
+    /* snapshot the watched members; only this thread removes them, so the pointers stay valid */
+    pthread_mutex_lock(&shard->mutex);
+    if (shard->pfd_cap < shard->count + 1) {
+        size_t cap = shard->cap + 1;
+        struct pollfd *pfds = realloc(shard->pfds, cap * sizeof(*pfds));
+        if (pfds) shard->pfds = pfds;
+        ci_context **polled = realloc(shard->polled, cap * sizeof(*polled));
+        if (polled) shard->polled = polled;
+        if (pfds && polled) shard->pfd_cap = cap;
+    }
+    if (shard->pfd_cap == 0) {
+        pthread_mutex_unlock(&shard->mutex);
+        return false;
+    }
+    size_t n = 0;
+    shard->pfds[n].fd = shard->wake.fds[0];
+    shard->pfds[n].events = POLLIN;
+    shard->polled[n++] = NULL;
+    for (size_t i = 0; i < shard->count && n < shard->pfd_cap; i++) {
+        if (shard->members[i]->always_ready) continue;
+        shard->pfds[n].fd = shard->members[i]->reader->fd;
+        shard->pfds[n].events = POLLIN;
+        shard->polled[n++] = shard->members[i];
+    }
+    pthread_mutex_unlock(&shard->mutex);
+
+    bool woken = false;
+    if (poll(shard->pfds, (nfds_t)n, timeout_ms) <= 0) return false;
+    for (size_t i = 0; i < n; i++) {
+        if (!shard->pfds[i].revents) continue;
+        if (!shard->polled[i]) {
+            ci_wake_drain(&shard->wake);
+            woken = true;
+            continue;
+        }
+        ci_reactor_service(shard, shard->polled[i]);
+    }
+    return woken;
+}
+
+static int ci_reactor_watch(ci_reactor_shard *shard, ci_context *ctx) {
+    (void)shard;
+    (void)ctx;
+    return 0;
+}
+
+static bool ci_reactor_backend_init(ci_reactor_shard *shard) {
+    shard->pfds = NULL;
+    shard->polled = NULL;
+    shard->pfd_cap = 0;
+    return true;
+}
+
+static void ci_reactor_backend_destroy(ci_reactor_shard *shard) {
+    free(shard->pfds);
+    free(shard->polled);
+}
+
+#endif
+
+/**
+ * @brief Shard thread: wait, service ready contexts, handle stop requests, repeat until closed.
+ * @param arg Shard to run.
+ * @return NULL when the shard is closed.
+ */
+static void *ci_reactor_thread(void *arg) {
+    ci_reactor_shard *shard = arg;
+
+    while (!ci_atomic_load(&shard->closing)) {
+        pthread_mutex_lock(&shard->mutex);
+        bool busy = shard->always > 0;
+        pthread_mutex_unlock(&shard->mutex);
+
+        bool woken = ci_reactor_wait(shard, busy ? 0 : -1);
+        if (busy) ci_reactor_sweep(shard, false);
+        if (woken) ci_reactor_sweep(shard, true);
+    }
+    /* detach whatever is left so its owner can stop or destroy it */
+    ci_reactor_sweep(shard, true);
+    return NULL;
+}
+
+ci_reactor *ci_reactor_create(unsigned threads) {
+    if (threads == 0) threads = 1;
+
+    ci_reactor *reactor = calloc(1, sizeof(*reactor));
+    if (!reactor) return NULL;
+    reactor->shards = calloc(threads, sizeof(*reactor->shards));
+    if (!reactor->shards) {
+        free(reactor);
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < threads; i++) {
+        ci_reactor_shard *shard = &reactor->shards[i];
+        ci_wake_init(&shard->wake);
+#if defined(__linux__)
+        shard->epfd = -1;
+#endif
+        pthread_mutex_init(&shard->mutex, NULL);
+        pthread_cond_init(&shard->cond, NULL);
+        reactor->count++;
+        if (!ci_wake_open(&shard->wake) || !ci_reactor_backend_init(shard) ||
+            pthread_create(&shard->thread, NULL, ci_reactor_thread, shard) != 0) {
+            ci_reactor_destroy(reactor);
+            return NULL;
+        }
+        shard->started = true;
+    }
+    return reactor;
+}
+
+void ci_reactor_destroy(ci_reactor *reactor) {
+    if (!reactor) return;
+    for (unsigned i = 0; i < reactor->count; i++) {
+        ci_reactor_shard *shard = &reactor->shards[i];
+        if (!shard->started) continue;
+        ci_atomic_store(&shard->closing, true);
+        ci_wake_signal(&shard->wake);
+        pthread_join(shard->thread, NULL);
+    }
+    for (unsigned i = 0; i < reactor->count; i++) {
+        ci_reactor_shard *shard = &reactor->shards[i];
+        ci_reactor_backend_destroy(shard);
+        ci_wake_close(&shard->wake);
+        free(shard->members);
+        pthread_cond_destroy(&shard->cond);
+        pthread_mutex_destroy(&shard->mutex);
+    }
+    free(reactor->shards);
+    free(reactor);
+}
+
+ci_status ci_reactor_add(ci_reactor *reactor, ci_context *ctx) {
+    if (!reactor || !ctx || !ctx->polling || !ctx->running || ci_atomic_load(&ctx->shard)) return CI_INVALID;
+    /* readiness comes from the descriptor, which an io_uring reader may already have drained */
+    if (ctx->reader->uring) return CI_INVALID;
+
+    unsigned index = (unsigned)(ci_atomic_add(&reactor->next, 1) - 1) % reactor->count;
+    ci_reactor_shard *shard = &reactor->shards[index];
+
+    pthread_mutex_lock(&shard->mutex);
+    if (ci_atomic_load(&shard->closing)) {
+        pthread_mutex_unlock(&shard->mutex);
+        return CI_INVALID;
+    }
+    if (shard->count == shard->cap) {
+        size_t cap = shard->cap ? shard->cap * 2 : CI_REACTOR_MIN_MEMBERS;
+        ci_context **members = realloc(shard->members, cap * sizeof(*members));
+        if (!members) {
+            pthread_mutex_unlock(&shard->mutex);
+            return CI_OVERFLOW;
+        }
+        shard->members = members;
+        shard->cap = cap;
+    }
+    ci_atomic_store(&ctx->shard, shard);
+    int watched = ci_reactor_watch(shard, ctx);
+    if (watched < 0) {
+        ci_atomic_store(&ctx->shard, (ci_reactor_shard *)NULL);
+        pthread_mutex_unlock(&shard->mutex);
+        return CI_INVALID;
+    }
+    ctx->always_ready = watched > 0;
+    if (ctx->always_ready) shard->always++;
+    shard->members[shard->count++] = ctx;
+    pthread_mutex_unlock(&shard->mutex);
+
+    /* let the shard pick up always-ready members (and rebuild its poll set without epoll) */
+    ci_wake_signal(&shard->wake);
+    return CI_OK;
+}
+
+void ci_reactor_release(ci_context *ctx) {
+    ci_reactor_shard *shard = ci_atomic_load(&ctx->shard);
+    if (!shard) return;
+
+    ci_context_request_stop(ctx);
+    /* from the shard's own callbacks, detaching happens right after the callback returns */
+    if (pthread_equal(pthread_self(), shard->thread)) return;
+
+    ci_wake_signal(&shard->wake);
+    pthread_mutex_lock(&shard->mutex);
+    while (ci_atomic_load(&ctx->shard) == shard) {
+        pthread_cond_wait(&shard->cond, &shard->mutex);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+ci_status ci_reactor_remove(ci_reactor *reactor, ci_context *ctx) {
+    if (!reactor || !ctx || !ci_atomic_load(&ctx->shard)) return CI_INVALID;
+    ci_reactor_release(ctx);
+    return CI_OK;
+}
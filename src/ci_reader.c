@@ -0,0 +1,278 @@
+#include "ci_internal.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CI_MAX_READERS 16
+
+typedef struct {
+    int fd;
+    ci_reader *reader;
+} ci_reader_slot;
+
+static ci_reader_slot ci_readers[CI_MAX_READERS];
+static size_t ci_reader_count = 0;
+static pthread_mutex_t ci_reader_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define CI_POLL_INPUT 1
+#define CI_POLL_WAKE 2
+
+/**
+ * @brief Wait for input or a wakeup.
+ * @param reader Reader to wait on.
+ * @param timeout_ms Milliseconds to wait; -1 blocks.
+ * @return CI_POLL_* bits of what is ready, 0 on timeout.
+ */
+static int ci_reader_poll(ci_reader *reader, int timeout_ms) {
+    struct pollfd pfds[2] = {{reader->fd, POLLIN, 0}, {reader->wake_fd, POLLIN, 0}};
+    nfds_t n = reader->wake_fd >= 0 ? 2 : 1;
+    int rc;
+    do {
+        reader->syscalls++;
+        rc = poll(pfds, n, timeout_ms);
+    } while (rc < 0 && errno == EINTR && timeout_ms < 0);
+    /* other errors count as input: the read reports them */
+    if (rc < 0) return errno == EINTR ? 0 : CI_POLL_INPUT;
+    if (rc == 0) return 0;
+    return (pfds[0].revents ? CI_POLL_INPUT : 0) | (n > 1 && pfds[1].revents ? CI_POLL_WAKE : 0);
+}
+
+ssize_t ci_reader_fill(ci_reader *reader, bool compact) {
+    if (reader->out) ci_output_flush(reader->out);
+    if (compact && reader->head > 0) {
+        memmove(reader->buf, reader->buf + reader->head, reader->tail - reader->head);
+        reader->tail -= reader->head;
+        reader->head = 0;
+    }
+
+    ssize_t n;
+    if (reader->uring) {
+        n = ci_uring_read(reader->uring, reader->buf + reader->tail, reader->cap - reader->tail, reader->wake_fd,
+                          &reader->syscalls);
+    } else {
+        if (reader->wake_fd >= 0 && ci_reader_poll(reader, -1) & CI_POLL_WAKE) return CI_READ_WOKEN;
+        do {
+            reader->syscalls++;
+            n = read(reader->fd, reader->buf + reader->tail, reader->cap - reader->tail);
+        } while (n < 0 && errno == EINTR);
+    }
+
+    if (n > 0) {
+        reader->tail += (size_t)n;
+#ifndef CI_NO_STATS
+        reader->filled_ns = ci_stats_now();
+#endif
+    }
+    return n;
+}
+
+bool ci_reader_wait(ci_reader *reader, int timeout_ms) {
+    if (reader->uring) return ci_uring_wait(reader->uring, timeout_ms, reader->wake_fd, &reader->syscalls);
+    return ci_reader_poll(reader, timeout_ms) != 0;
+}
+
+void ci_reader_skip_line(ci_reader *reader) {
+    for (;;) {
+        char *start = reader->buf + reader->head;
+        const char *nl = ci_scan(start, reader->tail - reader->head, '\n');
+        if (nl) {
+            reader->head += (size_t)(nl - start) + 1;
+            return;
+        }
+        reader->head = reader->tail;
+        if (ci_reader_fill(reader, true) <= 0) return;
+    }
+}
+
+ci_reader *ci_reader_create(int fd, size_t block_size) {
+    if (fd < 0) return NULL;
+    if (block_size == 0) block_size = CI_READER_BLOCK;
+    /* one byte may be held back for CRLF folding; leave room to read past it */
+    if (block_size < 2) block_size = 2;
+    ci_scan_init();
+
+    ci_reader *reader = malloc(sizeof(*reader));
+    if (!reader) return NULL;
+
+    /* one spare byte so a final unterminated line can always be NUL-terminated in place */
+    reader->buf = malloc(block_size + 1);
+    if (!reader->buf) {
+        free(reader);
+        return NULL;
+    }
+    reader->fd = fd;
+    reader->cap = block_size;
+    reader->head = 0;
+    reader->tail = 0;
+    reader->uring = NULL;
+    reader->syscalls = 0;
+    reader->filled_ns = 0;
+    reader->tty = -1;
+    reader->out = NULL;
+    reader->wake_fd = -1;
+    return reader;
+}
+
+void ci_reader_destroy(ci_reader *reader) {
+    if (!reader) return;
+    ci_uring_destroy(reader->uring);
+    free(reader->buf);
+    free(reader);
+}
+
+ci_status ci_reader_read_line(ci_reader *reader, char *buffer, size_t size) {
+    if (!reader || !buffer || size == 0) return CI_INVALID;
+
+    size_t out = 0;
+    for (;;) {
+        char *start = reader->buf + reader->head;
+        size_t avail = reader->tail - reader->head;
+        const char *nl = ci_scan(start, avail, '\n');
+
+        if (nl) {
+            size_t take = (size_t)(nl - start);
+            size_t len = (take > 0 && start[take - 1] == '\r') ? take - 1 : take;
+            reader->head += take + 1;
+            if (out + len >= size) {
+                memcpy(buffer + out, start, size - 1 - out);
+                buffer[size - 1] = '\0';
+                return CI_OVERFLOW;
+            }
+            memcpy(buffer + out, start, len);
+            buffer[out + len] = '\0';
+            return CI_OK;
+        }
+
+        /* hold back a trailing '\r' so a '\n' in the next block can fold it */
+        size_t keep = (avail > 0 && start[avail - 1] == '\r') ? 1 : 0;
+        size_t take = avail - keep;
+        if (out + take >= size) {
+            memcpy(buffer + out, start, size - 1 - out);
+            buffer[size - 1] = '\0';
+            reader->head = reader->tail;
+            ci_reader_skip_line(reader);
+            return CI_OVERFLOW;
+        }
+
+        /* partial line already copied out; make room for the next block */
+        memcpy(buffer + out, start, take);
+        out += take;
+        reader->head += take;
+        ssize_t n = ci_reader_fill(reader, true);
+        if (n == 0) {
+            if (keep) {
+                reader->head = reader->tail;
+                if (out + 1 >= size) {
+                    buffer[out] = '\0';
+                    return CI_OVERFLOW;
+                }
+                buffer[out++] = '\r';
+            }
+            if (out == 0) return CI_EOF;
+            buffer[out] = '\0';
+            return CI_OK;
+        }
+        if (n < 0) return CI_INVALID;
+    }
+}
+
+ci_status ci_reader_set_backend(ci_reader *reader, ci_read_backend backend) {
+    if (!reader) return CI_INVALID;
+    if (backend == CI_BACKEND_READ) return reader->uring ? CI_INVALID : CI_OK;
+    if (backend != CI_BACKEND_IO_URING) return CI_INVALID;
+    if (reader->uring) return CI_OK;
+
+    reader->uring = ci_uring_create(reader->fd, reader->cap);
+    return reader->uring ? CI_OK : CI_INVALID;
+}
+
+ci_read_backend ci_reader_get_backend(const ci_reader *reader) {
+    return reader && reader->uring ? CI_BACKEND_IO_URING : CI_BACKEND_READ;
+}
+
+bool ci_reader_next_buffered(ci_reader *reader, const char **line, size_t *len) {
+    char *start = reader->buf + reader->head;
+    const char *nl = ci_scan(start, reader->tail - reader->head, '\n');
+    if (!nl) return false;
+
+    size_t take = (size_t)(nl - start);
+    size_t n = (take > 0 && start[take - 1] == '\r') ? take - 1 : take;
+    start[n] = '\0';
+    reader->head += take + 1;
+    *line = start;
+    *len = n;
+    return true;
+}
+
+bool ci_reader_take_rest(ci_reader *reader, const char **line, size_t *len) {
+    if (reader->head == reader->tail) return false;
+
+    char *start = reader->buf + reader->head;
+    *len = reader->tail - reader->head;
+    start[*len] = '\0';
+    *line = start;
+    reader->head = reader->tail;
+    return true;
+}
+
+bool ci_reader_grow(ci_reader *reader, size_t max_line) {
+    /* the line, a '\r' held for CRLF folding and its '\n' must fit at once */
+    size_t limit = max_line + 2;
+    if (reader->cap >= limit) return false;
+
+    size_t cap = reader->cap > limit / 2 ? limit : reader->cap * 2;
+    char *buf = realloc(reader->buf, cap + 1);
+    if (!buf) return false;
+    reader->buf = buf;
+    reader->cap = cap;
+    return true;
+}
+
+ci_status ci_reader_next_line(ci_reader *reader, size_t max_line, const char **line, size_t *len) {
+    for (;;) {
+        if (ci_reader_next_buffered(reader, line, len)) return *len > max_line ? CI_OVERFLOW : CI_OK;
+
+        size_t pending = reader->tail - reader->head;
+        if (pending > max_line + 1 || (pending == reader->cap && !ci_reader_grow(reader, max_line))) {
+            /* no newline within the cap: drop the rest of the line */
+            reader->head = reader->tail;
+            ci_reader_skip_line(reader);
+            return CI_OVERFLOW;
+        }
+
+        ssize_t n = ci_reader_fill(reader, true);
+        if (n == CI_READ_WOKEN) return CI_WOKEN;
+        if (n < 0) return CI_INVALID;
+        if (n == 0) {
+            if (!ci_reader_take_rest(reader, line, len)) return CI_EOF;
+            return *len > max_line ? CI_OVERFLOW : CI_OK;
+        }
+    }
+}
+
+ci_reader *ci_reader_for_fd(int fd) {
+    if (fd < 0) return NULL;
+
+    ci_reader *reader = NULL;
+    pthread_mutex_lock(&ci_reader_mutex);
+    for (size_t i = 0; i < ci_reader_count; i++) {
+        if (ci_readers[i].fd == fd) {
+            reader = ci_readers[i].reader;
+            break;
+        }
+    }
+    if (!reader && ci_reader_count < CI_MAX_READERS) {
+        reader = ci_reader_create(fd, 0);
+        if (reader) {
+            ci_readers[ci_reader_count].fd = fd;
+            ci_readers[ci_reader_count].reader = reader;
+            ci_reader_count++;
+        }
+    }
+    pthread_mutex_unlock(&ci_reader_mutex);
+    return reader;
+}
@@ -0,0 +1,962 @@
+#include "ci_internal.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CI_REGISTRY_MIN_CAP 16
+#define CI_REGISTRY_SPIN 64
+
+struct ci_command_rec {
+    uint64_t hash;
+    size_t len;
+    ci_line_callback cb;
+    void *user_data;
+    unsigned flags;
+    ci_hist *stats; /* callback run times, allocated on the first timed run */
+    char name[];
+};
+
+struct ci_registry_table {
+    size_t cap;
+    size_t count;
+    ci_registry_slot slots[];
+};
+
+/* An installed static table and the run-time histograms of its commands. */
+struct ci_fixed_table {
+    const ci_command_table *table;
+    ci_fixed_table *next; /* in reg->fixed_list */
+    ci_hist *stats[];     /* per command, allocated on the first timed run */
+};
+
+/* The snapshots one lookup probes, each loaded once so a writer can't swap one in between. */
+typedef struct {
+    const ci_registry_table *table;
+    const ci_trie *verbs;
+    ci_pattern_set *patterns;
+} ci_registry_view;
+
+/* Snapshots and entries a writer unpublished, freed together after a grace period. */
+struct ci_retired {
+    ci_retired *next;
+    ci_registry_table *table;
+    ci_trie *verbs;
+    ci_pattern_set *patterns;
+    bool owned; /* the snapshots' records, verbs and patterns go too (ci_registry_clear) */
+    ci_command_rec *rec;
+    ci_pattern *pattern;
+    size_t verb_count;
+    ci_verb *verb_list[];
+};
+
+static void ci_retired_free(ci_retired *garbage);
+
+/* Read-side sections held by this thread, so writers called from a callback don't wait on themselves. */
+static CI_THREAD_LOCAL ci_registry *ci_held_reg = NULL;
+static CI_THREAD_LOCAL unsigned long ci_held_counts[2] = {0, 0};
+
+void ci_registry_init(ci_registry *reg) {
+    pthread_mutex_init(&reg->mutex, NULL);
+    pthread_mutex_init(&reg->gp_mutex, NULL);
+    reg->retired = NULL;
+    reg->table = NULL;
+    reg->epoch = 0;
+    reg->readers[0] = 0;
+    reg->readers[1] = 0;
+    reg->fixed = NULL;
+    reg->fixed_list = NULL;
+    reg->verbs = NULL;
+    reg->patterns = NULL;
+}
+
+void ci_registry_destroy(ci_registry *reg) {
+    ci_registry_clear(reg);
+    /* installed tables are kept until now, so lock-free readers never see one freed */
+    while (reg->fixed_list) {
+        ci_fixed_table *next = reg->fixed_list->next;
+        for (size_t i = 0; i < reg->fixed_list->table->count; i++) free(reg->fixed_list->stats[i]);
+        free(reg->fixed_list);
+        reg->fixed_list = next;
+    }
+    reg->fixed = NULL;
+    /* no readers are left, so nothing retired needs a grace period */
+    ci_retired_free(reg->retired);
+    reg->retired = NULL;
+    pthread_mutex_destroy(&reg->gp_mutex);
+    pthread_mutex_destroy(&reg->mutex);
+}
+
+/**
+ * @brief Hash shared by ci_hash_bytes and ci_hash_seeded, inlined into both.
+ */
+static inline uint64_t ci_hash_mix(const char *p, size_t len, uint64_t seed) {
+    const uint64_t mul = 0x9e3779b97f4a7c15ull;
+    uint64_t h = 0x243f6a8885a308d3ull ^ seed ^ ((uint64_t)len * mul);
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        h = (h ^ word) * mul;
+        h ^= h >> 29;
+    }
+    if (i < len) {
+        uint64_t word = 0;
+        memcpy(&word, p + i, len - i);
+        h = (h ^ word) * mul;
+        h ^= h >> 29;
+    }
+    h ^= h >> 32;
+    return h * mul;
+}
+
+uint64_t ci_hash_bytes(const char *p, size_t len) {
+    return ci_hash_mix(p, len, 0);
+}
+
+uint64_t ci_hash_seeded(const char *p, size_t len, uint64_t seed) {
+    return ci_hash_mix(p, len, seed);
+}
+
+/**
+ * @brief Free a record that no reader can see any more.
+ * @param rec Record (can be NULL).
+ */
+static void ci_command_rec_free(ci_command_rec *rec) {
+    if (!rec) return;
+    free(rec->stats);
+    free(rec);
+}
+
+/**
+ * @brief Free a verb that no reader can see any more.
+ * @param verb Verb (can be NULL).
+ */
+static void ci_verb_free(ci_verb *verb) {
+    if (!verb) return;
+    free(verb->stats);
+    free(verb);
+}
+
+/**
+ * @brief Free a pattern that no reader can see any more.
+ * @param pattern Pattern (can be NULL).
+ */
+static void ci_pattern_free(ci_pattern *pattern) {
+    if (!pattern) return;
+    free(pattern->stats);
+    free(pattern);
+}
+
+/**
+ * @brief Allocate an empty retire record.
+ * @param verb_capacity Room for this many retired verbs.
+ * @return Record, or NULL on allocation failure.
+ */
+static ci_retired *ci_retired_new(size_t verb_capacity) {
+    return calloc(1, sizeof(ci_retired) + verb_capacity * sizeof(ci_verb *));
+}
+
+/**
+ * @brief Free what a retire record holds (not the record itself).
+ */
+static void ci_retired_release(ci_retired *garbage) {
+    if (garbage->owned) {
+        for (size_t i = 0; garbage->table && i < garbage->table->cap; i++) {
+            ci_command_rec_free(garbage->table->slots[i].rec);
+        }
+        for (size_t i = 0; garbage->verbs && i < garbage->verbs->count; i++) ci_verb_free(garbage->verbs->verbs[i]);
+        size_t count;
+        ci_pattern *const *list = ci_pattern_set_list(garbage->patterns, &count);
+        for (size_t i = 0; i < count; i++) ci_pattern_free(list[i]);
+    }
+    free(garbage->table);
+    ci_trie_free(garbage->verbs);
+    ci_pattern_set_free(garbage->patterns);
+    ci_command_rec_free(garbage->rec);
+    ci_pattern_free(garbage->pattern);
+    for (size_t i = 0; i < garbage->verb_count; i++) ci_verb_free(garbage->verb_list[i]);
+}
+
+/**
+ * @brief Free a list of retire records and everything they hold.
+ */
+static void ci_retired_free(ci_retired *garbage) {
+    while (garbage) {
+        ci_retired *next = garbage->next;
+        ci_retired_release(garbage);
+        free(garbage);
+        garbage = next;
+    }
+}
+
+/**
+ * @brief Find the slot holding a command, or the empty slot where it would go.
+ * @param table Table snapshot to probe.
+ * @param name Command bytes.
+ * @param len Command length.
+ * @param hash Precomputed ci_hash_bytes(name, len).
+ * @return Slot index; table->slots[i].rec is NULL when the command is absent.
+ */
+static size_t ci_table_probe(const ci_registry_table *table, const char *name, size_t len, uint64_t hash) {
+    size_t mask = table->cap - 1;
+    size_t i = (size_t)hash & mask;
+
+    for (;;) {
+        const ci_registry_slot *slot = &table->slots[i];
+        if (!slot->rec) return i;
+        if (slot->hash == hash && slot->rec->len == len && memcmp(slot->rec->name, name, len) == 0) {
+            return i;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+/**
+ * @brief Copy every record of a table into a fresh table of the given capacity.
+ * @param old Source table (can be NULL).
+ * @param cap New capacity; must be a power of two larger than old->count.
+ * @return New unpublished table, or NULL on allocation failure.
+ */
+static ci_registry_table *ci_table_copy(const ci_registry_table *old, size_t cap) {
+    ci_registry_table *table = calloc(1, sizeof(*table) + cap * sizeof(ci_registry_slot));
+    if (!table) return NULL;
+    table->cap = cap;
+    if (!old) return table;
+
+    for (size_t i = 0; i < old->cap; i++) {
+        if (!old->slots[i].rec) continue;
+        size_t j = (size_t)old->slots[i].hash & (cap - 1);
+        while (table->slots[j].rec) j = (j + 1) & (cap - 1);
+        table->slots[j] = old->slots[i];
+    }
+    table->count = old->count;
+    return table;
+}
+
+/**
+ * @brief Whether this thread is inside a section of a registry (running one of its callbacks).
+ */
+static bool ci_registry_in_section(const ci_registry *reg) {
+    return ci_held_reg == reg && (ci_held_counts[0] || ci_held_counts[1]);
+}
+
+/**
+ * @brief Wait until no reader can still see a snapshot unpublished before this call.
+ * @param reg Registry whose readers to wait for (caller holds gp_mutex and no section of reg).
+ * @param wait false to give up instead of waiting when a reader is still inside.
+ * @return true once the grace period has passed.
+ *
+ * Flips the reader epoch twice, each time draining the counter that new readers no
+ * longer use.
+ */
+static bool ci_registry_synchronize(ci_registry *reg, bool wait) {
+    for (int pass = 0; pass < 2; pass++) {
+        unsigned long epoch = ci_atomic_load(&reg->epoch);
+        unsigned idx = (unsigned)(epoch & 1);
+        ci_atomic_store(&reg->epoch, epoch + 1);
+
+        for (unsigned spins = 0; ci_atomic_load(&reg->readers[idx]) > 0; spins++) {
+            if (!wait) return false;
+            if (spins < CI_REGISTRY_SPIN) {
+                sched_yield();
+            } else {
+                struct timespec ts = {0, 50000};
+                nanosleep(&ts, NULL);
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Free what writers have retired, once no reader can still see it.
+ * @param reg Registry to clean up; the calling thread holds no section of it.
+ * @param wait Wait for readers (a writer), or only try once (the end of a section).
+ */
+static void ci_registry_reclaim(ci_registry *reg, bool wait) {
+    if (wait) {
+        pthread_mutex_lock(&reg->gp_mutex);
+    } else if (pthread_mutex_trylock(&reg->gp_mutex) != 0) {
+        return;
+    }
+    pthread_mutex_lock(&reg->mutex);
+    ci_retired *garbage = reg->retired;
+    ci_atomic_store(&reg->retired, (ci_retired *)NULL);
+    pthread_mutex_unlock(&reg->mutex);
+
+    /* an empty list means a grace period that began after our publish has already ended */
+    if (garbage && !ci_registry_synchronize(reg, wait)) {
+        pthread_mutex_lock(&reg->mutex);
+        ci_retired *last = garbage;
+        while (last->next) last = last->next;
+        last->next = reg->retired;
+        ci_atomic_store(&reg->retired, garbage);
+        pthread_mutex_unlock(&reg->mutex);
+        garbage = NULL;
+    }
+    pthread_mutex_unlock(&reg->gp_mutex);
+    ci_retired_free(garbage);
+}
+
+/**
+ * @brief Queue what a writer unpublished and free it once readers are done.
+ * @param reg Registry just updated; the caller holds the writer mutex, which this releases.
+ * @param garbage What the new snapshot no longer references.
+ *
+ * A writer inside a section (a callback) doesn't wait: two callbacks on different
+ * threads would each wait for the other's section. The section end or a later
+ * writer frees what it retired.
+ */
+static void ci_registry_retire(ci_registry *reg, ci_retired *garbage) {
+    garbage->next = reg->retired;
+    ci_atomic_store(&reg->retired, garbage);
+    pthread_mutex_unlock(&reg->mutex);
+    if (!ci_registry_in_section(reg)) ci_registry_reclaim(reg, true);
+}
+
+/**
+ * @brief Publish a new command table and retire the old one.
+ * @param reg Registry to update (caller holds the writer mutex; released on return).
+ * @param table New snapshot (can be NULL for empty).
+ * @param retired Record no longer referenced by the new snapshot (can be NULL).
+ * @param garbage Empty retire record.
+ */
+static void ci_registry_publish(ci_registry *reg, ci_registry_table *table, ci_command_rec *retired,
+                                ci_retired *garbage) {
+    garbage->table = ci_atomic_load(&reg->table);
+    garbage->rec = retired;
+    ci_atomic_store(&reg->table, table);
+    ci_registry_retire(reg, garbage);
+}
+
+/**
+ * @brief Publish a new verb trie and retire the old one.
+ * @param reg Registry to update (caller holds the writer mutex; released on return).
+ * @param trie New trie (can be NULL when there are no verbs).
+ * @param garbage Retire record already holding the verbs no longer in the new trie.
+ */
+static void ci_registry_publish_verbs(ci_registry *reg, ci_trie *trie, ci_retired *garbage) {
+    garbage->verbs = ci_atomic_load(&reg->verbs);
+    ci_atomic_store(&reg->verbs, trie);
+    ci_registry_retire(reg, garbage);
+}
+
+/**
+ * @brief Publish a new pattern set and retire the old one.
+ * @param reg Registry to update (caller holds the writer mutex; released on return).
+ * @param set New set (can be NULL when there are no patterns).
+ * @param retired Pattern no longer in the new set (can be NULL).
+ * @param garbage Empty retire record.
+ */
+static void ci_registry_publish_patterns(ci_registry *reg, ci_pattern_set *set, ci_pattern *retired,
+                                         ci_retired *garbage) {
+    garbage->patterns = ci_atomic_load(&reg->patterns);
+    garbage->pattern = retired;
+    ci_atomic_store(&reg->patterns, set);
+    ci_registry_retire(reg, garbage);
+}
+
+/**
+ * @brief Enter a short read-side section (no callbacks may run inside it).
+ * @param reg Registry to read.
+ * @return Token to pass to ci_registry_exit.
+ */
+static unsigned ci_registry_enter(ci_registry *reg) {
+    unsigned idx = (unsigned)(ci_atomic_load(&reg->epoch) & 1);
+    ci_atomic_add(&reg->readers[idx], 1);
+    return idx;
+}
+
+/**
+ * @brief Leave a section entered with ci_registry_enter.
+ * @param reg Registry being read.
+ * @param idx Token returned by ci_registry_enter.
+ */
+static void ci_registry_exit(ci_registry *reg, unsigned idx) {
+    ci_atomic_sub(&reg->readers[idx], 1);
+}
+
+void ci_registry_begin(ci_registry *reg, ci_registry_section *section) {
+    section->prev_reg = ci_held_reg;
+    section->prev_counts[0] = ci_held_counts[0];
+    section->prev_counts[1] = ci_held_counts[1];
+    if (ci_held_reg != reg) {
+        ci_held_reg = reg;
+        ci_held_counts[0] = 0;
+        ci_held_counts[1] = 0;
+    }
+    section->idx = ci_registry_enter(reg);
+    ci_held_counts[section->idx]++;
+}
+
+void ci_registry_end(ci_registry *reg, const ci_registry_section *section) {
+    ci_held_counts[section->idx]--;
+    ci_registry_exit(reg, section->idx);
+    if (section->prev_reg != reg) {
+        ci_held_reg = section->prev_reg;
+        ci_held_counts[0] = section->prev_counts[0];
+        ci_held_counts[1] = section->prev_counts[1];
+    }
+    /* free what callbacks retired, if no other reader is in the way */
+    if (ci_atomic_load(&reg->retired) && !ci_registry_in_section(reg)) ci_registry_reclaim(reg, false);
+}
+
+/**
+ * @brief Load the registry's snapshots for one lookup.
+ * @param reg Registry to read.
+ * @param view Output snapshots.
+ * @return Whether any snapshot is set; if so, only a view loaded inside a section may be probed.
+ */
+static bool ci_registry_load(ci_registry *reg, ci_registry_view *view) {
+    view->table = ci_atomic_load(&reg->table);
+    view->verbs = ci_atomic_load(&reg->verbs);
+    view->patterns = ci_atomic_load(&reg->patterns);
+    return view->table || view->verbs || view->patterns;
+}
+
+/**
+ * @brief Find the record for a line in a table snapshot; caller is inside a read section.
+ * @param table Snapshot to search (can be NULL).
+ * @param line Line bytes.
+ * @param len Line length.
+ * @return Matching record, or NULL.
+ */
+static const ci_command_rec *ci_registry_find(const ci_registry_table *table, const char *line, size_t len) {
+    if (!table || table->count == 0) return NULL;
+    return table->slots[ci_table_probe(table, line, len, ci_hash_bytes(line, len))].rec;
+}
+
+/**
+ * @brief Find the static command for a line: one hash, one slot, one compare.
+ * @param fixed Installed table (can be NULL).
+ * @param line Line bytes.
+ * @param len Line length.
+ * @return Index of the matching command, or -1.
+ */
+static ptrdiff_t ci_fixed_find(const ci_fixed_table *fixed, const char *line, size_t len) {
+    if (!fixed) return -1;
+    const ci_command_table *t = fixed->table;
+    uint64_t hash = ci_hash_mix(line, len, t->seed);
+    uint32_t slot = t->slots[ci_phash_slot(hash, t->displace, t->bucket_mask, t->slot_mask)];
+    if (slot == 0) return -1;
+    const ci_command_def *def = &t->commands[slot - 1];
+    if (def->len != len || memcmp(def->name, line, len) != 0) return -1;
+    return (ptrdiff_t)slot - 1;
+}
+
+/**
+ * @brief Copy a static command into a lookup result.
+ */
+static void ci_fixed_entry(const ci_fixed_table *fixed, ptrdiff_t index, ci_command_entry *out_entry) {
+    const ci_command_def *def = &fixed->table->commands[index];
+    out_entry->cb = def->callback;
+    out_entry->user_data = def->user_data;
+    out_entry->flags = def->flags;
+}
+
+void ci_registry_clear(ci_registry *reg) {
+    ci_retired *garbage = ci_retired_new(0);
+    ci_retired fallback;
+    ci_retired *target = garbage ? garbage : &fallback;
+    memset(target, 0, sizeof(*target));
+    target->owned = true;
+
+    pthread_mutex_lock(&reg->mutex);
+    target->table = ci_atomic_load(&reg->table);
+    target->verbs = ci_atomic_load(&reg->verbs);
+    target->patterns = ci_atomic_load(&reg->patterns);
+    ci_atomic_store(&reg->table, (ci_registry_table *)NULL);
+    ci_atomic_store(&reg->verbs, (ci_trie *)NULL);
+    ci_atomic_store(&reg->patterns, (ci_pattern_set *)NULL);
+    if (garbage) {
+        ci_registry_retire(reg, garbage);
+        return;
+    }
+    pthread_mutex_unlock(&reg->mutex);
+
+    /* out of memory for the retire record: wait in place, unless a callback of ours would never end */
+    if (ci_registry_in_section(reg)) return;
+    pthread_mutex_lock(&reg->gp_mutex);
+    ci_registry_synchronize(reg, true);
+    pthread_mutex_unlock(&reg->gp_mutex);
+    ci_retired_release(&fallback);
+}
+
+/**
+ * @brief Find the command for a line and where its run-time histogram lives; caller is inside a section.
+ * @param reg Registry to search.
+ * @param view Snapshots to probe, loaded inside the caller's section (or all NULL).
+ * @param line Line bytes.
+ * @param len Line length.
+ * @param out_entry Output entry.
+ * @return The command's histogram pointer, or NULL if nothing matched.
+ */
+static ci_hist **ci_registry_match(ci_registry *reg,
+                                   const ci_registry_view *view,
+                                   const char *line,
+                                   size_t len,
+                                   ci_command_entry *out_entry) {
+    out_entry->cb = NULL;
+    out_entry->args_cb = NULL;
+    out_entry->verb_end = 0;
+
+    ci_command_rec *rec = (ci_command_rec *)ci_registry_find(view->table, line, len);
+    if (rec) {
+        out_entry->cb = rec->cb;
+        out_entry->user_data = rec->user_data;
+        out_entry->flags = rec->flags;
+        return &rec->stats;
+    }
+
+    /* static tables are never freed before the registry */
+    ci_fixed_table *fixed = ci_atomic_load(&reg->fixed);
+    ptrdiff_t index = ci_fixed_find(fixed, line, len);
+    if (index >= 0) {
+        ci_fixed_entry(fixed, index, out_entry);
+        return &fixed->stats[index];
+    }
+
+    ci_verb *verb = ci_trie_match(view->verbs, line, len, &out_entry->verb_end);
+    if (verb) {
+        out_entry->args_cb = verb->cb;
+        out_entry->user_data = verb->user_data;
+        out_entry->flags = verb->flags;
+        return &verb->stats;
+    }
+
+    ci_pattern *pattern = ci_pattern_set_match(view->patterns, line, len);
+    if (pattern) {
+        out_entry->cb = pattern->cb;
+        out_entry->user_data = pattern->user_data;
+        out_entry->flags = pattern->flags;
+        return &pattern->stats;
+    }
+    return NULL;
+}
+
+bool ci_registry_find_entry(ci_registry *reg, const char *line, size_t len, ci_command_entry *out_entry) {
+    ci_registry_view view;
+    ci_registry_load(reg, &view);
+    return ci_registry_match(reg, &view, line, len, out_entry) != NULL;
+}
+
+bool ci_registry_lookup(ci_registry *reg, const char *line, size_t len, ci_command_entry *out_entry) {
+    if (!line || !out_entry) return false;
+
+    /* with only a static table there is no snapshot to protect; otherwise reload inside the section */
+    ci_registry_view view;
+    bool snapshot = ci_registry_load(reg, &view);
+    unsigned idx = 0;
+    if (snapshot) {
+        idx = ci_registry_enter(reg);
+        ci_registry_load(reg, &view);
+    }
+    bool found = ci_registry_match(reg, &view, line, len, out_entry) != NULL;
+    if (snapshot) ci_registry_exit(reg, idx);
+    return found;
+}
+
+void ci_registry_run_entry(const ci_command_entry *entry, const char *line, size_t len) {
+    if (!entry->args_cb) {
+        entry->cb(line, entry->user_data);
+        return;
+    }
+    ci_arg argv[CI_MAX_ARGS];
+    argv[0].ptr = line;
+    argv[0].len = entry->verb_end;
+    size_t argc = 1 + ci_split_args(line + entry->verb_end, len - entry->verb_end, argv + 1, CI_MAX_ARGS - 1);
+    entry->args_cb(line, argv, argc, entry->user_data);
+}
+
+/**
+ * @brief Histogram of a command, allocating it on first use.
+ * @param slot Where the command's histogram pointer lives.
+ * @return Histogram, or NULL on allocation failure.
+ */
+static ci_hist *ci_command_hist(ci_hist **slot) {
+    ci_hist *stats = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (!stats) {
+        ci_hist *fresh = calloc(1, sizeof(*fresh));
+        if (fresh && __atomic_compare_exchange_n(slot, &stats, fresh, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            stats = fresh;
+        } else {
+            free(fresh); /* another thread published one first; stats now points to it */
+        }
+    }
+    return stats;
+}
+
+bool ci_registry_dispatch(ci_registry *reg, const char *line, size_t len, ci_stats_shard *shard) {
+    /* with only a static table there is no snapshot to protect; otherwise reload inside the section */
+    ci_registry_view view;
+    ci_registry_section section;
+    bool snapshot = ci_registry_load(reg, &view);
+    if (snapshot) {
+        ci_registry_begin(reg, &section);
+        ci_registry_load(reg, &view);
+    }
+
+    ci_command_entry entry;
+    ci_hist **stats_slot = ci_registry_match(reg, &view, line, len, &entry);
+    if (stats_slot && shard) {
+        ci_hist *stats = ci_command_hist(stats_slot);
+        ci_registry_run_entry(&entry, line, len);
+        uint64_t ns = ci_stats_callback(shard, true);
+        if (stats) ci_hist_add_shared(stats, ns);
+    } else if (stats_slot) {
+        ci_registry_run_entry(&entry, line, len);
+    }
+
+    if (snapshot) ci_registry_end(reg, &section);
+    return stats_slot != NULL;
+}
+
+bool ci_registry_command_stats(ci_registry *reg, const char *command, ci_latency_stats *out) {
+    ci_registry_section section;
+    ci_registry_begin(reg, &section);
+    size_t len = strlen(command);
+    const ci_command_rec *rec = ci_registry_find(ci_atomic_load(&reg->table), command, len);
+    ci_fixed_table *fixed = ci_atomic_load(&reg->fixed);
+    ptrdiff_t index = rec ? -1 : ci_fixed_find(fixed, command, len);
+    ci_hist *const *slot = rec ? &rec->stats : index >= 0 ? &fixed->stats[index] : NULL;
+    const ci_trie *verbs = ci_atomic_load(&reg->verbs);
+    for (size_t i = 0; !slot && verbs && i < verbs->count; i++) {
+        if (strcmp(verbs->verbs[i]->name, command) == 0) slot = &verbs->verbs[i]->stats;
+    }
+    size_t pattern_count;
+    ci_pattern *const *patterns = ci_pattern_set_list(ci_atomic_load(&reg->patterns), &pattern_count);
+    for (size_t i = 0; !slot && i < pattern_count; i++) {
+        if (strcmp(patterns[i]->text, command) == 0) slot = &patterns[i]->stats;
+    }
+    if (slot) {
+        const ci_hist *stats = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+        if (stats) {
+            ci_hist_summarize(stats, out);
+        } else {
+            memset(out, 0, sizeof(*out));
+        }
+    }
+    ci_registry_end(reg, &section);
+    return slot != NULL;
+}
+
+/**
+ * @brief Zero one command's histogram, if it has one.
+ */
+static void ci_hist_clear(ci_hist *const *slot) {
+    ci_hist *stats = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (!stats) return;
+    /* samples recorded while clearing may survive or be lost */
+    for (size_t b = 0; b < CI_HIST_BUCKETS; b++) __atomic_store_n(&stats->buckets[b], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->total_ns, 0, __ATOMIC_RELAXED);
+}
+
+void ci_registry_reset_stats(ci_registry *reg) {
+    ci_registry_section section;
+    ci_registry_begin(reg, &section);
+    const ci_registry_table *table = ci_atomic_load(&reg->table);
+    for (size_t i = 0; table && i < table->cap; i++) {
+        if (table->slots[i].rec) ci_hist_clear(&table->slots[i].rec->stats);
+    }
+    ci_fixed_table *fixed = ci_atomic_load(&reg->fixed);
+    for (size_t i = 0; fixed && i < fixed->table->count; i++) ci_hist_clear(&fixed->stats[i]);
+    const ci_trie *verbs = ci_atomic_load(&reg->verbs);
+    for (size_t i = 0; verbs && i < verbs->count; i++) ci_hist_clear(&verbs->verbs[i]->stats);
+    size_t pattern_count;
+    ci_pattern *const *patterns = ci_pattern_set_list(ci_atomic_load(&reg->patterns), &pattern_count);
+    for (size_t i = 0; i < pattern_count; i++) ci_hist_clear(&patterns[i]->stats);
+    ci_registry_end(reg, &section);
+}
+
+ci_status ci_registry_put(ci_registry *reg, const char *command, ci_line_callback callback, void *user_data,
+                          unsigned flags) {
+    size_t len = strlen(command);
+    uint64_t hash = ci_hash_bytes(command, len);
+
+    ci_command_rec *rec = malloc(sizeof(*rec) + len + 1);
+    ci_retired *garbage = ci_retired_new(0);
+    if (!rec || !garbage) {
+        free(rec);
+        free(garbage);
+        return CI_OVERFLOW;
+    }
+    rec->hash = hash;
+    rec->len = len;
+    rec->cb = callback;
+    rec->user_data = user_data;
+    rec->flags = flags;
+    rec->stats = NULL;
+    memcpy(rec->name, command, len + 1);
+
+    pthread_mutex_lock(&reg->mutex);
+
+    /* keep the load factor at or below 1/2 so probe chains stay short */
+    const ci_registry_table *old = ci_atomic_load(&reg->table);
+    size_t count = old ? old->count : 0;
+    size_t cap = old ? old->cap : CI_REGISTRY_MIN_CAP;
+    if ((count + 1) * 2 > cap) cap *= 2;
+
+    ci_registry_table *table = ci_table_copy(old, cap);
+    if (!table) {
+        pthread_mutex_unlock(&reg->mutex);
+        free(rec);
+        free(garbage);
+        return CI_OVERFLOW;
+    }
+
+    /* replace if already present; the old record is freed once readers are done */
+    ci_registry_slot *slot = &table->slots[ci_table_probe(table, command, len, hash)];
+    ci_command_rec *retired = slot->rec;
+    if (!retired) table->count++;
+    slot->hash = hash;
+    slot->rec = rec;
+
+    ci_registry_publish(reg, table, retired, garbage);
+    return CI_OK;
+}
+
+ci_status ci_registry_remove(ci_registry *reg, const char *command) {
+    size_t len = strlen(command);
+    uint64_t hash = ci_hash_bytes(command, len);
+
+    pthread_mutex_lock(&reg->mutex);
+    const ci_registry_table *old = ci_atomic_load(&reg->table);
+    if (!old || old->count == 0 || !old->slots[ci_table_probe(old, command, len, hash)].rec) {
+        pthread_mutex_unlock(&reg->mutex);
+        return CI_INVALID;
+    }
+
+    ci_registry_table *table = ci_table_copy(old, old->cap);
+    ci_retired *garbage = table ? ci_retired_new(0) : NULL;
+    if (!garbage) {
+        pthread_mutex_unlock(&reg->mutex);
+        free(table);
+        return CI_OVERFLOW;
+    }
+
+    size_t mask = table->cap - 1;
+    size_t i = ci_table_probe(table, command, len, hash);
+    ci_command_rec *retired = table->slots[i].rec;
+    table->slots[i].rec = NULL;
+    table->count--;
+
+    /* backward-shift deletion: pull later chain members into the hole */
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!table->slots[j].rec) break;
+        size_t home = (size_t)table->slots[j].hash & mask;
+        /* move j into i unless its home lies cyclically in (i, j] */
+        bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            table->slots[i] = table->slots[j];
+            table->slots[j].rec = NULL;
+            i = j;
+        }
+    }
+
+    ci_registry_publish(reg, table, retired, garbage);
+    return CI_OK;
+}
+
+ci_status ci_registry_set_table(ci_registry *reg, const ci_command_table *table) {
+    ci_fixed_table *fixed = NULL;
+    if (table) {
+        if (!table->commands || !table->displace || !table->slots || table->count > table->slot_mask) {
+            return CI_INVALID;
+        }
+        if ((table->slot_mask & (table->slot_mask + 1)) || (table->bucket_mask & (table->bucket_mask + 1))) {
+            return CI_INVALID;
+        }
+        /* a table from another hash (or hand-edited) would silently miss commands */
+        for (size_t i = 0; i < table->count; i++) {
+            const ci_command_def *def = &table->commands[i];
+            if (!def->name || !def->callback || strlen(def->name) != def->len || !ci_cmd_flags_valid(def->flags)) {
+                return CI_INVALID;
+            }
+            uint64_t hash = ci_hash_mix(def->name, def->len, table->seed);
+            if (table->slots[ci_phash_slot(hash, table->displace, table->bucket_mask, table->slot_mask)] != i + 1) {
+                return CI_INVALID;
+            }
+        }
+        fixed = calloc(1, sizeof(*fixed) + table->count * sizeof(fixed->stats[0]));
+        if (!fixed) return CI_OVERFLOW;
+        fixed->table = table;
+    }
+
+    pthread_mutex_lock(&reg->mutex);
+    if (fixed) {
+        fixed->next = reg->fixed_list;
+        reg->fixed_list = fixed;
+    }
+    ci_atomic_store(&reg->fixed, fixed);
+    pthread_mutex_unlock(&reg->mutex);
+    return CI_OK;
+}
+
+/**
+ * @brief Whether a new verb takes an existing verb's place: the same name, or a name that
+ *        folds to the same trie node when both are CI_CMD_NOCASE.
+ */
+static bool ci_verb_replaces(const ci_verb *old, const char *name, size_t len, unsigned flags) {
+    if (old->len != len) return false;
+    if (memcmp(old->name, name, len) == 0) return true;
+    if (!(old->flags & CI_CMD_NOCASE) || !(flags & CI_CMD_NOCASE)) return false;
+    for (size_t i = 0; i < len; i++) {
+        char a = old->name[i], b = name[i];
+        if (a >= 'A' && a <= 'Z') a = (char)(a + ('a' - 'A'));
+        if (b >= 'A' && b <= 'Z') b = (char)(b + ('a' - 'A'));
+        if (a != b) return false;
+    }
+    return true;
+}
+
+ci_status ci_registry_put_verb(ci_registry *reg, const char *verb, ci_args_callback callback, void *user_data,
+                               unsigned flags) {
+    size_t len = strlen(verb);
+    ci_verb *rec = malloc(sizeof(*rec) + len + 1);
+    if (!rec) return CI_OVERFLOW;
+    rec->len = len;
+    rec->cb = callback;
+    rec->user_data = user_data;
+    rec->flags = flags;
+    rec->stats = NULL;
+    memcpy(rec->name, verb, len + 1);
+
+    pthread_mutex_lock(&reg->mutex);
+    const ci_trie *old = ci_atomic_load(&reg->verbs);
+    size_t old_count = old ? old->count : 0;
+    ci_verb **list = malloc((old_count + 1) * sizeof(*list));
+    ci_retired *garbage = ci_retired_new(old_count);
+    size_t count = 0;
+    for (size_t i = 0; list && garbage && i < old_count; i++) {
+        if (ci_verb_replaces(old->verbs[i], verb, len, flags)) {
+            garbage->verb_list[garbage->verb_count++] = old->verbs[i];
+        } else {
+            list[count++] = old->verbs[i];
+        }
+    }
+    ci_trie *trie = NULL;
+    if (list && garbage) {
+        list[count++] = rec;
+        trie = ci_trie_build(list, count);
+    }
+    free(list);
+    if (!trie) {
+        pthread_mutex_unlock(&reg->mutex);
+        free(garbage);
+        free(rec);
+        return CI_OVERFLOW;
+    }
+
+    ci_registry_publish_verbs(reg, trie, garbage);
+    return CI_OK;
+}
+
+ci_status ci_registry_remove_verb(ci_registry *reg, const char *verb) {
+    pthread_mutex_lock(&reg->mutex);
+    const ci_trie *old = ci_atomic_load(&reg->verbs);
+    size_t found = SIZE_MAX;
+    for (size_t i = 0; old && i < old->count && found == SIZE_MAX; i++) {
+        if (strcmp(old->verbs[i]->name, verb) == 0) found = i;
+    }
+    if (found == SIZE_MAX) {
+        pthread_mutex_unlock(&reg->mutex);
+        return CI_INVALID;
+    }
+
+    ci_retired *garbage = ci_retired_new(1);
+    ci_trie *trie = NULL;
+    if (garbage && old->count > 1) {
+        ci_verb **list = malloc((old->count - 1) * sizeof(*list));
+        size_t count = 0;
+        for (size_t i = 0; list && i < old->count; i++) {
+            if (i != found) list[count++] = old->verbs[i];
+        }
+        trie = list ? ci_trie_build(list, count) : NULL;
+        free(list);
+    }
+    if (!garbage || (!trie && old->count > 1)) {
+        pthread_mutex_unlock(&reg->mutex);
+        free(garbage);
+        return CI_OVERFLOW;
+    }
+
+    garbage->verb_list[garbage->verb_count++] = old->verbs[found];
+    ci_registry_publish_verbs(reg, trie, garbage);
+    return CI_OK;
+}
+
+ci_status ci_registry_put_pattern(ci_registry *reg, ci_pattern *pattern) {
+    pthread_mutex_lock(&reg->mutex);
+    size_t old_count;
+    ci_pattern *const *old = ci_pattern_set_list(ci_atomic_load(&reg->patterns), &old_count);
+    ci_pattern **list = malloc((old_count + 1) * sizeof(*list));
+    ci_retired *garbage = ci_retired_new(0);
+    if (!list || !garbage) {
+        pthread_mutex_unlock(&reg->mutex);
+        free(list);
+        free(garbage);
+        free(pattern);
+        return CI_OVERFLOW;
+    }
+
+    /* a pattern registered again keeps its priority */
+    size_t count = old_count;
+    ci_pattern *retired = NULL;
+    if (old_count) memcpy(list, old, old_count * sizeof(*list));
+    for (size_t i = 0; i < old_count && !retired; i++) {
+        if (strcmp(old[i]->text, pattern->text) == 0) {
+            retired = old[i];
+            list[i] = pattern;
+        }
+    }
+    if (!retired) list[count++] = pattern;
+
+    ci_pattern_set *set = ci_pattern_set_build(list, count);
+    free(list);
+    if (!set) {
+        pthread_mutex_unlock(&reg->mutex);
+        free(garbage);
+        free(pattern);
+        return CI_OVERFLOW;
+    }
+    ci_registry_publish_patterns(reg, set, retired, garbage);
+    return CI_OK;
+}
+
+ci_status ci_registry_remove_pattern(ci_registry *reg, const char *text) {
+    pthread_mutex_lock(&reg->mutex);
+    size_t old_count;
+    ci_pattern *const *old = ci_pattern_set_list(ci_atomic_load(&reg->patterns), &old_count);
+    size_t found = SIZE_MAX;
+    for (size_t i = 0; i < old_count && found == SIZE_MAX; i++) {
+        if (strcmp(old[i]->text, text) == 0) found = i;
+    }
+    if (found == SIZE_MAX) {
+        pthread_mutex_unlock(&reg->mutex);
+        return CI_INVALID;
+    }
+
+    ci_retired *garbage = ci_retired_new(0);
+    ci_pattern_set *set = NULL;
+    if (garbage && old_count > 1) {
+        ci_pattern **list = malloc((old_count - 1) * sizeof(*list));
+        size_t count = 0;
+        for (size_t i = 0; list && i < old_count; i++) {
+            if (i != found) list[count++] = old[i];
+        }
+        set = list ? ci_pattern_set_build(list, count) : NULL;
+        free(list);
+    }
+    if (!garbage || (!set && old_count > 1)) {
+        pthread_mutex_unlock(&reg->mutex);
+        free(garbage);
+        return CI_OVERFLOW;
+    }
+    ci_registry_publish_patterns(reg, set, old[found], garbage);
+    return CI_OK;
+}
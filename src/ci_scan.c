@@ -0,0 +1,112 @@
+#include "ci_internal.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define CI_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+static ci_scan_fn ci_scan_impl = ci_scan_scalar;
+static pthread_once_t ci_scan_once = PTHREAD_ONCE_INIT;
+
+const char *ci_scan_scalar(const char *p, size_t n, char delim) {
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] == delim) return p + i;
+    }
+    return NULL;
+}
+
+const char *ci_scan_swar(const char *p, size_t n, char delim) {
+    const uint64_t ones = 0x0101010101010101ull;
+    const uint64_t highs = 0x8080808080808080ull;
+    const uint64_t pattern = ones * (unsigned char)delim;
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        word ^= pattern;
+        /* a byte of word is zero where it equals delim */
+        if ((word - ones) & ~word & highs) {
+            return ci_scan_scalar(p + i, 8, delim);
+        }
+    }
+    return ci_scan_scalar(p + i, n - i, delim);
+}
+
+#ifdef CI_SCAN_X86
+const char *ci_scan_sse2(const char *p, size_t n, char delim) {
+    const __m128i pattern = _mm_set1_epi8(delim);
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(const void *)(p + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+        if (mask) return p + i + __builtin_ctz(mask);
+    }
+    return ci_scan_scalar(p + i, n - i, delim);
+}
+
+__attribute__((target("avx2"))) const char *ci_scan_avx2(const char *p, size_t n, char delim) {
+    const __m256i pattern = _mm256_set1_epi8(delim);
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(const void *)(p + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, pattern));
+        if (mask) return p + i + __builtin_ctz(mask);
+    }
+    return ci_scan_sse2(p + i, n - i, delim);
+}
+#endif
+
+static const ci_scan_variant ci_scan_table[] = {
+    {"scalar", ci_scan_scalar},
+    {"swar", ci_scan_swar},
+#ifdef CI_SCAN_X86
+    {"sse2", ci_scan_sse2},
+    {"avx2", ci_scan_avx2},
+#endif
+};
+
+/**
+ * @brief Pick the widest kernel the running CPU supports.
+ */
+static void ci_scan_select(void) {
+#ifdef CI_SCAN_X86
+    __builtin_cpu_init();
+    ci_scan_impl = __builtin_cpu_supports("avx2") ? ci_scan_avx2 : ci_scan_sse2;
+#else
+    ci_scan_impl = ci_scan_swar;
+#endif
+}
+
+void ci_scan_init(void) {
+    pthread_once(&ci_scan_once, ci_scan_select);
+}
+
+const char *ci_scan(const char *p, size_t n, char delim) {
+    return ci_scan_impl(p, n, delim);
+}
+
+const ci_scan_variant *ci_scan_variants(size_t *count) {
+    size_t total = sizeof(ci_scan_table) / sizeof(ci_scan_table[0]);
+#ifdef CI_SCAN_X86
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("avx2")) total--;
+#endif
+    if (count) *count = total;
+    return ci_scan_table;
+}
+
+const char *ci_scan_selected(void) {
+    ci_scan_init();
+    size_t total = sizeof(ci_scan_table) / sizeof(ci_scan_table[0]);
+    for (size_t i = 0; i < total; i++) {
+        if (ci_scan_table[i].fn == ci_scan_impl) return ci_scan_table[i].name;
+    }
+    return "unknown";
+}
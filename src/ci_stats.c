@@ -0,0 +1,246 @@
+#include "ci_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CI_STATS_CACHE 4
+
+/*
+ * Every thread that dispatches lines for a context counts into a shard of
+ * its own, found through a small thread-local cache keyed by the set's id, so
+ * counting is a few plain stores. Snapshots sum the shards under the set's
+ * mutex. Shards are never freed before the set: a thread that exits gives its
+ * shard up, and the next thread to count takes it over with its totals.
+ */
+typedef struct {
+    uint64_t id;
+    ci_stats_shard *shard;
+} ci_stats_slot;
+
+static CI_THREAD_LOCAL ci_stats_slot ci_stats_cache[CI_STATS_CACHE];
+static CI_THREAD_LOCAL unsigned ci_stats_victim = 0;
+static uint64_t ci_stats_next_id = 0;
+
+void ci_stats_init(ci_stats_set *set) {
+    set->enabled = false;
+    set->id = ci_atomic_add(&ci_stats_next_id, 1);
+    pthread_mutex_init(&set->mutex, NULL);
+    set->shards = NULL;
+    set->baseline = NULL;
+}
+
+void ci_stats_destroy(ci_stats_set *set) {
+    while (set->shards) {
+        ci_stats_shard *next = set->shards->next;
+        free(set->shards);
+        set->shards = next;
+    }
+    free(set->baseline);
+    set->baseline = NULL;
+    pthread_mutex_destroy(&set->mutex);
+}
+
+ci_stats_shard *ci_stats_local(ci_stats_set *set) {
+    for (unsigned i = 0; i < CI_STATS_CACHE; i++) {
+        if (ci_stats_cache[i].id == set->id) return ci_stats_cache[i].shard;
+    }
+
+    /* a thread evicted from the cache keeps its shard; look for it before adopting or adding one */
+    pthread_t self = pthread_self();
+    pthread_mutex_lock(&set->mutex);
+    ci_stats_shard *shard = NULL;
+    for (ci_stats_shard *s = set->shards; s && !shard; s = s->next) {
+        if (s->owned && pthread_equal(s->owner, self)) shard = s;
+    }
+    for (ci_stats_shard *s = set->shards; s && !shard; s = s->next) {
+        if (!s->owned) shard = s;
+    }
+    if (!shard) {
+        shard = calloc(1, sizeof(*shard));
+        if (shard) {
+            shard->next = set->shards;
+            set->shards = shard;
+        }
+    }
+    if (shard) {
+        shard->owner = self;
+        shard->owned = true;
+    }
+    pthread_mutex_unlock(&set->mutex);
+    if (!shard) return NULL;
+
+    ci_stats_slot *slot = &ci_stats_cache[ci_stats_victim++ % CI_STATS_CACHE];
+    slot->id = set->id;
+    slot->shard = shard;
+    return shard;
+}
+
+void ci_stats_detach(ci_stats_set *set) {
+    for (unsigned i = 0; i < CI_STATS_CACHE; i++) {
+        if (ci_stats_cache[i].id != set->id) continue;
+        pthread_mutex_lock(&set->mutex);
+        ci_stats_cache[i].shard->owned = false;
+        pthread_mutex_unlock(&set->mutex);
+        ci_stats_cache[i].id = 0;
+        ci_stats_cache[i].shard = NULL;
+    }
+}
+
+uint64_t ci_stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Bucket holding a value.
+ */
+static size_t ci_hist_index(uint64_t ns) {
+    if (ns < CI_HIST_SUB) return (size_t)ns;
+    unsigned msb = 63u - (unsigned)__builtin_clzll(ns);
+    if (msb > CI_HIST_MAX_MSB) return CI_HIST_BUCKETS - 1;
+    unsigned shift = msb - CI_HIST_SUB_BITS;
+    return (size_t)(msb - CI_HIST_SUB_BITS + 1) * CI_HIST_SUB + (size_t)((ns >> shift) & (CI_HIST_SUB - 1));
+}
+
+/**
+ * @brief Largest value that falls in a bucket.
+ */
+static uint64_t ci_hist_upper(size_t index) {
+    if (index < CI_HIST_SUB) return index;
+    unsigned shift = (unsigned)(index / CI_HIST_SUB) - 1;
+    uint64_t lower = (uint64_t)(CI_HIST_SUB + index % CI_HIST_SUB) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void ci_hist_add(ci_hist *hist, uint64_t ns) {
+    ci_stats_count(&hist->buckets[ci_hist_index(ns)], 1);
+    ci_stats_count(&hist->total_ns, ns);
+}
+
+void ci_hist_add_shared(ci_hist *hist, uint64_t ns) {
+    __atomic_fetch_add(&hist->buckets[ci_hist_index(ns)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->total_ns, ns, __ATOMIC_RELAXED);
+}
+
+void ci_stats_line(ci_stats_shard *shard, size_t len, uint64_t read_ns) {
+    /* one clock read serves both the latency and the callback start */
+    uint64_t now = ci_stats_now();
+    shard->mark = now;
+    ci_stats_count(&shard->lines, 1);
+    ci_stats_count(&shard->bytes, len);
+    if (read_ns) ci_hist_add(&shard->read_to_dispatch, now > read_ns ? now - read_ns : 0);
+}
+
+uint64_t ci_stats_callback(ci_stats_shard *shard, bool hit) {
+    uint64_t now = ci_stats_now();
+    uint64_t ns = now > shard->mark ? now - shard->mark : 0;
+    if (hit) {
+        ci_stats_count(&shard->command_hits, 1);
+    } else {
+        ci_stats_count(&shard->command_misses, 1);
+    }
+    ci_hist_add(&shard->callback, ns);
+    return ns;
+}
+
+/**
+ * @brief Add (sign 1) or subtract (sign -1) one histogram's relaxed counts into another.
+ */
+static void ci_hist_accumulate(ci_hist *sum, const ci_hist *hist, int sign) {
+    for (size_t i = 0; i < CI_HIST_BUCKETS; i++) {
+        uint64_t v = __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+        sum->buckets[i] = sign > 0 ? sum->buckets[i] + v : sum->buckets[i] - v;
+    }
+    uint64_t total = __atomic_load_n(&hist->total_ns, __ATOMIC_RELAXED);
+    sum->total_ns = sign > 0 ? sum->total_ns + total : sum->total_ns - total;
+}
+
+/**
+ * @brief Add (sign 1) or subtract (sign -1) a shard's relaxed counts into another.
+ */
+static void ci_stats_accumulate(ci_stats_shard *sum, const ci_stats_shard *shard, int sign) {
+    const uint64_t *src[] = {&shard->lines,          &shard->bytes,        &shard->overflows,
+                             &shard->parse_failures, &shard->command_hits, &shard->command_misses};
+    uint64_t *dst[] = {&sum->lines, &sum->bytes, &sum->overflows, &sum->parse_failures, &sum->command_hits,
+                       &sum->command_misses};
+    for (size_t i = 0; i < sizeof(src) / sizeof(src[0]); i++) {
+        uint64_t v = __atomic_load_n(src[i], __ATOMIC_RELAXED);
+        *dst[i] = sign > 0 ? *dst[i] + v : *dst[i] - v;
+    }
+    ci_hist_accumulate(&sum->read_to_dispatch, &shard->read_to_dispatch, sign);
+    ci_hist_accumulate(&sum->callback, &shard->callback, sign);
+}
+
+/**
+ * @brief Percentiles of a histogram whose counts are stable.
+ */
+static void ci_hist_summary(const ci_hist *hist, ci_latency_stats *out) {
+    memset(out, 0, sizeof(*out));
+    for (size_t i = 0; i < CI_HIST_BUCKETS; i++) out->count += hist->buckets[i];
+    out->total_ns = hist->total_ns;
+    if (out->count == 0) return;
+
+    static const unsigned permille[] = {500, 900, 990, 999};
+    uint64_t *targets[] = {&out->p50_ns, &out->p90_ns, &out->p99_ns, &out->p999_ns};
+    uint64_t seen = 0;
+    size_t next = 0;
+    for (size_t i = 0; i < CI_HIST_BUCKETS; i++) {
+        if (hist->buckets[i] == 0) continue;
+        seen += hist->buckets[i];
+        /* the sample at rank ceil(q * count) */
+        while (next < 4 && seen * 1000 >= out->count * permille[next]) *targets[next++] = ci_hist_upper(i);
+        out->max_ns = ci_hist_upper(i);
+    }
+}
+
+void ci_hist_summarize(const ci_hist *hist, ci_latency_stats *out) {
+    ci_hist *copy = calloc(1, sizeof(*copy));
+    if (!copy) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    ci_hist_accumulate(copy, hist, 1);
+    ci_hist_summary(copy, out);
+    free(copy);
+}
+
+/**
+ * @brief Sum every shard (caller holds the set's mutex).
+ */
+static void ci_stats_total(ci_stats_set *set, ci_stats_shard *sum) {
+    memset(sum, 0, sizeof(*sum));
+    for (const ci_stats_shard *s = set->shards; s; s = s->next) ci_stats_accumulate(sum, s, 1);
+}
+
+void ci_stats_snapshot(ci_stats_set *set, ci_stats *out) {
+    memset(out, 0, sizeof(*out));
+    ci_stats_shard *sum = malloc(sizeof(*sum));
+    if (!sum) return;
+
+    pthread_mutex_lock(&set->mutex);
+    ci_stats_total(set, sum);
+    if (set->baseline) ci_stats_accumulate(sum, set->baseline, -1);
+    pthread_mutex_unlock(&set->mutex);
+
+    out->lines = sum->lines;
+    out->bytes = sum->bytes;
+    out->overflows = sum->overflows;
+    out->parse_failures = sum->parse_failures;
+    out->command_hits = sum->command_hits;
+    out->command_misses = sum->command_misses;
+    ci_hist_summary(&sum->read_to_dispatch, &out->read_to_dispatch);
+    ci_hist_summary(&sum->callback, &out->callback);
+    free(sum);
+}
+
+bool ci_stats_reset(ci_stats_set *set) {
+    /* shards belong to their threads, so a reset moves the zero instead of clearing them */
+    pthread_mutex_lock(&set->mutex);
+    if (!set->baseline) set->baseline = malloc(sizeof(*set->baseline));
+    if (set->baseline) ci_stats_total(set, set->baseline);
+    bool ok = set->baseline != NULL;
+    pthread_mutex_unlock(&set->mutex);
+    return ok;
+}
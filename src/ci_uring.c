@@ -0,0 +1,486 @@
+#include "ci_internal.h"
+
+#include <stdlib.h>
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define CI_URING_ENTRIES 8
+#define CI_URING_BUFS 8
+#define CI_URING_TICK_MS 100
+/* IORING_OP_READ_MULTISHOT (Linux 6.7); older headers don't name it */
+#define CI_URING_OP_READ_MULTISHOT 49
+#define CI_URING_PROBE_OPS 256
+#define CI_URING_READ_TAG 1
+#define CI_URING_CANCEL_TAG 2
+#define CI_URING_WAKE_TAG 3
+
+/*
+ * Reads through io_uring using raw syscalls (no liburing). Where the kernel and
+ * file allow it, a single multishot read keeps delivering chunks into a ring of
+ * provided buffers, so while input arrives faster than it is consumed completions
+ * are reaped from shared memory without entering the kernel. Otherwise one read
+ * into a registered buffer is submitted and waited for in a single io_uring_enter.
+ * Completed chunks are copied into the caller's buffer as it asks for them.
+ */
+struct ci_uring {
+    int ring_fd;
+    int fd;
+    bool multishot;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_map;
+    size_t sq_map_len;
+    void *cq_map;
+    size_t cq_map_len;
+    size_t sqes_len;
+    unsigned to_submit;
+    char *bufs;
+    size_t buf_size;
+    unsigned nbufs;
+    struct io_uring_buf *ring; /* provided-buffer ring (multishot only) */
+    size_t ring_len;
+    unsigned short ring_tail;
+    bool armed;
+    bool data_seen;
+    const char *cur;
+    size_t cur_len;
+    size_t cur_off;
+    int cur_bid;
+    bool eof;
+    int error;
+    int wake_fd;     /* descriptor of the armed wake poll, or -1 */
+    bool woken;      /* the wake poll completed and hasn't been reported yet */
+};
+
+/**
+ * @brief io_uring_enter wrapper, optionally waiting up to timeout_ms for one completion.
+ * @param u Ring to enter.
+ * @param timeout_ms Milliseconds to wait; negative submits without waiting.
+ * @param syscalls Counter incremented per kernel entry.
+ * @return Syscall result (-1 with errno set on error; ETIME on timeout).
+ */
+static int ci_uring_enter(ci_uring *u, int timeout_ms, unsigned long *syscalls) {
+    unsigned submit = u->to_submit;
+    long ret;
+    (*syscalls)++;
+    if (timeout_ms < 0) {
+        ret = syscall(__NR_io_uring_enter, u->ring_fd, submit, 0, 0, NULL, 0);
+    } else {
+        struct __kernel_timespec ts;
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000LL;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        ret = syscall(__NR_io_uring_enter, u->ring_fd, submit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+                      sizeof(arg));
+    }
+    if (ret >= 0) u->to_submit -= (unsigned)ret < submit ? (unsigned)ret : submit;
+    return (int)ret;
+}
+
+/**
+ * @brief Queue a zeroed submission entry (submitted by the next ci_uring_enter).
+ * @param u Ring to queue on.
+ * @return Entry to fill in.
+ */
+static struct io_uring_sqe *ci_uring_get_sqe(ci_uring *u) {
+    unsigned tail = *u->sq_tail;
+    unsigned idx = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[idx] = idx;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    u->to_submit++;
+    return sqe;
+}
+
+/**
+ * @brief Queue the read that feeds the next completions (multishot or one fixed-buffer read).
+ * @param u Ring to arm.
+ */
+static void ci_uring_arm(ci_uring *u) {
+    struct io_uring_sqe *sqe = ci_uring_get_sqe(u);
+    sqe->fd = u->fd;
+    sqe->off = (uint64_t)-1; /* current file position */
+    if (u->multishot) {
+        sqe->opcode = CI_URING_OP_READ_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = 0;
+    } else {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->addr = (uint64_t)(uintptr_t)u->bufs;
+        sqe->len = (unsigned)u->buf_size;
+        sqe->buf_index = 0;
+    }
+    sqe->user_data = CI_URING_READ_TAG;
+    u->armed = true;
+}
+
+/**
+ * @brief Queue a one-shot poll on a wake descriptor, so a wakeup completes the same wait as the read.
+ * @param u Ring to arm.
+ * @param wake_fd Descriptor to watch.
+ */
+static void ci_uring_arm_wake(ci_uring *u, int wake_fd) {
+    struct io_uring_sqe *sqe = ci_uring_get_sqe(u);
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = wake_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = CI_URING_WAKE_TAG;
+    u->wake_fd = wake_fd;
+}
+
+/**
+ * @brief Hand a consumed provided buffer back to the kernel.
+ * @param u Ring owning the buffer.
+ * @param bid Buffer id.
+ */
+static void ci_uring_recycle(ci_uring *u, int bid) {
+    struct io_uring_buf *buf = &u->ring[u->ring_tail & (u->nbufs - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(u->bufs + (size_t)bid * u->buf_size);
+    buf->len = (unsigned)u->buf_size;
+    buf->bid = (unsigned short)bid;
+    u->ring_tail++;
+    /* the ring tail overlays bufs[0].resv */
+    __atomic_store_n(&u->ring[0].resv, u->ring_tail, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Switch to single fixed-buffer reads (file can't do multishot).
+ * @param u Ring to switch.
+ * @return true on success.
+ */
+static bool ci_uring_use_fixed(ci_uring *u) {
+    struct iovec iov;
+    iov.iov_base = u->bufs;
+    iov.iov_len = u->buf_size;
+    if (syscall(__NR_io_uring_register, u->ring_fd, IORING_REGISTER_BUFFERS, &iov, 1) != 0) return false;
+    u->multishot = false;
+    return true;
+}
+
+/**
+ * @brief Take the next completion, if one is posted, as the current chunk.
+ * @param u Ring to reap from.
+ * @return true if a completion was consumed (data, end-of-file or error).
+ */
+static bool ci_uring_reap(ci_uring *u) {
+    unsigned head = *u->cq_head;
+    if (head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) return false;
+
+    struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+    int res = cqe->res;
+    unsigned flags = cqe->flags;
+    uint64_t tag = cqe->user_data;
+    __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+    if (tag == CI_URING_WAKE_TAG) {
+        u->wake_fd = -1;
+        u->woken = res >= 0;
+        return true;
+    }
+    if (tag != CI_URING_READ_TAG) return true;
+
+    if (!(flags & IORING_CQE_F_MORE)) u->armed = false;
+    if (res > 0) {
+        int bid = u->multishot ? (int)(flags >> IORING_CQE_BUFFER_SHIFT) : 0;
+        u->cur = u->bufs + (size_t)bid * u->buf_size;
+        u->cur_len = (size_t)res;
+        u->cur_off = 0;
+        u->cur_bid = bid;
+        u->data_seen = true;
+    } else if (res == 0) {
+        u->eof = true;
+    } else if (res == -ENOBUFS) {
+        /* every buffer was full; rearmed once the current chunk is consumed */
+    } else if (u->multishot && !u->data_seen && (res == -EINVAL || res == -EBADFD || res == -EOPNOTSUPP)) {
+        if (!ci_uring_use_fixed(u)) u->error = -res;
+    } else if (res == -ECANCELED) {
+        /* the thread that armed the read exited (a stopped context); the next fetch rearms it */
+    } else if (res != -EINTR && res != -EAGAIN) {
+        u->error = -res;
+    }
+    return true;
+}
+
+/**
+ * @brief Whether the wake poll completed and the wakeup is still pending.
+ * @param u Ring to check.
+ * @param wake_fd Wake descriptor, or -1.
+ * @return true if wake_fd is readable after a completed poll.
+ */
+static bool ci_uring_woken(ci_uring *u, int wake_fd) {
+    if (wake_fd < 0 || !u->woken) return false;
+    /* the poll may have fired for a wakeup that was drained since */
+    struct pollfd pfd = {wake_fd, POLLIN, 0};
+    if (poll(&pfd, 1, 0) > 0) return true;
+    u->woken = false;
+    return false;
+}
+
+/**
+ * @brief Make sure a chunk, end-of-file, an error or a wakeup is available.
+ * @param u Ring to wait on.
+ * @param timeout_ms Milliseconds to wait; -1 blocks.
+ * @param wake_fd Descriptor whose readability ends the wait, or -1.
+ * @param syscalls Counter incremented per kernel entry.
+ * @return true if something is available, false on timeout.
+ */
+static bool ci_uring_fetch(ci_uring *u, int timeout_ms, int wake_fd, unsigned long *syscalls) {
+    int waited = 0;
+    for (;;) {
+        if (u->cur_off < u->cur_len || u->eof || u->error) return true;
+        if (ci_uring_reap(u)) continue;
+        if (ci_uring_woken(u, wake_fd)) return true;
+        if (!u->armed) ci_uring_arm(u);
+        /* a poll left armed by an earlier wait keeps serving later ones */
+        if (wake_fd >= 0 && u->wake_fd != wake_fd) ci_uring_arm_wake(u, wake_fd);
+
+        int tick = CI_URING_TICK_MS;
+        if (timeout_ms >= 0) {
+            if (waited >= timeout_ms) {
+                if (u->to_submit > 0) ci_uring_enter(u, -1, syscalls);
+                return ci_uring_reap(u) && (u->cur_off < u->cur_len || u->eof || u->error);
+            }
+            if (timeout_ms - waited < tick) tick = timeout_ms - waited;
+        }
+        if (ci_uring_enter(u, tick, syscalls) < 0) {
+            if (errno == ETIME) {
+                waited += tick;
+            } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                u->error = errno;
+            }
+        }
+    }
+}
+
+ssize_t ci_uring_read(ci_uring *u, char *dst, size_t cap, int wake_fd, unsigned long *syscalls) {
+    ci_uring_fetch(u, -1, wake_fd, syscalls);
+    if (ci_uring_woken(u, wake_fd)) {
+        u->woken = false;
+        return CI_READ_WOKEN;
+    }
+    if (u->cur_off < u->cur_len) {
+        size_t n = u->cur_len - u->cur_off;
+        if (n > cap) n = cap;
+        memcpy(dst, u->cur + u->cur_off, n);
+        u->cur_off += n;
+        if (u->cur_off == u->cur_len && u->multishot) ci_uring_recycle(u, u->cur_bid);
+        return (ssize_t)n;
+    }
+    if (u->error) {
+        errno = u->error;
+        return -1;
+    }
+    return 0;
+}
+
+bool ci_uring_wait(ci_uring *u, int timeout_ms, int wake_fd, unsigned long *syscalls) {
+    return ci_uring_fetch(u, timeout_ms, wake_fd, syscalls);
+}
+
+/**
+ * @brief Check whether the running kernel supports an io_uring opcode.
+ * @param ring_fd Ring to probe.
+ * @param op Opcode.
+ * @return true if supported.
+ */
+static bool ci_uring_supports(int ring_fd, unsigned op) {
+    size_t len = sizeof(struct io_uring_probe) + CI_URING_PROBE_OPS * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, len);
+    if (!probe) return false;
+    bool ok = syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, CI_URING_PROBE_OPS) == 0 &&
+              op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    return ok;
+}
+
+/**
+ * @brief Register the provided-buffer ring used by multishot reads.
+ * @param u Ring to set up.
+ * @return true on success.
+ */
+static bool ci_uring_use_multishot(ci_uring *u) {
+    u->ring_len = u->nbufs * sizeof(struct io_uring_buf);
+    void *ring = mmap(NULL, u->ring_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) return false;
+    u->ring = ring;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring;
+    reg.ring_entries = u->nbufs;
+    reg.bgid = 0;
+    if (syscall(__NR_io_uring_register, u->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        munmap(ring, u->ring_len);
+        u->ring = NULL;
+        return false;
+    }
+    for (unsigned i = 0; i < u->nbufs; i++) ci_uring_recycle(u, (int)i);
+    u->multishot = true;
+    return true;
+}
+
+/**
+ * @brief Map the submission and completion rings of a freshly set up io_uring.
+ * @param u Ring to map.
+ * @param p Parameters filled in by io_uring_setup.
+ * @return true on success.
+ */
+static bool ci_uring_map(ci_uring *u, const struct io_uring_params *p) {
+    u->sq_map_len = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    u->cq_map_len = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    bool single = (p->features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && u->cq_map_len > u->sq_map_len) u->sq_map_len = u->cq_map_len;
+
+    u->sq_map = mmap(NULL, u->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd,
+                     IORING_OFF_SQ_RING);
+    if (u->sq_map == MAP_FAILED) {
+        u->sq_map = NULL;
+        return false;
+    }
+    if (single) {
+        u->cq_map = u->sq_map;
+    } else {
+        u->cq_map = mmap(NULL, u->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd,
+                         IORING_OFF_CQ_RING);
+        if (u->cq_map == MAP_FAILED) {
+            u->cq_map = NULL;
+            return false;
+        }
+    }
+    u->sqes_len = p->sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd,
+                   IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        return false;
+    }
+
+    char *sq = u->sq_map;
+    char *cq = u->cq_map;
+    u->sq_tail = (unsigned *)(sq + p->sq_off.tail);
+    u->sq_mask = (unsigned *)(sq + p->sq_off.ring_mask);
+    u->sq_array = (unsigned *)(sq + p->sq_off.array);
+    u->cq_head = (unsigned *)(cq + p->cq_off.head);
+    u->cq_tail = (unsigned *)(cq + p->cq_off.tail);
+    u->cq_mask = (unsigned *)(cq + p->cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+    return true;
+}
+
+ci_uring *ci_uring_create(int fd, size_t buf_size) {
+    ci_uring *u = calloc(1, sizeof(*u));
+    if (!u) return NULL;
+    u->fd = fd;
+    u->wake_fd = -1;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    u->ring_fd = (int)syscall(__NR_io_uring_setup, CI_URING_ENTRIES, &p);
+    if (u->ring_fd < 0) {
+        free(u);
+        return NULL;
+    }
+    /* waits are timed (EXT_ARG); reads at the current position need RW_CUR_POS */
+    if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_RW_CUR_POS) || !ci_uring_map(u, &p)) {
+        ci_uring_destroy(u);
+        return NULL;
+    }
+
+    /* multishot reads only work on pollable files (pipes, sockets, ttys) */
+    struct stat st;
+    bool pollable = fstat(fd, &st) == 0 && !S_ISREG(st.st_mode) && !S_ISBLK(st.st_mode);
+    bool multishot = pollable && ci_uring_supports(u->ring_fd, CI_URING_OP_READ_MULTISHOT);
+
+    u->buf_size = buf_size;
+    u->nbufs = multishot ? CI_URING_BUFS : 1;
+    u->bufs = malloc(u->nbufs * buf_size);
+    bool ok = u->bufs != NULL;
+    if (ok && multishot) multishot = ci_uring_use_multishot(u);
+    if (ok && !multishot) ok = ci_uring_use_fixed(u);
+    if (!ok) {
+        ci_uring_destroy(u);
+        return NULL;
+    }
+    return u;
+}
+
+/**
+ * @brief Cancel an armed read and wait for its final completion, so the kernel
+ *        is done with the buffers before they are freed.
+ * @param u Ring to quiesce.
+ */
+static void ci_uring_cancel(ci_uring *u) {
+    if (!u->armed || !u->sqes) return;
+    unsigned long syscalls = 0;
+    struct io_uring_sqe *sqe = ci_uring_get_sqe(u);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = CI_URING_READ_TAG;
+    sqe->user_data = CI_URING_CANCEL_TAG;
+    for (int tries = 0; u->armed && tries < 10; tries++) {
+        if (ci_uring_enter(u, CI_URING_TICK_MS, &syscalls) < 0 && errno != ETIME && errno != EINTR) break;
+        while (ci_uring_reap(u)) {
+        }
+    }
+}
+
+void ci_uring_destroy(ci_uring *u) {
+    if (!u) return;
+    ci_uring_cancel(u);
+    if (u->ring) munmap(u->ring, u->ring_len);
+    if (u->sqes) munmap(u->sqes, u->sqes_len);
+    if (u->cq_map && u->cq_map != u->sq_map) munmap(u->cq_map, u->cq_map_len);
+    if (u->sq_map) munmap(u->sq_map, u->sq_map_len);
+    /* closing the ring cancels an armed read before its buffers go away */
+    if (u->ring_fd >= 0) close(u->ring_fd);
+    free(u->bufs);
+    free(u);
+}
+
+#else
+
+ci_uring *ci_uring_create(int fd, size_t buf_size) {
+    (void)fd;
+    (void)buf_size;
+    return NULL;
+}
+
+void ci_uring_destroy(ci_uring *u) {
+    (void)u;
+}
+
+ssize_t ci_uring_read(ci_uring *u, char *dst, size_t cap, int wake_fd, unsigned long *syscalls) {
+    (void)u;
+    (void)dst;
+    (void)cap;
+    (void)wake_fd;
+    (void)syscalls;
+    return -1;
+}
+
+bool ci_uring_wait(ci_uring *u, int timeout_ms, int wake_fd, unsigned long *syscalls) {
+    (void)u;
+    (void)timeout_ms;
+    (void)wake_fd;
+    (void)syscalls;
+    return false;
+}
+
+#endif
@@ -0,0 +1,202 @@
+#include "ci_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Verbs are matched on a trie built once per registry change. Case-sensitive
+ * and CI_CMD_NOCASE verbs live under separate roots, and a lookup walks both
+ * with one cursor each in the same pass over the line, so the cost depends on
+ * the line and never on how many verbs there are.
+ */
+
+static inline bool ci_is_blank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static inline unsigned char ci_lower(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? (unsigned char)(c + ('a' - 'A')) : c;
+}
+
+size_t ci_split_args(const char *text, size_t len, ci_arg *argv, size_t max_args) {
+    size_t argc = 0, i = 0;
+    if (!text || !argv) return 0;
+    while (argc < max_args) {
+        while (i < len && ci_is_blank(text[i])) i++;
+        if (i == len) break;
+        if (argc + 1 == max_args) {
+            /* the last slot takes the rest of the line, unsplit */
+            size_t end = len;
+            while (end > i && ci_is_blank(text[end - 1])) end--;
+            argv[argc].ptr = text + i;
+            argv[argc++].len = end - i;
+            break;
+        }
+        size_t start = i;
+        if (text[i] == '"') {
+            const char *close = memchr(text + i + 1, '"', len - i - 1);
+            start = i + 1;
+            i = close ? (size_t)(close - text) : len;
+            argv[argc].ptr = text + start;
+            argv[argc++].len = i - start;
+            if (i < len) i++;
+            continue;
+        }
+        while (i < len && !ci_is_blank(text[i])) i++;
+        argv[argc].ptr = text + start;
+        argv[argc++].len = i - start;
+    }
+    return argc;
+}
+
+bool ci_verb_valid(const char *verb) {
+    if (!verb || verb[0] == '\0' || verb[0] == ' ') return false;
+    size_t i = 0;
+    for (; verb[i]; i++) {
+        if (verb[i] == '\t' || (verb[i] == ' ' && verb[i + 1] == ' ')) return false;
+    }
+    return verb[i - 1] != ' ';
+}
+
+/* Mutable node used while building: children form a singly linked sibling list. */
+typedef struct {
+    uint32_t child;
+    uint32_t sibling;
+    uint32_t verb;
+    unsigned char byte;
+} ci_trie_draft;
+
+/**
+ * @brief Child of a draft node for a byte, created when missing.
+ * @return Child index, or 0 when out of memory.
+ */
+static uint32_t ci_trie_draft_child(ci_trie_draft **nodes, size_t *count, size_t *cap, uint32_t parent,
+                                    unsigned char byte) {
+    for (uint32_t c = (*nodes)[parent].child; c; c = (*nodes)[c].sibling) {
+        if ((*nodes)[c].byte == byte) return c;
+    }
+    if (*count == *cap) {
+        size_t grown = *cap * 2;
+        ci_trie_draft *bigger = grown <= UINT32_MAX ? realloc(*nodes, grown * sizeof(**nodes)) : NULL;
+        if (!bigger) return 0;
+        *nodes = bigger;
+        *cap = grown;
+    }
+    uint32_t c = (uint32_t)(*count)++;
+    (*nodes)[c].child = 0;
+    (*nodes)[c].verb = 0;
+    (*nodes)[c].byte = byte;
+    (*nodes)[c].sibling = (*nodes)[parent].child;
+    (*nodes)[parent].child = c;
+    return c;
+}
+
+ci_trie *ci_trie_build(ci_verb *const *verbs, size_t count) {
+    size_t cap = 64, n = CI_TRIE_ROOTS;
+    ci_trie_draft *draft = calloc(cap, sizeof(*draft));
+    if (!draft) return NULL;
+
+    for (size_t v = 0; v < count; v++) {
+        bool nocase = (verbs[v]->flags & CI_CMD_NOCASE) != 0;
+        uint32_t node = nocase ? 1 : 0;
+        for (size_t i = 0; i < verbs[v]->len; i++) {
+            unsigned char c = (unsigned char)verbs[v]->name[i];
+            node = ci_trie_draft_child(&draft, &n, &cap, node, nocase ? ci_lower(c) : c);
+            if (!node) {
+                free(draft);
+                return NULL;
+            }
+        }
+        draft[node].verb = (uint32_t)v + 1;
+    }
+
+    ci_trie *trie = calloc(1, sizeof(*trie));
+    uint32_t *order = malloc(n * sizeof(*order));
+    if (trie) {
+        trie->count = count;
+        trie->verbs = malloc((count ? count : 1) * sizeof(*trie->verbs));
+        trie->nodes = malloc(n * sizeof(*trie->nodes));
+        trie->edge_bytes = malloc(n * sizeof(*trie->edge_bytes));
+    }
+    if (!trie || !order || !trie->verbs || !trie->nodes || !trie->edge_bytes) {
+        ci_trie_free(trie);
+        free(order);
+        free(draft);
+        return NULL;
+    }
+    if (count) memcpy(trie->verbs, verbs, count * sizeof(*verbs));
+
+    /* breadth-first renumbering: order[k] is the draft node that becomes node k */
+    size_t next = CI_TRIE_ROOTS;
+    for (size_t k = 0; k < CI_TRIE_ROOTS; k++) order[k] = (uint32_t)k;
+    for (size_t k = 0; k < n; k++) {
+        const ci_trie_draft *d = &draft[order[k]];
+        ci_trie_node *node = &trie->nodes[k];
+        node->first_edge = (uint32_t)(next - CI_TRIE_ROOTS);
+        node->edge_count = 0;
+        node->verb = d->verb;
+        for (uint32_t c = d->child; c; c = draft[c].sibling) {
+            trie->edge_bytes[next - CI_TRIE_ROOTS] = draft[c].byte;
+            order[next++] = c;
+            node->edge_count++;
+        }
+    }
+    free(order);
+    free(draft);
+    return trie;
+}
+
+void ci_trie_free(ci_trie *trie) {
+    if (!trie) return;
+    free(trie->verbs);
+    free(trie->nodes);
+    free(trie->edge_bytes);
+    free(trie);
+}
+
+/**
+ * @brief Follow the edge for a byte, or return 0 (no node is reached through an edge as 0).
+ */
+static inline uint32_t ci_trie_step(const ci_trie *trie, uint32_t node, unsigned char c) {
+    const ci_trie_node *nd = &trie->nodes[node];
+    const unsigned char *edges = trie->edge_bytes + nd->first_edge;
+    const unsigned char *hit = memchr(edges, c, nd->edge_count);
+    return hit ? (uint32_t)(nd->first_edge + (uint32_t)(hit - edges) + CI_TRIE_ROOTS) : 0;
+}
+
+ci_verb *ci_trie_match(const ci_trie *trie, const char *line, size_t len, size_t *verb_end) {
+    if (!trie || trie->count == 0) return NULL;
+    ci_verb *best = NULL;
+    uint32_t exact = trie->nodes[0].edge_count ? 0 : UINT32_MAX;
+    uint32_t nocase = trie->nodes[1].edge_count ? 1 : UINT32_MAX;
+    size_t i = 0;
+
+    while (exact != UINT32_MAX || nocase != UINT32_MAX) {
+        /* a verb matches only where a word ends */
+        if (i == len || ci_is_blank(line[i])) {
+            uint32_t v = exact != UINT32_MAX ? trie->nodes[exact].verb : 0;
+            if (!v && nocase != UINT32_MAX) v = trie->nodes[nocase].verb;
+            if (v) {
+                best = trie->verbs[v - 1];
+                *verb_end = i;
+            }
+        }
+        if (i == len) break;
+
+        unsigned char c = (unsigned char)line[i++];
+        if (ci_is_blank((char)c)) {
+            /* a run of blanks in the line matches the single space of a verb */
+            c = ' ';
+            while (i < len && ci_is_blank(line[i])) i++;
+        }
+        if (exact != UINT32_MAX) {
+            exact = ci_trie_step(trie, exact, c);
+            if (!exact) exact = UINT32_MAX;
+        }
+        if (nocase != UINT32_MAX) {
+            nocase = ci_trie_step(trie, nocase, ci_lower(c));
+            if (!nocase) nocase = UINT32_MAX;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,55 @@
+#include "ci_internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * A pipe watched next to the input descriptor. Writing a byte makes a blocked
+ * poll return without interrupting anything else in the thread, so a stop
+ * never leaves a read half done the way cancellation could.
+ */
+
+void ci_wake_init(ci_wake *wake) {
+    wake->fds[0] = wake->fds[1] = -1;
+}
+
+bool ci_wake_open(ci_wake *wake) {
+    if (wake->fds[0] >= 0) return true;
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    for (int i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    wake->fds[0] = fds[0];
+    ci_atomic_store(&wake->fds[1], fds[1]);
+    return true;
+}
+
+void ci_wake_close(ci_wake *wake) {
+    for (int i = 0; i < 2; i++) {
+        if (wake->fds[i] >= 0) close(wake->fds[i]);
+        wake->fds[i] = -1;
+    }
+}
+
+void ci_wake_signal(ci_wake *wake) {
+    int fd = ci_atomic_load(&wake->fds[1]);
+    if (fd < 0) return;
+    int saved = errno;
+    char byte = 0;
+    ssize_t n;
+    do {
+        n = write(fd, &byte, 1);
+    } while (n < 0 && errno == EINTR);
+    /* EAGAIN: the pipe is full, so a wakeup is already pending */
+    errno = saved;
+}
+
+void ci_wake_drain(ci_wake *wake) {
+    if (wake->fds[0] < 0) return;
+    char buf[64];
+    while (read(wake->fds[0], buf, sizeof(buf)) > 0) {
+    }
+}
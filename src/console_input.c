@@ -1,123 +1,152 @@
 #include "console_input.h"
+#include "ci_internal.h"
 
-#include <ctype.h>
-#include <errno.h>
 #include <limits.h>
-#include <pthread.h>
-#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-#define CI_ASYNC_BUFFER 256
-
-typedef struct {
-    char command[CI_COMMAND_MAX_LEN];
-    ci_line_callback cb;
-    void *user_data;
-} ci_command_entry;
+ci_reader *ci_stdin_reader(void) {
+    ci_reader *reader = ci_reader_for_fd(STDIN_FILENO);
+    if (reader) reader->out = &ci_default_context()->out;
+    return reader;
+}
 
-static pthread_t ci_thread;
-static ci_line_callback ci_cb = NULL;
-static void *ci_cb_data = NULL;
-static const char *ci_prompt = NULL;
-static volatile bool ci_running = false;
-static volatile bool ci_stop_requested = false;
-static ci_command_entry ci_commands[CI_MAX_COMMANDS];
-static size_t ci_command_count = 0;
-static pthread_mutex_t ci_cmd_mutex = PTHREAD_MUTEX_INITIALIZER;
+void ci_prompt(ci_reader *reader, const char *prompt) {
+    ci_context *ctx = ci_default_context();
+    if (prompt && reader && ci_prompt_wanted(ctx->prompt_policy, reader, &ctx->out)) {
+        ci_output_write(&ctx->out, prompt);
+    }
+}
 
-static void *ci_async_thread(void *arg);
+/**
+ * @brief Count a synchronous read toward the default context's statistics.
+ * @param status Result of the read.
+ * @param buffer Line that was read.
+ * @return status.
+ */
+static ci_status ci_count_sync_read(ci_status status, const char *buffer) {
+    ci_stats_shard *shard = ci_stats_shard_for(&ci_default_context()->stats);
+    if (shard && status == CI_OK) ci_stats_line(shard, strlen(buffer), 0);
+    if (shard && status == CI_OVERFLOW) ci_stats_count(&shard->overflows, 1);
+    return status;
+}
 
 /**
  * @brief Read a single line with optional prompt into a buffer.
- * @param stream Input stream to read from.
- * @param prompt Optional prompt to write to stdout before reading.
+ * @param reader Buffered reader to pull the line from.
+ * @param prompt Optional prompt for stdout, subject to the prompt policy.
  * @param buffer Destination buffer for the line.
  * @param size Size of the destination buffer.
  * @return CI_OK on success, CI_EOF on end-of-file, CI_OVERFLOW on truncation, CI_INVALID on error.
  */
-static ci_status ci_read_line_internal(FILE *stream, const char *prompt, char *buffer, size_t size) {
-    if (!buffer || size == 0) return CI_INVALID;
+static ci_status ci_read_line_internal(ci_reader *reader, const char *prompt, char *buffer, size_t size) {
+    if (!reader || !buffer || size == 0) return CI_INVALID;
 
-    if (prompt) {
-        fputs(prompt, stdout);
-        fflush(stdout);
-    }
+    ci_prompt(reader, prompt);
+    return ci_count_sync_read(ci_reader_read_line(reader, buffer, size), buffer);
+}
 
-    if (fgets(buffer, (int)size, stream) == NULL) {
-        return feof(stream) ? CI_EOF : CI_INVALID;
-    }
+/**
+ * @brief Read a line from a caller's stream through stdio, with the reader's line rules.
+ * @param stream Stream to read; whatever stdio has buffered is read first.
+ * @param buffer Destination buffer for the line.
+ * @param size Size of the destination buffer.
+ * @return CI_OK, CI_EOF, CI_OVERFLOW (rest of the line discarded) or CI_INVALID.
+ *
+ * A line of exactly size - 1 characters fits; "\r\n" endings are folded.
+ */
+static ci_status ci_stream_read_line(FILE *stream, char *buffer, size_t size) {
+    if (!buffer || size == 0) return CI_INVALID;
+    if (size > INT_MAX) size = INT_MAX;
+    if (!fgets(buffer, (int)size, stream)) return feof(stream) ? CI_EOF : CI_INVALID;
 
     size_t len = strlen(buffer);
-    if (len > 0 && buffer[len - 1] == '\n') {
-        buffer[len - 1] = '\0';
-    } else if (len + 1 == size) {
-        int c;
-        while ((c = fgetc(stream)) != '\n' && c != EOF) {
+    if (len + 1 == size && (len == 0 || buffer[len - 1] != '\n')) {
+        /* the buffer is full: the line still fits if its end comes next */
+        int c = getc(stream);
+        if (c == '\r' && (c = getc(stream)) != '\n') c = '\r';
+        if (c == EOF) return CI_OK;
+        if (c != '\n') {
+            while (c != '\n' && c != EOF) c = getc(stream);
+            return CI_OVERFLOW;
         }
-        return CI_OVERFLOW;
+        if (len > 0 && buffer[len - 1] == '\r') buffer[len - 1] = '\0';
+        return CI_OK;
+    }
+    if (len > 0 && buffer[len - 1] == '\n') {
+        buffer[--len] = '\0';
+        if (len > 0 && buffer[len - 1] == '\r') buffer[len - 1] = '\0';
     }
-
     return CI_OK;
 }
 
+/* Parses one scalar from a line for ci_prompt_numeric; flags are parser-specific. */
+typedef ci_status (*ci_number_parser)(const char *text, size_t len, unsigned flags, void *out);
+
 /**
  * @brief Parse a long from a string with overflow and validation checks.
- * @param input Input string to parse.
- * @param out_value Output pointer for parsed value.
+ * @param text Input string to parse.
+ * @param len Length of text.
+ * @param flags Unused.
+ * @param out Output pointer for the parsed long.
  * @return CI_OK on success, CI_OVERFLOW on range error, CI_INVALID on parse error.
  */
-static ci_status ci_parse_long(const char *input, long *out_value) {
-    if (!input || !out_value) return CI_INVALID;
-
-    errno = 0;
-    char *endptr = NULL;
-    long val = strtol(input, &endptr, 10);
-
-    if (errno == ERANGE || val > LONG_MAX || val < LONG_MIN) {
-        return CI_OVERFLOW;
-    }
+static ci_status ci_parse_long(const char *text, size_t len, unsigned flags, void *out) {
+    (void)flags;
+    int64_t val;
+    ci_status status = ci_parse_signed(text, len, 10, LONG_MIN, LONG_MAX, &val);
+    if (status == CI_OK) *(long *)out = (long)val;
+    return status;
+}
 
-    if (endptr == input || *endptr != '\0') {
-        return CI_INVALID;
-    }
+static ci_status ci_parse_double_cb(const char *text, size_t len, unsigned flags, void *out) {
+    return ci_parse_double(text, len, flags, out);
+}
 
-    *out_value = val;
-    return CI_OK;
+static ci_status ci_parse_float_cb(const char *text, size_t len, unsigned flags, void *out) {
+    return ci_parse_float(text, len, flags, out);
 }
 
 ci_status ci_read_line(FILE *stream, char *buffer, size_t size) {
-    return ci_read_line_internal(stream, NULL, buffer, size);
+    if (!stream) return CI_INVALID;
+    /* stdin belongs to the library's reader, shared with prompts and async input */
+    if (stream == stdin) return ci_read_line_internal(ci_stdin_reader(), NULL, buffer, size);
+    return ci_count_sync_read(ci_stream_read_line(stream, buffer, size), buffer);
 }
 
 ci_status ci_prompt_line(const char *prompt, char *buffer, size_t size) {
-    return ci_read_line_internal(stdin, prompt, buffer, size);
+    return ci_read_line_internal(ci_stdin_reader(), prompt, buffer, size);
 }
 
 /**
- * @brief Prompt repeatedly until a valid numeric (long) value is entered.
+ * @brief Prompt repeatedly until a valid number is entered.
  * @param prompt Prompt text to display.
- * @param out_value Output pointer for parsed long.
- * @return CI_OK on success, CI_EOF if input ends, CI_OVERFLOW on length/range issues, CI_INVALID on other errors.
+ * @param parse Parser for the value type.
+ * @param flags Passed to parse.
+ * @param out_value Output pointer for the parsed value.
+ * @return CI_OK on success, CI_EOF if input ends, CI_OVERFLOW/CI_UNDERFLOW on length/range issues, CI_INVALID on other errors.
  */
-static ci_status ci_prompt_numeric(const char *prompt, long *out_value) {
+static ci_status ci_prompt_numeric(const char *prompt, ci_number_parser parse, unsigned flags, void *out_value) {
     char buf[128];
     ci_status status;
 
+    if (!out_value) return CI_INVALID;
     while (1) {
         status = ci_prompt_line(prompt, buf, sizeof(buf));
         if (status == CI_EOF) return CI_EOF;
         if (status == CI_OVERFLOW) {
-            fprintf(stdout, "Input too long, try again.\n");
+            ci_output_write(&ci_default_context()->out, "Input too long, try again.\n");
             continue;
         }
         if (status != CI_OK) return status;
 
-        status = ci_parse_long(buf, out_value);
+        status = parse(buf, strlen(buf), flags, out_value);
         if (status == CI_INVALID) {
-            fprintf(stdout, "Invalid number, try again.\n");
+            ci_stats_shard *shard = ci_stats_shard_for(&ci_default_context()->stats);
+            if (shard) ci_stats_count(&shard->parse_failures, 1);
+            ci_output_write(&ci_default_context()->out, "Invalid number, try again.\n");
             continue;
         }
         return status;
@@ -126,7 +155,8 @@ static ci_status ci_prompt_numeric(const char *prompt, long *out_value) {
 
 ci_status ci_read_int(const char *prompt, int *out_value) {
     long val;
-    ci_status status = ci_prompt_numeric(prompt, &val);
+    if (!out_value) return CI_INVALID;
+    ci_status status = ci_prompt_numeric(prompt, ci_parse_long, 0, &val);
     if (status != CI_OK) return status;
 
     if (val > INT_MAX || val < INT_MIN) return CI_OVERFLOW;
@@ -135,156 +165,119 @@ ci_status ci_read_int(const char *prompt, int *out_value) {
 }
 
 ci_status ci_read_long(const char *prompt, long *out_value) {
-    return ci_prompt_numeric(prompt, out_value);
+    return ci_prompt_numeric(prompt, ci_parse_long, 0, out_value);
 }
 
-/**
- * @brief Lookup a registered command matching the given line.
- * @param line Input line to match.
- * @param out_entry Output copy of the matched entry when found.
- * @return true if a command matched, false otherwise.
- */
-static bool ci_lookup_command(const char *line, ci_command_entry *out_entry) {
-    if (!line || !out_entry) return false;
-
-    bool found = false;
-    pthread_mutex_lock(&ci_cmd_mutex);
-    for (size_t i = 0; i < ci_command_count; i++) {
-        if (strcmp(line, ci_commands[i].command) == 0) {
-            *out_entry = ci_commands[i];
-            found = true;
-            break;
-        }
-    }
-    pthread_mutex_unlock(&ci_cmd_mutex);
-    return found;
+ci_status ci_read_double(const char *prompt, unsigned flags, double *out_value) {
+    return ci_prompt_numeric(prompt, ci_parse_double_cb, flags, out_value);
 }
 
-/**
- * @brief Thread routine that reads lines and dispatches to commands/default callback.
- * @param arg Unused thread argument.
- * @return NULL when thread exits.
- */
-static void *ci_async_thread(void *arg) {
-    (void)arg;
-    char buffer[CI_ASYNC_BUFFER];
+ci_status ci_read_float(const char *prompt, unsigned flags, float *out_value) {
+    return ci_prompt_numeric(prompt, ci_parse_float_cb, flags, out_value);
+}
 
-    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+/* The async API below drives the default (stdin/stdout) context. */
 
-    while (ci_running && !ci_stop_requested) {
-        ci_status status = ci_read_line_internal(stdin, ci_prompt, buffer, sizeof(buffer));
-        if (status == CI_EOF) break;
-        if (status == CI_OVERFLOW) {
-            fprintf(stdout, "Input too long, try again.\n");
-            continue;
-        }
-        if (status != CI_OK) continue;
+ci_status ci_start_async_input(const char *prompt, ci_line_callback callback, void *user_data) {
+    return ci_context_start(ci_default_context(), prompt, callback, user_data, NULL);
+}
 
-        ci_command_entry entry;
-        if (ci_lookup_command(buffer, &entry) && entry.cb) {
-            entry.cb(buffer, entry.user_data);
-        } else if (ci_cb) {
-            ci_cb(buffer, ci_cb_data);
-        }
+ci_status ci_start_async_input_ex(const char *prompt,
+                                  ci_line_callback callback,
+                                  void *user_data,
+                                  const ci_async_options *options) {
+    return ci_context_start(ci_default_context(), prompt, callback, user_data, options);
+}
 
-        if (ci_stop_requested) break;
-    }
+ci_status ci_register_command(const char *command, ci_line_callback callback, void *user_data) {
+    return ci_context_register_command(ci_default_context(), command, callback, user_data, 0);
+}
 
-    ci_running = false;
-    ci_stop_requested = false;
-    return NULL;
+ci_status ci_register_command_ex(const char *command, ci_line_callback callback, void *user_data, unsigned flags) {
+    return ci_context_register_command(ci_default_context(), command, callback, user_data, flags);
 }
 
-ci_status ci_start_async_input(const char *prompt, ci_line_callback callback, void *user_data) {
-    if (!callback) return CI_INVALID;
-    if (ci_running) return CI_INVALID;
-
-    ci_cb = callback;
-    ci_cb_data = user_data;
-    ci_prompt = prompt;
-    ci_command_count = 0;
-    ci_stop_requested = false;
-    ci_running = true;
-
-    int rc = pthread_create(&ci_thread, NULL, ci_async_thread, NULL);
-    if (rc != 0) {
-        ci_running = false;
-        return CI_INVALID;
-    }
+ci_status ci_unregister_command(const char *command) {
+    return ci_context_unregister_command(ci_default_context(), command);
+}
 
-    return CI_OK;
+ci_status ci_set_command_table(const ci_command_table *table) {
+    return ci_context_set_command_table(ci_default_context(), table);
 }
 
-ci_status ci_register_command(const char *command, ci_line_callback callback, void *user_data) {
-    if (!command || !callback) return CI_INVALID;
-    if (strlen(command) >= CI_COMMAND_MAX_LEN) return CI_OVERFLOW;
-
-    pthread_mutex_lock(&ci_cmd_mutex);
-
-    /* replace if already present */
-    for (size_t i = 0; i < ci_command_count; i++) {
-        if (strcmp(command, ci_commands[i].command) == 0) {
-            ci_commands[i].cb = callback;
-            ci_commands[i].user_data = user_data;
-            pthread_mutex_unlock(&ci_cmd_mutex);
-            return CI_OK;
-        }
-    }
+ci_status ci_register_verb(const char *verb, ci_args_callback callback, void *user_data, unsigned flags) {
+    return ci_context_register_verb(ci_default_context(), verb, callback, user_data, flags);
+}
 
-    if (ci_command_count >= CI_MAX_COMMANDS) {
-        pthread_mutex_unlock(&ci_cmd_mutex);
-        return CI_OVERFLOW;
-    }
+ci_status ci_unregister_verb(const char *verb) {
+    return ci_context_unregister_verb(ci_default_context(), verb);
+}
 
-    ci_command_entry *slot = &ci_commands[ci_command_count++];
-    strncpy(slot->command, command, CI_COMMAND_MAX_LEN);
-    slot->command[CI_COMMAND_MAX_LEN - 1] = '\0';
-    slot->cb = callback;
-    slot->user_data = user_data;
+ci_status ci_register_pattern(const char *pattern, ci_line_callback callback, void *user_data, unsigned flags) {
+    return ci_context_register_pattern(ci_default_context(), pattern, callback, user_data, flags);
+}
 
-    pthread_mutex_unlock(&ci_cmd_mutex);
-    return CI_OK;
+ci_status ci_unregister_pattern(const char *pattern) {
+    return ci_context_unregister_pattern(ci_default_context(), pattern);
 }
 
-ci_status ci_unregister_command(const char *command) {
-    if (!command) return CI_INVALID;
-
-    pthread_mutex_lock(&ci_cmd_mutex);
-    for (size_t i = 0; i < ci_command_count; i++) {
-        if (strcmp(command, ci_commands[i].command) == 0) {
-            ci_command_count--;
-            if (i != ci_command_count) {
-                ci_commands[i] = ci_commands[ci_command_count];
-            }
-            pthread_mutex_unlock(&ci_cmd_mutex);
-            return CI_OK;
-        }
-    }
-    pthread_mutex_unlock(&ci_cmd_mutex);
+void ci_stop_async_input(void) {
+    ci_context_stop(ci_default_context());
+}
 
-    return CI_INVALID;
+void ci_request_stop_async_input(void) {
+    ci_context_request_stop(ci_default_context());
 }
 
-void ci_stop_async_input(void) {
-    if (!ci_running) return;
+bool ci_async_is_running(void) {
+    return ci_context_is_running(ci_default_context());
+}
 
-    ci_stop_requested = true;
-    pthread_cancel(ci_thread);
-    pthread_join(ci_thread, NULL);
+int ci_get_fd(void) {
+    return ci_context_get_fd(ci_default_context());
+}
 
-    ci_running = false;
-    ci_cb = NULL;
-    ci_cb_data = NULL;
-    ci_prompt = NULL;
-    ci_command_count = 0;
-    ci_stop_requested = false;
+ci_status ci_process_ready(void) {
+    return ci_context_process_ready(ci_default_context());
 }
 
-void ci_request_stop_async_input(void) {
-    ci_stop_requested = true;
+ci_status ci_process_file(const char *path, ci_line_callback callback, void *user_data,
+                          const ci_file_options *options) {
+    return ci_context_process_file(ci_default_context(), path, callback, user_data, options);
 }
 
-bool ci_async_is_running(void) {
-    return ci_running;
+void ci_set_prompt_policy(ci_prompt_policy policy) {
+    ci_context_set_prompt_policy(ci_default_context(), policy);
+}
+
+ci_status ci_get_arena_stats(ci_arena_stats *out) {
+    return ci_context_get_arena_stats(ci_default_context(), out);
+}
+
+ci_status ci_inject_line(const char *line, size_t len) {
+    return ci_context_inject_line(ci_default_context(), line, len);
+}
+
+ci_status ci_inject_lines(const ci_line_view *lines, size_t count) {
+    return ci_context_inject_lines(ci_default_context(), lines, count);
+}
+
+ci_status ci_get_ingest_stats(ci_ingest_stats *out) {
+    return ci_context_get_ingest_stats(ci_default_context(), out);
+}
+
+ci_status ci_enable_stats(bool enable) {
+    return ci_context_enable_stats(ci_default_context(), enable);
+}
+
+ci_status ci_get_stats(ci_stats *out) {
+    return ci_context_get_stats(ci_default_context(), out);
+}
+
+void ci_reset_stats(void) {
+    ci_context_reset_stats(ci_default_context());
+}
+
+ci_status ci_get_command_stats(const char *command, ci_latency_stats *out) {
+    return ci_context_get_command_stats(ci_default_context(), command, out);
 }
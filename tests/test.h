@@ -103,6 +103,7 @@ static inline void wait_millis(int millis) {
 
 /* Temporarily redirect stdout to /dev/null; returns previous fd, or -1 on error. */
 static inline int suppress_stdout(void) {
+    fflush(stdout);
     int devnull = open("/dev/null", O_WRONLY);
     if (devnull < 0) return -1;
     int saved = dup(STDOUT_FILENO);
@@ -120,6 +121,7 @@ static inline int suppress_stdout(void) {
 }
 
 static inline void restore_stdout(int saved_fd) {
+    fflush(stdout); /* messages are queued on stdout's buffer until the reader blocks */
     if (saved_fd >= 0) {
         dup2(saved_fd, STDOUT_FILENO);
         close(saved_fd);
@@ -1,8 +1,12 @@
 #include "console_input.h"
+#include "ci_internal.h"
 #include "test.h"
 
+#include <poll.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 static volatile int default_calls = 0;
 static volatile int cmd_calls = 0;
@@ -28,6 +32,96 @@ static void quit_cb(const char *line, void *user_data) {
     ci_request_stop_async_input();
 }
 
+static volatile int slow_started = 0;
+static volatile int slow_finished = 0;
+
+static void slow_cb(const char *line, void *user_data) {
+    (void)user_data;
+    (void)line;
+    slow_started = 1;
+    wait_millis(100);
+    slow_finished = 1;
+}
+
+static void self_unregister_cb(const char *line, void *user_data) {
+    (void)user_data;
+    cmd_calls++;
+    ci_unregister_command(line);
+}
+
+static int in_flight = 0;
+static int max_in_flight = 0;
+static int serial_in_flight = 0;
+static int serial_max_in_flight = 0;
+static int work_done = 0;
+
+static void track_max(int *counter, int *max) {
+    int now = __atomic_add_fetch(counter, 1, __ATOMIC_SEQ_CST);
+    int seen = __atomic_load_n(max, __ATOMIC_SEQ_CST);
+    while (now > seen && !__atomic_compare_exchange_n(max, &seen, now, false, __ATOMIC_SEQ_CST,
+                                                      __ATOMIC_SEQ_CST)) {
+    }
+}
+
+static void slow_parallel_cb(const char *line, void *user_data) {
+    (void)line;
+    (void)user_data;
+    track_max(&in_flight, &max_in_flight);
+    wait_millis(5);
+    __atomic_sub_fetch(&in_flight, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&work_done, 1, __ATOMIC_SEQ_CST);
+}
+
+static void slow_serial_cb(const char *line, void *user_data) {
+    (void)line;
+    (void)user_data;
+    track_max(&serial_in_flight, &serial_max_in_flight);
+    wait_millis(2);
+    __atomic_sub_fetch(&serial_in_flight, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&work_done, 1, __ATOMIC_SEQ_CST);
+}
+
+static int batch_lines = 0;
+static int batch_calls = 0;
+static size_t batch_largest = 0;
+static int lines_before_cmd = -1;
+static int batch_order_ok = 1;
+
+static void batch_cb(const ci_line_view *lines, size_t count, void *user_data) {
+    (void)user_data;
+    for (size_t i = 0; i < count; i++) {
+        char expect[16];
+        snprintf(expect, sizeof(expect), "l%d", batch_lines);
+        if (lines[i].len != strlen(expect) || strcmp(lines[i].data, expect) != 0) batch_order_ok = 0;
+        batch_lines++;
+    }
+    batch_calls++;
+    if (count > batch_largest) batch_largest = count;
+}
+
+static void batch_cmd_cb(const char *line, void *user_data) {
+    (void)line;
+    (void)user_data;
+    lines_before_cmd = batch_lines;
+}
+
+#define CTX_COUNT 24
+
+typedef struct {
+    int lines;
+    int pings;
+} ctx_counts;
+
+static void ctx_line_cb(const char *line, void *user_data) {
+    (void)line;
+    ((ctx_counts *)user_data)->lines++;
+}
+
+static void ctx_ping_cb(const char *line, void *user_data) {
+    (void)line;
+    ((ctx_counts *)user_data)->pings++;
+}
+
 static void reset_counters(void) {
     default_calls = 0;
     cmd_calls = 0;
@@ -145,32 +239,998 @@ static void test_stop_via_request(void) {
     restore_stdin_from_fd(saved_fd);
 }
 
-static void test_command_capacity_limit(void) {
+static void test_command_registry_grows(void) {
     reset_counters();
-    /* Ensure registry is clean */
-    ci_start_async_input("", default_cb, NULL);
-    ci_stop_async_input();
+    int saved_fd, write_fd;
+    replace_stdin_with_pipe(NULL, 0, &saved_fd, &write_fd);
+
+    ci_status st = ci_start_async_input("", default_cb, NULL);
+    ASSERT_STATUS(CI_OK, st);
 
-    for (int i = 0; i < CI_MAX_COMMANDS; i++) {
-        char name[16];
+    /* far beyond the old 32-entry table, plus a name longer than the old 64-byte limit */
+    char name[16];
+    for (int i = 0; i < 500; i++) {
         snprintf(name, sizeof(name), "cmd%d", i);
-        ci_status st = ci_register_command(name, cmd_cb, NULL);
-        ASSERT_STATUS(CI_OK, st);
+        ASSERT_STATUS(CI_OK, ci_register_command(name, cmd_cb, NULL));
     }
-    ci_status overflow = ci_register_command("extra", cmd_cb, NULL);
-    ASSERT_STATUS(CI_OVERFLOW, overflow);
+    char long_name[201];
+    memset(long_name, 'x', sizeof(long_name) - 1);
+    long_name[sizeof(long_name) - 1] = '\0';
+    ASSERT_STATUS(CI_OK, ci_register_command(long_name, quit_cb, NULL));
 
-    /* cleanup */
-    for (int i = 0; i < CI_MAX_COMMANDS; i++) {
-        char name[16];
-        snprintf(name, sizeof(name), "cmd%d", i);
-        ci_unregister_command(name);
+    write(write_fd, "cmd0\ncmd499\ncmd500\n", 19);
+    write(write_fd, long_name, strlen(long_name));
+    write(write_fd, "\n", 1);
+    close(write_fd);
+
+    for (int i = 0; i < 20 && quit_calls == 0; i++) {
+        wait_millis(10);
     }
+    ci_stop_async_input();
 
-    /* reset state */
-    quit_calls = 0;
-    default_calls = 0;
-    cmd_calls = 0;
+    ASSERT_EQ_INT(2, cmd_calls);
+    ASSERT_EQ_INT(1, default_calls); /* for 'cmd500' */
+    ASSERT_EQ_INT(1, quit_calls);
+
+    restore_stdin_from_fd(saved_fd);
+}
+
+static void test_registry_remove_keeps_chains(void) {
+    ci_registry reg = CI_REGISTRY_INIT;
+    ci_command_entry entry;
+    char name[16];
+
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "c%d", i);
+        ASSERT_STATUS(CI_OK, ci_registry_put(&reg, name, cmd_cb, (void *)(size_t)(i + 1), 0));
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        snprintf(name, sizeof(name), "c%d", i);
+        ASSERT_STATUS(CI_OK, ci_registry_remove(&reg, name));
+    }
+    ASSERT_STATUS(CI_INVALID, ci_registry_remove(&reg, "c0"));
+
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "c%d", i);
+        bool found = ci_registry_lookup(&reg, name, strlen(name), &entry);
+        ASSERT_TRUE(found == (i % 3 != 0), "lookup after removals");
+        if (found) ASSERT_TRUE(entry.user_data == (void *)(size_t)(i + 1), "entry data");
+    }
+
+    ci_registry_clear(&reg);
+    ASSERT_TRUE(!ci_registry_lookup(&reg, "c1", 2, &entry), "cleared");
+}
+
+static void test_unregister_waits_for_running_callback(void) {
+    reset_counters();
+    slow_started = 0;
+    slow_finished = 0;
+    int saved_fd, write_fd;
+    replace_stdin_with_pipe(NULL, 0, &saved_fd, &write_fd);
+
+    ASSERT_STATUS(CI_OK, ci_start_async_input("", default_cb, NULL));
+    ASSERT_STATUS(CI_OK, ci_register_command("slow", slow_cb, NULL));
+    ASSERT_STATUS(CI_OK, ci_register_command("self", self_unregister_cb, NULL));
+
+    write(write_fd, "slow\n", 5);
+    for (int i = 0; i < 100 && !slow_started; i++) {
+        wait_millis(1);
+    }
+    ASSERT_TRUE(slow_started, "slow callback started");
+    ASSERT_STATUS(CI_OK, ci_unregister_command("slow"));
+    ASSERT_TRUE(slow_finished, "callback must not outlive ci_unregister_command");
+
+    /* a callback may unregister its own command without deadlocking */
+    write(write_fd, "self\nself\n", 10);
+    close(write_fd);
+    for (int i = 0; i < 50 && default_calls == 0; i++) {
+        wait_millis(2);
+    }
+    ci_stop_async_input();
+
+    ASSERT_EQ_INT(1, cmd_calls);
+    ASSERT_EQ_INT(1, default_calls);
+
+    restore_stdin_from_fd(saved_fd);
+}
+
+static int reentrant_seq = 0;
+static int reentrant_done = 0;
+
+static void args_nop_cb(const char *line, const ci_arg *argv, size_t argc, void *user_data) {
+    (void)line;
+    (void)argv;
+    (void)argc;
+    (void)user_data;
+}
+
+/* Adds and drops commands of its own while callbacks on other workers do the same. */
+static void reentrant_cb(const char *line, void *user_data) {
+    (void)line;
+    ci_context *ctx = user_data;
+    char name[32];
+    snprintf(name, sizeof(name), "tmp%d", __atomic_add_fetch(&reentrant_seq, 1, __ATOMIC_SEQ_CST));
+    ASSERT_STATUS(CI_OK, ci_context_register_command(ctx, name, cmd_cb, NULL, 0));
+    ASSERT_STATUS(CI_OK, ci_context_register_verb(ctx, name, args_nop_cb, NULL, 0));
+    ASSERT_STATUS(CI_OK, ci_context_register_pattern(ctx, name, cmd_cb, NULL, 0));
+    wait_millis(1);
+    ASSERT_STATUS(CI_OK, ci_context_unregister_command(ctx, name));
+    ASSERT_STATUS(CI_OK, ci_context_unregister_verb(ctx, name));
+    ASSERT_STATUS(CI_OK, ci_context_unregister_pattern(ctx, name));
+    __atomic_add_fetch(&reentrant_done, 1, __ATOMIC_SEQ_CST);
+}
+
+static void test_register_from_workers(void) {
+    int fds[2];
+    ASSERT_TRUE(pipe(fds) == 0, "pipe");
+    ci_context *ctx = ci_context_create(fds[0], NULL);
+    ASSERT_TRUE(ctx != NULL, "context should be created");
+    ci_async_options opts = {0};
+    opts.workers = 4;
+    ASSERT_STATUS(CI_OK, ci_context_start(ctx, NULL, default_cb, NULL, &opts));
+    ASSERT_STATUS(CI_OK, ci_context_register_command(ctx, "reg", reentrant_cb, ctx, 0));
+
+    /* callbacks that register from inside their read sections must not wait on each other */
+    for (int i = 0; i < 64; i++) write(fds[1], "reg\n", 4);
+    for (int i = 0; i < 400 && __atomic_load_n(&reentrant_done, __ATOMIC_SEQ_CST) < 64; i++) wait_millis(5);
+    ASSERT_EQ_INT(64, __atomic_load_n(&reentrant_done, __ATOMIC_SEQ_CST));
+
+    /* a writer outside any callback still frees everything the callbacks retired */
+    ASSERT_STATUS(CI_OK, ci_context_unregister_command(ctx, "reg"));
+    close(fds[1]);
+    ci_context_stop(ctx);
+    ci_context_destroy(ctx);
+    close(fds[0]);
+}
+
+static void test_worker_pool_dispatch(void) {
+    reset_counters();
+    int saved_fd, write_fd;
+    replace_stdin_with_pipe(NULL, 0, &saved_fd, &write_fd);
+
+    ci_async_options opts = {0};
+    opts.workers = 4;
+    opts.queue_capacity = 8;
+    ASSERT_STATUS(CI_OK, ci_start_async_input_ex("", slow_parallel_cb, NULL, &opts));
+    ASSERT_STATUS(CI_OK, ci_register_command_ex("s", slow_serial_cb, NULL, CI_CMD_SERIAL));
+
+    /* 40 default lines and 20 serial commands, interleaved; more than the queue holds */
+    for (int i = 0; i < 20; i++) {
+        write(write_fd, "a\ns\nb\n", 6);
+    }
+    close(write_fd);
+
+    for (int i = 0; i < 200 && ci_async_is_running(); i++) {
+        wait_millis(5);
+    }
+    ci_stop_async_input();
+
+    ASSERT_EQ_INT(60, work_done);
+    ASSERT_TRUE(max_in_flight > 1, "default callbacks should overlap on workers");
+    ASSERT_EQ_INT(1, serial_max_in_flight);
+
+    restore_stdin_from_fd(saved_fd);
+}
+
+static void test_batch_callback(void) {
+    int saved_fd, write_fd;
+    replace_stdin_with_pipe(NULL, 0, &saved_fd, &write_fd);
+
+    ci_async_options opts = {0};
+    opts.batch_callback = batch_cb;
+    opts.max_batch = 16;
+    opts.max_wait_ms = 5;
+    ASSERT_STATUS(CI_OK, ci_start_async_input_ex("", NULL, NULL, &opts));
+    ASSERT_STATUS(CI_OK, ci_register_command("cmd", batch_cmd_cb, NULL));
+
+    char text[1024];
+    size_t pos = 0;
+    for (int i = 0; i < 100; i++) {
+        pos += (size_t)snprintf(text + pos, sizeof(text) - pos, "l%d\r\n", i);
+        if (i == 49) pos += (size_t)snprintf(text + pos, sizeof(text) - pos, "cmd\n");
+    }
+    write(write_fd, text, pos);
+    close(write_fd);
+
+    for (int i = 0; i < 100 && ci_async_is_running(); i++) {
+        wait_millis(5);
+    }
+    ci_stop_async_input();
+
+    ASSERT_EQ_INT(100, batch_lines);
+    ASSERT_TRUE(batch_order_ok, "batch views arrive in order with CRLF folded");
+    ASSERT_EQ_INT(50, lines_before_cmd);
+    ASSERT_TRUE(batch_largest <= 16, "batch capped at max_batch");
+    ASSERT_TRUE(batch_calls < 100, "lines are delivered in batches");
+
+    restore_stdin_from_fd(saved_fd);
+}
+
+static void test_pollable_mode(void) {
+    reset_counters();
+    int saved_fd, write_fd;
+    replace_stdin_with_pipe(NULL, 0, &saved_fd, &write_fd);
+
+    ASSERT_EQ_INT(-1, ci_get_fd());
+    ASSERT_STATUS(CI_INVALID, ci_process_ready());
+
+    ci_async_options opts = {0};
+    opts.pollable = true;
+    ASSERT_STATUS(CI_OK, ci_start_async_input_ex("", default_cb, NULL, &opts));
+    ASSERT_STATUS(CI_OK, ci_register_command("cmd", cmd_cb, NULL));
+    ASSERT_EQ_INT(STDIN_FILENO, ci_get_fd());
+
+    /* nothing written yet: must return without blocking */
+    ASSERT_STATUS(CI_OK, ci_process_ready());
+    ASSERT_EQ_INT(0, default_calls);
+
+    write(write_fd, "a\ncmd\nb", 8);
+    struct pollfd pfd = {ci_get_fd(), POLLIN, 0};
+    ASSERT_TRUE(poll(&pfd, 1, 1000) == 1, "input fd should become readable");
+    ASSERT_STATUS(CI_OK, ci_process_ready());
+    ASSERT_EQ_INT(1, default_calls);
+    ASSERT_EQ_INT(1, cmd_calls);
+
+    /* the partial line completes at end-of-file */
+    close(write_fd);
+    ci_status st = CI_OK;
+    for (int i = 0; i < 10 && st == CI_OK; i++) {
+        ASSERT_TRUE(poll(&pfd, 1, 1000) == 1, "end-of-file should be readable");
+        st = ci_process_ready();
+    }
+    ASSERT_STATUS(CI_EOF, st);
+    ASSERT_EQ_INT(2, default_calls);
+    ci_stop_async_input();
+    ASSERT_EQ_INT(-1, ci_get_fd());
+
+    restore_stdin_from_fd(saved_fd);
+}
+
+static void test_independent_contexts(void) {
+    ci_context *ctxs[CTX_COUNT];
+    ctx_counts counts[CTX_COUNT];
+    int write_fds[CTX_COUNT];
+    int read_fds[CTX_COUNT];
+
+    for (int i = 0; i < CTX_COUNT; i++) {
+        int fds[2];
+        ASSERT_TRUE(pipe(fds) == 0, "pipe");
+        read_fds[i] = fds[0];
+        write_fds[i] = fds[1];
+        memset(&counts[i], 0, sizeof(counts[i]));
+        ctxs[i] = ci_context_create(read_fds[i], NULL);
+        ASSERT_TRUE(ctxs[i] != NULL, "context should be created");
+        ASSERT_STATUS(CI_OK, ci_context_start(ctxs[i], "> ", ctx_line_cb, &counts[i], NULL));
+        ASSERT_STATUS(CI_OK, ci_context_register_command(ctxs[i], "ping", ctx_ping_cb, &counts[i], 0));
+    }
+    /* the default context is untouched by the others */
+    ASSERT_TRUE(!ci_async_is_running(), "default context stays stopped");
+    ASSERT_STATUS(CI_INVALID, ci_unregister_command("ping"));
+
+    /* context i gets i pings and 2*i plain lines */
+    for (int i = 0; i < CTX_COUNT; i++) {
+        for (int j = 0; j < i; j++) {
+            write(write_fds[i], "ping\nx\ny\n", 9);
+        }
+        close(write_fds[i]);
+    }
+    for (int i = 0; i < CTX_COUNT; i++) {
+        for (int tries = 0; tries < 200 && ci_context_is_running(ctxs[i]); tries++) {
+            wait_millis(5);
+        }
+        ASSERT_TRUE(!ci_context_is_running(ctxs[i]), "context stops at end of its input");
+        ci_context_destroy(ctxs[i]);
+        close(read_fds[i]);
+        ASSERT_EQ_INT(i, counts[i].pings);
+        ASSERT_EQ_INT(2 * i, counts[i].lines);
+    }
+}
+
+#define REACTOR_PIPES 50
+
+static void test_reactor_many_fds(void) {
+    ci_reactor *reactor = ci_reactor_create(3);
+    ASSERT_TRUE(reactor != NULL, "reactor should start");
+
+    ci_context *ctxs[REACTOR_PIPES];
+    ctx_counts counts[REACTOR_PIPES];
+    int write_fds[REACTOR_PIPES];
+    int read_fds[REACTOR_PIPES];
+    ci_async_options opts = {0};
+    opts.pollable = true;
+
+    for (int i = 0; i < REACTOR_PIPES; i++) {
+        int fds[2];
+        ASSERT_TRUE(pipe(fds) == 0, "pipe");
+        read_fds[i] = fds[0];
+        write_fds[i] = fds[1];
+        memset(&counts[i], 0, sizeof(counts[i]));
+        ctxs[i] = ci_context_create(read_fds[i], NULL);
+        ASSERT_TRUE(ctxs[i] != NULL, "context should be created");
+        ASSERT_STATUS(CI_INVALID, ci_reactor_add(reactor, ctxs[i]));
+        ASSERT_STATUS(CI_OK, ci_context_start(ctxs[i], NULL, ctx_line_cb, &counts[i], &opts));
+        ASSERT_STATUS(CI_OK, ci_context_register_command(ctxs[i], "ping", ctx_ping_cb, &counts[i], 0));
+        ASSERT_STATUS(CI_OK, ci_reactor_add(reactor, ctxs[i]));
+    }
+    ASSERT_STATUS(CI_INVALID, ci_reactor_add(reactor, ctxs[0]));
+
+    /* a regular file can't join an epoll set but is still served */
+    FILE *file = tmpfile();
+    ASSERT_TRUE(file != NULL, "tmpfile");
+    fputs("ping\na\nb\nc", file);
+    fflush(file);
+    rewind(file);
+    ctx_counts file_counts = {0, 0};
+    ci_context *file_ctx = ci_context_create(fileno(file), NULL);
+    ASSERT_STATUS(CI_OK, ci_context_start(file_ctx, NULL, ctx_line_cb, &file_counts, &opts));
+    ASSERT_STATUS(CI_OK, ci_context_register_command(file_ctx, "ping", ctx_ping_cb, &file_counts, 0));
+    ASSERT_STATUS(CI_OK, ci_reactor_add(reactor, file_ctx));
+
+    /* pipe i gets i pings and 2*i plain lines, in two writes */
+    for (int i = 1; i < REACTOR_PIPES; i++) {
+        for (int j = 0; j < i; j++) {
+            write(write_fds[i], "ping\nx\n", 7);
+        }
+        for (int j = 0; j < i; j++) {
+            write(write_fds[i], "y\n", 2);
+        }
+        close(write_fds[i]);
+    }
+
+    for (int i = 1; i < REACTOR_PIPES; i++) {
+        for (int tries = 0; tries < 400 && ci_context_is_running(ctxs[i]); tries++) {
+            wait_millis(5);
+        }
+        ASSERT_TRUE(!ci_context_is_running(ctxs[i]), "context stops at end of its input");
+        ASSERT_EQ_INT(i, counts[i].pings);
+        ASSERT_EQ_INT(2 * i, counts[i].lines);
+        ci_context_destroy(ctxs[i]);
+        close(read_fds[i]);
+    }
+    for (int tries = 0; tries < 400 && ci_context_is_running(file_ctx); tries++) {
+        wait_millis(5);
+    }
+    ASSERT_EQ_INT(1, file_counts.pings);
+    ASSERT_EQ_INT(3, file_counts.lines);
+    ci_context_destroy(file_ctx);
+    fclose(file);
+
+    /* an idle context can be removed while the reactor waits */
+    ASSERT_TRUE(ci_context_is_running(ctxs[0]), "idle context still attached");
+    ASSERT_STATUS(CI_OK, ci_reactor_remove(reactor, ctxs[0]));
+    ASSERT_TRUE(!ci_context_is_running(ctxs[0]), "removed context is stopped");
+    ASSERT_STATUS(CI_INVALID, ci_reactor_remove(reactor, ctxs[0]));
+    ci_context_destroy(ctxs[0]);
+    close(read_fds[0]);
+    close(write_fds[0]);
+
+    ci_reactor_destroy(reactor);
+}
+
+static void test_io_uring_context_stops(void) {
+    int fds[2];
+    ASSERT_TRUE(pipe(fds) == 0, "pipe");
+    ctx_counts counts = {0, 0};
+    ci_context *ctx = ci_context_create(fds[0], NULL);
+    ASSERT_TRUE(ctx != NULL, "context should be created");
+
+    ci_async_options opts = {0};
+    opts.backend = CI_BACKEND_IO_URING;
+    ASSERT_STATUS(CI_OK, ci_context_start(ctx, NULL, ctx_line_cb, &counts, &opts));
+    ASSERT_STATUS(CI_OK, ci_context_register_command(ctx, "ping", ctx_ping_cb, &counts, 0));
+    write(fds[1], "a\nping\nb\n", 9);
+    for (int tries = 0; tries < 200 && counts.lines < 2; tries++) {
+        wait_millis(5);
+    }
+    ASSERT_EQ_INT(2, counts.lines);
+    ASSERT_EQ_INT(1, counts.pings);
+
+    /* the reader thread is idle in the kernel; stopping must not hang */
+    ci_context_stop(ctx);
+    ASSERT_TRUE(!ci_context_is_running(ctx), "context stopped");
+    ci_context_destroy(ctx);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+typedef struct {
+    ci_context *ctx;
+    char seen[64];
+    int lines;
+} stop_log;
+
+static void stop_log_line(const char *line, void *user_data) {
+    stop_log *log = user_data;
+    strncat(log->seen, line, sizeof(log->seen) - strlen(log->seen) - 1);
+    log->lines++;
+}
+
+static void stop_log_batch(const ci_line_view *lines, size_t count, void *user_data) {
+    for (size_t i = 0; i < count; i++) stop_log_line(lines[i].data, user_data);
+}
+
+static void stop_log_stop(const char *line, void *user_data) {
+    (void)line;
+    ci_context_request_stop(((stop_log *)user_data)->ctx);
+}
+
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) * 1e3 + (double)(now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void test_stop_wakes_reader(void) {
+    for (int mode = 0; mode < 4; mode++) {
+        bool batch = mode & 1;
+        int fds[2];
+        ASSERT_TRUE(pipe(fds) == 0, "pipe");
+        stop_log log = {NULL, "", 0};
+        log.ctx = ci_context_create(fds[0], NULL);
+        ASSERT_TRUE(log.ctx != NULL, "context should be created");
+        ci_async_options opts = {0};
+        opts.backend = mode & 2 ? CI_BACKEND_IO_URING : CI_BACKEND_READ;
+        if (batch) opts.batch_callback = stop_log_batch;
+
+        /* a request while the thread waits on an idle pipe ends it without further input */
+        ASSERT_STATUS(CI_OK, ci_context_start(log.ctx, NULL, batch ? NULL : stop_log_line, &log, &opts));
+        wait_millis(20);
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ci_context_request_stop(log.ctx);
+        while (ci_context_is_running(log.ctx) && elapsed_ms(&start) < 1000) wait_millis(1);
+        ASSERT_TRUE(!ci_context_is_running(log.ctx), "request stops a thread blocked on input");
+        ASSERT_TRUE(elapsed_ms(&start) < 50, "stop takes effect without waiting for input");
+
+        /* lines behind the stopping command stay buffered for the next start */
+        ASSERT_STATUS(CI_OK, ci_context_start(log.ctx, NULL, batch ? NULL : stop_log_line, &log, &opts));
+        ASSERT_STATUS(CI_OK, ci_context_register_command(log.ctx, "stop", stop_log_stop, &log, 0));
+        write(fds[1], "a\nstop\nb\nc", 10);
+        for (int tries = 0; tries < 200 && ci_context_is_running(log.ctx); tries++) wait_millis(5);
+        ASSERT_TRUE(!ci_context_is_running(log.ctx), "stopped by command");
+        ASSERT_STR_EQ("a", log.seen);
+
+        ASSERT_STATUS(CI_OK, ci_context_start(log.ctx, NULL, batch ? NULL : stop_log_line, &log, &opts));
+        write(fds[1], "\n", 1);
+        for (int tries = 0; tries < 200 && log.lines < 3; tries++) wait_millis(5);
+        ASSERT_STR_EQ("abc", log.seen);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ci_context_stop(log.ctx);
+        ASSERT_TRUE(elapsed_ms(&start) < 50, "stop joins an idle thread promptly");
+        ci_context_destroy(log.ctx);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    /* after a stop, the default context hands the rest of stdin back to sync reads */
+    reset_counters();
+    int saved_fd, write_fd;
+    replace_stdin_with_pipe(NULL, 0, &saved_fd, &write_fd);
+    ASSERT_STATUS(CI_OK, ci_start_async_input(NULL, default_cb, NULL));
+    ASSERT_STATUS(CI_OK, ci_register_command("q", quit_cb, NULL));
+    write(write_fd, "x\nq\nrest\n", 9);
+    for (int tries = 0; tries < 200 && ci_async_is_running(); tries++) wait_millis(5);
+    ci_stop_async_input();
+    ASSERT_EQ_INT(1, default_calls);
+    char line[32];
+    ASSERT_STATUS(CI_OK, ci_read_line(stdin, line, sizeof(line)));
+    ASSERT_STR_EQ("rest", line);
+    close(write_fd);
+    restore_stdin_from_fd(saved_fd);
+}
+
+#define LONG_LINE 300000
+#define LINE_CAP 400000
+
+typedef struct {
+    int lines;
+    size_t bytes;
+    int nul_ok;
+    int long_ok;
+} view_counts;
+
+static void record_view(view_counts *counts, const char *line, size_t len) {
+    counts->lines++;
+    counts->bytes += len;
+    if (len == 4 && memcmp(line, "n\0ul", 5) == 0) counts->nul_ok = 1;
+    if (len == LONG_LINE && line[0] == 'x' && line[len - 1] == 'x' && line[len] == '\0') counts->long_ok = 1;
+}
+
+static void view_cb(const char *line, size_t len, void *user_data) {
+    record_view(user_data, line, len);
+}
+
+static void view_batch_cb(const ci_line_view *lines, size_t count, void *user_data) {
+    for (size_t i = 0; i < count; i++) record_view(user_data, lines[i].data, lines[i].len);
+}
+
+/* "a", a 300000-byte line, "n\0ul", a line over the cap, "end" (unterminated) */
+static int long_lines_file(void) {
+    char path[] = "/tmp/ci_long_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0, "mkstemp");
+    unlink(path);
+    char *big = malloc(LINE_CAP + 100);
+    ASSERT_TRUE(big != NULL, "malloc");
+    write(fd, "a\n", 2);
+    memset(big, 'x', LONG_LINE);
+    big[LONG_LINE] = '\n';
+    write(fd, big, LONG_LINE + 1);
+    write(fd, "n\0ul\r\n", 7);
+    memset(big, 'y', LINE_CAP + 99);
+    big[LINE_CAP + 99] = '\n';
+    write(fd, big, LINE_CAP + 100);
+    write(fd, "end", 3);
+    lseek(fd, 0, SEEK_SET);
+    free(big);
+    return fd;
+}
+
+static void test_long_lines(void) {
+    for (int mode = 0; mode < 4; mode++) {
+        int fd = long_lines_file();
+        view_counts counts = {0, 0, 0, 0};
+        ci_context *ctx = ci_context_create(fd, NULL);
+        ASSERT_TRUE(ctx != NULL, "context should be created");
+
+        ci_async_options opts = {0};
+        opts.max_line = LINE_CAP;
+        if (mode == 1) opts.batch_callback = view_batch_cb;
+        if (mode == 2) opts.pollable = true;
+        if (mode == 3) opts.workers = 2;
+        if (mode != 1) opts.view_callback = view_cb;
+        ASSERT_STATUS(CI_OK, ci_context_start(ctx, NULL, NULL, &counts, &opts));
+
+        if (mode == 2) {
+            ci_status st = CI_OK;
+            for (int i = 0; i < 1000 && st == CI_OK; i++) st = ci_context_process_ready(ctx);
+            ASSERT_STATUS(CI_EOF, st);
+        } else {
+            for (int tries = 0; tries < 400 && ci_context_is_running(ctx); tries++) {
+                wait_millis(5);
+            }
+        }
+        ci_context_destroy(ctx);
+        close(fd);
+
+        ASSERT_EQ_INT(4, counts.lines);
+        ASSERT_TRUE(counts.bytes == 1 + LONG_LINE + 4 + 3, "over-long line skipped, others whole");
+        ASSERT_TRUE(counts.long_ok, "long line delivered in one piece");
+        ASSERT_TRUE(counts.nul_ok, "embedded NUL kept with the length");
+    }
+
+    /* the buffer is grown once and then reused */
+    int fds[2];
+    ASSERT_TRUE(pipe(fds) == 0, "pipe");
+    ci_reader *reader = ci_reader_create(fds[0], 16);
+    ASSERT_TRUE(reader != NULL, "reader should be created");
+    write(fds[1], "0123456789abcdefghij\nshort\n0123456789abcdefghijklmn\n", 52);
+    close(fds[1]);
+    const char *line;
+    size_t len;
+    ASSERT_STATUS(CI_OK, ci_reader_next_line(reader, 64, &line, &len));
+    ASSERT_EQ_INT(20, (int)len);
+    ASSERT_STATUS(CI_OK, ci_reader_next_line(reader, 64, &line, &len));
+    ASSERT_STR_EQ("short", line);
+    char *grown = reader->buf;
+    size_t cap = reader->cap;
+    ASSERT_STATUS(CI_OK, ci_reader_next_line(reader, 64, &line, &len));
+    ASSERT_EQ_INT(24, (int)len);
+    ASSERT_TRUE(reader->buf == grown && reader->cap == cap, "no reallocation once grown");
+    ASSERT_STATUS(CI_EOF, ci_reader_next_line(reader, 64, &line, &len));
+    ci_reader_destroy(reader);
+    close(fds[0]);
+}
+
+#define ARENA_LINES 2000
+
+static const char *kept_lines[ARENA_LINES];
+static int kept_count = 0;
+static pthread_mutex_t kept_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* keep every line whose number is a multiple of 100, like a handler deferring work */
+static void retain_cb(const char *line, void *user_data) {
+    (void)user_data;
+    if (atoi(line + 4) % 100 != 0) return;
+    ci_line_retain(line);
+    pthread_mutex_lock(&kept_mutex);
+    kept_lines[kept_count++] = line;
+    pthread_mutex_unlock(&kept_mutex);
+}
+
+static void test_arena_lines(void) {
+    for (int workers = 0; workers <= 2; workers += 2) {
+        int fds[2];
+        ASSERT_TRUE(pipe(fds) == 0, "pipe");
+        ci_context *ctx = ci_context_create(fds[0], NULL);
+        ASSERT_TRUE(ctx != NULL, "context should be created");
+        kept_count = 0;
+
+        ci_arena_stats stats;
+        ASSERT_STATUS(CI_INVALID, ci_context_get_arena_stats(ctx, &stats));
+        ci_async_options opts = {0};
+        opts.workers = (unsigned)workers;
+        opts.arena_lines = true;
+        opts.arena_chunk_size = 512;
+        ASSERT_STATUS(CI_OK, ci_context_start(ctx, NULL, retain_cb, NULL, &opts));
+
+        char text[64];
+        for (int i = 0; i < ARENA_LINES; i++) {
+            int n = snprintf(text, sizeof(text), "line%d payload\n", i);
+            write(fds[1], text, (size_t)n);
+        }
+        /* longer than a chunk: gets a chunk of its own */
+        char big[1200];
+        memset(big, 'z', sizeof(big));
+        memcpy(big, "line7", 5);
+        big[sizeof(big) - 1] = '\n';
+        write(fds[1], big, sizeof(big));
+        close(fds[1]);
+
+        for (int tries = 0; tries < 400 && ci_context_is_running(ctx); tries++) {
+            wait_millis(5);
+        }
+        ASSERT_STATUS(CI_OK, ci_context_get_arena_stats(ctx, &stats));
+        ASSERT_TRUE(stats.lines == ARENA_LINES + 1, "every line copied into the arena");
+        ASSERT_TRUE(stats.oversize_lines == 1, "long line counted as oversize");
+        ASSERT_TRUE(stats.dropped_lines == 0, "no line dropped for lack of arena memory");
+        ASSERT_TRUE(stats.chunk_reuses > 0, "released chunks are recycled");
+        /* retained lines pin 20 chunks; with workers, queued lines pin a few more */
+        ASSERT_TRUE(workers > 0 || stats.chunk_allocs < 40, "chunks are reused rather than allocated per line");
+
+        /* retained lines outlive the callbacks and the context */
+        ci_context_destroy(ctx);
+        close(fds[0]);
+        ASSERT_EQ_INT(ARENA_LINES / 100, kept_count);
+        int seen = 0;
+        for (int i = 0; i < kept_count; i++) {
+            int n = atoi(kept_lines[i] + 4);
+            ASSERT_TRUE(n % 100 == 0, "retained line intact");
+            snprintf(text, sizeof(text), "line%d payload", n);
+            ASSERT_STR_EQ(text, kept_lines[i]);
+            seen += n;
+            ci_line_release(kept_lines[i]);
+        }
+        ASSERT_EQ_INT(19 * 20 / 2 * 100, seen);
+    }
+
+    /* a chunk goes back on the free list only once all its lines are released */
+    ci_arena *arena = ci_arena_create(64);
+    ASSERT_TRUE(arena != NULL, "arena should be created");
+    char *a = ci_arena_copy(arena, "alpha", 5);
+    char *b = ci_arena_copy(arena, "b\0b", 3);
+    ASSERT_TRUE(a && b, "copies");
+    ASSERT_EQ_INT(3, (int)ci_arena_line_len(b));
+    ci_line_retain(a);
+    ci_line_release(a);
+    ci_line_release(b);
+    char *c = ci_arena_copy(arena, "a line that does not fit", 24);
+    ci_arena_stats stats;
+    ci_arena_get_stats(arena, &stats);
+    ASSERT_TRUE(stats.chunks == 2 && stats.chunks_free == 0, "first chunk still held by a");
+    ci_line_release(a);
+    ci_arena_get_stats(arena, &stats);
+    ASSERT_TRUE(stats.chunks_free == 1, "first chunk recycled after its last release");
+    ASSERT_STR_EQ("a line that does not fit", c);
+    ci_arena_destroy(arena);
+    ci_line_release(c); /* frees the arena */
+}
+
+static void stats_line_cb(const char *line, void *user_data) {
+    (void)line;
+    (void)user_data;
+}
+
+static void stats_batch_cb(const ci_line_view *lines, size_t count, void *user_data) {
+    (void)lines;
+    (void)count;
+    (void)user_data;
+}
+
+static void test_stats(void) {
+    /* line loop, batches, pollable, workers; then the same with stats off */
+    for (int mode = 0; mode < 5; mode++) {
+        int fds[2];
+        ASSERT_TRUE(pipe(fds) == 0, "pipe");
+        ci_context *ctx = ci_context_create(fds[0], NULL);
+        ASSERT_TRUE(ctx != NULL, "context should be created");
+        ASSERT_STATUS(CI_OK, ci_context_enable_stats(ctx, mode < 4));
+
+        ci_async_options opts = {0};
+        opts.max_line = 8;
+        if (mode == 1) opts.batch_callback = stats_batch_cb;
+        if (mode == 2) opts.pollable = true;
+        if (mode == 3) opts.workers = 2;
+        ASSERT_STATUS(CI_OK, ci_context_start(ctx, NULL, stats_line_cb, NULL, &opts));
+        ASSERT_STATUS(CI_OK, ci_context_register_command(ctx, "ping", stats_line_cb, NULL, 0));
+        write(fds[1], "ping\na\nwaytoolongline\nping\nbb\nping\n", 35);
+        close(fds[1]);
+
+        if (mode == 2) {
+            ci_status st = CI_OK;
+            for (int i = 0; i < 1000 && st == CI_OK; i++) st = ci_context_process_ready(ctx);
+            ASSERT_STATUS(CI_EOF, st);
+        } else {
+            for (int tries = 0; tries < 400 && ci_context_is_running(ctx); tries++) wait_millis(5);
+        }
+        /* workers have drained once the thread reports stopped */
+        ci_stats stats;
+        ASSERT_STATUS(CI_OK, ci_context_get_stats(ctx, &stats));
+        ci_latency_stats ping;
+        ASSERT_STATUS(CI_OK, ci_context_get_command_stats(ctx, "ping", &ping));
+        ASSERT_STATUS(CI_INVALID, ci_context_get_command_stats(ctx, "pong", &ping));
+
+        if (mode == 4) {
+            ASSERT_TRUE(stats.lines == 0 && stats.overflows == 0 && ping.count == 0, "nothing counted while off");
+        } else {
+            ASSERT_EQ_INT(5, (int)stats.lines);
+            ASSERT_EQ_INT(15, (int)stats.bytes);
+            ASSERT_EQ_INT(1, (int)stats.overflows);
+            ASSERT_EQ_INT(3, (int)stats.command_hits);
+            ASSERT_EQ_INT(2, (int)stats.command_misses);
+            ASSERT_EQ_INT(5, (int)stats.read_to_dispatch.count);
+            ASSERT_EQ_INT(3, (int)ping.count);
+            if (mode != 1) ASSERT_EQ_INT(5, (int)stats.callback.count);
+            const ci_latency_stats *l = &stats.read_to_dispatch;
+            ASSERT_TRUE(l->p50_ns <= l->p90_ns && l->p90_ns <= l->p99_ns && l->p99_ns <= l->p999_ns &&
+                            l->p999_ns <= l->max_ns,
+                        "percentiles ordered");
+            ASSERT_TRUE(l->max_ns >= l->total_ns / l->count, "max at least the mean");
+
+            ASSERT_STATUS(CI_OK, ci_context_reset_stats(ctx));
+            ASSERT_STATUS(CI_OK, ci_context_get_stats(ctx, &stats));
+            ASSERT_STATUS(CI_OK, ci_context_get_command_stats(ctx, "ping", &ping));
+            ASSERT_TRUE(stats.lines == 0 && stats.command_hits == 0 && stats.callback.count == 0 && ping.count == 0,
+                        "reset starts from zero");
+        }
+        ci_context_destroy(ctx);
+        close(fds[0]);
+    }
+
+    /* the sync helpers count into the default context */
+    ASSERT_STATUS(CI_OK, ci_enable_stats(true));
+    ci_reset_stats();
+    const char *input = "x\n7\n";
+    int saved_fd;
+    replace_stdin_with_pipe(input, strlen(input), &saved_fd, NULL);
+    int saved_stdout = suppress_stdout();
+    int value = 0;
+    ASSERT_STATUS(CI_OK, ci_read_int(NULL, &value));
+    restore_stdout(saved_stdout);
+    restore_stdin_from_fd(saved_fd);
+    ci_stats stats;
+    ASSERT_STATUS(CI_OK, ci_get_stats(&stats));
+    ASSERT_EQ_INT(2, (int)stats.lines);
+    ASSERT_EQ_INT(1, (int)stats.parse_failures);
+    ASSERT_STATUS(CI_OK, ci_enable_stats(false));
+}
+
+static char overload_log[256];
+static volatile int hold_started = 0;
+static volatile int hold_release = 0;
+
+static void overload_log_cb(const char *line, void *user_data) {
+    (void)user_data;
+    strcat(overload_log, line);
+    strcat(overload_log, ",");
+}
+
+static void hold_cb(const char *line, void *user_data) {
+    overload_log_cb(line, user_data);
+    hold_started = 1;
+    while (!hold_release) wait_millis(1);
+}
+
+static void test_overload_policies(void) {
+    static const struct {
+        ci_overload_policy policy;
+        const char *input;    /* written while the only worker is held */
+        const char *expect;   /* callbacks run, in order */
+        int dropped_oldest;
+        int dropped_newest;
+        int coalesced;
+        int blocked;
+    } cases[] = {
+        {CI_OVERLOAD_DROP_NEWEST, "l0\nl1\nl2\nl3\nl4\nq\nl5\n", "hold,q,l0,l1,", 0, 4, 0, 0},
+        {CI_OVERLOAD_DROP_OLDEST, "l0\nl1\nl2\nl3\nl4\nq\nl5\n", "hold,q,l4,l5,", 4, 0, 0, 0},
+        {CI_OVERLOAD_COALESCE, "a\nb\na\nb\na\nq\nc\n", "hold,q,a,b,c,", 0, 0, 3, 1},
+        /* the reader holds l2 and l3 for the full lane and still reads q */
+        {CI_OVERLOAD_BLOCK, "l0\nl1\nl2\nl3\nq\n", "hold,q,l0,l1,l2,l3,", 0, 0, 0, 2},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int fds[2];
+        ASSERT_TRUE(pipe(fds) == 0, "pipe");
+        ci_context *ctx = ci_context_create(fds[0], NULL);
+        ASSERT_TRUE(ctx != NULL, "context should be created");
+        ci_ingest_stats stats;
+        ASSERT_STATUS(CI_INVALID, ci_context_get_ingest_stats(ctx, &stats));
+
+        overload_log[0] = '\0';
+        hold_started = 0;
+        hold_release = 0;
+        ci_async_options opts = {0};
+        opts.workers = 1;
+        opts.queue_capacity = 2;
+        opts.overload = cases[i].policy;
+        ASSERT_STATUS(CI_OK, ci_context_start(ctx, NULL, overload_log_cb, NULL, &opts));
+        ASSERT_STATUS(CI_OK, ci_context_register_command(ctx, "hold", hold_cb, NULL, 0));
+        ASSERT_STATUS(CI_OK, ci_context_register_command(ctx, "q", overload_log_cb, NULL, CI_CMD_PRIORITY));
+        write(fds[1], "hold\n", 5);
+        for (int tries = 0; tries < 400 && !hold_started; tries++) wait_millis(5);
+        ASSERT_TRUE(hold_started, "worker holds");
+
+        /* every line is read once dropped, coalesced, held or waited for */
+        write(fds[1], cases[i].input, strlen(cases[i].input));
+        int settled = 0;
+        for (int tries = 0; tries < 400 && !settled; tries++) {
+            ASSERT_STATUS(CI_OK, ci_context_get_ingest_stats(ctx, &stats));
+            settled = stats.priority == 1 && (int)stats.dropped_oldest == cases[i].dropped_oldest &&
+                      (int)stats.dropped_newest == cases[i].dropped_newest &&
+                      (int)stats.coalesced == cases[i].coalesced && (int)stats.blocked == cases[i].blocked;
+            if (!settled) wait_millis(5);
+        }
+        ASSERT_TRUE(settled, "drop counters");
+        hold_release = 1;
+        close(fds[1]);
+        for (int tries = 0; tries < 400 && ci_context_is_running(ctx); tries++) wait_millis(5);
+        ci_context_stop(ctx);
+        ASSERT_STR_EQ(cases[i].expect, overload_log);
+
+        /* counters outlive the stop */
+        ASSERT_STATUS(CI_OK, ci_context_get_ingest_stats(ctx, &stats));
+        ASSERT_EQ_INT(2, (int)stats.capacity);
+        ASSERT_EQ_INT(0, (int)stats.dropped_nomem);
+        int lines = 0;
+        for (const char *c = cases[i].input; *c; c++) lines += *c == '\n';
+        ASSERT_EQ_INT(lines - cases[i].dropped_newest - cases[i].coalesced + 1, (int)stats.queued);
+        ci_context_destroy(ctx);
+        close(fds[0]);
+    }
+
+    ci_context *ctx = ci_context_create(STDIN_FILENO, NULL);
+    ASSERT_TRUE(ctx != NULL, "context should be created");
+    ci_async_options opts = {0};
+    opts.overload = CI_OVERLOAD_DROP_OLDEST;
+    ASSERT_STATUS(CI_INVALID, ci_context_start(ctx, NULL, overload_log_cb, NULL, &opts));
+    opts.workers = 1;
+    opts.overload = (ci_overload_policy)42;
+    ASSERT_STATUS(CI_INVALID, ci_context_start(ctx, NULL, overload_log_cb, NULL, &opts));
+    ci_context_destroy(ctx);
+}
+
+enum { INJECT_PRODUCERS = 4, INJECT_LINES = 600, INJECT_BURST = 10 };
+
+typedef struct {
+    pthread_mutex_t mutex;
+    int lines;
+    int commands;
+    int next[INJECT_PRODUCERS]; /* next sequence number expected from each producer */
+    bool in_order;
+} inject_log;
+
+static void inject_record(inject_log *log, const char *line, size_t len) {
+    int producer, seq;
+    pthread_mutex_lock(&log->mutex);
+    if (sscanf(line, "p%d %d", &producer, &seq) == 2 && producer >= 0 && producer < INJECT_PRODUCERS &&
+        strlen(line) == len) {
+        if (seq != log->next[producer]) log->in_order = false;
+        log->next[producer] = seq + 1;
+        log->lines++;
+    } else {
+        log->in_order = false;
+    }
+    pthread_mutex_unlock(&log->mutex);
+}
+
+static void inject_line_cb(const char *line, void *user_data) {
+    inject_record(user_data, line, strlen(line));
+}
+
+static void inject_batch_cb(const ci_line_view *lines, size_t count, void *user_data) {
+    for (size_t i = 0; i < count; i++) inject_record(user_data, lines[i].data, lines[i].len);
+}
+
+static void inject_cmd_cb(const char *line, void *user_data) {
+    (void)line;
+    inject_log *log = user_data;
+    pthread_mutex_lock(&log->mutex);
+    log->commands++;
+    pthread_mutex_unlock(&log->mutex);
+}
+
+typedef struct {
+    ci_context *ctx;
+    int producer;
+    bool ok;
+} inject_producer;
+
+/* Even producers push one line per call, odd ones bursts of INJECT_BURST. */
+static void *inject_producer_main(void *arg) {
+    inject_producer *p = arg;
+    char text[INJECT_BURST][32];
+    ci_line_view views[INJECT_BURST];
+    p->ok = true;
+    for (int seq = 0; seq < INJECT_LINES; seq += INJECT_BURST) {
+        for (int i = 0; i < INJECT_BURST; i++) {
+            views[i].data = text[i];
+            views[i].len = (size_t)snprintf(text[i], sizeof(text[i]), "p%d %d", p->producer, seq + i);
+        }
+        if (p->producer % 2) {
+            if (ci_context_inject_lines(p->ctx, views, INJECT_BURST) != CI_OK) p->ok = false;
+        } else {
+            for (int i = 0; i < INJECT_BURST; i++) {
+                if (ci_context_inject_line(p->ctx, views[i].data, views[i].len) != CI_OK) p->ok = false;
+            }
+        }
+        if (seq == INJECT_LINES / 2 && ci_context_inject_line(p->ctx, "cmd", 3) != CI_OK) p->ok = false;
+    }
+    return NULL;
+}
+
+static void test_inject_lines(void) {
+    ASSERT_STATUS(CI_INVALID, ci_inject_line("x", 1));
+    ASSERT_STATUS(CI_INVALID, ci_context_inject_line(NULL, "x", 1));
+
+    for (int mode = 0; mode < 3; mode++) {
+        /* nothing is ever written: injection alone has to wake the input thread */
+        int fds[2];
+        ASSERT_TRUE(pipe(fds) == 0, "pipe");
+        ci_context *ctx = ci_context_create(fds[0], NULL);
+        ASSERT_TRUE(ctx != NULL, "context should be created");
+        ASSERT_STATUS(CI_INVALID, ci_context_inject_line(ctx, "x", 1));
+
+        inject_log log;
+        memset(&log, 0, sizeof(log));
+        pthread_mutex_init(&log.mutex, NULL);
+        log.in_order = true;
+        ci_async_options opts = {0};
+        opts.max_line = 16;
+        if (mode == 1) opts.workers = 2;
+        if (mode == 2) {
+            opts.batch_callback = inject_batch_cb;
+            opts.max_batch = 16;
+            opts.max_wait_ms = 5;
+        }
+        ASSERT_STATUS(CI_OK, ci_context_start(ctx, NULL, inject_line_cb, &log, &opts));
+        ASSERT_STATUS(CI_OK, ci_context_register_command(ctx, "cmd", inject_cmd_cb, &log, 0));
+        ASSERT_STATUS(CI_OVERFLOW, ci_context_inject_line(ctx, "seventeen bytes!!", 17));
+        ci_line_view bad = {NULL, 1};
+        ASSERT_STATUS(CI_INVALID, ci_context_inject_lines(ctx, &bad, 1));
+        ASSERT_STATUS(CI_OK, ci_context_inject_lines(ctx, NULL, 0));
+
+        pthread_t threads[INJECT_PRODUCERS];
+        inject_producer producers[INJECT_PRODUCERS];
+        for (int i = 0; i < INJECT_PRODUCERS; i++) {
+            producers[i].ctx = ctx;
+            producers[i].producer = i;
+            ASSERT_TRUE(pthread_create(&threads[i], NULL, inject_producer_main, &producers[i]) == 0, "producer");
+        }
+        for (int i = 0; i < INJECT_PRODUCERS; i++) {
+            pthread_join(threads[i], NULL);
+            ASSERT_TRUE(producers[i].ok, "every injection accepted");
+        }
+        /* a line that reached the queue before the stop still runs */
+        ci_context_stop(ctx);
+        ASSERT_EQ_INT(INJECT_PRODUCERS * INJECT_LINES, log.lines);
+        ASSERT_EQ_INT(INJECT_PRODUCERS, log.commands);
+        if (mode != 1) ASSERT_TRUE(log.in_order, "each producer's lines arrive in order");
+        ASSERT_STATUS(CI_INVALID, ci_context_inject_line(ctx, "x", 1));
+
+        pthread_mutex_destroy(&log.mutex);
+        ci_context_destroy(ctx);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    /* pollable mode has no input thread to pick lines up */
+    ci_context *ctx = ci_context_create(STDIN_FILENO, NULL);
+    ASSERT_TRUE(ctx != NULL, "context should be created");
+    ci_async_options opts = {0};
+    opts.pollable = true;
+    ASSERT_STATUS(CI_OK, ci_context_start(ctx, NULL, default_cb, NULL, &opts));
+    ASSERT_STATUS(CI_INVALID, ci_context_inject_line(ctx, "x", 1));
+    ci_context_destroy(ctx);
 }
 
 int main(void) {
@@ -178,7 +1238,22 @@ int main(void) {
     test_command_dispatch_and_default();
     test_command_replace_and_unregister();
     test_stop_via_request();
-    test_command_capacity_limit();
+    test_command_registry_grows();
+    test_registry_remove_keeps_chains();
+    test_unregister_waits_for_running_callback();
+    test_register_from_workers();
+    test_worker_pool_dispatch();
+    test_batch_callback();
+    test_pollable_mode();
+    test_independent_contexts();
+    test_reactor_many_fds();
+    test_io_uring_context_stops();
+    test_stop_wakes_reader();
+    test_long_lines();
+    test_arena_lines();
+    test_stats();
+    test_overload_policies();
+    test_inject_lines();
     printf("test_async passed\n");
     return 0;
 }
@@ -0,0 +1,188 @@
+#include "console_input.h"
+#include "test.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FILE_LINES 20000
+
+typedef struct {
+    pthread_mutex_t mutex;
+    long lines;
+    long cmds;
+    long long sum;
+    long last; /* ordered mode: previous line number */
+    int in_order;
+    int crlf_ok;
+    int tail_ok;
+    long stop_at; /* request a stop on this line number, or -1 */
+} file_counts;
+
+static void file_line_cb(const char *line, void *user_data) {
+    file_counts *c = user_data;
+    if (strcmp(line, "tail") == 0) {
+        c->tail_ok = 1;
+        return;
+    }
+    long n = strtol(line, NULL, 10);
+    pthread_mutex_lock(&c->mutex);
+    if (strchr(line, '\r')) c->crlf_ok = 0;
+    c->lines++;
+    c->sum += n;
+    if (n <= c->last) c->in_order = 0;
+    c->last = n;
+    pthread_mutex_unlock(&c->mutex);
+    if (n == c->stop_at) ci_request_stop_async_input();
+}
+
+static void file_cmd_cb(const char *line, void *user_data) {
+    file_counts *c = user_data;
+    (void)line;
+    pthread_mutex_lock(&c->mutex);
+    c->cmds++;
+    pthread_mutex_unlock(&c->mutex);
+}
+
+/* Lines "0".."FILE_LINES-1" with every 7th replaced by the command "cmd" and every 5th
+   ending in CRLF; a final "tail" has no newline. */
+static void write_test_file(const char *path) {
+    FILE *f = fopen(path, "wb");
+    ASSERT_TRUE(f != NULL, "fopen");
+    for (int i = 0; i < FILE_LINES; i++) {
+        if (i % 7 == 0) {
+            fprintf(f, "cmd%s\n", i % 5 == 0 ? "\r" : "");
+        } else {
+            fprintf(f, "%d%s\n", i, i % 5 == 0 ? "\r" : "");
+        }
+    }
+    fputs("tail", f);
+    fclose(f);
+}
+
+static void reset_file_counts(file_counts *c) {
+    c->lines = c->cmds = 0;
+    c->sum = 0;
+    c->last = -1;
+    c->in_order = 1;
+    c->crlf_ok = 1;
+    c->tail_ok = 0;
+    c->stop_at = -1;
+}
+
+static void test_process_file(void) {
+    char path[] = "/tmp/ci_file_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0, "mkstemp");
+    close(fd);
+    write_test_file(path);
+
+    file_counts c;
+    pthread_mutex_init(&c.mutex, NULL);
+    ASSERT_STATUS(CI_OK, ci_register_command("cmd", file_cmd_cb, &c));
+    long long expected = 0;
+    for (int i = 0; i < FILE_LINES; i++) expected += i % 7 ? i : 0;
+
+    /* small chunks put boundaries inside lines, on newlines and between CR and LF */
+    static const size_t chunks[] = {0, 1, 7, 64, 4096};
+    for (int ordered = 0; ordered <= 1; ordered++) {
+        for (size_t k = 0; k < sizeof(chunks) / sizeof(chunks[0]); k++) {
+            for (unsigned threads = 1; threads <= 4; threads += 3) {
+                reset_file_counts(&c);
+                ci_file_options opts = {0};
+                opts.threads = threads;
+                opts.ordered = ordered != 0;
+                opts.chunk_size = chunks[k];
+                ASSERT_STATUS(CI_OK, ci_process_file(path, file_line_cb, &c, &opts));
+                ASSERT_EQ_INT(FILE_LINES - (FILE_LINES + 6) / 7, c.lines);
+                ASSERT_EQ_INT((FILE_LINES + 6) / 7, c.cmds);
+                ASSERT_TRUE(c.sum == expected, "every line exactly once");
+                ASSERT_TRUE(c.crlf_ok, "CRLF folded");
+                ASSERT_TRUE(c.tail_ok, "final line without newline delivered");
+                if (ordered) ASSERT_TRUE(c.in_order, "ordered delivery keeps file order");
+            }
+        }
+    }
+
+    /* a stop request from a callback ends the replay */
+    reset_file_counts(&c);
+    c.stop_at = 701;
+    ci_file_options opts = {0};
+    opts.threads = 2;
+    opts.ordered = true;
+    opts.chunk_size = 256;
+    ASSERT_STATUS(CI_EOF, ci_process_file(path, file_line_cb, &c, &opts));
+    ASSERT_TRUE(c.lines < FILE_LINES / 2 && c.last == 701, "stopped right after the requesting line");
+    ASSERT_TRUE(c.in_order, "lines before the stop in order");
+
+    ASSERT_STATUS(CI_OK, ci_unregister_command("cmd"));
+    unlink(path);
+    pthread_mutex_destroy(&c.mutex);
+}
+
+static int register_seq = 0;
+
+/* A replay handler that changes the command set while handlers on other threads do too. */
+static void file_register_cb(const char *line, void *user_data) {
+    char name[32];
+    snprintf(name, sizeof(name), "tmp%d", __atomic_add_fetch(&register_seq, 1, __ATOMIC_SEQ_CST));
+    ASSERT_STATUS(CI_OK, ci_register_command(name, file_cmd_cb, user_data));
+    ASSERT_STATUS(CI_OK, ci_unregister_command(name));
+    file_cmd_cb(line, user_data);
+}
+
+static void test_process_file_registers(void) {
+    char path[] = "/tmp/ci_file_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0, "mkstemp");
+    close(fd);
+    write_test_file(path);
+
+    file_counts c;
+    pthread_mutex_init(&c.mutex, NULL);
+    reset_file_counts(&c);
+    ASSERT_STATUS(CI_OK, ci_register_command("cmd", file_register_cb, &c));
+    ci_file_options opts = {0};
+    opts.threads = 4;
+    opts.chunk_size = 512;
+    ASSERT_STATUS(CI_OK, ci_process_file(path, file_line_cb, &c, &opts));
+    ASSERT_EQ_INT((FILE_LINES + 6) / 7, c.cmds);
+    ASSERT_EQ_INT(FILE_LINES - (FILE_LINES + 6) / 7, c.lines);
+
+    ASSERT_STATUS(CI_OK, ci_unregister_command("cmd"));
+    unlink(path);
+    pthread_mutex_destroy(&c.mutex);
+}
+
+static void test_process_file_edges(void) {
+    char path[] = "/tmp/ci_file_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0, "mkstemp");
+
+    file_counts c;
+    pthread_mutex_init(&c.mutex, NULL);
+    reset_file_counts(&c);
+    ASSERT_STATUS(CI_OK, ci_process_file(path, file_line_cb, &c, NULL));
+    ASSERT_EQ_INT(0, c.lines);
+
+    /* empty lines count as lines */
+    write(fd, "\n\n1\n", 4);
+    close(fd);
+    reset_file_counts(&c);
+    ASSERT_STATUS(CI_OK, ci_process_file(path, file_line_cb, &c, NULL));
+    ASSERT_EQ_INT(3, c.lines);
+
+    ASSERT_STATUS(CI_INVALID, ci_process_file("/nonexistent/ci_file", file_line_cb, &c, NULL));
+    ASSERT_STATUS(CI_INVALID, ci_process_file("/tmp", file_line_cb, &c, NULL));
+    ASSERT_STATUS(CI_INVALID, ci_process_file(NULL, file_line_cb, &c, NULL));
+    unlink(path);
+    pthread_mutex_destroy(&c.mutex);
+}
+
+int main(void) {
+    test_process_file();
+    test_process_file_registers();
+    test_process_file_edges();
+    printf("test_file passed\n");
+    return 0;
+}
@@ -0,0 +1,242 @@
+#include "console_input.h"
+#include "test.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+
+#define P(s) (s), (sizeof(s) - 1)
+
+static uint64_t rng_state = 0x2545F4914F6CDD1Dull;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static uint64_t double_bits(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+static uint32_t float_bits(float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+static bool has_nonzero_digit(const char *s) {
+    for (; *s && *s != 'e' && *s != 'E'; s++) {
+        if (*s >= '1' && *s <= '9') return true;
+    }
+    return false;
+}
+
+/* Compare against strtod/strtof, which glibc rounds correctly, bit for bit. */
+static void check_string(const char *s) {
+    size_t len = strlen(s);
+    double expect = strtod(s, NULL);
+    double got = 0.0;
+    ci_status status = ci_parse_double(s, len, 0, &got);
+
+    ci_status want = CI_OK;
+    if (isinf(expect)) want = CI_OVERFLOW;
+    if (expect == 0.0 && has_nonzero_digit(s)) want = CI_UNDERFLOW;
+    if (status != want || (status == CI_OK && double_bits(got) != double_bits(expect))) {
+        fprintf(stderr, "double mismatch for '%s': expected %d/%.17g, got %d/%.17g\n", s, (int)want, expect,
+                (int)status, got);
+        exit(1);
+    }
+
+    float fexpect = strtof(s, NULL);
+    float fgot = 0.0f;
+    status = ci_parse_float(s, len, 0, &fgot);
+    want = CI_OK;
+    if (isinf(fexpect)) want = CI_OVERFLOW;
+    if (fexpect == 0.0f && has_nonzero_digit(s)) want = CI_UNDERFLOW;
+    if (status != want || (status == CI_OK && float_bits(fgot) != float_bits(fexpect))) {
+        fprintf(stderr, "float mismatch for '%s': expected %d/%.9g, got %d/%.9g\n", s, (int)want, (double)fexpect,
+                (int)status, (double)fgot);
+        exit(1);
+    }
+}
+
+static void test_corpus(void) {
+    static const char *const corpus[] = {
+        "0", "-0", "0.0", "1", "-1", "0.1", "0.2", "0.3", "1.5", "3.141592653589793", "2.718281828459045",
+        "1e0", "1E+0", "1e-0", ".5", "5.", "00000000000000000000000000000001.5", "0.000000000000000000000000000001",
+        /* Clinger fast-path edges */
+        "9007199254740992", "9007199254740993", "9007199254740994", "9007199254740995", "1e22", "1e23",
+        "123456789e22", "4503599627370497.5", "8.98846567431158e307",
+        /* doubles: extremes, subnormals, underflow boundary */
+        "1.7976931348623157e308", "1.7976931348623158e308", "1.7976931348623159e308", "1e308", "1e309",
+        "2.2250738585072011e-308", "2.2250738585072012e-308", "2.2250738585072014e-308", "4.9406564584124654e-324",
+        "2.4703282292062327e-324", "2.4703282292062328e-324", "1e-323", "1e-324", "1e-400", "5e-324",
+        /* long significands that land on or near a rounding boundary */
+        "9007199254740993.0000000000000000001", "9007199254740992.9999999999999999999",
+        "2.22507385850720113605740979670913197593481954635164564e-308",
+        "2.22507385850720113605740979670913197593481954635164565e-308",
+        "2.4703282292062327208828439643411068618252990130716238221279284125033775364e-324",
+        "2.4703282292062327208828439643411068618252990130716238221279284125033775365e-324",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203124",
+        "1.00000000000000011102230246251565404236316680908203126",
+        "123456789012345678901234567890", "0.000000000000000000000000000000000000000000000001234567890123456789012",
+        "7.2057594037927933e16", "1448997445238699", "1.8446744073709552e19", "18446744073709551615",
+        "18446744073709551616", "18446744073709551617",
+        /* floats */
+        "3.4028234663852886e38", "3.4028235e38", "3.4028236e38", "3.40282357e38", "1.17549435e-38",
+        "1.4e-45", "7e-46", "7.1e-46", "7.006492321624085e-46", "7.006492321624086e-46", "16777217", "7.038531e-26",
+        "1.00000017881393432617187499", "1.000000178813934326171875", "1.000000178813934326171875001",
+        /* exponents beyond any table */
+        "1e99999999999", "1e-99999999999", "0e99999999999", "0.0000e-99999999999",
+    };
+    for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]); i++) {
+        check_string(corpus[i]);
+        if (corpus[i][0] == '-') continue;
+        char neg[160];
+        snprintf(neg, sizeof(neg), "-%s", corpus[i]);
+        check_string(neg);
+    }
+}
+
+/* Random significands of 1 to 25 digits with the decimal point and exponent anywhere. */
+static void test_random_decimals(void) {
+    char buf[80];
+    for (int iter = 0; iter < 300000; iter++) {
+        uint64_t r = rng_next();
+        size_t ndigits = 1 + (size_t)(r % 25);
+        size_t point = (size_t)((r >> 8) % (ndigits + 1));
+        int exp10 = (int)((r >> 16) % 700) - 350;
+        size_t n = 0;
+        for (size_t d = 0; d < ndigits; d++) {
+            if (d == point) buf[n++] = '.';
+            buf[n++] = (char)('0' + rng_next() % 10);
+        }
+        snprintf(buf + n, sizeof(buf) - n, "e%d", exp10);
+        check_string(buf);
+    }
+}
+
+/* Round-trip random bit patterns, and probe the exact midpoints between neighbours. */
+static void test_random_doubles(void) {
+    char buf[128];
+    for (int iter = 0; iter < 200000; iter++) {
+        uint64_t bits = rng_next() & 0x7FFFFFFFFFFFFFFFull;
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        if (isnan(v) || isinf(v)) continue;
+
+        snprintf(buf, sizeof(buf), "%.17g", v);
+        check_string(buf);
+        snprintf(buf, sizeof(buf), "%.*g", (int)(1 + rng_next() % 17), v);
+        check_string(buf);
+
+#if LDBL_MANT_DIG >= 64
+        /* the halfway point needs 54 bits, exact in long double; print it with a long tail */
+        double next;
+        uint64_t next_bits = bits + 1;
+        memcpy(&next, &next_bits, sizeof(next));
+        long double mid = ((long double)v + (long double)next) / 2;
+        snprintf(buf, sizeof(buf), "%.*Le", (int)(18 + rng_next() % 40), mid);
+        check_string(buf);
+#endif
+        float f = (float)v;
+        if (!isinf(f) && f != 0.0f) {
+            snprintf(buf, sizeof(buf), "%.9g", (double)f);
+            check_string(buf);
+        }
+    }
+}
+
+static void test_syntax_and_flags(void) {
+    double d = 42.0;
+    float f = 0.0f;
+    ASSERT_STATUS(CI_OK, ci_parse_double(P("  -1.25e+2"), 0, &d));
+    ASSERT_TRUE(d == -125.0, "leading space, sign, exponent");
+    ASSERT_STATUS(CI_INVALID, ci_parse_double(P(""), 0, &d));
+    ASSERT_STATUS(CI_INVALID, ci_parse_double(P("."), 0, &d));
+    ASSERT_STATUS(CI_INVALID, ci_parse_double(P("-"), 0, &d));
+    ASSERT_STATUS(CI_INVALID, ci_parse_double(P("1e"), 0, &d));
+    ASSERT_STATUS(CI_INVALID, ci_parse_double(P("1e+"), 0, &d));
+    ASSERT_STATUS(CI_INVALID, ci_parse_double(P("1.5 "), 0, &d));
+    ASSERT_STATUS(CI_INVALID, ci_parse_double(P("1..5"), 0, &d));
+    ASSERT_STATUS(CI_INVALID, ci_parse_double(P("0x1p3"), 0, &d));
+    ASSERT_STATUS(CI_INVALID, ci_parse_double(P("1"), 0, NULL));
+    ASSERT_STATUS(CI_OK, ci_parse_double("2.5e10", 3, 0, &d));
+    ASSERT_TRUE(d == 2.5, "parse stops at len");
+
+    /* NaN and infinity only when asked for */
+    d = 42.0;
+    ASSERT_STATUS(CI_INVALID, ci_parse_double(P("inf"), 0, &d));
+    ASSERT_STATUS(CI_INVALID, ci_parse_double(P("nan"), CI_FLOAT_ALLOW_INF, &d));
+    ASSERT_TRUE(d == 42.0, "output untouched on failure");
+    ASSERT_STATUS(CI_OK, ci_parse_double(P("-Infinity"), CI_FLOAT_ALLOW_INF, &d));
+    ASSERT_TRUE(isinf(d) && d < 0, "negative infinity");
+    ASSERT_STATUS(CI_OK, ci_parse_double(P("INF"), CI_FLOAT_ALLOW_INF, &d));
+    ASSERT_TRUE(isinf(d) && d > 0, "infinity");
+    ASSERT_STATUS(CI_INVALID, ci_parse_double(P("infin"), CI_FLOAT_ALLOW_INF, &d));
+    ASSERT_STATUS(CI_OK, ci_parse_double(P("NaN"), CI_FLOAT_ALLOW_NAN, &d));
+    ASSERT_TRUE(isnan(d), "nan");
+    ASSERT_STATUS(CI_OK, ci_parse_float(P("nan"), CI_FLOAT_ALLOW_NAN, &f));
+    ASSERT_TRUE(isnan(f), "float nan");
+
+    /* range errors are reported ahead of trailing characters, as for integers */
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_double(P("1e400x"), 0, &d));
+    ASSERT_STATUS(CI_UNDERFLOW, ci_parse_double(P("1e-400"), 0, &d));
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_float(P("1e39"), 0, &f));
+    ASSERT_STATUS(CI_UNDERFLOW, ci_parse_float(P("1e-46"), 0, &f));
+}
+
+static void test_read_double(void) {
+    int saved_stdin = -1;
+    int saved_stdout = suppress_stdout();
+    const char *input = "abc\n6.02214076e23\n1e999\nnan\ninf\n0.5\n";
+    ASSERT_TRUE(replace_stdin_with_pipe(input, strlen(input), &saved_stdin, NULL) == 0, "pipe stdin");
+
+    double d = 0.0;
+    float f = 0.0f;
+    ASSERT_STATUS(CI_OK, ci_read_double("> ", 0, &d)); /* re-prompts past "abc" */
+    ASSERT_TRUE(d == 6.02214076e23, "avogadro");
+    ASSERT_STATUS(CI_OVERFLOW, ci_read_double(NULL, 0, &d));
+    ASSERT_STATUS(CI_OK, ci_read_double(NULL, CI_FLOAT_ALLOW_NAN, &d));
+    ASSERT_TRUE(isnan(d), "nan allowed");
+    ASSERT_STATUS(CI_OK, ci_read_float(NULL, 0, &f)); /* "inf" rejected, then 0.5 */
+    ASSERT_TRUE(f == 0.5f, "float after rejected inf");
+    ASSERT_STATUS(CI_EOF, ci_read_float(NULL, 0, &f));
+
+    fflush(stdout);
+    restore_stdin_from_fd(saved_stdin);
+    restore_stdout(saved_stdout);
+}
+
+static void test_double_list(void) {
+    ci_double_list list = {0};
+    list.growable = true;
+    ASSERT_STATUS(CI_INVALID, ci_parse_double_list(P("1.5, 2e-400 nan 1e999 -0.25"), &list));
+    ASSERT_EQ_INT(5, list.count);
+    ASSERT_STATUS(CI_OK, list.status[0]);
+    ASSERT_STATUS(CI_UNDERFLOW, list.status[1]);
+    ASSERT_STATUS(CI_INVALID, list.status[2]);
+    ASSERT_STATUS(CI_OVERFLOW, list.status[3]);
+    ASSERT_TRUE(list.values[4] == -0.25, "last element");
+
+    list.flags = CI_FLOAT_ALLOW_NAN | CI_FLOAT_ALLOW_INF;
+    ASSERT_STATUS(CI_OK, ci_parse_double_list(P("nan,-inf, 3"), &list));
+    ASSERT_TRUE(isnan(list.values[0]) && isinf(list.values[1]) && list.values[2] == 3.0, "flags apply to lists");
+    ci_double_list_free(&list);
+}
+
+int main(void) {
+    test_corpus();
+    test_random_decimals();
+    test_random_doubles();
+    test_syntax_and_flags();
+    test_read_double();
+    test_double_list();
+    printf("test_float passed\n");
+    return 0;
+}
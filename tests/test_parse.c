@@ -0,0 +1,296 @@
+#include "console_input.h"
+#include "test.h"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+
+#define P(s) (s), (sizeof(s) - 1)
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void test_decimal_basics(void) {
+    int64_t v = 0;
+    ASSERT_STATUS(CI_OK, ci_parse_int64(P("0"), 10, &v));
+    ASSERT_TRUE(v == 0, "zero");
+    ASSERT_STATUS(CI_OK, ci_parse_int64(P("  -42"), 10, &v));
+    ASSERT_TRUE(v == -42, "leading space and sign");
+    ASSERT_STATUS(CI_OK, ci_parse_int64(P("+0000000000000000000000123"), 10, &v));
+    ASSERT_TRUE(v == 123, "leading zeros do not count toward overflow");
+    ASSERT_STATUS(CI_OK, ci_parse_int64(P("9223372036854775807"), 10, &v));
+    ASSERT_TRUE(v == INT64_MAX, "int64 max");
+    ASSERT_STATUS(CI_OK, ci_parse_int64(P("-9223372036854775808"), 10, &v));
+    ASSERT_TRUE(v == INT64_MIN, "int64 min");
+
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_int64(P("9223372036854775808"), 10, &v));
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_int64(P("-9223372036854775809"), 10, &v));
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_int64(P("123456789012345678901234567890"), 10, &v));
+    /* like strtol, a range error wins over trailing garbage */
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_int64(P("99999999999999999999x"), 10, &v));
+
+    ASSERT_STATUS(CI_INVALID, ci_parse_int64(P(""), 10, &v));
+    ASSERT_STATUS(CI_INVALID, ci_parse_int64(P("   "), 10, &v));
+    ASSERT_STATUS(CI_INVALID, ci_parse_int64(P("-"), 10, &v));
+    ASSERT_STATUS(CI_INVALID, ci_parse_int64(P("12a"), 10, &v));
+    ASSERT_STATUS(CI_INVALID, ci_parse_int64(P("12 "), 10, &v));
+    ASSERT_STATUS(CI_INVALID, ci_parse_int64(P("--1"), 10, &v));
+    ASSERT_STATUS(CI_INVALID, ci_parse_int64(P("1"), 7, &v));
+    ASSERT_STATUS(CI_INVALID, ci_parse_int64(NULL, 0, 10, &v));
+    ASSERT_STATUS(CI_INVALID, ci_parse_int64(P("1"), 10, NULL));
+
+    /* the range ends at len; bytes after it are never read */
+    ASSERT_STATUS(CI_OK, ci_parse_int64("12345678901234567890", 9, 10, &v));
+    ASSERT_TRUE(v == 123456789, "parse stops at len");
+}
+
+static void test_other_bases(void) {
+    uint64_t u = 0;
+    int32_t i = 0;
+    ASSERT_STATUS(CI_OK, ci_parse_uint64(P("ffffffffffffffff"), 16, &u));
+    ASSERT_TRUE(u == UINT64_MAX, "hex max");
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_uint64(P("10000000000000000"), 16, &u));
+    ASSERT_STATUS(CI_OK, ci_parse_uint64(P("0X00000000000000000DeadBeef"), 16, &u));
+    ASSERT_TRUE(u == 0xDEADBEEFu, "hex prefix, leading zeros, mixed case");
+    ASSERT_STATUS(CI_OK, ci_parse_uint64(P("1777777777777777777777"), 8, &u));
+    ASSERT_TRUE(u == UINT64_MAX, "octal max");
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_uint64(P("2000000000000000000000"), 8, &u));
+    ASSERT_STATUS(CI_OK, ci_parse_int32(P("-0b1111111111111111111111111111111"), 2, &i));
+    ASSERT_TRUE(i == -INT32_MAX, "binary with prefix and sign");
+    ASSERT_STATUS(CI_INVALID, ci_parse_int32(P("102"), 2, &i));
+    ASSERT_STATUS(CI_INVALID, ci_parse_int32(P("0x"), 16, &i));
+    ASSERT_STATUS(CI_INVALID, ci_parse_int32(P("0x1"), 10, &i));
+
+    /* base 0 picks by prefix; there is no C-style leading-zero octal */
+    ASSERT_STATUS(CI_OK, ci_parse_int32(P("0x1F"), 0, &i));
+    ASSERT_EQ_INT(31, i);
+    ASSERT_STATUS(CI_OK, ci_parse_int32(P("0o17"), 0, &i));
+    ASSERT_EQ_INT(15, i);
+    ASSERT_STATUS(CI_OK, ci_parse_int32(P("0b101"), 0, &i));
+    ASSERT_EQ_INT(5, i);
+    ASSERT_STATUS(CI_OK, ci_parse_int32(P("017"), 0, &i));
+    ASSERT_EQ_INT(17, i);
+    /* in base 16 "0b1" is a hex number, not a binary prefix */
+    ASSERT_STATUS(CI_OK, ci_parse_int32(P("0b1"), 16, &i));
+    ASSERT_EQ_INT(0xb1, i);
+}
+
+static void test_typed_ranges(void) {
+    int8_t i8;
+    int16_t i16;
+    uint8_t u8;
+    uint16_t u16;
+    uint32_t u32;
+    size_t sz;
+
+    ASSERT_STATUS(CI_OK, ci_parse_int8(P("-128"), 10, &i8));
+    ASSERT_EQ_INT(-128, i8);
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_int8(P("128"), 10, &i8));
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_int8(P("-129"), 10, &i8));
+    ASSERT_STATUS(CI_OK, ci_parse_int16(P("0x7fff"), 16, &i16));
+    ASSERT_EQ_INT(32767, i16);
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_int16(P("-32769"), 10, &i16));
+    ASSERT_STATUS(CI_OK, ci_parse_uint8(P("255"), 10, &u8));
+    ASSERT_EQ_INT(255, u8);
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_uint8(P("256"), 10, &u8));
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_uint16(P("-1"), 10, &u16));
+    ASSERT_STATUS(CI_OK, ci_parse_uint16(P("-0"), 10, &u16));
+    ASSERT_EQ_INT(0, u16);
+    ASSERT_STATUS(CI_OK, ci_parse_uint32(P("4294967295"), 10, &u32));
+    ASSERT_TRUE(u32 == UINT32_MAX, "uint32 max");
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_uint32(P("4294967296"), 10, &u32));
+    ASSERT_STATUS(CI_OK, ci_parse_size(P("18446744073709551615"), 10, &sz));
+    ASSERT_TRUE((uint64_t)sz == (uint64_t)SIZE_MAX || SIZE_MAX < UINT64_MAX, "size_t max");
+
+    /* output is untouched on failure */
+    u8 = 7;
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_uint8(P("1000"), 10, &u8));
+    ASSERT_EQ_INT(7, u8);
+}
+
+/* Cross-check random digit strings of every length against strtoll/strtoull. */
+static void test_matches_strtoll(void) {
+    char buf[48];
+    for (int iter = 0; iter < 200000; iter++) {
+        uint64_t r = rng_next();
+        size_t ndigits = 1 + (size_t)(r % 24);
+        size_t n = 0;
+        bool negative = (r >> 8) & 1;
+        if (negative) buf[n++] = '-';
+        for (size_t d = 0; d < ndigits; d++) {
+            buf[n++] = (char)('0' + rng_next() % 10);
+        }
+        /* sometimes poison one position to test digit validation in every lane */
+        if ((r >> 16) % 8 == 0) buf[(r >> 24) % n] = (char)('0' + 10 + (r >> 32) % 40);
+        buf[n] = '\0';
+
+        errno = 0;
+        char *end = NULL;
+        long long expect = strtoll(buf, &end, 10);
+        ci_status expect_status = errno == ERANGE ? CI_OVERFLOW : (end == buf || *end) ? CI_INVALID : CI_OK;
+        int64_t got = 0;
+        ci_status status = ci_parse_int64(buf, n, 10, &got);
+        if (status != expect_status || (status == CI_OK && got != expect)) {
+            fprintf(stderr, "int64 mismatch for '%s': expected %d/%lld, got %d/%" PRId64 "\n", buf,
+                    (int)expect_status, expect, (int)status, got);
+            exit(1);
+        }
+
+        if (negative) continue;
+        errno = 0;
+        unsigned long long uexpect = strtoull(buf, &end, 10);
+        expect_status = errno == ERANGE ? CI_OVERFLOW : (end == buf || *end) ? CI_INVALID : CI_OK;
+        uint64_t ugot = 0;
+        status = ci_parse_uint64(buf, n, 10, &ugot);
+        if (status != expect_status || (status == CI_OK && ugot != uexpect)) {
+            fprintf(stderr, "uint64 mismatch for '%s'\n", buf);
+            exit(1);
+        }
+    }
+}
+
+static void test_int_list_text(void) {
+    int64_t values[8];
+    ci_status status[8];
+    ci_int_list list = {values, status, 0, 8, 0, false};
+
+    ASSERT_STATUS(CI_OK, ci_parse_int_list(P("  12 -7\t88,1024 , 5\r"), &list));
+    ASSERT_EQ_INT(5, list.count);
+    ASSERT_TRUE(values[0] == 12 && values[1] == -7 && values[2] == 88 && values[3] == 1024 && values[4] == 5,
+                "values in line order");
+
+    ASSERT_STATUS(CI_INVALID, ci_parse_int_list(P("1 x2 99999999999999999999 4,,5,"), &list));
+    ASSERT_EQ_INT(7, list.count);
+    ASSERT_EQ_INT(4, list.errors);
+    ASSERT_STATUS(CI_OK, status[0]);
+    ASSERT_STATUS(CI_INVALID, status[1]);
+    ASSERT_STATUS(CI_OVERFLOW, status[2]);
+    ASSERT_STATUS(CI_OK, status[3]);
+    ASSERT_STATUS(CI_INVALID, status[4]); /* empty between commas */
+    ASSERT_STATUS(CI_OK, status[5]);
+    ASSERT_STATUS(CI_INVALID, status[6]); /* empty after trailing comma */
+    ASSERT_TRUE(values[1] == 0 && values[5] == 5, "failed elements keep their slot");
+
+    ASSERT_STATUS(CI_OK, ci_parse_int_list(P("   "), &list));
+    ASSERT_EQ_INT(0, list.count);
+
+    ASSERT_STATUS(CI_OVERFLOW, ci_parse_int_list(P("1 2 3 4 5 6 7 8 9 10"), &list));
+    ASSERT_EQ_INT(8, list.count);
+    ASSERT_EQ_INT(2, list.errors); /* 9 and 10 were dropped */
+    ASSERT_TRUE(values[7] == 8, "fixed list keeps what fits");
+
+    /* status is optional for caller-owned arrays */
+    ci_int_list bare = {values, NULL, 0, 8, 0, false};
+    ASSERT_STATUS(CI_INVALID, ci_parse_int_list(P("1 ? 3"), &bare));
+    ASSERT_EQ_INT(1, bare.errors);
+}
+
+static void test_double_list_text(void) {
+    ci_double_list list = {0};
+    list.growable = true;
+    ASSERT_STATUS(CI_OK, ci_parse_double_list(P("1.5, -2e3 0.125 7"), &list));
+    ASSERT_EQ_INT(4, list.count);
+    ASSERT_TRUE(list.values[0] == 1.5 && list.values[1] == -2000.0 && list.values[2] == 0.125 &&
+                    list.values[3] == 7.0,
+                "double values");
+    ASSERT_STATUS(CI_INVALID, ci_parse_double_list(P("1e999 2.5.1 3"), &list));
+    ASSERT_STATUS(CI_OVERFLOW, list.status[0]);
+    ASSERT_STATUS(CI_INVALID, list.status[1]);
+    ASSERT_TRUE(list.values[2] == 3.0, "later elements still parse");
+    ci_double_list_free(&list);
+    ASSERT_TRUE(list.values == NULL && list.capacity == 0, "free resets the list");
+}
+
+/* Lines far longer than the reader block, split at every possible token boundary. */
+static void test_int_list_streams_long_lines(void) {
+    enum { N = 20000 };
+    size_t cap = (size_t)N * 24 + 64;
+    char *text = malloc(cap);
+    ASSERT_TRUE(text != NULL, "alloc");
+    size_t len = 0;
+    for (int i = 0; i < N; i++) {
+        long long v = (long long)(rng_next() % 2000000000000ull) - 1000000000000ll;
+        len += (size_t)snprintf(text + len, cap - len, i % 3 ? "%lld " : "%lld,", v);
+    }
+    len += (size_t)snprintf(text + len, cap - len, "\r\n4 5\n");
+
+    char path[] = "/tmp/ci_list_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0, "mkstemp");
+    unlink(path);
+    ASSERT_TRUE(write(fd, text, len) == (ssize_t)len, "write");
+    /* and a token longer than the whole block */
+    static const char tail[] = "1 000000000000000000000000000000000007 2\n";
+    ASSERT_TRUE(write(fd, tail, sizeof(tail) - 1) == (ssize_t)(sizeof(tail) - 1), "write tail");
+
+    static const size_t blocks[] = {16, 17, 4096};
+    for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+        lseek(fd, 0, SEEK_SET);
+        ci_reader *reader = ci_reader_create(fd, blocks[b]);
+        ci_int_list list = {0};
+        list.growable = true;
+
+        ASSERT_STATUS(CI_OK, ci_reader_read_int_list(reader, &list));
+        ASSERT_EQ_INT(N, list.count);
+        const char *p = text;
+        for (size_t i = 0; i < list.count; i++) {
+            char *end;
+            long long expect = strtoll(p, &end, 10);
+            ASSERT_TRUE(list.values[i] == expect, "streamed value matches");
+            p = end + 1;
+        }
+
+        ASSERT_STATUS(CI_OK, ci_reader_read_int_list(reader, &list));
+        ASSERT_EQ_INT(2, list.count);
+        ASSERT_TRUE(list.values[0] == 4 && list.values[1] == 5, "next line");
+
+        ci_status expect = blocks[b] < 40 ? CI_INVALID : CI_OK;
+        ASSERT_STATUS(expect, ci_reader_read_int_list(reader, &list));
+        ASSERT_EQ_INT(3, list.count);
+        ASSERT_TRUE(list.values[0] == 1 && list.values[2] == 2, "elements around a long token");
+        ASSERT_STATUS(blocks[b] < 40 ? CI_OVERFLOW : CI_OK, list.status[1]);
+
+        ASSERT_STATUS(CI_EOF, ci_reader_read_int_list(reader, &list));
+        ci_int_list_free(&list);
+        ci_reader_destroy(reader);
+    }
+    close(fd);
+    free(text);
+}
+
+static void test_read_long_uses_parser(void) {
+    int saved_stdin = -1;
+    int saved_stdout = suppress_stdout();
+    const char *input = "-9223372036854775808\n2147483648\n-17\n";
+    ASSERT_TRUE(replace_stdin_with_pipe(input, strlen(input), &saved_stdin, NULL) == 0, "pipe stdin");
+
+    long l = 0;
+    int i = 0;
+    ASSERT_STATUS(CI_OK, ci_read_long(NULL, &l));
+    ASSERT_TRUE(l == LONG_MIN || LONG_MAX == INT32_MAX, "long min");
+    ASSERT_STATUS(CI_OVERFLOW, ci_read_int(NULL, &i));
+    ASSERT_STATUS(CI_OK, ci_read_int(NULL, &i));
+    ASSERT_EQ_INT(-17, i);
+
+    restore_stdin_from_fd(saved_stdin);
+    restore_stdout(saved_stdout);
+}
+
+int main(void) {
+    test_decimal_basics();
+    test_other_bases();
+    test_typed_ranges();
+    test_matches_strtoll();
+    test_read_long_uses_parser();
+    test_int_list_text();
+    test_double_list_text();
+    test_int_list_streams_long_lines();
+    printf("test_parse passed\n");
+    return 0;
+}
@@ -0,0 +1,267 @@
+#define _GNU_SOURCE /* FNM_CASEFOLD */
+
+#include "console_input.h"
+#include "ci_internal.h"
+#include "test.h"
+
+#include <fnmatch.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *hit; /* user_data of the callback that ran */
+
+static void named_cb(const char *line, void *user_data) {
+    (void)line;
+    hit = user_data;
+}
+
+/* Dispatch a line and return the name of the callback that ran, or NULL. */
+static const char *run(ci_registry *reg, const char *line) {
+    hit = NULL;
+    return ci_registry_dispatch(reg, line, strlen(line), NULL) ? hit : NULL;
+}
+
+static ci_status put(ci_registry *reg, const char *text, const char *name, unsigned flags) {
+    ci_pattern *pattern;
+    ci_status status = ci_pattern_compile(text, named_cb, (void *)name, flags, &pattern);
+    return status == CI_OK ? ci_registry_put_pattern(reg, pattern) : status;
+}
+
+static void test_pattern_syntax(void) {
+    static const struct {
+        const char *pattern;
+        const char *line;
+        bool match;
+    } cases[] = {
+        {"get *", "get key", true},
+        {"get *", "get ", true},
+        {"get *", "get", false},
+        {"get *", "xget key", false},
+        {"a?c", "abc", true},
+        {"a?c", "ac", false},
+        {"a**c", "ac", true},
+        {"a*c*e", "abcdXe", true},
+        {"a*c*e", "abcdX", false},
+        {"[a-c]x", "bx", true},
+        {"[a-c]x", "dx", false},
+        {"[!a-c]x", "dx", true},
+        {"[^a-c]x", "ax", false},
+        {"[]]", "]", true},
+        {"[a-]", "-", true},
+        {"job [0-9]+", "job 42", true},
+        {"job [0-9]+", "job ", false},
+        {"job [0-9]+", "job 4x", false},
+        {"x+y", "xxxy", true},
+        {"x+y", "y", false},
+        {"?+", "", false},
+        {"?+", "anything", true},
+        {"\\*", "*", true},
+        {"\\*", "x", false},
+        {"a\\+", "a+", true},
+        {"[\\]]", "]", true},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        ci_registry reg;
+        ci_registry_init(&reg);
+        ASSERT_STATUS(CI_OK, put(&reg, cases[i].pattern, "p", 0));
+        if ((run(&reg, cases[i].line) != NULL) != cases[i].match) {
+            fprintf(stderr, "pattern \"%s\" on \"%s\"\n", cases[i].pattern, cases[i].line);
+            ASSERT_TRUE(false, "pattern match");
+        }
+        ci_registry_destroy(&reg);
+    }
+
+    /* with NOCASE a negated class excludes both cases of what it lists */
+    static const struct {
+        const char *pattern;
+        const char *line;
+        bool match;
+    } nocase[] = {
+        {"[!a]x", "ax", false},
+        {"[!a]x", "Ax", false},
+        {"[!a]x", "bX", true},
+        {"[!A]x", "ax", false},
+        {"[!a-z]x", "Zx", false},
+        {"[!a-z]x", "qx", false},
+        {"[!a-z]x", "1x", true},
+        {"[^B-C]", "b", false},
+        {"[a-c]x", "BX", true},
+        {"[A]", "a", true},
+    };
+    for (size_t i = 0; i < sizeof(nocase) / sizeof(nocase[0]); i++) {
+        ci_registry reg;
+        ci_registry_init(&reg);
+        ASSERT_STATUS(CI_OK, put(&reg, nocase[i].pattern, "p", CI_CMD_NOCASE));
+        if ((run(&reg, nocase[i].line) != NULL) != nocase[i].match) {
+            fprintf(stderr, "NOCASE pattern \"%s\" on \"%s\"\n", nocase[i].pattern, nocase[i].line);
+            ASSERT_TRUE(false, "NOCASE pattern match");
+        }
+        ci_registry_destroy(&reg);
+    }
+
+    static const char *bad[] = {"", "[ab", "[", "ab\\", "+a", "*+", "a++"};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        ci_pattern *pattern;
+        ASSERT_STATUS(CI_INVALID, ci_pattern_compile(bad[i], named_cb, NULL, 0, &pattern));
+    }
+}
+
+static void test_pattern_priority(void) {
+    ci_registry reg;
+    ci_registry_init(&reg);
+
+    ASSERT_STATUS(CI_OK, put(&reg, "get k1 *", "k1", 0));
+    ASSERT_STATUS(CI_OK, put(&reg, "get *", "any", 0));
+    ASSERT_STATUS(CI_OK, put(&reg, "GET *", "nocase", CI_CMD_NOCASE));
+    ASSERT_STR_EQ("k1", run(&reg, "get k1 x"));
+    ASSERT_STR_EQ("any", run(&reg, "get k2 x"));
+    ASSERT_STR_EQ("nocase", run(&reg, "gEt k1 x"));
+    ASSERT_TRUE(run(&reg, "put x") == NULL, "no pattern matches");
+
+    /* registering again replaces the callback and keeps the place */
+    ASSERT_STATUS(CI_OK, put(&reg, "get k1 *", "k1 again", 0));
+    ASSERT_STR_EQ("k1 again", run(&reg, "get k1 x"));
+    ASSERT_STATUS(CI_OK, ci_registry_remove_pattern(&reg, "get k1 *"));
+    ASSERT_STR_EQ("any", run(&reg, "get k1 x"));
+    ASSERT_STATUS(CI_INVALID, ci_registry_remove_pattern(&reg, "get k1 *"));
+
+    /* exact commands and verbs come first */
+    ASSERT_STATUS(CI_OK, ci_registry_put(&reg, "get all", named_cb, "exact", 0));
+    ASSERT_STR_EQ("exact", run(&reg, "get all"));
+    ASSERT_STR_EQ("any", run(&reg, "get all x"));
+
+    ci_command_entry entry;
+    ASSERT_STATUS(CI_OK, put(&reg, "commit *", "commit", CI_CMD_SERIAL));
+    ASSERT_TRUE(ci_registry_lookup(&reg, "commit now", 10, &entry), "pattern found by lookup");
+    ASSERT_TRUE(entry.cb == named_cb && (entry.flags & CI_CMD_SERIAL), "pattern entry");
+
+    ASSERT_STATUS(CI_OK, ci_registry_remove_pattern(&reg, "get *"));
+    ASSERT_STATUS(CI_OK, ci_registry_remove_pattern(&reg, "GET *"));
+    ASSERT_STATUS(CI_OK, ci_registry_remove_pattern(&reg, "commit *"));
+    ASSERT_TRUE(run(&reg, "get x") == NULL, "all removed");
+    ASSERT_STATUS(CI_OK, put(&reg, "x*", "x", 0));
+    ci_registry_clear(&reg);
+    ASSERT_TRUE(run(&reg, "xy") == NULL, "clear removes patterns");
+    ci_registry_destroy(&reg);
+}
+
+static unsigned long rng_state = 12345;
+
+static unsigned rng(unsigned n) {
+    rng_state = rng_state * 6364136223846793005ul + 1442695040888963407ul;
+    return (unsigned)(rng_state >> 33) % n;
+}
+
+/* The first pattern that fnmatch accepts, as an index, or -1. */
+static int first_fnmatch(char patterns[][32], int count, const char *line, int fnm_flags) {
+    for (int i = 0; i < count; i++) {
+        if (fnmatch(patterns[i], line, fnm_flags) == 0) return i;
+    }
+    return -1;
+}
+
+/* Random patterns over a few atoms against fnmatch; with NOCASE the lines mix cases. */
+static void check_pattern_random(unsigned flags) {
+    static const char *atoms[] = {"a", "b", "?", "*", "[ab]", "[!a]", "B", "[!A-B]"};
+    const char *letters = flags & CI_CMD_NOCASE ? "abcAB" : "abc";
+    unsigned atom_count = flags & CI_CMD_NOCASE ? 8 : 6;
+    int fnm_flags = flags & CI_CMD_NOCASE ? FNM_CASEFOLD : 0;
+    enum { PATTERNS = 40, LINES = 4000 };
+    char patterns[PATTERNS][32];
+    ci_registry reg;
+    ci_registry_init(&reg);
+    for (int i = 0; i < PATTERNS; i++) {
+        patterns[i][0] = '\0';
+        for (unsigned n = 1 + rng(4); n > 0; n--) strcat(patterns[i], atoms[rng(atom_count)]);
+        if (put(&reg, patterns[i], patterns[i], flags) != CI_OK) ASSERT_TRUE(false, "random pattern");
+    }
+    /* a pattern drawn twice is replaced in its first place, as the fnmatch loop finds it */
+    for (int i = 0; i < LINES; i++) {
+        char line[12];
+        unsigned len = rng(sizeof(line));
+        for (unsigned j = 0; j < len; j++) line[j] = letters[rng((unsigned)strlen(letters))];
+        line[len] = '\0';
+        int want = first_fnmatch(patterns, PATTERNS, line, fnm_flags);
+        const char *got = run(&reg, line);
+        if (want < 0 ? got != NULL : (got == NULL || strcmp(got, patterns[want]) != 0)) {
+            fprintf(stderr, "line \"%s\": want %s, got %s\n", line, want < 0 ? "none" : patterns[want],
+                    got ? got : "none");
+            ASSERT_TRUE(false, "DFA agrees with fnmatch");
+        }
+    }
+    ci_registry_destroy(&reg);
+}
+
+static void test_pattern_random(void) {
+    check_pattern_random(0);
+    check_pattern_random(CI_CMD_NOCASE);
+}
+
+static void test_pattern_state_limit(void) {
+    /* "*a" followed by 14 '?' needs more DFA states than are kept: the rest runs uncached */
+    const char *text = "*a??????????????";
+    ci_registry reg;
+    ci_registry_init(&reg);
+    ASSERT_STATUS(CI_OK, put(&reg, text, "p", 0));
+    for (int i = 0; i < 3000; i++) {
+        char line[41];
+        unsigned len = 15 + rng(26);
+        for (unsigned j = 0; j < len; j++) line[j] = "ab"[rng(2)];
+        line[len] = '\0';
+        bool want = fnmatch(text, line, 0) == 0;
+        ASSERT_TRUE((run(&reg, line) != NULL) == want, "agrees with fnmatch past the state limit");
+    }
+    ci_registry_destroy(&reg);
+}
+
+static void count_cb(const char *line, void *user_data) {
+    (void)line;
+    ci_atomic_add((int *)user_data, 1);
+}
+
+static void test_context_patterns(void) {
+    ci_context *ctx = ci_context_create(STDIN_FILENO, NULL);
+    ASSERT_TRUE(ctx != NULL, "context should be created");
+    int hits = 0, other = 0;
+    ASSERT_STATUS(CI_INVALID, ci_context_register_pattern(ctx, "[x", count_cb, &hits, 0));
+    ASSERT_STATUS(CI_INVALID, ci_context_register_pattern(ctx, NULL, count_cb, &hits, 0));
+    ASSERT_STATUS(CI_INVALID, ci_context_register_pattern(ctx, "x", NULL, &hits, 0));
+    ASSERT_STATUS(CI_INVALID, ci_context_register_pattern(ctx, "x", count_cb, &hits, CI_CMD_SERIAL | CI_CMD_PRIORITY));
+    ASSERT_STATUS(CI_INVALID, ci_context_unregister_pattern(ctx, "x"));
+
+    /* through ci_process_file's threads, which fill the DFA concurrently */
+    char path[] = "/tmp/ci_pattern_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0, "mkstemp");
+    FILE *f = fdopen(fd, "w");
+    for (int i = 0; i < 1000; i++) {
+        fprintf(f, "%s.host%d.%s %d\n", i % 3 ? "CPU" : "cpu", i, i % 4 ? "idle" : "busy", i);
+    }
+    fclose(f);
+    ASSERT_STATUS(CI_OK, ci_context_enable_stats(ctx, true));
+    ASSERT_STATUS(CI_OK, ci_context_register_pattern(ctx, "cpu.host*.busy [0-9]+", count_cb, &hits, CI_CMD_NOCASE));
+    ASSERT_STATUS(CI_OK, ci_context_register_pattern(ctx, "cpu.*", count_cb, &other, 0));
+    ci_file_options opts = {0};
+    opts.threads = 3;
+    opts.chunk_size = 512;
+    ASSERT_STATUS(CI_OK, ci_context_process_file(ctx, path, NULL, NULL, &opts));
+    ASSERT_EQ_INT(250, hits);
+    ASSERT_EQ_INT(250, other);
+    ci_latency_stats stats;
+    ASSERT_STATUS(CI_OK, ci_context_get_command_stats(ctx, "cpu.*", &stats));
+    ASSERT_EQ_INT(250, (int)stats.count);
+
+    ASSERT_STATUS(CI_OK, ci_context_unregister_pattern(ctx, "cpu.*"));
+    ci_context_destroy(ctx);
+    unlink(path);
+}
+
+int main(void) {
+    test_pattern_syntax();
+    test_pattern_priority();
+    test_pattern_random();
+    test_pattern_state_limit();
+    test_context_patterns();
+    printf("test_pattern passed\n");
+    return 0;
+}
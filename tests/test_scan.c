@@ -0,0 +1,100 @@
+#include "ci_internal.h"
+#include "test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SCAN_MAX_LEN 160
+#define SCAN_MAX_ALIGN 64
+
+static char scan_buf[SCAN_MAX_ALIGN + SCAN_MAX_LEN + 64];
+
+/* Fill with bytes that differ from '\n' in a single bit to catch sloppy masks. */
+static void fill_near_misses(char *p, size_t n) {
+    static const char near[] = {'\x0b', '\x08', '\x0e', '\x8a', '\x4a', '\r', 'a', '\0'};
+    for (size_t i = 0; i < n; i++) {
+        p[i] = near[(i * 7 + 3) % sizeof(near)];
+    }
+}
+
+static void check_all_variants(const char *p, size_t n) {
+    size_t count = 0;
+    const ci_scan_variant *variants = ci_scan_variants(&count);
+    const char *expected = ci_scan_scalar(p, n, '\n');
+
+    for (size_t v = 0; v < count; v++) {
+        const char *got = variants[v].fn(p, n, '\n');
+        if (got != expected) {
+            fprintf(stderr, "%s mismatch: len %zu, expected %ld, got %ld\n", variants[v].name, n,
+                    expected ? (long)(expected - p) : -1L, got ? (long)(got - p) : -1L);
+            exit(1);
+        }
+    }
+    ASSERT_TRUE(ci_scan(p, n, '\n') == expected, "dispatched kernel agrees with scalar");
+}
+
+static void test_variants_match_scalar(void) {
+    ci_scan_init();
+    for (size_t align = 0; align < SCAN_MAX_ALIGN; align++) {
+        for (size_t len = 0; len <= SCAN_MAX_LEN; len++) {
+            char *p = scan_buf + align;
+            fill_near_misses(scan_buf, sizeof(scan_buf));
+            /* a delimiter just past the tail must never be reported */
+            p[len] = '\n';
+            check_all_variants(p, len);
+
+            for (size_t pos = 0; pos < len; pos++) {
+                p[pos] = '\n';
+                check_all_variants(p, len);
+                p[pos] = (char)0x0b;
+            }
+        }
+    }
+}
+
+static void test_multiple_delimiters_first_wins(void) {
+    size_t count = 0;
+    const ci_scan_variant *variants = ci_scan_variants(&count);
+    fill_near_misses(scan_buf, sizeof(scan_buf));
+    scan_buf[40] = '\n';
+    scan_buf[41] = '\n';
+    scan_buf[100] = '\n';
+    for (size_t v = 0; v < count; v++) {
+        ASSERT_TRUE(variants[v].fn(scan_buf, 128, '\n') == scan_buf + 40, variants[v].name);
+        ASSERT_TRUE(variants[v].fn(scan_buf, 128, ',') == NULL, variants[v].name);
+    }
+}
+
+static void test_reader_folds_crlf(void) {
+    const char *input = "one\r\ntwo\r\n\r\nbare\rcr\r\nlast\r";
+    int fds[2];
+    ASSERT_TRUE(pipe(fds) == 0, "pipe");
+    (void)write(fds[1], input, strlen(input));
+    close(fds[1]);
+
+    /* 4-byte blocks split several '\r\n' pairs across reads */
+    ci_reader *reader = ci_reader_create(fds[0], 4);
+    char buf[16];
+    ASSERT_STATUS(CI_OK, ci_reader_read_line(reader, buf, sizeof(buf)));
+    ASSERT_STR_EQ("one", buf);
+    ASSERT_STATUS(CI_OK, ci_reader_read_line(reader, buf, sizeof(buf)));
+    ASSERT_STR_EQ("two", buf);
+    ASSERT_STATUS(CI_OK, ci_reader_read_line(reader, buf, sizeof(buf)));
+    ASSERT_STR_EQ("", buf);
+    ASSERT_STATUS(CI_OK, ci_reader_read_line(reader, buf, sizeof(buf)));
+    ASSERT_STR_EQ("bare\rcr", buf);
+    ASSERT_STATUS(CI_OK, ci_reader_read_line(reader, buf, sizeof(buf)));
+    ASSERT_STR_EQ("last\r", buf);
+    ASSERT_STATUS(CI_EOF, ci_reader_read_line(reader, buf, sizeof(buf)));
+
+    ci_reader_destroy(reader);
+    close(fds[0]);
+}
+
+int main(void) {
+    test_variants_match_scalar();
+    test_multiple_delimiters_first_wins();
+    test_reader_folds_crlf();
+    printf("test_scan passed (dispatch: %s)\n", ci_scan_selected());
+    return 0;
+}
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <sys/wait.h>
 
 static void test_read_line_ok(void) {
     const char *input = "hello world\n";
@@ -48,6 +49,66 @@ static void test_read_line_eof(void) {
     restore_stdin_from_fd(saved_fd);
 }
 
+static FILE *temp_stream(const char *text, char *path) {
+    strcpy(path, "/tmp/ci_sync_XXXXXX");
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0, "mkstemp");
+    ASSERT_TRUE(write(fd, text, strlen(text)) == (ssize_t)strlen(text), "write");
+    close(fd);
+    FILE *f = fopen(path, "r");
+    ASSERT_TRUE(f != NULL, "fopen");
+    return f;
+}
+
+static void test_read_line_streams(void) {
+    char path_a[32], path_b[32], buf[8];
+
+    /* a reopened stream that reuses the descriptor starts from its own data */
+    FILE *a = temp_stream("a1\na2\n", path_a);
+    ASSERT_STATUS(CI_OK, ci_read_line(a, buf, sizeof(buf)));
+    ASSERT_STR_EQ("a1", buf);
+    fclose(a);
+    FILE *b = temp_stream("b1\n", path_b);
+    ASSERT_STATUS(CI_OK, ci_read_line(b, buf, sizeof(buf)));
+    ASSERT_STR_EQ("b1", buf);
+    ASSERT_STATUS(CI_EOF, ci_read_line(b, buf, sizeof(buf)));
+    fclose(b);
+
+    /* what stdio has already buffered isn't skipped */
+    a = fopen(path_a, "r");
+    ASSERT_TRUE(fgets(buf, sizeof(buf), a) != NULL, "fgets");
+    ASSERT_STATUS(CI_OK, ci_read_line(a, buf, sizeof(buf)));
+    ASSERT_STR_EQ("a2", buf);
+    fclose(a);
+
+    /* any number of streams, with or without a descriptor */
+    FILE *many[20];
+    for (int i = 0; i < 20; i++) many[i] = fopen(path_a, "r");
+    for (int i = 0; i < 20; i++) {
+        ASSERT_STATUS(CI_OK, ci_read_line(many[i], buf, sizeof(buf)));
+        ASSERT_STR_EQ("a1", buf);
+        fclose(many[i]);
+    }
+    char text[] = "m1\r\nexactly\nexactly\r\ntoo long\nm2";
+    FILE *m = fmemopen(text, strlen(text), "r");
+    ASSERT_TRUE(m != NULL, "fmemopen");
+    ASSERT_STATUS(CI_OK, ci_read_line(m, buf, sizeof(buf)));
+    ASSERT_STR_EQ("m1", buf);
+    ASSERT_STATUS(CI_OK, ci_read_line(m, buf, sizeof(buf)));
+    ASSERT_STR_EQ("exactly", buf);
+    ASSERT_STATUS(CI_OK, ci_read_line(m, buf, sizeof(buf)));
+    ASSERT_STR_EQ("exactly", buf);
+    ASSERT_STATUS(CI_OVERFLOW, ci_read_line(m, buf, sizeof(buf)));
+    ASSERT_STR_EQ("too lon", buf);
+    ASSERT_STATUS(CI_OK, ci_read_line(m, buf, sizeof(buf)));
+    ASSERT_STR_EQ("m2", buf);
+    ASSERT_STATUS(CI_EOF, ci_read_line(m, buf, sizeof(buf)));
+    fclose(m);
+
+    unlink(path_a);
+    unlink(path_b);
+}
+
 static void test_prompt_line_overflow_and_retry(void) {
     /* first prompt should overflow */
     const char *long_input = "thisiswaytoolongforthesize\n";
@@ -111,6 +172,56 @@ static void test_read_int_overflow(void) {
     restore_stdin_from_fd(saved_fd);
 }
 
+/* Redirect stdout to a temporary file; returns previous fd. */
+static int capture_stdout(FILE **file) {
+    fflush(stdout);
+    *file = tmpfile();
+    ASSERT_TRUE(*file != NULL, "tmpfile");
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(*file), STDOUT_FILENO);
+    return saved;
+}
+
+/* Restore stdout and return what was written to it while captured. */
+static void captured_stdout(FILE *file, int saved, char *text, size_t size) {
+    fflush(stdout);
+    restore_stdout(saved);
+    rewind(file);
+    size_t n = fread(text, 1, size - 1, file);
+    text[n] = '\0';
+    fclose(file);
+}
+
+static void test_prompt_policy(void) {
+    static const char *expected[] = {
+        "n: n: n: Invalid number, try again.\nn: ", /* CI_PROMPT_ALWAYS */
+        "Invalid number, try again.\n",             /* CI_PROMPT_TTY: stdout is a file */
+        "Invalid number, try again.\n",             /* CI_PROMPT_NEVER */
+    };
+    static const ci_prompt_policy policies[] = {CI_PROMPT_ALWAYS, CI_PROMPT_TTY, CI_PROMPT_NEVER};
+
+    for (int i = 0; i < 3; i++) {
+        const char *input = "1\n2\nx\n3\n";
+        int saved_fd;
+        replace_stdin_with_pipe(input, strlen(input), &saved_fd, NULL);
+        ci_set_prompt_policy(policies[i]);
+
+        FILE *file;
+        int saved_stdout = capture_stdout(&file);
+        int a = 0, b = 0, c = 0;
+        ASSERT_STATUS(CI_OK, ci_read_int("n: ", &a));
+        ASSERT_STATUS(CI_OK, ci_read_int("n: ", &b));
+        ASSERT_STATUS(CI_OK, ci_read_int("n: ", &c));
+        char text[128];
+        captured_stdout(file, saved_stdout, text, sizeof(text));
+
+        ASSERT_TRUE(a == 1 && b == 2 && c == 3, "values read past the invalid line");
+        ASSERT_STR_EQ(expected[i], text);
+        restore_stdin_from_fd(saved_fd);
+    }
+    ci_set_prompt_policy(CI_PROMPT_TTY);
+}
+
 static void test_read_long_valid(void) {
     const char *input = "123456\n";
     int saved_fd;
@@ -124,15 +235,104 @@ static void test_read_long_valid(void) {
     restore_stdin_from_fd(saved_fd);
 }
 
+static void test_reader_small_blocks(void) {
+    const char *input = "abcdefghij\nxy\n0123456789abcdef\ntail";
+    int fds[2];
+    ASSERT_TRUE(pipe(fds) == 0, "pipe");
+    (void)write(fds[1], input, strlen(input));
+    close(fds[1]);
+
+    /* 4-byte blocks force every line to span several reads */
+    ci_reader *reader = ci_reader_create(fds[0], 4);
+    ASSERT_TRUE(reader != NULL, "reader created");
+
+    char buf[12];
+    ASSERT_STATUS(CI_OK, ci_reader_read_line(reader, buf, sizeof(buf)));
+    ASSERT_STR_EQ("abcdefghij", buf);
+    ASSERT_STATUS(CI_OK, ci_reader_read_line(reader, buf, sizeof(buf)));
+    ASSERT_STR_EQ("xy", buf);
+    ASSERT_STATUS(CI_OVERFLOW, ci_reader_read_line(reader, buf, sizeof(buf)));
+    ASSERT_STR_EQ("0123456789a", buf);
+    ASSERT_STATUS(CI_OK, ci_reader_read_line(reader, buf, sizeof(buf)));
+    ASSERT_STR_EQ("tail", buf);
+    ASSERT_STATUS(CI_EOF, ci_reader_read_line(reader, buf, sizeof(buf)));
+
+    ci_reader_destroy(reader);
+    close(fds[0]);
+}
+
+/* Read "line N" lines 0..count-1 from a reader, checking order and framing. */
+static void expect_numbered_lines(ci_reader *reader, int count) {
+    char buf[32];
+    char expect[32];
+    for (int i = 0; i < count; i++) {
+        ASSERT_STATUS(CI_OK, ci_reader_read_line(reader, buf, sizeof(buf)));
+        snprintf(expect, sizeof(expect), "line %d", i);
+        ASSERT_STR_EQ(expect, buf);
+    }
+    ASSERT_STATUS(CI_EOF, ci_reader_read_line(reader, buf, sizeof(buf)));
+}
+
+static void test_reader_io_uring(void) {
+    enum { LINES = 50000 };
+    int fds[2];
+    ASSERT_TRUE(pipe(fds) == 0, "pipe");
+
+    /* small blocks so the writer outruns the reader and chunks split lines and CRLF pairs */
+    ci_reader *reader = ci_reader_create(fds[0], 4096);
+    ASSERT_TRUE(reader != NULL, "reader created");
+    ci_status st = ci_reader_set_backend(reader, CI_BACKEND_IO_URING);
+    if (st == CI_OK) {
+        ASSERT_TRUE(ci_reader_get_backend(reader) == CI_BACKEND_IO_URING, "backend switched");
+        ASSERT_STATUS(CI_INVALID, ci_reader_set_backend(reader, CI_BACKEND_READ));
+    } else {
+        ASSERT_TRUE(ci_reader_get_backend(reader) == CI_BACKEND_READ, "falls back to read(2)");
+    }
+
+    pid_t pid = fork();
+    ASSERT_TRUE(pid >= 0, "fork");
+    if (pid == 0) {
+        close(fds[0]);
+        char line[32];
+        for (int i = 0; i < LINES; i++) {
+            int n = snprintf(line, sizeof(line), "line %d%s", i, (i % 3) ? "\n" : "\r\n");
+            (void)write(fds[1], line, (size_t)n);
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    expect_numbered_lines(reader, LINES);
+    waitpid(pid, NULL, 0);
+    ci_reader_destroy(reader);
+    close(fds[0]);
+
+    /* regular files take the single-read path */
+    FILE *file = tmpfile();
+    ASSERT_TRUE(file != NULL, "tmpfile");
+    for (int i = 0; i < 1000; i++) fprintf(file, "line %d\n", i);
+    fflush(file);
+    rewind(file);
+    reader = ci_reader_create(fileno(file), 512);
+    ASSERT_TRUE(reader != NULL, "reader created");
+    ci_reader_set_backend(reader, CI_BACKEND_IO_URING);
+    expect_numbered_lines(reader, 1000);
+    ci_reader_destroy(reader);
+    fclose(file);
+}
+
 int main(void) {
     test_read_line_ok();
     test_read_line_overflow();
     test_read_line_eof();
+    test_read_line_streams();
     test_prompt_line_overflow_and_retry();
     test_read_int_valid();
     test_read_int_invalid_then_valid();
     test_read_int_overflow();
     test_read_long_valid();
+    test_prompt_policy();
+    test_reader_small_blocks();
+    test_reader_io_uring();
     printf("test_sync passed\n");
     return 0;
 }
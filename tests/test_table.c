@@ -0,0 +1,274 @@
+#include "console_input.h"
+#include "ci_internal.h"
+#include "test.h"
+#include "test_table_cmds.h"
+
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+
+static int quit_calls = 0;
+static int help_calls = 0;
+static int show_calls = 0;
+static int commit_calls = 0;
+static int commit_running = 0;
+static int commit_overlap = 0;
+static int runtime_help_calls = 0;
+static int default_calls = 0;
+
+void on_quit(const char *line, void *user_data) {
+    (void)line;
+    (void)user_data;
+    ci_atomic_add(&quit_calls, 1);
+}
+
+void on_help(const char *line, void *user_data) {
+    (void)line;
+    (void)user_data;
+    ci_atomic_add(&help_calls, 1);
+}
+
+void on_show(const char *line, void *user_data) {
+    (void)user_data;
+    /* "what?\?!" checks that the generated literal isn't read as a trigraph */
+    ASSERT_TRUE(strcmp(line, "show all") == 0 || strcmp(line, "say \"hi\"") == 0 || strcmp(line, "what?\?!") == 0,
+                "quoted names in the spec");
+    ci_atomic_add(&show_calls, 1);
+}
+
+void on_commit(const char *line, void *user_data) {
+    (void)line;
+    (void)user_data;
+    if (ci_atomic_add(&commit_running, 1) != 1) ci_atomic_store(&commit_overlap, 1);
+    usleep(200);
+    ci_atomic_sub(&commit_running, 1);
+    ci_atomic_add(&commit_calls, 1);
+}
+
+static void runtime_help_cb(const char *line, void *user_data) {
+    (void)line;
+    (void)user_data;
+    runtime_help_calls++;
+}
+
+static void default_cb(const char *line, void *user_data) {
+    (void)line;
+    (void)user_data;
+    default_calls++;
+}
+
+static void reset_calls(void) {
+    quit_calls = help_calls = show_calls = commit_calls = 0;
+    runtime_help_calls = default_calls = 0;
+}
+
+/* Write lines to a pollable context and dispatch until `lines` callbacks have run. */
+static void feed(ci_context *ctx, int write_fd, const char *text, int lines) {
+    ASSERT_TRUE(write(write_fd, text, strlen(text)) == (ssize_t)strlen(text), "write");
+    struct pollfd pfd = {ci_context_get_fd(ctx), POLLIN, 0};
+    for (int tries = 0; tries < 100; tries++) {
+        if (quit_calls + help_calls + show_calls + commit_calls + runtime_help_calls + default_calls >= lines) break;
+        ASSERT_TRUE(poll(&pfd, 1, 1000) == 1, "input should become readable");
+        ASSERT_STATUS(CI_OK, ci_context_process_ready(ctx));
+    }
+}
+
+static void test_static_table(void) {
+    int fds[2];
+    ASSERT_TRUE(pipe(fds) == 0, "pipe");
+    ci_context *ctx = ci_context_create(fds[0], NULL);
+    ASSERT_TRUE(ctx != NULL, "context should be created");
+    ASSERT_STATUS(CI_OK, ci_context_set_command_table(ctx, &test_commands));
+    ASSERT_STATUS(CI_OK, ci_context_enable_stats(ctx, true));
+    ASSERT_TRUE(test_commands_commands[0].flags == CI_CMD_PRIORITY && test_commands_commands[4].flags == CI_CMD_SERIAL,
+                "flags from the spec");
+
+    ci_async_options opts = {0};
+    opts.pollable = true;
+    ASSERT_STATUS(CI_OK, ci_context_start(ctx, NULL, default_cb, NULL, &opts));
+    reset_calls();
+    feed(ctx, fds[1], "quit\nhelp\nshow all\nsay \"hi\"\nwhat?\?!\nshow\nquit \nquit\n", 8);
+    ASSERT_EQ_INT(2, quit_calls);
+    ASSERT_EQ_INT(1, help_calls);
+    ASSERT_EQ_INT(3, show_calls);
+    ASSERT_EQ_INT(2, default_calls);
+
+    /* a registered command of the same name wins over the table */
+    ASSERT_STATUS(CI_OK, ci_context_register_command(ctx, "help", runtime_help_cb, NULL, 0));
+    reset_calls();
+    feed(ctx, fds[1], "help\nquit\n", 2);
+    ASSERT_EQ_INT(1, runtime_help_calls);
+    ASSERT_EQ_INT(0, help_calls);
+    ASSERT_EQ_INT(1, quit_calls);
+
+    ci_latency_stats quit;
+    ASSERT_STATUS(CI_OK, ci_context_get_command_stats(ctx, "quit", &quit));
+    ASSERT_EQ_INT(3, (int)quit.count);
+    ASSERT_STATUS(CI_OK, ci_context_reset_stats(ctx));
+    ASSERT_STATUS(CI_OK, ci_context_get_command_stats(ctx, "quit", &quit));
+    ASSERT_EQ_INT(0, (int)quit.count);
+
+    /* stop clears the registered overlay but keeps the table */
+    ci_context_stop(ctx);
+    ASSERT_STATUS(CI_OK, ci_context_start(ctx, NULL, default_cb, NULL, &opts));
+    reset_calls();
+    feed(ctx, fds[1], "help\nquit\n", 2);
+    ASSERT_EQ_INT(0, runtime_help_calls);
+    ASSERT_EQ_INT(1, help_calls);
+    ASSERT_EQ_INT(1, quit_calls);
+
+    /* removing the table makes every line a miss */
+    ASSERT_STATUS(CI_OK, ci_context_set_command_table(ctx, NULL));
+    reset_calls();
+    feed(ctx, fds[1], "help\nquit\n", 2);
+    ASSERT_EQ_INT(2, default_calls);
+    ASSERT_EQ_INT(0, help_calls + quit_calls);
+
+    ci_context_destroy(ctx);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_serial_through_workers(void) {
+    int fds[2];
+    ASSERT_TRUE(pipe(fds) == 0, "pipe");
+    ci_context *ctx = ci_context_create(fds[0], NULL);
+    ASSERT_TRUE(ctx != NULL, "context should be created");
+    ASSERT_STATUS(CI_OK, ci_context_set_command_table(ctx, &test_commands));
+
+    ci_async_options opts = {0};
+    opts.workers = 4;
+    reset_calls();
+    commit_overlap = 0;
+    ASSERT_STATUS(CI_OK, ci_context_start(ctx, NULL, default_cb, NULL, &opts));
+    for (int i = 0; i < 50; i++) ASSERT_TRUE(write(fds[1], "commit\nquit\n", 12) == 12, "write");
+    close(fds[1]);
+    for (int tries = 0; tries < 400 && ci_context_is_running(ctx); tries++) wait_millis(5);
+    ASSERT_TRUE(!ci_context_is_running(ctx), "context should stop at end of input");
+    ASSERT_EQ_INT(50, commit_calls);
+    ASSERT_EQ_INT(50, quit_calls);
+    ASSERT_EQ_INT(0, commit_overlap);
+
+    ci_context_destroy(ctx);
+    close(fds[0]);
+}
+
+static void test_invalid_tables(void) {
+    ci_context *ctx = ci_context_create(STDIN_FILENO, NULL);
+    ASSERT_TRUE(ctx != NULL, "context should be created");
+    ASSERT_STATUS(CI_INVALID, ci_context_set_command_table(NULL, &test_commands));
+
+    /* every damage to the generated table must be caught */
+    uint32_t slots[sizeof(test_commands_slots) / sizeof(test_commands_slots[0])];
+    ci_command_def defs[sizeof(test_commands_commands) / sizeof(test_commands_commands[0])];
+    for (int damage = 0; damage < 7; damage++) {
+        ci_command_table table = test_commands;
+        memcpy(slots, test_commands_slots, sizeof(slots));
+        memcpy(defs, test_commands_commands, sizeof(defs));
+        table.slots = slots;
+        table.commands = defs;
+        if (damage == 0) table.seed++;
+        if (damage == 1) table.slot_mask = 6;
+        if (damage == 2) table.count = table.slot_mask + 1;
+        if (damage == 3) defs[1].callback = NULL;
+        if (damage == 4) defs[2].len--;
+        if (damage == 6) defs[0].flags |= CI_CMD_SERIAL; /* one lane per command */
+        if (damage == 5) {
+            size_t a = 0, b = 0;
+            while (slots[a] == 0) a++;
+            for (b = a + 1; slots[b] == 0; b++) {
+            }
+            uint32_t t = slots[a];
+            slots[a] = slots[b];
+            slots[b] = t;
+        }
+        ASSERT_STATUS(CI_INVALID, ci_context_set_command_table(ctx, &table));
+    }
+    ci_context_destroy(ctx);
+}
+
+static void test_phash_build(void) {
+    enum { KEYS = 5000 };
+    static char storage[KEYS][16];
+    static const char *names[KEYS];
+    static size_t lens[KEYS];
+    for (size_t i = 0; i < KEYS; i++) {
+        lens[i] = (size_t)snprintf(storage[i], sizeof(storage[i]), "cmd%zu", i);
+        names[i] = storage[i];
+    }
+
+    /* counts around the power-of-two boundaries of both masks */
+    static const size_t counts[] = {1, 2, 3, 4, 5, 8, 9, 63, 64, 65, 1000, KEYS};
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        ci_phash ph;
+        ASSERT_TRUE(ci_phash_build(names, lens, counts[c], &ph), "perfect hash found");
+        ASSERT_TRUE(ph.slot_mask + 1 >= counts[c], "a slot per key");
+        for (size_t i = 0; i < counts[c]; i++) {
+            size_t s = ci_phash_slot(ci_hash_seeded(names[i], lens[i], ph.seed), ph.displace, ph.bucket_mask,
+                                     ph.slot_mask);
+            ASSERT_TRUE(ph.slots[s] == i + 1, "each key in its own slot");
+        }
+        ci_phash_free(&ph);
+    }
+
+    /* duplicates can never be placed */
+    ci_phash ph;
+    names[1] = names[0];
+    lens[1] = lens[0];
+    ASSERT_TRUE(!ci_phash_build(names, lens, 8, &ph), "duplicate keys rejected");
+}
+
+static int dyn_registered = 0;
+static int dyn_late = 0;
+
+static void dyn_cb(const char *line, void *user_data) {
+    (void)line;
+    (void)user_data;
+    if (!ci_atomic_load(&dyn_registered)) ci_atomic_store(&dyn_late, 1);
+}
+
+typedef struct {
+    ci_registry *reg;
+    int done;
+} race_reader;
+
+static void *race_reader_main(void *arg) {
+    race_reader *r = arg;
+    ci_command_entry entry;
+    while (!ci_atomic_load(&r->done)) {
+        ci_registry_dispatch(r->reg, "dyn", 3, NULL);
+        ci_registry_lookup(r->reg, "help", 4, &entry);
+    }
+    return NULL;
+}
+
+static void test_snapshot_race(void) {
+    /* with only the static table, readers skip the section: a command published meanwhile
+       must not be probed outside one, nor run after its unregister returned */
+    ci_registry reg;
+    ci_registry_init(&reg);
+    ASSERT_STATUS(CI_OK, ci_registry_set_table(&reg, &test_commands));
+    race_reader r = {&reg, 0};
+    pthread_t threads[2];
+    for (int i = 0; i < 2; i++) ASSERT_TRUE(pthread_create(&threads[i], NULL, race_reader_main, &r) == 0, "reader");
+    for (int i = 0; i < 20000; i++) {
+        ci_atomic_store(&dyn_registered, 1);
+        ASSERT_STATUS(CI_OK, ci_registry_put(&reg, "dyn", dyn_cb, NULL, 0));
+        ASSERT_STATUS(CI_OK, ci_registry_remove(&reg, "dyn"));
+        ci_atomic_store(&dyn_registered, 0);
+    }
+    ci_atomic_store(&r.done, 1);
+    for (int i = 0; i < 2; i++) pthread_join(threads[i], NULL);
+    ASSERT_TRUE(!dyn_late, "no callback runs after ci_registry_remove returned");
+    ci_registry_destroy(&reg);
+}
+
+int main(void) {
+    test_static_table();
+    test_serial_through_workers();
+    test_invalid_tables();
+    test_phash_build();
+    test_snapshot_race();
+    printf("test_table passed\n");
+    return 0;
+}
@@ -0,0 +1,225 @@
+#include "console_input.h"
+#include "ci_internal.h"
+#include "test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    const char *name; /* which callback ran */
+    char args[CI_MAX_ARGS][64];
+    size_t argc;
+    int calls;
+} verb_log;
+
+static void record(verb_log *log, const char *name, const ci_arg *argv, size_t argc) {
+    log->name = name;
+    log->argc = argc;
+    log->calls++;
+    for (size_t i = 0; i < argc && i < CI_MAX_ARGS; i++) {
+        size_t n = argv[i].len < 63 ? argv[i].len : 63;
+        memcpy(log->args[i], argv[i].ptr, n);
+        log->args[i][n] = '\0';
+    }
+}
+
+static void set_cb(const char *line, const ci_arg *argv, size_t argc, void *user_data) {
+    (void)line;
+    record(user_data, "set", argv, argc);
+}
+
+static void show_cb(const char *line, const ci_arg *argv, size_t argc, void *user_data) {
+    (void)line;
+    record(user_data, "show", argv, argc);
+}
+
+static void show_stats_cb(const char *line, const ci_arg *argv, size_t argc, void *user_data) {
+    (void)line;
+    record(user_data, "show stats", argv, argc);
+}
+
+static void nocase_cb(const char *line, const ci_arg *argv, size_t argc, void *user_data) {
+    (void)line;
+    record(user_data, "nocase", argv, argc);
+}
+
+static void exact_cb(const char *line, void *user_data) {
+    verb_log *log = user_data;
+    (void)line;
+    log->name = "exact";
+    log->argc = 0;
+    log->calls++;
+}
+
+/* Dispatch a line and return the callback that ran, or NULL. */
+static const char *run(ci_registry *reg, verb_log *log, const char *line) {
+    log->name = NULL;
+    log->argc = 0;
+    return ci_registry_dispatch(reg, line, strlen(line), NULL) ? log->name : NULL;
+}
+
+static void test_split_args(void) {
+    ci_arg argv[4];
+    const char *text = "  put \"two words\"\tx  ";
+    size_t argc = ci_split_args(text, strlen(text), argv, 4);
+    ASSERT_EQ_INT(3, (int)argc);
+    ASSERT_TRUE(argv[0].ptr == text + 2 && argv[0].len == 3, "views point into the line");
+    ASSERT_TRUE(argv[1].len == 9 && memcmp(argv[1].ptr, "two words", 9) == 0, "quotes group and are dropped");
+    ASSERT_TRUE(argv[2].len == 1 && argv[2].ptr[0] == 'x', "tabs separate");
+
+    text = "a b c d e f";
+    argc = ci_split_args(text, strlen(text), argv, 4);
+    ASSERT_EQ_INT(4, (int)argc);
+    ASSERT_TRUE(argv[3].len == 5 && memcmp(argv[3].ptr, "d e f", 5) == 0, "last slot keeps the rest");
+
+    text = "say \"unterminated";
+    argc = ci_split_args(text, strlen(text), argv, 4);
+    ASSERT_EQ_INT(2, (int)argc);
+    ASSERT_TRUE(argv[1].len == 12, "unterminated quote runs to the end");
+
+    text = "\"\" x";
+    argc = ci_split_args(text, strlen(text), argv, 4);
+    ASSERT_TRUE(argc == 2 && argv[0].len == 0, "empty quoted argument");
+    ASSERT_EQ_INT(0, (int)ci_split_args("   ", 3, argv, 4));
+    ASSERT_EQ_INT(0, (int)ci_split_args("a", 1, argv, 0));
+}
+
+static void test_verb_matching(void) {
+    ci_registry reg;
+    ci_registry_init(&reg);
+    verb_log log = {0};
+
+    ASSERT_STATUS(CI_OK, ci_registry_put_verb(&reg, "set", set_cb, &log, 0));
+    ASSERT_STATUS(CI_OK, ci_registry_put_verb(&reg, "show", show_cb, &log, 0));
+    ASSERT_STATUS(CI_OK, ci_registry_put_verb(&reg, "show stats", show_stats_cb, &log, 0));
+
+    ASSERT_STR_EQ("set", run(&reg, &log, "set x 5"));
+    ASSERT_EQ_INT(3, (int)log.argc);
+    ASSERT_STR_EQ("set", log.args[0]);
+    ASSERT_STR_EQ("x", log.args[1]);
+    ASSERT_STR_EQ("5", log.args[2]);
+    ASSERT_STR_EQ("set", run(&reg, &log, "set"));
+    ASSERT_EQ_INT(1, (int)log.argc);
+    ASSERT_TRUE(run(&reg, &log, "settings") == NULL, "a verb matches whole words only");
+    ASSERT_TRUE(run(&reg, &log, "Set x") == NULL, "case-sensitive by default");
+    ASSERT_TRUE(run(&reg, &log, " set x") == NULL, "verbs start the line");
+
+    /* longest verb wins, and blank runs in the line match a verb's space */
+    ASSERT_STR_EQ("show stats", run(&reg, &log, "show \t stats now"));
+    ASSERT_STR_EQ("show \t stats", log.args[0]);
+    ASSERT_STR_EQ("now", log.args[1]);
+    ASSERT_STR_EQ("show", run(&reg, &log, "show statsx"));
+    ASSERT_STR_EQ("statsx", log.args[1]);
+    ASSERT_STR_EQ("show", run(&reg, &log, "show"));
+
+    /* case-insensitive verbs; a case-sensitive verb of the same length wins */
+    ASSERT_STATUS(CI_OK, ci_registry_put_verb(&reg, "GET", nocase_cb, &log, CI_CMD_NOCASE));
+    ASSERT_STR_EQ("nocase", run(&reg, &log, "get a"));
+    ASSERT_STR_EQ("nocase", run(&reg, &log, "gEt"));
+    ASSERT_STATUS(CI_OK, ci_registry_put_verb(&reg, "SET", nocase_cb, &log, CI_CMD_NOCASE));
+    ASSERT_STR_EQ("set", run(&reg, &log, "set a"));
+    ASSERT_STR_EQ("nocase", run(&reg, &log, "SeT a"));
+    /* a NOCASE verb replaces one that folds to the same name */
+    ASSERT_STATUS(CI_OK, ci_registry_put_verb(&reg, "get", set_cb, &log, CI_CMD_NOCASE));
+    ASSERT_STR_EQ("set", run(&reg, &log, "GET"));
+    ASSERT_STATUS(CI_INVALID, ci_registry_remove_verb(&reg, "GET"));
+    ASSERT_STATUS(CI_OK, ci_registry_remove_verb(&reg, "get"));
+    ASSERT_TRUE(run(&reg, &log, "get") == NULL, "removed");
+
+    /* exact commands are tried first */
+    ASSERT_STATUS(CI_OK, ci_registry_put(&reg, "set all", exact_cb, &log, 0));
+    ASSERT_STR_EQ("exact", run(&reg, &log, "set all"));
+    ASSERT_STR_EQ("set", run(&reg, &log, "set all now"));
+
+    /* replacing and removing verbs */
+    ASSERT_STATUS(CI_OK, ci_registry_put_verb(&reg, "show", set_cb, &log, 0));
+    ASSERT_STR_EQ("set", run(&reg, &log, "show x"));
+    ASSERT_STATUS(CI_OK, ci_registry_remove_verb(&reg, "show stats"));
+    ASSERT_STR_EQ("set", run(&reg, &log, "show stats"));
+    ASSERT_STATUS(CI_INVALID, ci_registry_remove_verb(&reg, "show stats"));
+
+    /* lookup reports the flags used to route lines to workers */
+    ASSERT_STATUS(CI_OK, ci_registry_put_verb(&reg, "commit", set_cb, &log, CI_CMD_SERIAL));
+    ci_command_entry entry;
+    ASSERT_TRUE(ci_registry_lookup(&reg, "commit now", 10, &entry), "verb found by lookup");
+    ASSERT_TRUE(entry.args_cb == set_cb && (entry.flags & CI_CMD_SERIAL), "verb entry");
+
+    ci_registry_clear(&reg);
+    ASSERT_TRUE(run(&reg, &log, "set x") == NULL, "clear removes verbs");
+    ci_registry_destroy(&reg);
+}
+
+static void test_many_verbs(void) {
+    enum { VERBS = 2000 };
+    ci_registry reg;
+    ci_registry_init(&reg);
+    verb_log log = {0};
+    char name[32];
+    for (int i = 0; i < VERBS; i++) {
+        /* verbs sharing long prefixes, some of them multi-word */
+        snprintf(name, sizeof(name), i % 3 ? "cmd%d" : "cmd %d", i);
+        ASSERT_STATUS(CI_OK, ci_registry_put_verb(&reg, name, set_cb, &log, i % 2 ? CI_CMD_NOCASE : 0));
+    }
+    for (int i = 0; i < VERBS; i++) {
+        char line[64];
+        snprintf(line, sizeof(line), i % 3 ? "%s%d arg" : "%s %d arg", i % 2 ? "CMD" : "cmd", i);
+        ASSERT_STR_EQ("set", run(&reg, &log, line));
+        ASSERT_EQ_INT(2, (int)log.argc);
+        ASSERT_STR_EQ("arg", log.args[1]);
+    }
+    ASSERT_TRUE(run(&reg, &log, "cmd") == NULL, "prefix of verbs only");
+    ci_registry_destroy(&reg);
+}
+
+static void verb_count_cb(const char *line, const ci_arg *argv, size_t argc, void *user_data) {
+    (void)line;
+    if (argc == 3 && argv[2].len == 1 && argv[2].ptr[0] == '1') ci_atomic_add((int *)user_data, 1);
+}
+
+static void test_context_verbs(void) {
+    ci_context *ctx = ci_context_create(STDIN_FILENO, NULL);
+    ASSERT_TRUE(ctx != NULL, "context should be created");
+    int hits = 0;
+    static const char *bad[] = {"", " set", "set ", "set  x", "set\tx"};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        ASSERT_STATUS(CI_INVALID, ci_context_register_verb(ctx, bad[i], verb_count_cb, &hits, 0));
+    }
+    ASSERT_STATUS(CI_INVALID, ci_context_register_verb(ctx, NULL, verb_count_cb, &hits, 0));
+    ASSERT_STATUS(CI_INVALID, ci_context_register_verb(ctx, "set", NULL, &hits, 0));
+    ASSERT_STATUS(CI_INVALID, ci_context_register_command(ctx, "set", exact_cb, NULL, CI_CMD_NOCASE));
+    ASSERT_STATUS(CI_INVALID, ci_context_register_command(ctx, "set", exact_cb, NULL, CI_CMD_SERIAL | CI_CMD_PRIORITY));
+    ASSERT_STATUS(CI_INVALID,
+                  ci_context_register_verb(ctx, "set", verb_count_cb, &hits, CI_CMD_SERIAL | CI_CMD_PRIORITY));
+    ASSERT_STATUS(CI_INVALID, ci_context_unregister_verb(ctx, "set"));
+
+    /* through ci_process_file's threads, with stats on */
+    char path[] = "/tmp/ci_verb_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_TRUE(fd >= 0, "mkstemp");
+    FILE *f = fdopen(fd, "w");
+    for (int i = 0; i < 1000; i++) fprintf(f, "%s key%d %d\n", i % 2 ? "SET" : "set", i, i % 4 == 1);
+    fclose(f);
+    ASSERT_STATUS(CI_OK, ci_context_enable_stats(ctx, true));
+    ASSERT_STATUS(CI_OK, ci_context_register_verb(ctx, "set", verb_count_cb, &hits, CI_CMD_NOCASE));
+    ci_file_options opts = {0};
+    opts.threads = 3;
+    opts.chunk_size = 512;
+    ASSERT_STATUS(CI_OK, ci_context_process_file(ctx, path, NULL, NULL, &opts));
+    ASSERT_EQ_INT(250, hits);
+    ci_latency_stats set;
+    ASSERT_STATUS(CI_OK, ci_context_get_command_stats(ctx, "set", &set));
+    ASSERT_EQ_INT(1000, (int)set.count);
+
+    ASSERT_STATUS(CI_OK, ci_context_unregister_verb(ctx, "set"));
+    ci_context_destroy(ctx);
+    unlink(path);
+}
+
+int main(void) {
+    test_split_args();
+    test_verb_matching();
+    test_many_verbs();
+    test_context_verbs();
+    printf("test_verb passed\n");
+    return 0;
+}
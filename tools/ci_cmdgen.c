@@ -0,0 +1,219 @@
+#include "console_input.h"
+#include "ci_internal.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Build-time generator for static command tables. Reads a spec with one
+ * command per line:
+ *
+ *     # name      callback     [serial | priority]
+ *     quit        on_quit      priority
+ *     "show all"  on_show_all
+ *     commit      on_commit    serial
+ *
+ * and writes a header defining a ci_command_table called NAME whose perfect
+ * hash was found here, plus prototypes for the callbacks (define them with
+ * external linkage). Names with spaces are quoted; \" and \\ escape inside quotes.
+ *
+ * usage: ci_cmdgen NAME SPEC OUT
+ */
+
+#define CMDGEN_LINE_MAX 4096
+
+typedef struct {
+    char *name;
+    size_t len;
+    char *callback;
+    bool serial;
+    bool priority;
+} cmdgen_entry;
+
+static void die(const char *spec, size_t lineno, const char *msg) {
+    if (lineno) {
+        fprintf(stderr, "%s:%zu: %s\n", spec, lineno, msg);
+    } else {
+        fprintf(stderr, "ci_cmdgen: %s: %s\n", spec, msg);
+    }
+    exit(1);
+}
+
+static bool is_identifier(const char *s) {
+    if (!isalpha((unsigned char)*s) && *s != '_') return false;
+    for (; *s; s++) {
+        if (!isalnum((unsigned char)*s) && *s != '_') return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Take the next field of a spec line: a bare word or a quoted string.
+ * @param p In/out cursor.
+ * @param out Output field (unescaped, NUL-terminated in place).
+ * @param len Output field length.
+ * @return false at end of line or on an unterminated quote (*len == SIZE_MAX).
+ */
+static bool next_field(char **p, char **out, size_t *len) {
+    char *s = *p;
+    while (*s == ' ' || *s == '\t') s++;
+    if (*s == '\0' || *s == '#') return false;
+
+    if (*s != '"') {
+        *out = s;
+        while (*s && *s != ' ' && *s != '\t') s++;
+        *len = (size_t)(s - *out);
+        if (*s) *s++ = '\0';
+        *p = s;
+        return true;
+    }
+
+    char *dst = ++s;
+    *out = dst;
+    for (; *s && *s != '"'; s++) {
+        if (*s == '\\' && (s[1] == '"' || s[1] == '\\')) s++;
+        *dst++ = *s;
+    }
+    if (*s != '"') {
+        *len = SIZE_MAX;
+        return false;
+    }
+    *len = (size_t)(dst - *out);
+    *dst = '\0';
+    *p = s + 1;
+    return true;
+}
+
+/**
+ * @brief Write a command name as a C string literal.
+ * @note '?' is escaped, since -std=c99 would read "??/" or "??!" in the literal as a trigraph.
+ */
+static void put_literal(FILE *out, const char *s, size_t len) {
+    fputc('"', out);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\' || c == '?') {
+            fprintf(out, "\\%c", c);
+        } else if (isprint(c)) {
+            fputc(c, out);
+        } else {
+            fprintf(out, "\\%03o", c); /* always three digits, so a following digit can't join it */
+        }
+    }
+    fputc('"', out);
+}
+
+static void put_array(FILE *out, const char *table, const char *suffix, const uint32_t *values, size_t count) {
+    fprintf(out, "static const uint32_t %s_%s[%zu] = {", table, suffix, count);
+    for (size_t i = 0; i < count; i++) fprintf(out, "%s%s%u", i ? "," : "", i % 16 ? " " : "\n    ", values[i]);
+    fprintf(out, "\n};\n\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: ci_cmdgen NAME SPEC OUT\n");
+        return 2;
+    }
+    const char *table = argv[1];
+    const char *spec = argv[2];
+    if (!is_identifier(table)) die(spec, 0, "table name must be a C identifier");
+
+    FILE *in = fopen(spec, "r");
+    if (!in) die(spec, 0, "can't open spec");
+    cmdgen_entry *entries = NULL;
+    size_t count = 0, cap = 0, lineno = 0;
+    char buf[CMDGEN_LINE_MAX];
+    while (fgets(buf, sizeof(buf), in)) {
+        lineno++;
+        buf[strcspn(buf, "\r\n")] = '\0';
+        char *p = buf, *name, *callback, *flag;
+        size_t len, cb_len, flag_len;
+        if (!next_field(&p, &name, &len)) {
+            if (len == SIZE_MAX) die(spec, lineno, "unterminated quote");
+            continue;
+        }
+        if (!next_field(&p, &callback, &cb_len) || !is_identifier(callback)) {
+            die(spec, lineno, "expected: name callback [serial | priority]");
+        }
+        bool serial = false, priority = false;
+        while (next_field(&p, &flag, &flag_len)) {
+            if (strcmp(flag, "serial") == 0 && !serial) {
+                serial = true;
+            } else if (strcmp(flag, "priority") == 0 && !priority) {
+                priority = true;
+            } else {
+                die(spec, lineno, "unknown or repeated flag (only 'serial' and 'priority')");
+            }
+        }
+        if (serial && priority) die(spec, lineno, "'serial' and 'priority' can't be combined");
+        if (memchr(name, '\0', len) || memchr(name, '\n', len)) die(spec, lineno, "bad command name");
+
+        if (count == cap) {
+            cap = cap ? cap * 2 : 16;
+            entries = realloc(entries, cap * sizeof(*entries));
+            if (!entries) die(spec, 0, "out of memory");
+        }
+        entries[count].name = malloc(len + 1);
+        entries[count].callback = malloc(cb_len + 1);
+        if (!entries[count].name || !entries[count].callback) die(spec, 0, "out of memory");
+        memcpy(entries[count].name, name, len + 1);
+        memcpy(entries[count].callback, callback, cb_len + 1);
+        entries[count].len = len;
+        entries[count].serial = serial;
+        entries[count].priority = priority;
+        count++;
+    }
+    fclose(in);
+    if (count == 0) die(spec, 0, "no commands");
+
+    const char **names = malloc(count * sizeof(*names));
+    size_t *lens = malloc(count * sizeof(*lens));
+    if (!names || !lens) die(spec, 0, "out of memory");
+    for (size_t i = 0; i < count; i++) {
+        names[i] = entries[i].name;
+        lens[i] = entries[i].len;
+        for (size_t j = 0; j < i; j++) {
+            if (lens[j] == lens[i] && memcmp(names[j], names[i], lens[i]) == 0) die(spec, 0, "duplicate command");
+        }
+    }
+    ci_phash ph;
+    if (!ci_phash_build(names, lens, count, &ph)) die(spec, 0, "no perfect hash found");
+
+    FILE *out = fopen(argv[3], "w");
+    if (!out) die(argv[3], 0, "can't create output");
+    fprintf(out, "/* Generated by tools/ci_cmdgen from %s; do not edit. */\n", spec);
+    fprintf(out, "#ifndef CI_CMDGEN_%s_H\n#define CI_CMDGEN_%s_H\n\n#include \"console_input.h\"\n\n", table, table);
+    for (size_t i = 0; i < count; i++) {
+        bool seen = false;
+        for (size_t j = 0; j < i && !seen; j++) seen = strcmp(entries[j].callback, entries[i].callback) == 0;
+        if (!seen) fprintf(out, "void %s(const char *line, void *user_data);\n", entries[i].callback);
+    }
+
+    fprintf(out, "\nstatic const ci_command_def %s_commands[%zu] = {\n", table, count);
+    for (size_t i = 0; i < count; i++) {
+        fputs("    {", out);
+        put_literal(out, entries[i].name, entries[i].len);
+        const char *flags = entries[i].serial ? "CI_CMD_SERIAL" : entries[i].priority ? "CI_CMD_PRIORITY" : "0";
+        fprintf(out, ", %zu, %s, NULL, %s},\n", entries[i].len, entries[i].callback, flags);
+    }
+    fprintf(out, "};\n\n");
+    put_array(out, table, "displace", ph.displace, ph.bucket_mask + 1);
+    put_array(out, table, "slots", ph.slots, ph.slot_mask + 1);
+    fprintf(out,
+            "static const ci_command_table %s = {%s_commands, %zu, %lluull, %s_displace, %zu, %s_slots, %zu};\n\n"
+            "#endif\n",
+            table, table, count, (unsigned long long)ph.seed, table, ph.bucket_mask, table, ph.slot_mask);
+    if (fclose(out) != 0) die(argv[3], 0, "write failed");
+
+    ci_phash_free(&ph);
+    for (size_t i = 0; i < count; i++) {
+        free(entries[i].name);
+        free(entries[i].callback);
+    }
+    free(entries);
+    free(names);
+    free(lens);
+    return 0;
+}